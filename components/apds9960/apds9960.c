@@ -13,148 +13,230 @@
 // limitations under the License.
 
 #include <stdio.h>
-#include "driver/i2c.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "apds9960.h"
 
 #define APDS9960_TIMEOUT_MS_DEFAULT   (1000)
+#define APDS9960_GESTURE_BUDGET_MS    (10)   /* FIFO reads give up early, the next poll retries */
+#define APDS9960_STATUS_COALESCE_US   (1000) /* tasks polling data ready of different engines share a STATUS read */
+#define APDS9960_GFIFO_DEPTH          (32)   /* datasets the gesture FIFO holds */
+#define APDS9960_GESTURE_RING_LEN     (64)   /* two full FIFOs, the recogniser may lag one drain behind */
+#define APDS9960_GESTURE_RATIO_ONE    (256)  /* channel ratios are Q8 */
+#define APDS9960_GESTURE_WINDOW_MIN   (2)    /* a fast swipe crosses the sensor in two datasets */
+#define APDS9960_GESTURE_WINDOW_MAX   (128)  /* about 0.5 s of datasets, keeps the trajectory sums in 32 bits */
+#define APDS9960_GESTURE_EXIT_DATASETS (2)   /* datasets without a hand in view that close a window */
+#define APDS9960_GESTURE_DEPTH_PCT    (50)   /* level change over the peak level that makes a NEAR or FAR */
+
+/* FIFO level asserting INT in interrupt mode, a gesture end asserts it earlier */
+#if defined(CONFIG_APDS9960_GESTURE_IRQ_FIFOTH_16)
+#define APDS9960_GESTURE_IRQ_FIFOTH   APDS9960_GFIFO_16
+#elif defined(CONFIG_APDS9960_GESTURE_IRQ_FIFOTH_8)
+#define APDS9960_GESTURE_IRQ_FIFOTH   APDS9960_GFIFO_8
+#elif defined(CONFIG_APDS9960_GESTURE_IRQ_FIFOTH_4)
+#define APDS9960_GESTURE_IRQ_FIFOTH   APDS9960_GFIFO_4
+#else
+#define APDS9960_GESTURE_IRQ_FIFOTH   APDS9960_GFIFO_1
+#endif
+
+/* Registers updated by the device itself, all others are served from the i2c_bus register cache */
+static const uint8_t apds9960_volatile_regs[] = {
+    APDS9960_STATUS, APDS9960_CDATAL, APDS9960_CDATAH, APDS9960_RDATAL, APDS9960_RDATAH,
+    APDS9960_GDATAL, APDS9960_GDATAH, APDS9960_BDATAL, APDS9960_BDATAH, APDS9960_PDATA,
+    APDS9960_GCONF4, APDS9960_GFLVL, APDS9960_GSTATUS, APDS9960_IFORCE, APDS9960_PICLEAR,
+    APDS9960_CICLEAR, APDS9960_AICLEAR, APDS9960_GFIFO_U, APDS9960_GFIFO_D, APDS9960_GFIFO_L,
+    APDS9960_GFIFO_R,
+};
+
+/* Configuration registers shadowed by the driver: X(name, address, reset value), in address order */
+#define APDS9960_SHADOW_REGS(X)                 \
+    X(ENABLE,  APDS9960_MODE_ENABLE, 0x00)      \
+    X(PERS,    APDS9960_PERS,        0x00)      \
+    X(CONFIG1, APDS9960_CONFIG1,     0x40)      \
+    X(PPULSE,  APDS9960_PPULSE,      0x40)      \
+    X(CONTROL, APDS9960_CONTROL,     0x00)      \
+    X(CONFIG2, APDS9960_CONFIG2,     0x01)      \
+    X(CONFIG3, APDS9960_CONFIG3,     0x00)      \
+    X(GCONF1,  APDS9960_GCONF1,      0x00)      \
+    X(GCONF2,  APDS9960_GCONF2,      0x00)      \
+    X(GPULSE,  APDS9960_GPULSE,      0x40)      \
+    X(GCONF3,  APDS9960_GCONF3,      0x00)      \
+    X(GCONF4,  APDS9960_GCONF4,      0x00)
+
+/* Fields of the shadowed registers: X(register, name, shift, width) */
+#define APDS9960_CONFIG_FIELDS(X)                                                       \
+    X(ENABLE, pon, 0, 1) X(ENABLE, aen, 1, 1) X(ENABLE, pen, 2, 1) X(ENABLE, wen, 3, 1) \
+    X(ENABLE, aien, 4, 1) X(ENABLE, pien, 5, 1) X(ENABLE, gen, 6, 1)                    \
+    X(PERS, apers, 0, 4) X(PERS, ppers, 4, 4)                                           \
+    X(CONFIG1, wlong, 1, 1)                                                             \
+    X(PPULSE, ppulse, 0, 6) X(PPULSE, pplen, 6, 2)                                      \
+    X(CONTROL, again, 0, 2) X(CONTROL, pgain, 2, 2) X(CONTROL, leddrive, 6, 2)          \
+    X(CONFIG2, led_boost, 4, 2) X(CONFIG2, cpsien, 6, 1) X(CONFIG2, psien, 7, 1)        \
+    X(CONFIG3, pmask_r, 0, 1) X(CONFIG3, pmask_l, 1, 1) X(CONFIG3, pmask_d, 2, 1)       \
+    X(CONFIG3, pmask_u, 3, 1) X(CONFIG3, sai, 4, 1) X(CONFIG3, pcmp, 5, 1)              \
+    X(GCONF1, gexpers, 0, 2) X(GCONF1, gexmsk, 2, 4) X(GCONF1, gfifoth, 6, 2)           \
+    X(GCONF2, gwtime, 0, 3) X(GCONF2, gldrive, 3, 2) X(GCONF2, ggain, 5, 2)             \
+    X(GPULSE, gpulse, 0, 6) X(GPULSE, gplen, 6, 2)                                      \
+    X(GCONF3, gdims, 0, 2)                                                              \
+    X(GCONF4, gmode, 0, 1) X(GCONF4, gien, 1, 1)
+
+/* Fields of the status registers, decoded from the last read value */
+#define APDS9960_STATUS_FIELDS(X)                                                                \
+    X(STATUS, avalid, 0, 1) X(STATUS, pvalid, 1, 1) X(STATUS, gint, 2, 1) X(STATUS, aint, 4, 1) \
+    X(STATUS, pint, 5, 1) X(STATUS, pgsat, 6, 1) X(STATUS, cpsat, 7, 1)                         \
+    X(GSTATUS, gvalid, 0, 1) X(GSTATUS, gfov, 1, 1)
+
+#define APDS9960_SHADOW_INDEX(name, addr, reset) APDS9960_SHADOW_##name,
+#define APDS9960_SHADOW_ADDR(name, addr, reset) addr,
+#define APDS9960_SHADOW_RESET(name, addr, reset) reset,
+#define APDS9960_FIELD_REG(reg, name, shift, width) APDS9960_SHADOW_OF_##name = APDS9960_SHADOW_##reg,
+#define APDS9960_FIELD_ACCESSORS(reg, name, shift, width) I2C_BUS_FIELD_ACCESSORS(apds9960_field, name, shift, width)
+
+typedef enum {
+    APDS9960_SHADOW_REGS(APDS9960_SHADOW_INDEX)
+    APDS9960_SHADOW_NUM,
+} apds9960_shadow_t;
+
+enum {
+    APDS9960_CONFIG_FIELDS(APDS9960_FIELD_REG)
+};
+
+APDS9960_CONFIG_FIELDS(APDS9960_FIELD_ACCESSORS)
+APDS9960_STATUS_FIELDS(APDS9960_FIELD_ACCESSORS)
+
+static const uint8_t apds9960_shadow_addr[APDS9960_SHADOW_NUM] = { APDS9960_SHADOW_REGS(APDS9960_SHADOW_ADDR) };
+static const uint8_t apds9960_shadow_reset[APDS9960_SHADOW_NUM] = { APDS9960_SHADOW_REGS(APDS9960_SHADOW_RESET) };
+static const i2c_bus_regmap_t apds9960_shadow_map = { apds9960_shadow_addr, APDS9960_SHADOW_NUM };
+
+/* field of a shadowed register */
+#define APDS9960_GET(sens, name) apds9960_field_##name##_get((sens)->regs[APDS9960_SHADOW_OF_##name])
+#define APDS9960_SET(sens, name, value) \
+    ((sens)->regs[APDS9960_SHADOW_OF_##name] = apds9960_field_##name##_set((sens)->regs[APDS9960_SHADOW_OF_##name], (value)))
+/* set a field and write its register, evaluates to the esp_err_t of the write */
+#define APDS9960_UPDATE(sens, name, value) \
+    (APDS9960_SET(sens, name, value), apds9960_shadow_write(sens, (apds9960_shadow_t) APDS9960_SHADOW_OF_##name))
+
 typedef struct {
     i2c_bus_device_handle_t i2c_dev;
     uint8_t dev_addr;
     uint32_t timeout;
-    apds9960_control_t _control_t; /*< config control register>*/
-    apds9960_enable_t _enable_t;   /*< config enable register>*/
-    apds9960_config1_t _config1_t; /*< config config1 register>*/
-    apds9960_config2_t _config2_t; /*< config config2 register>*/
-    apds9960_config3_t _config3_t; /*< config config3 register>*/
-    apds9960_gconf1_t _gconf1_t;   /*< config gconfig1 register>*/
-    apds9960_gconf2_t _gconf2_t;   /*< config gconfig2 register>*/
-    apds9960_gconf3_t _gconf3_t;   /*< config gconfig3 register>*/
-    apds9960_gconf4_t _gconf4_t;   /*< config gconfig4 register>*/
-    apds9960_status_t _status_t;   /*< config status register>*/
-    apds9960_gstatus_t _gstatus_t; /*< config gstatus register>*/
-    apds9960_propulse_t _ppulse_t; /*< config pro pulse register>*/
-    apds9960_gespulse_t _gpulse_t; /*< config ges pulse register>*/
-    apds9960_pers_t _pers_t;       /*< config pers register>*/
-    uint8_t gest_cnt;              /*< counter of gesture >*/
-    uint8_t up_cnt;                /*< counter of up gesture >*/
-    uint8_t down_cnt;              /*< counter of down gesture >*/
-    uint8_t left_cnt;              /*< counter of left gesture >*/
-    uint8_t right_cnt;             /*< counter of right gesture >*/
+    uint8_t regs[APDS9960_SHADOW_NUM]; /*< shadow of the configuration registers >*/
+    uint8_t status;                /*< last read status register >*/
+    uint8_t gstatus;               /*< last read gesture status register >*/
+    apds9960_gesture_engine_t gengine; /*< recogniser of the gesture window in progress >*/
+    TickType_t gesture_tick;       /*< tick of the last dataset fed to gengine >*/
+    apds9960_gesture_dataset_t gring[APDS9960_GESTURE_RING_LEN]; /*< datasets drained from the gesture FIFO >*/
+    uint8_t gring_head;            /*< oldest dataset of gring >*/
+    uint8_t gring_count;           /*< datasets in gring >*/
+    apds9960_gesture_stats_t gstats; /*< gesture acquisition counters >*/
+    portMUX_TYPE gring_lock;       /*< protects gring and gstats, the INT line handler fills them from the bus worker >*/
+    SemaphoreHandle_t gesture_sem; /*< given when the INT line handler drained datasets, NULL in polling mode >*/
+    i2c_bus_request_t gesture_req; /*< GFLVL and GSTATUS read queued when the INT line is asserted >*/
+    uint8_t gesture_level[2];      /*< GFLVL and GSTATUS read by gesture_req >*/
 } apds9960_dev_t;
 
-static float __powf(const float x, const float y)
+static esp_err_t apds9960_shadow_write(apds9960_dev_t *sens, apds9960_shadow_t reg)
 {
-    return (float)(pow((double) x, (double) y));
+    return i2c_bus_write_byte(sens->i2c_dev, apds9960_shadow_addr[reg], sens->regs[reg]);
 }
 
 uint8_t apds9960_get_enable(apds9960_handle_t sensor)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    return (sens->_enable_t.gen << 6) | (sens->_enable_t.pien << 5) | (sens->_enable_t.aien << 4)
-           | (sens->_enable_t.wen << 3) | (sens->_enable_t.pen << 2) | (sens->_enable_t.aen << 1) | sens->_enable_t.pon;
+    return sens->regs[APDS9960_SHADOW_ENABLE];
 }
 
 uint8_t apds9960_get_pers(apds9960_handle_t sensor)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    return (sens->_pers_t.ppers << 4) | sens->_pers_t.apers;
+    return sens->regs[APDS9960_SHADOW_PERS];
 }
 
 uint8_t apds9960_get_ppulse(apds9960_handle_t sensor)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    return (sens->_ppulse_t.pplen << 6) | sens->_ppulse_t.ppulse;
+    return sens->regs[APDS9960_SHADOW_PPULSE];
 }
 
 uint8_t apds9960_get_gpulse(apds9960_handle_t sensor)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    return (sens->_gpulse_t.gplen << 6) | sens->_gpulse_t.gpulse;
+    return sens->regs[APDS9960_SHADOW_GPULSE];
 }
 
 uint8_t apds9960_get_control(apds9960_handle_t sensor)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    return (sens->_control_t.leddrive << 6) | (sens->_control_t.pgain << 2) | sens->_control_t.again;
+    return sens->regs[APDS9960_SHADOW_CONTROL];
 }
 
 uint8_t apds9960_get_config1(apds9960_handle_t sensor)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    return sens->_config1_t.wlong << 1;
+    return sens->regs[APDS9960_SHADOW_CONFIG1];
 }
 
 uint8_t apds9960_get_config2(apds9960_handle_t sensor)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    return (sens->_config2_t.psien << 7) | (sens->_config2_t.cpsien << 6) | (sens->_config2_t.led_boost << 4) | 1;
+    return sens->regs[APDS9960_SHADOW_CONFIG2];
 }
 
 uint8_t apds9960_get_config3(apds9960_handle_t sensor)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    return (sens->_config3_t.pcmp << 5) | (sens->_config3_t.sai << 4) | (sens->_config3_t.pmask_u << 3)
-           | (sens->_config3_t.pmask_d << 2) | (sens->_config3_t.pmask_l << 1) | sens->_config3_t.pmask_r;
+    return sens->regs[APDS9960_SHADOW_CONFIG3];
 }
 
 void apds9960_set_status(apds9960_handle_t sensor, uint8_t data)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    sens->_status_t.avalid = data & 0x01;
-    sens->_status_t.pvalid = (data >> 1) & 0x01;
-    sens->_status_t.gint = (data >> 2) & 0x01;
-    sens->_status_t.aint = (data >> 4) & 0x01;
-    sens->_status_t.pint = (data >> 5) & 0x01;
-    sens->_status_t.pgsat = (data >> 6) & 0x01;
-    sens->_status_t.cpsat = (data >> 7) & 0x01;
+    sens->status = data;
 }
 
 void apds9960_set_gstatus(apds9960_handle_t sensor, uint8_t data)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    sens->_gstatus_t.gfov = (data >> 1) & 0x01;
-    sens->_gstatus_t.gvalid = data & 0x01;
+    sens->gstatus = data;
 }
 
 uint8_t apds9960_get_gconf1(apds9960_handle_t sensor)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    return (sens->_gconf1_t.gfifoth << 7) | (sens->_gconf1_t.gexmsk << 5) | sens->_gconf1_t.gexpers;
+    return sens->regs[APDS9960_SHADOW_GCONF1];
 }
 
 uint8_t apds9960_get_gconf2(apds9960_handle_t sensor)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    return (sens->_gconf2_t.ggain << 5) | (sens->_gconf2_t.gldrive << 3) | sens->_gconf2_t.gwtime;
+    return sens->regs[APDS9960_SHADOW_GCONF2];
 }
 
 uint8_t apds9960_get_gconf3(apds9960_handle_t sensor)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    return sens->_gconf3_t.gdims;
+    return sens->regs[APDS9960_SHADOW_GCONF3];
 }
 
 uint8_t apds9960_get_gconf4(apds9960_handle_t sensor)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    return (sens->_gconf4_t.gien << 1) | sens->_gconf4_t.gmode;
+    return sens->regs[APDS9960_SHADOW_GCONF4];
 }
 
 void apds9960_set_gconf4(apds9960_handle_t sensor, uint8_t data)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    sens->_gconf4_t.gien = (data >> 1) & 0x01;
-    sens->_gconf4_t.gmode = data & 0x01;
+    APDS9960_SET(sens, gien, apds9960_field_gien_get(data));
+    APDS9960_SET(sens, gmode, apds9960_field_gmode_get(data));
 }
 
 void apds9960_reset_counts(apds9960_handle_t sensor)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    sens->gest_cnt = 0;
-    sens->up_cnt = 0;
-    sens->down_cnt = 0;
-    sens->left_cnt = 0;
-    sens->right_cnt = 0;
+    apds9960_gesture_engine_reset(&sens->gengine);
 }
 
 esp_err_t apds9960_set_timeout(apds9960_handle_t sensor, uint32_t tout_ms)
@@ -206,18 +288,12 @@ esp_err_t apds9960_enable_gesture_engine(apds9960_handle_t sensor, bool en)
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
 
     if (!en) {
-        sens->_gconf4_t.gmode = 0;
-        if (i2c_bus_write_byte(sens->i2c_dev, APDS9960_GCONF4,
-                               (sens->_gconf4_t.gien << 1) | sens->_gconf4_t.gmode) != ESP_OK) {
+        if (APDS9960_UPDATE(sens, gmode, 0) != ESP_OK) {
             return ESP_FAIL;
         }
     }
 
-    sens->_enable_t.gen = en;
-    ret = i2c_bus_write_byte(sens->i2c_dev, APDS9960_MODE_ENABLE,
-                             (sens->_enable_t.gen << 6) | (sens->_enable_t.pien << 5) | (sens->_enable_t.aien << 4)
-                             | (sens->_enable_t.wen << 3) | (sens->_enable_t.pen << 2) | (sens->_enable_t.aen << 1)
-                             | sens->_enable_t.pon);
+    ret = APDS9960_UPDATE(sens, gen, en);
     apds9960_reset_counts(sensor);
     return ret;
 }
@@ -227,17 +303,11 @@ esp_err_t apds9960_set_led_drive_boost(apds9960_handle_t sensor, apds9960_leddri
 {
     // set BOOST
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    sens->_config2_t.led_boost = boost;
-
-    if (i2c_bus_write_byte(sens->i2c_dev, APDS9960_CONFIG2,
-                           (sens->_config2_t.psien << 7) | (sens->_config2_t.cpsien << 6) | (sens->_config2_t.led_boost << 4)
-                           | 1) != ESP_OK) {
+    if (APDS9960_UPDATE(sens, led_boost, boost) != ESP_OK) {
         return ESP_FAIL;
     }
 
-    sens->_control_t.leddrive = drive;
-    return i2c_bus_write_byte(sens->i2c_dev, APDS9960_CONTROL,
-                              ((sens->_control_t.leddrive << 6) | (sens->_control_t.pgain << 2) | sens->_control_t.again));
+    return APDS9960_UPDATE(sens, leddrive, drive);
 }
 
 esp_err_t apds9960_set_wait_time(apds9960_handle_t sensor, uint8_t time)
@@ -246,9 +316,8 @@ esp_err_t apds9960_set_wait_time(apds9960_handle_t sensor, uint8_t time)
     return i2c_bus_write_byte(sens->i2c_dev, APDS9960_WTIME, time);
 }
 
-esp_err_t apds9960_set_adc_integration_time(apds9960_handle_t sensor, uint16_t iTimeMS)
+static uint8_t apds9960_calc_atime(uint16_t iTimeMS)
 {
-    apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
     float temp;
     // convert ms into 2.78ms increments
     temp = iTimeMS;
@@ -261,8 +330,14 @@ esp_err_t apds9960_set_adc_integration_time(apds9960_handle_t sensor, uint16_t i
         temp = 0;
     }
 
+    return (uint8_t) temp;
+}
+
+esp_err_t apds9960_set_adc_integration_time(apds9960_handle_t sensor, uint16_t iTimeMS)
+{
+    apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
     /* Update the timing register */
-    return i2c_bus_write_byte(sens->i2c_dev, APDS9960_ATIME, (uint8_t) temp);
+    return i2c_bus_write_byte(sens->i2c_dev, APDS9960_ATIME, apds9960_calc_atime(iTimeMS));
 }
 
 float apds9960_get_adc_integration_time(apds9960_handle_t sensor)
@@ -285,11 +360,7 @@ float apds9960_get_adc_integration_time(apds9960_handle_t sensor)
 esp_err_t apds9960_set_ambient_light_gain(apds9960_handle_t sensor, apds9960_again_t again)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    sens->_control_t.again = again;
-
-    /* Update the timing register */
-    return i2c_bus_write_byte(sens->i2c_dev, APDS9960_CONTROL,
-                              ((sens->_control_t.leddrive << 6) | (sens->_control_t.pgain << 2) | sens->_control_t.again));
+    return APDS9960_UPDATE(sens, again, again);
 }
 
 apds9960_again_t apds9960_get_ambient_light_gain(apds9960_handle_t sensor)
@@ -308,11 +379,7 @@ esp_err_t apds9960_enable_gesture_interrupt(apds9960_handle_t sensor, bool en)
 {
     esp_err_t ret;
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    sens->_enable_t.gen = en;
-    ret = i2c_bus_write_byte(sens->i2c_dev, APDS9960_MODE_ENABLE,
-                             ((sens->_enable_t.gen << 6) | (sens->_enable_t.pien << 5) | (sens->_enable_t.aien << 4)
-                              | (sens->_enable_t.wen << 3) | (sens->_enable_t.pen << 2) | (sens->_enable_t.aen << 1)
-                              | sens->_enable_t.pon));
+    ret = APDS9960_UPDATE(sens, gen, en);
     apds9960_clear_interrupt(sensor);
     return ret;
 }
@@ -320,21 +387,13 @@ esp_err_t apds9960_enable_gesture_interrupt(apds9960_handle_t sensor, bool en)
 esp_err_t apds9960_enable_proximity_engine(apds9960_handle_t sensor, bool en)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    sens->_enable_t.pen = en;
-    return i2c_bus_write_byte(sens->i2c_dev, APDS9960_MODE_ENABLE,
-                              ((sens->_enable_t.gen << 6) | (sens->_enable_t.pien << 5) | (sens->_enable_t.aien << 4)
-                               | (sens->_enable_t.wen << 3) | (sens->_enable_t.pen << 2) | (sens->_enable_t.aen << 1)
-                               | sens->_enable_t.pon));
+    return APDS9960_UPDATE(sens, pen, en);
 }
 
 esp_err_t apds9960_set_proximity_gain(apds9960_handle_t sensor, apds9960_pgain_t pgain)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    sens->_control_t.pgain = pgain;
-
-    /* Update the timing register */
-    return i2c_bus_write_byte(sens->i2c_dev, APDS9960_CONTROL,
-                              (sens->_control_t.leddrive << 6) | (sens->_control_t.pgain << 2) | sens->_control_t.again);
+    return APDS9960_UPDATE(sens, pgain, pgain);
 }
 
 apds9960_pgain_t apds9960_get_proximity_gain(apds9960_handle_t sensor)
@@ -360,19 +419,14 @@ esp_err_t apds9960_set_proximity_pulse(apds9960_handle_t sensor, apds9960_ppulse
     }
 
     pulses--;
-    sens->_ppulse_t.pplen = pLen;
-    sens->_ppulse_t.ppulse = pulses;
-    return i2c_bus_write_byte(sens->i2c_dev, APDS9960_PPULSE, (sens->_ppulse_t.pplen << 6) | sens->_ppulse_t.ppulse);
+    APDS9960_SET(sens, pplen, pLen);
+    return APDS9960_UPDATE(sens, ppulse, pulses);
 }
 
 esp_err_t apds9960_enable_color_engine(apds9960_handle_t sensor, bool en)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    sens->_enable_t.aen = en;
-    return i2c_bus_write_byte(sens->i2c_dev, APDS9960_MODE_ENABLE,
-                              ((sens->_enable_t.gen << 6) | (sens->_enable_t.pien << 5) | (sens->_enable_t.aien << 4)
-                               | (sens->_enable_t.wen << 3) | (sens->_enable_t.pen << 2) | (sens->_enable_t.aen << 1)
-                               | sens->_enable_t.pon));
+    return APDS9960_UPDATE(sens, aen, en);
 }
 
 bool apds9960_color_data_ready(apds9960_handle_t sensor)
@@ -381,72 +435,149 @@ bool apds9960_color_data_ready(apds9960_handle_t sensor)
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
     i2c_bus_read_byte(sens->i2c_dev, APDS9960_STATUS, &data);
     apds9960_set_status(sensor, data);
-    return sens->_status_t.avalid;
+    return apds9960_field_avalid_get(sens->status);
 }
 
 esp_err_t apds9960_get_color_data(apds9960_handle_t sensor, uint16_t *r, uint16_t *g, uint16_t *b, uint16_t *c)
 {
-    apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    uint8_t data[2] = { 0 };
-    i2c_bus_read_bytes(sens->i2c_dev, APDS9960_CDATAL, 2, data);
-    *c = (data[0] << 8) | data[1];
-    i2c_bus_read_bytes(sens->i2c_dev, APDS9960_RDATAL, 2, data);
-    *r = (data[0] << 8) | data[1];
-    i2c_bus_read_bytes(sens->i2c_dev, APDS9960_GDATAL, 2, data);
-    *g = (data[0] << 8) | data[1];
-    i2c_bus_read_bytes(sens->i2c_dev, APDS9960_BDATAL, 2, data);
-    *b = (data[0] << 8) | data[1];
+    apds9960_color_sample_t sample;
+    esp_err_t ret = apds9960_read_color_sample(sensor, &sample);
+
+    /* channels of the last completed cycle are returned whether a new one completed or not */
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+        return ret;
+    }
+
+    *c = sample.c;
+    *r = sample.r;
+    *g = sample.g;
+    *b = sample.b;
     return ESP_OK;
 }
 
-uint16_t apds9960_calculate_color_temperature(apds9960_handle_t sensor, uint16_t r, uint16_t g, uint16_t b)
+esp_err_t apds9960_read_color_sample(apds9960_handle_t sensor, apds9960_color_sample_t *sample)
 {
-    float rgb_xcorrelation, rgb_ycorrelation, rgb_zcorrelation; /* RGB to XYZ correlation      */
-    float chromaticity_xc, chromaticity_yc; /* Chromaticity co-ordinates   */
-    float formula; /* McCamy's formula            */
-    float cct;
+    apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
+    uint8_t data[APDS9960_BDATAH - APDS9960_STATUS + 1];
 
-    /* 1. Map RGB values to their XYZ counterparts.    */
-    /* Based on 6500K fluorescent, 3000K fluorescent   */
-    /* and 60W incandescent values for a wide range.   */
-    /* Note: Y = Illuminance or lux                    */
-    rgb_xcorrelation = (-0.14282F * r) + (1.54924F * g) + (-0.95641F * b);
-    rgb_ycorrelation = (-0.32466F * r) + (1.57837F * g) + (-0.73191F * b);
-    rgb_zcorrelation = (-0.68202F * r) + (0.77073F * g) + (0.56332F * b);
+    if (sample == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
 
-    /* 2. Calculate the chromaticity co-ordinates      */
-    chromaticity_xc = (rgb_xcorrelation) / (rgb_xcorrelation);
-    chromaticity_yc = (rgb_ycorrelation) / (rgb_xcorrelation + rgb_ycorrelation + rgb_zcorrelation);
+    esp_err_t ret = i2c_bus_read_bytes(sens->i2c_dev, APDS9960_STATUS, sizeof(data), data);
 
-    /* 3. Use McCamy's formula to determine the CCT    */
-    formula = (chromaticity_xc - 0.3320F) / (0.1858F - chromaticity_yc);
+    if (ret != ESP_OK) {
+        return ret;
+    }
 
-    /* Calculate the final CCT */
-    cct = (449.0F * __powf(formula, 3)) + (3525.0F * __powf(formula, 2)) + (6823.3F * formula) + 5520.33F;
+    apds9960_set_status(sensor, data[0]);
+    /* channels are little endian, low byte first */
+    sample->status = data[0];
+    sample->c = data[APDS9960_CDATAL - APDS9960_STATUS] | (data[APDS9960_CDATAH - APDS9960_STATUS] << 8);
+    sample->r = data[APDS9960_RDATAL - APDS9960_STATUS] | (data[APDS9960_RDATAH - APDS9960_STATUS] << 8);
+    sample->g = data[APDS9960_GDATAL - APDS9960_STATUS] | (data[APDS9960_GDATAH - APDS9960_STATUS] << 8);
+    sample->b = data[APDS9960_BDATAL - APDS9960_STATUS] | (data[APDS9960_BDATAH - APDS9960_STATUS] << 8);
+    return apds9960_field_avalid_get(data[0]) ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+/* RGB to CIE XYZ, based on 6500K fluorescent, 3000K fluorescent and 60W incandescent values, Y is the illuminance */
+#define APDS9960_RGB_TO_X(r, g, b) ((-0.14282F * (r)) + (1.54924F * (g)) + (-0.95641F * (b)))
+#define APDS9960_RGB_TO_Y(r, g, b) ((-0.32466F * (r)) + (1.57837F * (g)) + (-0.73191F * (b)))
+#define APDS9960_RGB_TO_Z(r, g, b) ((-0.68202F * (r)) + (0.77073F * (g)) + (0.56332F * (b)))
+
+/* McCamy's formula on the chromaticity of X, Y, Z, 0 if it is out of range */
+static uint16_t apds9960_cct(float x, float y, float z)
+{
+    float sum = x + y + z;
+
+    if (sum <= 0.0F) {
+        return 0;
+    }
 
-    /* Return the results in degrees Kelvin */
-    return (uint16_t) cct;
+    float xc = x / sum;
+    float yc = y / sum;
+
+    if (yc >= 0.1858F) {
+        return 0;
+    }
+
+    float n = (xc - 0.3320F) / (0.1858F - yc);
+    /* 449 n^3 + 3525 n^2 + 6823.3 n + 5520.33 in Horner form */
+    float cct = ((449.0F * n + 3525.0F) * n + 6823.3F) * n + 5520.33F;
+
+    if (cct <= 0.0F) {
+        return 0;
+    }
+
+    return cct >= 65535.0F ? 65535 : (uint16_t) cct;
+}
+
+static uint16_t apds9960_lux(float y)
+{
+    if (y <= 0.0F) {
+        return 0;
+    }
+
+    return y >= 65535.0F ? 65535 : (uint16_t) y;
+}
+
+uint16_t apds9960_calculate_color_temperature(apds9960_handle_t sensor, uint16_t r, uint16_t g, uint16_t b)
+{
+    return apds9960_cct(APDS9960_RGB_TO_X(r, g, b), APDS9960_RGB_TO_Y(r, g, b), APDS9960_RGB_TO_Z(r, g, b));
+}
+
+/* R, G and B filters pass IR the clear channel sees only once, the excess is twice the IR level */
+static void apds9960_ir_remove(const apds9960_color_sample_t *sample, float *r, float *g, float *b)
+{
+    int32_t ir = ((int32_t) sample->r + sample->g + sample->b - sample->c) / 2;
+    ir = ir > 0 ? ir : 0;
+    *r = (float)((int32_t) sample->r > ir ? sample->r - ir : 0);
+    *g = (float)((int32_t) sample->g > ir ? sample->g - ir : 0);
+    *b = (float)((int32_t) sample->b > ir ? sample->b - ir : 0);
 }
 
 uint16_t apds9960_calculate_lux(apds9960_handle_t sensor, uint16_t r, uint16_t g, uint16_t b)
 {
-    float illuminance;
+    return apds9960_lux(APDS9960_RGB_TO_Y(r, g, b));
+}
+
+uint16_t apds9960_calculate_color_temperature_ir(uint16_t r, uint16_t g, uint16_t b, uint16_t c)
+{
+    apds9960_color_sample_t sample = { .c = c, .r = r, .g = g, .b = b };
+    float rf, gf, bf;
+    apds9960_ir_remove(&sample, &rf, &gf, &bf);
+    return apds9960_cct(APDS9960_RGB_TO_X(rf, gf, bf), APDS9960_RGB_TO_Y(rf, gf, bf), APDS9960_RGB_TO_Z(rf, gf, bf));
+}
+
+uint16_t apds9960_calculate_lux_ir(uint16_t r, uint16_t g, uint16_t b, uint16_t c)
+{
+    apds9960_color_sample_t sample = { .c = c, .r = r, .g = g, .b = b };
+    float rf, gf, bf;
+    apds9960_ir_remove(&sample, &rf, &gf, &bf);
+    return apds9960_lux(APDS9960_RGB_TO_Y(rf, gf, bf));
+}
+
+esp_err_t apds9960_calculate_light(const apds9960_color_sample_t *samples, apds9960_light_t *results, size_t num)
+{
+    if (samples == NULL || results == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
 
-    /* This only uses RGB ... how can we integrate clear or calculate lux */
-    /* based exclusively on clear since this might be more reliable?      */
-    illuminance = (-0.32466F * r) + (1.57837F * g) + (-0.73191F * b);
+    for (size_t i = 0; i < num; i++) {
+        float r, g, b;
+        apds9960_ir_remove(&samples[i], &r, &g, &b);
+        float y = APDS9960_RGB_TO_Y(r, g, b);
+        results[i].cct = apds9960_cct(APDS9960_RGB_TO_X(r, g, b), y, APDS9960_RGB_TO_Z(r, g, b));
+        results[i].lux = apds9960_lux(y);
+    }
 
-    return (uint16_t) illuminance;
+    return ESP_OK;
 }
 
 esp_err_t apds9960_enable_color_interrupt(apds9960_handle_t sensor, bool en)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    sens->_enable_t.aien = en;
-    return i2c_bus_write_byte(sens->i2c_dev, APDS9960_MODE_ENABLE,
-                              ((sens->_enable_t.gen << 6) | (sens->_enable_t.pien << 5) | (sens->_enable_t.aien << 4)
-                               | (sens->_enable_t.wen << 3) | (sens->_enable_t.pen << 2) | (sens->_enable_t.aen << 1)
-                               | sens->_enable_t.pon));
+    return APDS9960_UPDATE(sens, aien, en);
 }
 
 esp_err_t apds9960_set_int_limits(apds9960_handle_t sensor, uint16_t low, uint16_t high)
@@ -462,11 +593,7 @@ esp_err_t apds9960_enable_proximity_interrupt(apds9960_handle_t sensor, bool en)
 {
     esp_err_t ret;
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    sens->_enable_t.pien = en;
-    ret = i2c_bus_write_byte(sens->i2c_dev, APDS9960_MODE_ENABLE,
-                             ((sens->_enable_t.gen << 6) | (sens->_enable_t.pien << 5) | (sens->_enable_t.aien << 4)
-                              | (sens->_enable_t.wen << 3) | (sens->_enable_t.pen << 2) | (sens->_enable_t.aen << 1)
-                              | sens->_enable_t.pon));
+    ret = APDS9960_UPDATE(sens, pien, en);
     apds9960_clear_interrupt(sensor);
     return ret;
 }
@@ -494,8 +621,7 @@ esp_err_t apds9960_set_proximity_interrupt_threshold(apds9960_handle_t sensor, u
         persistance = 7;
     }
 
-    sens->_pers_t.ppers = persistance;
-    return i2c_bus_write_byte(sens->i2c_dev, APDS9960_PERS, (sens->_pers_t.ppers << 4) | sens->_pers_t.apers);
+    return APDS9960_UPDATE(sens, ppers, persistance);
 }
 
 bool apds9960_get_proximity_interrupt(apds9960_handle_t sensor)
@@ -504,31 +630,28 @@ bool apds9960_get_proximity_interrupt(apds9960_handle_t sensor)
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
     i2c_bus_read_byte(sens->i2c_dev, APDS9960_STATUS, &data);
     apds9960_set_status(sensor, data);
-    return sens->_status_t.pint;
+    return apds9960_field_pint_get(sens->status);
 }
 
 esp_err_t apds9960_clear_interrupt(apds9960_handle_t sensor)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
     esp_err_t ret = i2c_bus_write_byte(sens->i2c_dev, NULL_I2C_MEM_ADDR, APDS9960_AICLEAR);
+    /* special function write, the cache does not know it changes STATUS */
+    i2c_bus_reg_cache_invalidate(sens->i2c_dev, APDS9960_STATUS, 1);
     return ret;
 }
 
 esp_err_t apds9960_enable(apds9960_handle_t sensor, bool en)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    sens->_enable_t.pon = en;
-    return i2c_bus_write_byte(sens->i2c_dev, APDS9960_MODE_ENABLE,
-                              ((sens->_enable_t.gen << 6) | (sens->_enable_t.pien << 5) | (sens->_enable_t.aien << 4)
-                               | (sens->_enable_t.wen << 3) | (sens->_enable_t.pen << 2) | (sens->_enable_t.aen << 1)
-                               | sens->_enable_t.pon));
+    return APDS9960_UPDATE(sens, pon, en);
 }
 
 esp_err_t apds9960_set_gesture_dimensions(apds9960_handle_t sensor, uint8_t dims)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    sens->_gconf3_t.gdims = dims;
-    return i2c_bus_write_byte(sens->i2c_dev, APDS9960_GCONF3, sens->_gconf3_t.gdims);
+    return APDS9960_UPDATE(sens, gdims, dims);
 }
 
 esp_err_t apds9960_set_light_intlow_threshold(apds9960_handle_t sensor, uint16_t threshold)
@@ -570,35 +693,19 @@ esp_err_t apds9960_set_light_inthigh_threshold(apds9960_handle_t sensor, uint16_
 esp_err_t apds9960_set_gesture_fifo_threshold(apds9960_handle_t sensor, uint8_t thresh)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    sens->_gconf1_t.gfifoth = thresh;
-    return i2c_bus_write_byte(sens->i2c_dev, APDS9960_GCONF1,
-                              ((sens->_gconf1_t.gfifoth << 7) | (sens->_gconf1_t.gexmsk << 5) | sens->_gconf1_t.gexpers));
+    return APDS9960_UPDATE(sens, gfifoth, thresh);
 }
 
 esp_err_t apds9960_set_gesture_waittime(apds9960_handle_t sensor, apds9960_gwtime_t time)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    uint8_t val;
-
-    /* Read value from GCONF2 register */
-    if (i2c_bus_read_byte(sens->i2c_dev, APDS9960_GCONF2, &val) != ESP_OK) {
-        return ESP_FAIL;
-    }
-
-    /* Set bits in register to given value */
-    time &= 0x07;
-    val &= 0xf8;
-    val |= time;
-    /* Write register value back into GCONF2 register */
-    return i2c_bus_write_byte(sens->i2c_dev, APDS9960_GCONF2, val);
+    return APDS9960_UPDATE(sens, gwtime, time);
 }
 
 esp_err_t apds9960_set_gesture_gain(apds9960_handle_t sensor, apds9960_ggain_t gain)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    sens->_gconf2_t.ggain = gain;
-    return i2c_bus_write_byte(sens->i2c_dev, APDS9960_GCONF2,
-                              ((sens->_gconf2_t.ggain << 5) | (sens->_gconf2_t.gldrive << 3) | sens->_gconf2_t.gwtime));
+    return APDS9960_UPDATE(sens, ggain, gain);
 }
 
 esp_err_t apds9960_set_gesture_proximity_threshold(apds9960_handle_t sensor, uint8_t entthresh, uint8_t exitthresh)
@@ -625,76 +732,360 @@ esp_err_t apds9960_set_gesture_offset(apds9960_handle_t sensor, uint8_t offset_u
     return ESP_OK;
 }
 
+/* rise over the window of the line fitted to values y at dataset index x, from sum y and sum x * y */
+static int32_t apds9960_gesture_trend(uint16_t n, int32_t sum, int32_t moment)
+{
+    int64_t sum_x = (int64_t) n * (n - 1) / 2;
+    int64_t den = (int64_t) n * n * ((int64_t) n * n - 1) / 12; /* n * sum x^2 - (sum x)^2 */
+    return (int32_t)(((int64_t) n * moment - sum_x * sum) * (n - 1) / den);
+}
+
+/* classify the open window and close it */
+static uint8_t apds9960_gesture_engine_close(apds9960_gesture_engine_t *engine)
+{
+    uint8_t gesture = 0;
+
+    if (engine->n >= APDS9960_GESTURE_WINDOW_MIN) {
+        /* a hand moving up is seen by D last, the U - D ratio falls; moving left the L - R ratio falls */
+        int32_t ud = apds9960_gesture_trend(engine->n, engine->ud_sum, engine->ud_moment);
+        int32_t lr = apds9960_gesture_trend(engine->n, engine->lr_sum, engine->lr_moment);
+        int32_t level = (int32_t) engine->level_last - engine->level_first;
+        int32_t major = abs(ud) > abs(lr) ? abs(ud) : abs(lr);
+        int32_t minor = abs(ud) > abs(lr) ? abs(lr) : abs(ud);
+
+        if (major * 100 >= GESTURE_SENSITIVITY_1 * APDS9960_GESTURE_RATIO_ONE) {
+            if (minor * 5 >= major * 2) {
+                /* both trajectories within 23 degrees of a diagonal */
+                gesture = ud < 0 ? (lr < 0 ? APDS9960_UP_LEFT : APDS9960_UP_RIGHT)
+                          : (lr < 0 ? APDS9960_DOWN_LEFT : APDS9960_DOWN_RIGHT);
+            } else if (abs(ud) > abs(lr)) {
+                gesture = ud < 0 ? APDS9960_UP : APDS9960_DOWN;
+            } else {
+                gesture = lr < 0 ? APDS9960_LEFT : APDS9960_RIGHT;
+            }
+        } else if (abs(level) * 100 >= engine->peak * APDS9960_GESTURE_DEPTH_PCT) {
+            /* no lateral motion, the reflected level at exit is above or below the one at entry */
+            gesture = level > 0 ? APDS9960_NEAR : APDS9960_FAR;
+        }
+    }
+
+    apds9960_gesture_engine_reset(engine);
+    return gesture;
+}
+
+void apds9960_gesture_engine_reset(apds9960_gesture_engine_t *engine)
+{
+    memset(engine, 0, sizeof(apds9960_gesture_engine_t));
+}
+
+uint8_t apds9960_gesture_engine_feed(apds9960_gesture_engine_t *engine, const apds9960_gesture_dataset_t *dataset)
+{
+    uint16_t ud_level = dataset->u + dataset->d;
+    uint16_t lr_level = dataset->l + dataset->r;
+    uint16_t level = ud_level + lr_level;
+
+    if (level <= 4 * GESTURE_THRESHOLD_OUT) {
+        /* the hand left the field of view, a single dip does not split the window */
+        if (engine->active && ++engine->quiet >= APDS9960_GESTURE_EXIT_DATASETS) {
+            return apds9960_gesture_engine_close(engine);
+        }
+
+        return 0;
+    }
+
+    /*
+     * channels normalised by their pair sum, gain and distance of the hand cancel out.
+     * A fast swipe lights a single pair at the edges of the sensor, the dark pair counts as centred.
+     */
+    int32_t ud = 0;
+    int32_t lr = 0;
+
+    if (ud_level > 2 * GESTURE_THRESHOLD_OUT) {
+        ud = ((int32_t) dataset->u - dataset->d) * APDS9960_GESTURE_RATIO_ONE / ud_level;
+    }
+
+    if (lr_level > 2 * GESTURE_THRESHOLD_OUT) {
+        lr = ((int32_t) dataset->l - dataset->r) * APDS9960_GESTURE_RATIO_ONE / lr_level;
+    }
+
+    int32_t x = engine->n;
+    engine->active = true;
+    engine->quiet = 0;
+    engine->ud_sum += ud;
+    engine->ud_moment += x * ud;
+    engine->lr_sum += lr;
+    engine->lr_moment += x * lr;
+    engine->level_last = level;
+
+    if (engine->n == 0) {
+        engine->level_first = level;
+    }
+
+    if (level > engine->peak) {
+        engine->peak = level;
+    }
+
+    if (++engine->n == APDS9960_GESTURE_WINDOW_MAX) {
+        /* a hand held still is classified without waiting for it to leave */
+        return apds9960_gesture_engine_close(engine);
+    }
+
+    return 0;
+}
+
+uint8_t apds9960_gesture_engine_flush(apds9960_gesture_engine_t *engine)
+{
+    return engine->active ? apds9960_gesture_engine_close(engine) : 0;
+}
+
 uint8_t apds9960_read_gesture(apds9960_handle_t sensor)
 {
-    uint8_t toRead;
-    uint8_t buf[256];
-    unsigned long t = 0;
-    uint8_t gestureReceived;
+    apds9960_gesture_dataset_t dataset;
+    uint8_t gestureReceived = 0;
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
 
     while (1) {
-        int up_down_diff = 0;
-        int left_right_diff = 0;
-        gestureReceived = 0;
-
-        if (!apds9960_gesture_valid(sensor)) {
-            return 0;
+        if (sens->gengine.active && xTaskGetTickCount() - sens->gesture_tick > (300 / portTICK_RATE_MS)) {
+            /* no dataset for a while, the hand left without the sensor reporting an exit */
+            gestureReceived = apds9960_gesture_engine_flush(&sens->gengine);
+            break;
         }
 
-        vTaskDelay(30 / portTICK_RATE_MS);
-        i2c_bus_read_byte(sens->i2c_dev, APDS9960_GFLVL, &toRead);
-        i2c_bus_read_bytes(sens->i2c_dev, APDS9960_GFIFO_U, toRead, buf);
+        if (sens->gesture_sem != NULL) {
+            /* datasets are drained by the INT line handler, no bus traffic until the FIFO reaches its threshold */
+            TickType_t wait = (sens->gengine.active ? 300 : sens->timeout) / portTICK_RATE_MS;
 
-        if (abs((int) buf[0] - (int) buf[1]) > 13) {
-            up_down_diff += (int) buf[0] - (int) buf[1];
-        }
+            portENTER_CRITICAL(&sens->gring_lock);
+            bool empty = (sens->gring_count == 0);
+            portEXIT_CRITICAL(&sens->gring_lock);
 
-        if (abs((int) buf[2] - (int) buf[3]) > 13) {
-            left_right_diff += (int) buf[2] - (int) buf[3];
-        }
+            if (empty && xSemaphoreTake(sens->gesture_sem, wait) != pdTRUE && !sens->gengine.active) {
+                return 0;
+            }
+        } else {
+            /* datasets below the FIFO threshold are still read while a window is open, they may close it */
+            if (!sens->gengine.active && !apds9960_gesture_valid(sensor)) {
+                return 0;
+            }
+
+            vTaskDelay(30 / portTICK_RATE_MS);
 
-        if (up_down_diff != 0) {
-            if (up_down_diff < 0) {
-                if (sens->down_cnt > 0) {
-                    gestureReceived = APDS9960_UP;
-                } else {
-                    sens->up_cnt++;
-                }
-            } else if (up_down_diff > 0) {
-                if (sens->up_cnt > 0) {
-                    gestureReceived = APDS9960_DOWN;
-                } else {
-                    sens->down_cnt++;
-                }
+            if (apds9960_drain_gesture_fifo(sensor, NULL) != ESP_OK) {
+                return 0;
             }
         }
 
-        if (left_right_diff != 0) {
-            if (left_right_diff < 0) {
-                if (sens->right_cnt > 0) {
-                    gestureReceived = APDS9960_LEFT;
-                } else {
-                    sens->left_cnt++;
-                }
-            } else if (left_right_diff > 0) {
-                if (sens->left_cnt > 0) {
-                    gestureReceived = APDS9960_RIGHT;
-                } else {
-                    sens->right_cnt++;
-                }
-            }
+        bool fed = false;
+
+        /* the window is classified as a whole when the hand leaves, not dataset by dataset */
+        while (!gestureReceived && apds9960_pop_gesture_dataset(sensor, &dataset)) {
+            gestureReceived = apds9960_gesture_engine_feed(&sens->gengine, &dataset);
+            fed = true;
         }
 
-        if (up_down_diff != 0 || left_right_diff != 0) {
-            t = xTaskGetTickCount();
+        if (fed) {
+            sens->gesture_tick = xTaskGetTickCount();
         }
 
-        if (gestureReceived || xTaskGetTickCount() - t > (300 / portTICK_RATE_MS)) {
-            apds9960_reset_counts(sensor);
-            return gestureReceived;
+        if (gestureReceived || !sens->gengine.active) {
+            break;
         }
     }
+
+    /* datasets left belong to the motion just recognised */
+    portENTER_CRITICAL(&sens->gring_lock);
+    sens->gring_count = 0;
+    portEXIT_CRITICAL(&sens->gring_lock);
+    return gestureReceived;
+}
+
+/* read the datasets announced by GFLVL and GSTATUS (level) into the ring buffer */
+static esp_err_t apds9960_gesture_fifo_read(apds9960_dev_t *sens, const uint8_t level[2], uint8_t *num)
+{
+    uint8_t buf[APDS9960_GFIFO_DEPTH * 4];
+    apds9960_set_gstatus((apds9960_handle_t) sens, level[1]);
+
+    if (num != NULL) {
+        *num = 0;
+    }
+
+    uint8_t count = level[0] < APDS9960_GFIFO_DEPTH ? level[0] : APDS9960_GFIFO_DEPTH;
+
+    /* FIFO page reads wrap from GFIFO_R to GFIFO_U, datasets are read in one burst */
+    if (count > 0 && i2c_bus_read_bytes_timeout(sens->i2c_dev, APDS9960_GFIFO_U, count * 4, buf, APDS9960_GESTURE_BUDGET_MS) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    portENTER_CRITICAL(&sens->gring_lock);
+
+    if (apds9960_field_gfov_get(level[1])) {
+        sens->gstats.fifo_overflows++;
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        if (sens->gring_count == APDS9960_GESTURE_RING_LEN) {
+            /* oldest dataset dropped, the latest motion is kept */
+            sens->gring_head = (sens->gring_head + 1) % APDS9960_GESTURE_RING_LEN;
+            sens->gring_count--;
+            sens->gstats.ring_overruns++;
+        }
+
+        apds9960_gesture_dataset_t *dataset = &sens->gring[(sens->gring_head + sens->gring_count) % APDS9960_GESTURE_RING_LEN];
+        dataset->u = buf[i * 4];
+        dataset->d = buf[i * 4 + 1];
+        dataset->l = buf[i * 4 + 2];
+        dataset->r = buf[i * 4 + 3];
+        sens->gring_count++;
+    }
+
+    sens->gstats.datasets += count;
+    portEXIT_CRITICAL(&sens->gring_lock);
+
+    if (num != NULL) {
+        *num = count;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t apds9960_drain_gesture_fifo(apds9960_handle_t sensor, uint8_t *num)
+{
+    apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
+    uint8_t level[2]; /* GFLVL, GSTATUS */
+
+    if (num != NULL) {
+        *num = 0;
+    }
+
+    if (i2c_bus_read_bytes_timeout(sens->i2c_dev, APDS9960_GFLVL, sizeof(level), level, APDS9960_GESTURE_BUDGET_MS) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    return apds9960_gesture_fifo_read(sens, level, num);
+}
+
+bool apds9960_pop_gesture_dataset(apds9960_handle_t sensor, apds9960_gesture_dataset_t *dataset)
+{
+    apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
+    bool ret = false;
+    portENTER_CRITICAL(&sens->gring_lock);
+
+    if (sens->gring_count > 0) {
+        *dataset = sens->gring[sens->gring_head];
+        sens->gring_head = (sens->gring_head + 1) % APDS9960_GESTURE_RING_LEN;
+        sens->gring_count--;
+        ret = true;
+    }
+
+    portEXIT_CRITICAL(&sens->gring_lock);
+    return ret;
+}
+
+esp_err_t apds9960_get_gesture_stats(apds9960_handle_t sensor, apds9960_gesture_stats_t *stats)
+{
+    apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
+
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&sens->gring_lock);
+    *stats = sens->gstats;
+    portEXIT_CRITICAL(&sens->gring_lock);
+    return ESP_OK;
+}
+
+/* GMODE is set and cleared by the gesture engine itself, writing back its shadow would force the engine
+ * in or out of gesture mode, GIEN is changed in place within one bus acquisition instead */
+static esp_err_t apds9960_set_gien(apds9960_dev_t *sens, uint8_t en)
+{
+    i2c_bus_txn_t txn;
+    esp_err_t ret = i2c_bus_txn_begin(&txn, sens->i2c_dev);
+    ret = (ret == ESP_OK) ? i2c_bus_txn_add_rmw(&txn, APDS9960_GCONF4, apds9960_field_gien_set(0, 1), apds9960_field_gien_set(0, en)) : ret;
+    ret = (ret == ESP_OK) ? i2c_bus_txn_commit(&txn) : ret;
+
+    if (ret == ESP_OK) {
+        APDS9960_SET(sens, gien, en);
+    }
+
+    return ret;
+}
+
+/* bus worker callback of the INT line request, GINT is cleared once the FIFO is read below its threshold */
+static void apds9960_gesture_irq_cb(i2c_bus_request_t *req, void *user_ctx)
+{
+    apds9960_dev_t *sens = (apds9960_dev_t *) user_ctx;
+    uint8_t count = 0;
+
+    /* the line is unmasked when this returns, an assertion left uncleared is served again at once */
+    if (req->ret == ESP_OK && apds9960_gesture_fifo_read(sens, sens->gesture_level, &count) == ESP_OK && count > 0) {
+        xSemaphoreGive(sens->gesture_sem);
+    }
+}
+
+esp_err_t apds9960_enable_gesture_irq(apds9960_handle_t sensor, int gpio_num)
+{
+    apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
+    esp_err_t ret;
+
+    if (sens->gesture_sem != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    sens->gesture_sem = xSemaphoreCreateBinary();
+
+    if (sens->gesture_sem == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    memset(&sens->gesture_req, 0, sizeof(i2c_bus_request_t));
+    sens->gesture_req.type = I2C_BUS_REQ_READ;
+    sens->gesture_req.dev_handle = sens->i2c_dev;
+    sens->gesture_req.mem_address = APDS9960_GFLVL;
+    sens->gesture_req.data_len = sizeof(sens->gesture_level);
+    sens->gesture_req.data = sens->gesture_level;
+    sens->gesture_req.callback = apds9960_gesture_irq_cb;
+    sens->gesture_req.user_ctx = sens;
+    /* INT is an open-drain active low output */
+    i2c_bus_irq_config_t irq_conf = {
+        .gpio_num = gpio_num,
+        .active_high = false,
+        .pull_en = true,
+        .req = &sens->gesture_req,
+    };
+    ret = i2c_bus_device_bind_irq(sens->i2c_dev, &irq_conf);
+
+    if (ret != ESP_OK) {
+        vSemaphoreDelete(sens->gesture_sem);
+        sens->gesture_sem = NULL;
+        return ret;
+    }
+
+    /* INT is asserted from the FIFO threshold on, GFIFOTH of a polling setup may be anything */
+    ret = APDS9960_UPDATE(sens, gfifoth, APDS9960_GESTURE_IRQ_FIFOTH);
+    ret = (ret == ESP_OK) ? apds9960_set_gien(sens, 1) : ret;
+
+    if (ret != ESP_OK) {
+        apds9960_disable_gesture_irq(sensor);
+    }
+
+    return ret;
+}
+
+esp_err_t apds9960_disable_gesture_irq(apds9960_handle_t sensor)
+{
+    apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
+
+    if (sens->gesture_sem == NULL) {
+        return ESP_OK;
+    }
+
+    /* GIEN cleared first, a request already queued is served by unbind */
+    esp_err_t ret = apds9960_set_gien(sens, 0);
+    i2c_bus_device_unbind_irq(sens->i2c_dev);
+    vSemaphoreDelete(sens->gesture_sem);
+    sens->gesture_sem = NULL;
+    return ret;
 }
 
 bool apds9960_gesture_valid(apds9960_handle_t sensor)
@@ -702,17 +1093,15 @@ bool apds9960_gesture_valid(apds9960_handle_t sensor)
     uint8_t data;
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
     i2c_bus_read_byte(sens->i2c_dev, APDS9960_GSTATUS, &data);
-    sens->_gstatus_t.gfov = (data >> 1) & 0x01;
-    sens->_gstatus_t.gvalid = data & 0x01;
-    return sens->_gstatus_t.gvalid;
+    apds9960_set_gstatus(sensor, data);
+    return apds9960_field_gvalid_get(sens->gstatus);
 }
 
 esp_err_t apds9960_set_gesture_pulse(apds9960_handle_t sensor, apds9960_gpulselen_t gpulseLen, uint8_t pulses)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
-    sens->_gpulse_t.gplen = gpulseLen;
-    sens->_gpulse_t.gpulse = pulses; //10 pulses
-    return i2c_bus_write_byte(sens->i2c_dev, APDS9960_GPULSE, (sens->_gpulse_t.gplen << 6) | sens->_gpulse_t.gpulse);
+    APDS9960_SET(sens, gplen, gpulseLen);
+    return APDS9960_UPDATE(sens, gpulse, pulses);
 }
 
 esp_err_t apds9960_set_gesture_enter_thresh(apds9960_handle_t sensor, uint8_t threshold)
@@ -734,13 +1123,40 @@ esp_err_t apds9960_set_gesture_exit_thresh(apds9960_handle_t sensor, uint8_t thr
 apds9960_handle_t apds9960_create(i2c_bus_handle_t bus, uint8_t dev_addr)
 {
     apds9960_dev_t *sens = (apds9960_dev_t *) calloc(1, sizeof(apds9960_dev_t));
-    sens->i2c_dev = i2c_bus_device_create(bus, dev_addr, i2c_bus_get_current_clk_speed(bus));
+    if (sens == NULL) {
+        return NULL;
+    }
+    /* gesture FIFO overflows if draining is delayed by other devices on the bus */
+    i2c_bus_device_config_t dev_conf = {
+        .dev_addr = dev_addr,
+        .clk_speed = i2c_bus_get_current_clk_speed(bus),
+        .priority = I2C_BUS_PRIO_HIGH,
+    };
+    sens->i2c_dev = i2c_bus_device_create_with_config(bus, &dev_conf);
     if (sens->i2c_dev == NULL) {
         free(sens);
         return NULL;
     }
     sens->dev_addr = dev_addr;
     sens->timeout = APDS9960_TIMEOUT_MS_DEFAULT;
+    portMUX_TYPE gring_lock_init = portMUX_INITIALIZER_UNLOCKED;
+    sens->gring_lock = gring_lock_init;
+    const uint8_t coalesced_regs[] = {APDS9960_STATUS};
+    esp_err_t ret = i2c_bus_reg_cache_enable(sens->i2c_dev, apds9960_volatile_regs, sizeof(apds9960_volatile_regs));
+    if (ret == ESP_OK) {
+        ret = i2c_bus_reg_cache_set_coalesce(sens->i2c_dev, coalesced_regs, sizeof(coalesced_regs), APDS9960_STATUS_COALESCE_US);
+    }
+    if (ret != ESP_OK) {
+        i2c_bus_device_delete(&sens->i2c_dev);
+        free(sens);
+        return NULL;
+    }
+    memcpy(sens->regs, apds9960_shadow_reset, sizeof(sens->regs));
+
+    /* a sensor not powered yet keeps the reset values, gesture init writes them all */
+    if (i2c_bus_regmap_read(sens->i2c_dev, &apds9960_shadow_map, sens->regs) != ESP_OK) {
+        memcpy(sens->regs, apds9960_shadow_reset, sizeof(sens->regs));
+    }
     return (apds9960_handle_t) sens;
 }
 
@@ -751,6 +1167,7 @@ esp_err_t apds9960_delete(apds9960_handle_t *sensor)
     }
 
     apds9960_dev_t *sens = (apds9960_dev_t *)(*sensor);
+    apds9960_disable_gesture_irq(*sensor);
     i2c_bus_device_delete(&sens->i2c_dev);
     free(sens);
     *sensor = NULL;
@@ -759,25 +1176,64 @@ esp_err_t apds9960_delete(apds9960_handle_t *sensor)
 
 esp_err_t apds9960_gesture_init(apds9960_handle_t sensor)
 {
+    apds9960_dev_t *sens = (apds9960_dev_t *) sensor;
+    i2c_bus_txn_t txn;
+    esp_err_t ret;
+
+    /* Power cycle writes are queued and sent with a single bus acquisition */
+    ret = i2c_bus_txn_begin(&txn, sens->i2c_dev);
+
     /* Set default values for ambient light and proximity registers */
-    apds9960_set_adc_integration_time(sensor, 10);
-    apds9960_set_ambient_light_gain(sensor, APDS9960_AGAIN_4X);
-    apds9960_enable_gesture_engine(sensor, false);
-    apds9960_enable_proximity_engine(sensor, false);
-    apds9960_enable_color_engine(sensor, false);
-    apds9960_enable_color_interrupt(sensor, false);
-    apds9960_enable_proximity_interrupt(sensor, false);
-    apds9960_clear_interrupt(sensor);
-    apds9960_enable(sensor, false);
-    apds9960_enable(sensor, true);
-    apds9960_set_gesture_dimensions(sensor, APDS9960_DIMENSIONS_ALL);
-    apds9960_set_gesture_fifo_threshold(sensor, APDS9960_GFIFO_4);
-    apds9960_set_gesture_gain(sensor, APDS9960_GGAIN_4X);
-    apds9960_set_gesture_proximity_threshold(sensor, 50, 0);
+    ret = (ret == ESP_OK) ? i2c_bus_txn_add_write_byte(&txn, APDS9960_ATIME, apds9960_calc_atime(10)) : ret;
+
+    /* Disable all engines and interrupts, then power cycle the device */
+    APDS9960_SET(sens, gmode, 0);
+    ret = (ret == ESP_OK) ? i2c_bus_txn_add_write_byte(&txn, APDS9960_GCONF4, sens->regs[APDS9960_SHADOW_GCONF4]) : ret;
+    APDS9960_SET(sens, gen, 0);
+    APDS9960_SET(sens, pen, 0);
+    APDS9960_SET(sens, aen, 0);
+    APDS9960_SET(sens, aien, 0);
+    APDS9960_SET(sens, pien, 0);
+    ret = (ret == ESP_OK) ? i2c_bus_txn_add_write_byte(&txn, APDS9960_MODE_ENABLE, sens->regs[APDS9960_SHADOW_ENABLE]) : ret;
+    ret = (ret == ESP_OK) ? i2c_bus_txn_add_write_byte(&txn, NULL_I2C_MEM_ADDR, APDS9960_AICLEAR) : ret;
+    APDS9960_SET(sens, pon, 0);
+    ret = (ret == ESP_OK) ? i2c_bus_txn_add_write_byte(&txn, APDS9960_MODE_ENABLE, sens->regs[APDS9960_SHADOW_ENABLE]) : ret;
+    APDS9960_SET(sens, pon, 1);
+    ret = (ret == ESP_OK) ? i2c_bus_txn_add_write_byte(&txn, APDS9960_MODE_ENABLE, sens->regs[APDS9960_SHADOW_ENABLE]) : ret;
+
+    ret = (ret == ESP_OK) ? i2c_bus_txn_add_write_byte(&txn, APDS9960_GPENTH, 50) : ret;
+    ret = (ret == ESP_OK) ? i2c_bus_txn_add_write_byte(&txn, APDS9960_GEXTH, 0) : ret;
+
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    ret = i2c_bus_txn_commit(&txn);
+    i2c_bus_reg_cache_invalidate(sens->i2c_dev, APDS9960_STATUS, 1);
+
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    /* Gesture engine configuration, all shadowed registers are written in one batch */
+    APDS9960_SET(sens, again, APDS9960_AGAIN_4X);
+    APDS9960_SET(sens, leddrive, APDS9960_LEDDRIVE_100MA);
+    APDS9960_SET(sens, led_boost, APDS9960_LEDBOOST_100PCNT);
+    APDS9960_SET(sens, gdims, APDS9960_DIMENSIONS_ALL);
+    APDS9960_SET(sens, gfifoth, APDS9960_GFIFO_4);
+    APDS9960_SET(sens, ggain, APDS9960_GGAIN_4X);
+    APDS9960_SET(sens, gwtime, APDS9960_GWTIME_2_8MS);
+    APDS9960_SET(sens, gplen, APDS9960_GPULSELEN_32US);
+    APDS9960_SET(sens, gpulse, 8);
+
+    ret = i2c_bus_regmap_write(sens->i2c_dev, &apds9960_shadow_map, sens->regs);
+
+    /* Start proximity and gesture engines once configured */
+    if (ret == ESP_OK) {
+        APDS9960_SET(sens, pen, 1);
+        ret = APDS9960_UPDATE(sens, gen, 1);
+    }
+
     apds9960_reset_counts(sensor);
-    apds9960_set_led_drive_boost(sensor, APDS9960_LEDDRIVE_100MA, APDS9960_LEDBOOST_100PCNT);
-    apds9960_set_gesture_waittime(sensor, APDS9960_GWTIME_2_8MS);
-    apds9960_set_gesture_pulse(sensor, APDS9960_GPULSELEN_32US, 8);
-    apds9960_enable_proximity_engine(sensor, true);
-    return apds9960_enable_gesture_engine(sensor, true);
-}
\ No newline at end of file
+    return ret;
+}
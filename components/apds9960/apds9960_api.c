@@ -71,6 +71,24 @@ static void apds9960_gesture_task(void *arg)
         case APDS9960_RIGHT:
             apds9960_event_cb(APDS9960_GESTURE_RIGHT_EVT, params);
             break;
+        case APDS9960_NEAR:
+            apds9960_event_cb(APDS9960_GESTURE_NEAR_EVT, params);
+            break;
+        case APDS9960_FAR:
+            apds9960_event_cb(APDS9960_GESTURE_FAR_EVT, params);
+            break;
+        case APDS9960_UP_LEFT:
+            apds9960_event_cb(APDS9960_GESTURE_UP_LEFT_EVT, params);
+            break;
+        case APDS9960_UP_RIGHT:
+            apds9960_event_cb(APDS9960_GESTURE_UP_RIGHT_EVT, params);
+            break;
+        case APDS9960_DOWN_LEFT:
+            apds9960_event_cb(APDS9960_GESTURE_DOWN_LEFT_EVT, params);
+            break;
+        case APDS9960_DOWN_RIGHT:
+            apds9960_event_cb(APDS9960_GESTURE_DOWN_RIGHT_EVT, params);
+            break;
         default:
             break;
         }
@@ -0,0 +1,297 @@
+// Copyright 2015-2016 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "apds9960.h"
+#include "apds9960_sim.h"
+
+static const char *TAG = "apds9960_sim";
+
+#define APDS9960_SIM_GVALID_BIT     ((uint8_t)0x01)   /*!< GSTATUS */
+#define APDS9960_SIM_GFOV_BIT       ((uint8_t)0x02)   /*!< GSTATUS */
+#define APDS9960_SIM_AVALID_BIT     ((uint8_t)0x01)   /*!< STATUS */
+#define APDS9960_SIM_PVALID_BIT     ((uint8_t)0x02)   /*!< STATUS */
+#define APDS9960_SIM_GINT_BIT       ((uint8_t)0x04)   /*!< STATUS */
+#define APDS9960_SIM_AINT_BIT       ((uint8_t)0x10)   /*!< STATUS */
+#define APDS9960_SIM_PINT_BIT       ((uint8_t)0x20)   /*!< STATUS */
+#define APDS9960_SIM_PGSAT_BIT      ((uint8_t)0x40)   /*!< STATUS */
+#define APDS9960_SIM_CPSAT_BIT      ((uint8_t)0x80)   /*!< STATUS */
+#define APDS9960_SIM_GFIFO_CLR_BIT  ((uint8_t)0x04)   /*!< GCONF4 */
+
+typedef struct {
+    i2c_bus_sim_dev_t *dev;
+    uint8_t gfifo[APDS9960_SIM_GFIFO_LEN][4]; /*< gesture FIFO, gfifo_head is read next >*/
+    uint8_t gfifo_head;
+    uint8_t gfifo_level;
+    bool gfov;                                /*< FIFO overflow since last drain >*/
+    uint8_t (*script)[4];                     /*< recorded datasets not yet in the FIFO >*/
+    size_t script_len;
+    size_t script_pos;
+    uint32_t script_period_us;
+    int64_t script_start_us;
+} apds9960_sim_t;
+
+/* move recorded datasets whose time has come into the FIFO, called with the simulated bus locked */
+static void apds9960_sim_fill_fifo(apds9960_sim_t *sim)
+{
+    uint8_t *regs = i2c_bus_sim_dev_regs(sim->dev);
+
+    if (sim->script == NULL || !(regs[APDS9960_MODE_ENABLE] & APDS9960_GEN_MASK)) {
+        return;
+    }
+
+    int64_t elapsed_us = i2c_bus_sim_get_time_us() - sim->script_start_us;
+
+    while (sim->script_pos < sim->script_len &&
+            (sim->script_period_us == 0 || elapsed_us >= (int64_t) sim->script_pos * sim->script_period_us)) {
+        if (sim->gfifo_level < APDS9960_SIM_GFIFO_LEN) {
+            uint8_t tail = (sim->gfifo_head + sim->gfifo_level) % APDS9960_SIM_GFIFO_LEN;
+            memcpy(sim->gfifo[tail], sim->script[sim->script_pos], 4);
+            sim->gfifo_level++;
+        } else {
+            sim->gfov = true;
+        }
+
+        sim->script_pos++;
+    }
+}
+
+/* threshold of GCONF1.GFIFOTH in datasets */
+static uint8_t apds9960_sim_gfifo_thresh(const uint8_t *regs)
+{
+    static const uint8_t thresh[] = {1, 4, 8, 16};
+    return thresh[(regs[APDS9960_GCONF1] >> 6) & 0x03];
+}
+
+static uint8_t apds9960_sim_read(i2c_bus_sim_dev_t *dev, uint8_t reg, uint8_t *value, void *ctx)
+{
+    apds9960_sim_t *sim = (apds9960_sim_t *) ctx;
+    uint8_t *regs = i2c_bus_sim_dev_regs(dev);
+    apds9960_sim_fill_fifo(sim);
+    bool gvalid = sim->gfifo_level >= apds9960_sim_gfifo_thresh(regs);
+
+    switch (reg) {
+    case APDS9960_STATUS:
+        *value = (regs[APDS9960_STATUS] & ~APDS9960_SIM_GINT_BIT) | (gvalid ? APDS9960_SIM_GINT_BIT : 0);
+        break;
+    case APDS9960_GFLVL:
+        *value = sim->gfifo_level;
+        break;
+    case APDS9960_CDATAL:
+    case APDS9960_CDATAH:
+    case APDS9960_RDATAL:
+    case APDS9960_RDATAH:
+    case APDS9960_GDATAL:
+    case APDS9960_GDATAH:
+    case APDS9960_BDATAL:
+    case APDS9960_BDATAH:
+        regs[APDS9960_STATUS] &= ~APDS9960_SIM_AVALID_BIT;
+        break;
+    case APDS9960_PDATA:
+        regs[APDS9960_STATUS] &= ~APDS9960_SIM_PVALID_BIT;
+        break;
+    case APDS9960_GSTATUS:
+        *value = (gvalid ? APDS9960_SIM_GVALID_BIT : 0) | (sim->gfov ? APDS9960_SIM_GFOV_BIT : 0);
+        break;
+    case APDS9960_GFIFO_U:
+    case APDS9960_GFIFO_D:
+    case APDS9960_GFIFO_L:
+    case APDS9960_GFIFO_R:
+        *value = sim->gfifo_level > 0 ? sim->gfifo[sim->gfifo_head][reg - APDS9960_GFIFO_U] : 0;
+
+        /* a dataset is popped once its R byte is read, page reads wrap to U */
+        if (reg == APDS9960_GFIFO_R) {
+            if (sim->gfifo_level > 0) {
+                sim->gfifo_head = (sim->gfifo_head + 1) % APDS9960_SIM_GFIFO_LEN;
+                sim->gfifo_level--;
+            }
+
+            if (sim->gfifo_level == 0) {
+                sim->gfov = false;
+            }
+
+            return APDS9960_GFIFO_U;
+        }
+        break;
+    default:
+        break;
+    }
+
+    return reg + 1;
+}
+
+static uint8_t apds9960_sim_write(i2c_bus_sim_dev_t *dev, uint8_t reg, uint8_t value, void *ctx)
+{
+    apds9960_sim_t *sim = (apds9960_sim_t *) ctx;
+    uint8_t *regs = i2c_bus_sim_dev_regs(dev);
+
+    switch (reg) {
+    case APDS9960_GCONF4:
+        if (value & APDS9960_SIM_GFIFO_CLR_BIT) {
+            sim->gfifo_level = 0;
+            sim->gfov = false;
+            regs[APDS9960_GCONF4] = value & ~APDS9960_SIM_GFIFO_CLR_BIT;
+        }
+        break;
+    default:
+        break;
+    }
+
+    return reg + 1;
+}
+
+/* interrupt clears are special function addresses, the address write alone clears the flags */
+static void apds9960_sim_address(i2c_bus_sim_dev_t *dev, uint8_t reg, void *ctx)
+{
+    uint8_t *regs = i2c_bus_sim_dev_regs(dev);
+
+    switch (reg) {
+    case APDS9960_PICLEAR:
+        regs[APDS9960_STATUS] &= ~(APDS9960_SIM_PINT_BIT | APDS9960_SIM_PGSAT_BIT);
+        break;
+    case APDS9960_CICLEAR:
+        regs[APDS9960_STATUS] &= ~(APDS9960_SIM_AINT_BIT | APDS9960_SIM_CPSAT_BIT);
+        break;
+    case APDS9960_AICLEAR:
+        regs[APDS9960_STATUS] &= ~(APDS9960_SIM_PINT_BIT | APDS9960_SIM_PGSAT_BIT | APDS9960_SIM_AINT_BIT | APDS9960_SIM_CPSAT_BIT);
+        break;
+    default:
+        break;
+    }
+}
+
+static const i2c_bus_sim_dev_ops_t apds9960_sim_ops = {
+    .read = apds9960_sim_read,
+    .write = apds9960_sim_write,
+    .address = apds9960_sim_address,
+};
+
+apds9960_sim_handle_t apds9960_sim_create(i2c_port_t port, uint8_t dev_addr)
+{
+    apds9960_sim_t *sim = (apds9960_sim_t *) calloc(1, sizeof(apds9960_sim_t));
+    uint8_t regs[256] = {0};
+
+    if (sim == NULL) {
+        return NULL;
+    }
+
+    regs[APDS9960_WHO_AM_I_REG] = APDS9960_WHO_AM_I_VAL;
+    regs[APDS9960_ATIME] = 0xFF;
+    regs[APDS9960_WTIME] = 0xFF;
+    regs[APDS9960_PPULSE] = 0x40;
+    regs[APDS9960_CONFIG1] = 0x40;
+    regs[APDS9960_CONFIG2] = 0x01;
+    regs[APDS9960_GPULSE] = 0x40;
+    i2c_bus_sim_dev_config_t dev_conf = {
+        .dev_addr = dev_addr,
+        .reg_init = regs,
+        .ops = &apds9960_sim_ops,
+        .ctx = sim,
+    };
+    sim->dev = i2c_bus_sim_dev_create(port, &dev_conf);
+
+    if (sim->dev == NULL) {
+        free(sim);
+        return NULL;
+    }
+
+    return (apds9960_sim_handle_t) sim;
+}
+
+esp_err_t apds9960_sim_delete(apds9960_sim_handle_t *sim_handle)
+{
+    if (sim_handle == NULL || *sim_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    apds9960_sim_t *sim = (apds9960_sim_t *)(*sim_handle);
+    i2c_bus_sim_dev_delete(&sim->dev);
+    free(sim->script);
+    free(sim);
+    *sim_handle = NULL;
+    return ESP_OK;
+}
+
+esp_err_t apds9960_sim_play_gesture(apds9960_sim_handle_t sim_handle, const uint8_t (*datasets)[4], size_t num, uint32_t dataset_period_us)
+{
+    apds9960_sim_t *sim = (apds9960_sim_t *) sim_handle;
+
+    if (sim == NULL || (datasets == NULL && num > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint8_t (*script)[4] = NULL;
+
+    if (num > 0) {
+        script = malloc(num * 4);
+
+        if (script == NULL) {
+            ESP_LOGE(TAG, "gesture script malloc failed");
+            return ESP_ERR_NO_MEM;
+        }
+
+        memcpy(script, datasets, num * 4);
+    }
+
+    i2c_bus_sim_lock();
+    free(sim->script);
+    sim->script = script;
+    sim->script_len = num;
+    sim->script_pos = 0;
+    sim->script_period_us = dataset_period_us;
+    sim->script_start_us = i2c_bus_sim_get_time_us();
+    i2c_bus_sim_unlock();
+    return ESP_OK;
+}
+
+esp_err_t apds9960_sim_set_color(apds9960_sim_handle_t sim_handle, uint16_t c, uint16_t r, uint16_t g, uint16_t b)
+{
+    apds9960_sim_t *sim = (apds9960_sim_t *) sim_handle;
+
+    if (sim == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    i2c_bus_sim_lock();
+    uint8_t *regs = i2c_bus_sim_dev_regs(sim->dev);
+    regs[APDS9960_CDATAL] = c & 0xFF;
+    regs[APDS9960_CDATAH] = c >> 8;
+    regs[APDS9960_RDATAL] = r & 0xFF;
+    regs[APDS9960_RDATAH] = r >> 8;
+    regs[APDS9960_GDATAL] = g & 0xFF;
+    regs[APDS9960_GDATAH] = g >> 8;
+    regs[APDS9960_BDATAL] = b & 0xFF;
+    regs[APDS9960_BDATAH] = b >> 8;
+    regs[APDS9960_STATUS] |= APDS9960_SIM_AVALID_BIT;
+    i2c_bus_sim_unlock();
+    return ESP_OK;
+}
+
+esp_err_t apds9960_sim_set_proximity(apds9960_sim_handle_t sim_handle, uint8_t proximity)
+{
+    apds9960_sim_t *sim = (apds9960_sim_t *) sim_handle;
+
+    if (sim == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    i2c_bus_sim_lock();
+    uint8_t *regs = i2c_bus_sim_dev_regs(sim->dev);
+    regs[APDS9960_PDATA] = proximity;
+    regs[APDS9960_STATUS] |= APDS9960_SIM_PVALID_BIT;
+    i2c_bus_sim_unlock();
+    return ESP_OK;
+}
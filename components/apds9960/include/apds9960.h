@@ -15,7 +15,6 @@
 #ifndef _APDS9960_H_
 #define _APDS9960_H_
 
-#include "driver/i2c.h"
 #include "i2c_bus.h"
 #include "esp_log.h"
 #include "math.h"
@@ -34,6 +33,12 @@
 #define APDS9960_DOWN           0x02
 #define APDS9960_LEFT           0x03
 #define APDS9960_RIGHT          0x04
+#define APDS9960_NEAR           0x05
+#define APDS9960_FAR            0x06
+#define APDS9960_UP_LEFT        0x07
+#define APDS9960_UP_RIGHT       0x08
+#define APDS9960_DOWN_LEFT      0x09
+#define APDS9960_DOWN_RIGHT     0x0A
 
 /* Gesture parameters */
 #define GESTURE_THRESHOLD_OUT   10   //Output threshold
@@ -225,151 +230,60 @@ typedef enum {
 #define DEFAULT_GCONF3          0       // All photodiodes active during gesture
 #define DEFAULT_GIEN            0       // Disable gesture interrupts
 
-typedef struct control {
-    uint8_t again : 2; //ALS and Color gain control
-    uint8_t pgain : 2; //proximity gain control
-    uint8_t leddrive : 2; //led drive strength
-} apds9960_control_t;
-
-typedef struct pers {
-    //ALS Interrupt Persistence. Controls rate of Clear channel interrupt to the host processor
-    uint8_t apers : 4;
-    //proximity interrupt persistence, controls rate of prox interrupt to host processor
-    uint8_t ppers : 4;
-} apds9960_pers_t;
-
-typedef struct config1 {
-    uint8_t wlong : 1;
-} apds9960_config1_t;
-
-typedef struct config2 {
-    /* Additional LDR current during proximity and gesture LED pulses. Current value, set by LDRIVE,
-     is increased by the percentage of LED_BOOST.*/
-    uint8_t led_boost : 2;
-    //clear photodiode saturation int enable
-    uint8_t cpsien : 1;
-    //proximity saturation interrupt enable
-    uint8_t psien : 1;
-} apds9960_config2_t;
-
-typedef struct config3 {
-    //proximity mask
-    uint8_t pmask_r : 1;
-    uint8_t pmask_l : 1;
-    uint8_t pmask_d : 1;
-    uint8_t pmask_u : 1;
-    /* Sleep After Interrupt. When enabled, the device will automatically enter low power mode
-     when the INT pin is asserted and the state machine has progressed to the SAI decision block.
-     Normal operation is resumed when INT pin is cleared over I2C.*/
-    uint8_t sai : 1;
-    /* Proximity Gain Compensation Enable. This bit provides gain compensation when proximity
-     photodiode signal is reduced as a result of sensor masking. If only one diode of the diode pair
-     is contributing, then only half of the signal is available at the ADC; this results in a maximum
-     ADC value of 127. Enabling PCMP enables an additional gain of 2X, resulting in a maximum
-     ADC value of 255.*/
-    uint8_t pcmp : 1;
-} apds9960_config3_t;
-
-typedef struct gconf1 {
-    /* Gesture Exit Persistence. When a number of consecutive gesture end occurrences become
-     * equal or greater to the GEPERS value, the Gesture state machine is exited.*/
-    uint8_t gexpers : 2;
-    /* Gesture Exit Mask. Controls which of the gesture detector photodiodes (UDLR) will be included
-     * to determine a gesture end and subsequent exit of the gesture state machine. Unmasked
-     * UDLR data will be compared with the value in GTHR_OUT. Field value bits correspond to UDLR
-     * detectors.*/
-    uint8_t gexmsk : 4;
-    /* Gesture FIFO Threshold. This value is compared with the FIFO Level (i.e. the number of UDLR
-     * datasets) to generate an interrupt (if enabled).*/
-    uint8_t gfifoth : 2;
-} apds9960_gconf1_t;
-
-typedef struct gconf2 {
-    /* Gesture Wait Time. The GWTIME controls the amount of time in a low power mode
-     * between gesture detection cycles.*/
-    uint8_t gwtime : 3;
-    uint8_t gldrive : 2; //Gesture LED Drive Strength. Sets LED Drive Strength in gesture mode.
-    uint8_t ggain : 2; //Gesture Gain Control. Sets the gain of the proximity receiver in gesture mode.
-} apds9960_gconf2_t;
-
-typedef struct gconf3 {
-    /* Gesture Dimension Select. Selects which gesture photodiode pairs are enabled to gather
-     * results during gesture. */
-    uint8_t gdims : 2;
-} apds9960_gconf3_t;
-
-typedef struct gconf4 {
-    /* Gesture Mode. Reading this bit reports if the gesture state machine is actively running, 1
-     * = Gesture, 0= ALS, Proximity, Color. Writing a 1 to this bit causes immediate entry in to the
-     * gesture state machine (as if GPENTH had been exceeded). Writing a 0 to this bit causes exit of
-     * gesture when current analog conversion has finished (as if GEXTH had been exceeded).*/
-    uint8_t gmode : 1;
-    /* Gesture interrupt enable. Gesture Interrupt Enable. When asserted, all gesture related
-     * interrupts are unmasked.*/
-    uint8_t gien : 2;
-} apds9960_gconf4_t;
-
-typedef struct enable {
-    uint8_t pon : 1; //power on
-    uint8_t aen : 1; //ALS enable
-    uint8_t pen : 1; //Proximity detect enable
-    uint8_t wen : 1; //wait timer enable
-    uint8_t aien : 1; //ALS interrupt enable
-    uint8_t pien : 1; //proximity interrupt enable
-    uint8_t gen : 1; //gesture enable
-} apds9960_enable_t;
-
-typedef struct status {
-    /* ALS Valid. Indicates that an ALS cycle has completed since AEN was asserted or since a read
-     from any of the ALS/Color data registers.*/
-    uint8_t avalid : 1;
-    /* Proximity Valid. Indicates that a proximity cycle has completed since PEN was asserted or since
-     PDATA was last read. A read of PDATA automatically clears PVALID.*/
-    uint8_t pvalid : 1;
-    /* Gesture Interrupt. GINT is asserted when GFVLV becomes greater than GFIFOTH or if GVALID
-     has become asserted when GMODE transitioned to zero. The bit is reset when FIFO is
-     completely emptied (read).  */
-    uint8_t gint : 1;
-    //ALS Interrupt. This bit triggers an interrupt if AIEN in ENABLE is set.
-    uint8_t aint : 1;
-    //Proximity Interrupt. This bit triggers an interrupt if PIEN in ENABLE is set.
-    uint8_t pint : 1;
-    /* Indicates that an analog saturation event occurred during a previous proximity or gesture
-     cycle. Once set, this bit remains set until cleared by clear proximity interrupt special function
-     command (0xE5 PICLEAR) or by disabling Prox (PEN=0). This bit triggers an interrupt if PSIEN
-     is set.  */
-    uint8_t pgsat : 1;
-    /* Clear Photodiode Saturation. When asserted, the analog sensor was at the upper end of its
-     dynamic range. The bit can be de-asserted by sending a Clear channel interrupt command
-     (0xE6 CICLEAR) or by disabling the ADC (AEN=0). This bit triggers an interrupt if CPSIEN is set. */
-    uint8_t cpsat : 1;
-} apds9960_status_t;
-
-typedef struct gstatus {
-    /* Gesture FIFO Data. GVALID bit is sent when GFLVL becomes greater than GFIFOTH (i.e. FIFO has
-     enough data to set GINT). GFIFOD is reset when GMODE = 0 and the GFLVL=0 (i.e. All FIFO data
-     has been read). */
-    uint8_t gvalid : 1;
-    /* Gesture FIFO Overflow. A setting of 1 indicates that the FIFO has filled to capacity and that new
-     gesture detector data has been lost. */
-    uint8_t gfov : 1;
-} apds9960_gstatus_t;
-
-typedef struct ppulse {
-    /*Proximity Pulse Count. Specifies the number of proximity pulses to be generated on LDR.
-     Number of pulses is set by PPULSE value plus 1. */
-    uint8_t ppulse : 6;
-    //Proximity Pulse Length. Sets the LED-ON pulse width during a proximity LDR pulse.
-    uint8_t pplen : 2;
-} apds9960_propulse_t;
-
-typedef struct gpulse {
-    /* Number of Gesture Pulses. Specifies the number of pulses to be generated on LDR.
-     Number of pulses is set by GPULSE value plus 1. */
-    uint8_t gpulse : 6;
-    //Gesture Pulse Length. Sets the LED_ON pulse width during a Gesture LDR Pulse.
-    uint8_t gplen : 2;
-} apds9960_gespulse_t;
+/**
+ * @brief Color sample, status and the four channels read in one burst
+ */
+typedef struct {
+    uint8_t status; /*!< STATUS register the channels were read with */
+    uint16_t c;     /*!< clear channel */
+    uint16_t r;     /*!< red channel */
+    uint16_t g;     /*!< green channel */
+    uint16_t b;     /*!< blue channel */
+} apds9960_color_sample_t;
+
+/**
+ * @brief Light values computed from a color sample
+ */
+typedef struct {
+    uint16_t cct; /*!< correlated color temperature in degrees Kelvin, 0 if out of range */
+    uint16_t lux; /*!< ambient light, same scale as apds9960_calculate_lux */
+} apds9960_light_t;
+
+/**
+ * @brief Gesture dataset, one entry of the gesture FIFO
+ */
+typedef struct {
+    uint8_t u; /*!< up photodiode */
+    uint8_t d; /*!< down photodiode */
+    uint8_t l; /*!< left photodiode */
+    uint8_t r; /*!< right photodiode */
+} apds9960_gesture_dataset_t;
+
+/**
+ * @brief Gesture acquisition counters
+ */
+typedef struct {
+    uint32_t datasets;       /*!< datasets read from the gesture FIFO */
+    uint32_t fifo_overflows; /*!< drains that found GFOV set, datasets were lost in the sensor */
+    uint32_t ring_overruns;  /*!< datasets dropped from the ring buffer before they were processed */
+} apds9960_gesture_stats_t;
+
+/**
+ * @brief Gesture window recogniser, fed with the datasets of one sensor.
+ *        Only running sums are kept, the window length does not change its size.
+ */
+typedef struct {
+    bool active;          /*!< a gesture window is open */
+    uint8_t quiet;        /*!< consecutive datasets without a hand in view */
+    uint16_t n;           /*!< datasets in the window */
+    uint16_t peak;        /*!< highest U + D + L + R of the window */
+    int32_t ud_sum;       /*!< sum of the (U - D) / (U + D) ratios, Q8 */
+    int32_t ud_moment;    /*!< sum of the U/D ratios weighted by their dataset index */
+    int32_t lr_sum;       /*!< sum of the (L - R) / (L + R) ratios, Q8 */
+    int32_t lr_moment;    /*!< sum of the L/R ratios weighted by their dataset index */
+    uint16_t level_first; /*!< U + D + L + R of the first dataset */
+    uint16_t level_last;  /*!< U + D + L + R of the last dataset */
+} apds9960_gesture_engine_t;
 
 typedef void *apds9960_handle_t;
 
@@ -722,7 +636,10 @@ esp_err_t apds9960_set_gesture_offset(apds9960_handle_t sensor,
         uint8_t offset_right);
 
 /**
- * @brief Processes a gesture event and returns best guessed gesture
+ * @brief Processes a gesture event and returns best guessed gesture.
+ *        In polling mode it returns 0 at once if no gesture data is valid. Once apds9960_enable_gesture_irq
+ *        succeeded, it waits up to the sensor timeout (see apds9960_set_timeout) for datasets drained on
+ *        the INT line instead, the bus is not accessed while no gesture is made.
  *
  * @param sensor object handle of apds9960
  *
@@ -731,6 +648,114 @@ esp_err_t apds9960_set_gesture_offset(apds9960_handle_t sensor,
  */
 uint8_t apds9960_read_gesture(apds9960_handle_t sensor);
 
+/**
+ * @brief Drain the gesture FIFO on the INT pin instead of polling GSTATUS every 30 ms.
+ *        GIEN is set and the FIFO threshold is set to the menuconfig level (1 dataset by default, about 2.8 ms
+ *        of FIFO fill), the sensor asserts INT when the FIFO reaches the threshold
+ *        (apds9960_set_gesture_fifo_threshold can change it afterwards) or when a gesture ends. The GPIO is bound with
+ *        i2c_bus_device_bind_irq, the FIFO is read into the ring buffer by the bus worker task and
+ *        apds9960_read_gesture is woken. The proximity and ALS interrupts (PIEN, AIEN) must stay disabled,
+ *        they would keep INT asserted.
+ *        menuconfig:Bus Options->I2C Bus Options->enable interrupt-driven reads
+ *        menuconfig:APDS9960->gesture FIFO level asserting INT
+ *
+ * @param sensor object handle of apds9960
+ * @param gpio_num GPIO connected to the INT pin
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG GPIO number error
+ *     - ESP_ERR_INVALID_STATE Already enabled, or the line of the device is bound to another request
+ *     - ESP_ERR_NO_MEM Fail to create the semaphore or the bus worker task
+ *     - ESP_ERR_NOT_SUPPORTED Interrupt-driven reads not enabled, polling mode is kept
+ *     - ESP_FAIL Fail to write GCONF1 or GCONF4
+ */
+esp_err_t apds9960_enable_gesture_irq(apds9960_handle_t sensor, int gpio_num);
+
+/**
+ * @brief Go back to polling mode, GIEN is cleared and the INT pin released. Called by apds9960_delete.
+ *
+ * @param sensor object handle of apds9960
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_FAIL Fail to write GCONF4
+ */
+esp_err_t apds9960_disable_gesture_irq(apds9960_handle_t sensor);
+
+/**
+ * @brief Read every dataset of the gesture FIFO (GFLVL x 4 bytes) into the ring buffer of the sensor.
+ *        GFLVL and GSTATUS are read in one burst, then the datasets in a second one. If the ring buffer is full,
+ *        the oldest datasets are dropped.
+ *
+ * @param sensor object handle of apds9960
+ * @param num pointer to save the number of datasets read, NULL if not needed
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_FAIL Fail
+ */
+esp_err_t apds9960_drain_gesture_fifo(apds9960_handle_t sensor, uint8_t *num);
+
+/**
+ * @brief Take the oldest dataset from the ring buffer of the sensor
+ *
+ * @param sensor object handle of apds9960
+ * @param dataset pointer to save the dataset
+ *
+ * @return
+ *     - true a dataset is returned
+ *     - false the ring buffer is empty
+ */
+bool apds9960_pop_gesture_dataset(apds9960_handle_t sensor, apds9960_gesture_dataset_t *dataset);
+
+/**
+ * @brief Get gesture acquisition counters since the sensor was created
+ *
+ * @param sensor object handle of apds9960
+ * @param stats pointer to save the counters
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG stats is NULL
+ */
+esp_err_t apds9960_get_gesture_stats(apds9960_handle_t sensor, apds9960_gesture_stats_t *stats);
+
+/**
+ * @brief Clear a gesture recogniser, the window in progress is dropped
+ *
+ * @param engine the recogniser
+ */
+void apds9960_gesture_engine_reset(apds9960_gesture_engine_t *engine);
+
+/**
+ * @brief Feed one dataset to a gesture recogniser. A window opens at the first dataset whose U + D + L + R exceeds
+ *        four times GESTURE_THRESHOLD_OUT and closes when the hand leaves, or after 128 datasets for a hand held still.
+ *        A pair at or below twice GESTURE_THRESHOLD_OUT, dark while a fast swipe crosses the other one, counts as centred.
+ *        On close, lines are fitted to the U/D and L/R ratio trajectories of the window: a ratio change above
+ *        GESTURE_SENSITIVITY_1 percent gives UP, DOWN, LEFT, RIGHT, or a diagonal if both ratios changed alike,
+ *        else a change of the reflected level between first and last dataset of half the peak gives NEAR or FAR.
+ *        Fixed-point only.
+ *
+ * @param engine the recogniser
+ * @param dataset the next dataset of the gesture FIFO
+ *
+ * @return
+ *     - the gesture recognised when a window closes (APDS9960_UP ... APDS9960_DOWN_RIGHT)
+ *     - 0 while the window is open, or if it closed without a gesture
+ */
+uint8_t apds9960_gesture_engine_feed(apds9960_gesture_engine_t *engine, const apds9960_gesture_dataset_t *dataset);
+
+/**
+ * @brief Close the window in progress of a gesture recogniser, e.g. when no dataset came for a while
+ *
+ * @param engine the recogniser
+ *
+ * @return
+ *     - the gesture recognised, 0 if none or no window was open
+ */
+uint8_t apds9960_gesture_engine_flush(apds9960_gesture_engine_t *engine);
+
 /**
  * @brief Reset some temp counts of gesture detection
  *
@@ -838,7 +863,23 @@ esp_err_t apds9960_get_color_data(apds9960_handle_t sensor, uint16_t *r,
                                       uint16_t *g, uint16_t *b, uint16_t *c);
 
 /**
- * @brief  Converts the raw R/G/B values to color temperature in degrees Kelvin
+ * @brief  Read STATUS and the clear, red, green and blue channels in a single auto-increment burst,
+ *         one transfer instead of a status poll and four channel reads.
+ *         Reading the channels clears AVALID, sample->status holds the value the channels were read with.
+ *
+ * @param sensor object handle of apds9960
+ * @param sample pointer to save the sample
+ *
+ * @return
+ *     - ESP_OK Success, the channels hold a completed ALS cycle
+ *     - ESP_ERR_INVALID_STATE AVALID not set, no ALS cycle completed since the last read, channels are stale
+ *     - ESP_FAIL Fail
+ */
+esp_err_t apds9960_read_color_sample(apds9960_handle_t sensor, apds9960_color_sample_t *sample);
+
+/**
+ * @brief  Converts the raw R/G/B values to color temperature in degrees Kelvin, with McCamy's formula.
+ *         The IR passed by the color filters is not removed, see apds9960_calculate_color_temperature_ir.
  *
  * @param sensor object handle of apds9960
  * @param r value of r
@@ -846,13 +887,14 @@ esp_err_t apds9960_get_color_data(apds9960_handle_t sensor, uint16_t *r,
  * @param b value of b
  *
  * @return
- *     - Return the results in degrees Kelvin
+ *     - Return the results in degrees Kelvin, 0 if the chromaticity is out of the range of the formula
  */
 uint16_t apds9960_calculate_color_temperature(apds9960_handle_t sensor,
         uint16_t r, uint16_t g, uint16_t b);
 
 /**
- * @brief  Calculate ambient light values
+ * @brief  Calculate ambient light values from the raw R/G/B values.
+ *         The IR passed by the color filters is not removed, see apds9960_calculate_lux_ir.
  *
  * @param sensor object handle of apds9960
  * @param r value of r
@@ -865,6 +907,49 @@ uint16_t apds9960_calculate_color_temperature(apds9960_handle_t sensor,
 uint16_t apds9960_calculate_lux(apds9960_handle_t sensor, uint16_t r,
                                     uint16_t g, uint16_t b);
 
+/**
+ * @brief  Converts R/G/B values to color temperature in degrees Kelvin, the IR level estimated from the clear
+ *         channel is removed first as in apds9960_calculate_light
+ *
+ * @param r value of r
+ * @param g value of g
+ * @param b value of b
+ * @param c value of the clear channel
+ *
+ * @return
+ *     - Return the results in degrees Kelvin, 0 if the chromaticity is out of the range of the formula
+ */
+uint16_t apds9960_calculate_color_temperature_ir(uint16_t r, uint16_t g, uint16_t b, uint16_t c);
+
+/**
+ * @brief  Calculate ambient light values, the IR level estimated from the clear channel is removed first
+ *         as in apds9960_calculate_light
+ *
+ * @param r value of r
+ * @param g value of g
+ * @param b value of b
+ * @param c value of the clear channel
+ *
+ * @return
+ *     - Return the results of ambient light values
+ */
+uint16_t apds9960_calculate_lux_ir(uint16_t r, uint16_t g, uint16_t b, uint16_t c);
+
+/**
+ * @brief  Calculate color temperature and ambient light of an array of samples, e.g. read by
+ *         apds9960_read_color_sample. The IR level is estimated from the clear channel, (R + G + B - C) / 2,
+ *         and removed from R, G and B before the conversion. Single precision only, no pow.
+ *
+ * @param samples RGBC samples
+ * @param results pointer to save num results, in sample order
+ * @param num number of samples
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG samples or results is NULL
+ */
+esp_err_t apds9960_calculate_light(const apds9960_color_sample_t *samples, apds9960_light_t *results, size_t num);
+
 /**
  * @brief Turns color interrupts on or off
  *
@@ -14,6 +14,12 @@ extern "C"
         APDS9960_GESTURE_DOWN_EVT = 0x02,  /*!< When down gesture is detected, the event comes */
         APDS9960_GESTURE_LEFT_EVT = 0x03,  /*!< When left gesture is detected, the event comes */
         APDS9960_GESTURE_RIGHT_EVT = 0x04, /*!< When right gesture is detected, the event comes */
+        APDS9960_GESTURE_NEAR_EVT = 0x05,  /*!< When a hand approaches the sensor, the event comes */
+        APDS9960_GESTURE_FAR_EVT = 0x06,   /*!< When a hand moves away from the sensor, the event comes */
+        APDS9960_GESTURE_UP_LEFT_EVT = 0x07,    /*!< When up-left gesture is detected, the event comes */
+        APDS9960_GESTURE_UP_RIGHT_EVT = 0x08,   /*!< When up-right gesture is detected, the event comes */
+        APDS9960_GESTURE_DOWN_LEFT_EVT = 0x09,  /*!< When down-left gesture is detected, the event comes */
+        APDS9960_GESTURE_DOWN_RIGHT_EVT = 0x0A, /*!< When down-right gesture is detected, the event comes */
 
     } apds9960_cb_event_t;
 
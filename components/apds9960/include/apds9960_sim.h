@@ -0,0 +1,99 @@
+// Copyright 2015-2016 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _APDS9960_SIM_H_
+#define _APDS9960_SIM_H_
+
+#include "i2c_bus.h"
+
+#define APDS9960_SIM_GFIFO_LEN  32  /*!< datasets the gesture FIFO holds, as the real sensor */
+
+typedef void *apds9960_sim_handle_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * @brief Create a virtual APDS9960 on a simulated bus (linux target only)
+ *
+ * @param port I2C port of the simulated bus
+ * @param dev_addr I2C device address of sensor
+ *
+ * @return
+ *     - NULL Fail
+ *     - Others Success
+ */
+apds9960_sim_handle_t apds9960_sim_create(i2c_port_t port, uint8_t dev_addr);
+
+/**
+ * @brief Delete a virtual APDS9960
+ *
+ * @param sim Point to object handle of the virtual sensor
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ */
+esp_err_t apds9960_sim_delete(apds9960_sim_handle_t *sim);
+
+/**
+ * @brief Replay recorded gesture data. Datasets enter the gesture FIFO one every dataset_period_us of simulated
+ *        time while the gesture engine is enabled, a full FIFO drops datasets and reports overflow in GSTATUS.
+ *
+ * @param sim object handle of the virtual sensor
+ * @param datasets recorded UDLR datasets, copied
+ * @param num number of datasets
+ * @param dataset_period_us time between two datasets, 0 to fill the FIFO at once
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_NO_MEM Out of memory
+ */
+esp_err_t apds9960_sim_play_gesture(apds9960_sim_handle_t sim, const uint8_t (*datasets)[4], size_t num, uint32_t dataset_period_us);
+
+/**
+ * @brief Set the color data registers
+ *
+ * @param sim object handle of the virtual sensor
+ * @param c clear channel
+ * @param r red channel
+ * @param g green channel
+ * @param b blue channel
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ */
+esp_err_t apds9960_sim_set_color(apds9960_sim_handle_t sim, uint16_t c, uint16_t r, uint16_t g, uint16_t b);
+
+/**
+ * @brief Set the proximity data register
+ *
+ * @param sim object handle of the virtual sensor
+ * @param proximity proximity value
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ */
+esp_err_t apds9960_sim_set_proximity(apds9960_sim_handle_t sim, uint8_t proximity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
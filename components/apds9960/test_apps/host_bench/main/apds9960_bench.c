@@ -0,0 +1,519 @@
+// Copyright 2020-2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Host micro-benchmarks of the apds9960 engines:
+ * - gesture: accuracy and time per dataset of the window recogniser against the former counter recogniser,
+ *   on synthetic swipes of every class and on idle noise, then the same swipes replayed through the simulated sensor
+ *   and the driver. With APDS9960_GFIFO_FILE set, the recorded datasets of the file go through both recognisers too.
+ * - light: time per sample and CCT error of the batch and single sample conversions against the former pow based
+ *   conversion, the CCT shift IR causes with and without compensation, then samples read through the simulated sensor.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <time.h>
+#include "i2c_bus.h"
+#include "apds9960.h"
+#include "apds9960_sim.h"
+
+#define BENCH_PORT             I2C_NUM_0
+#define BENCH_GESTURE_TRIALS   (2000)  /* 200 per class */
+#define BENCH_REPLAY_TRIALS    (2)     /* per class, each replay runs in real time */
+#define BENCH_TRACE_MAX        (400)
+#define BENCH_DATASET_US       (2800)  /* GWTIME set by apds9960_gesture_init */
+#define BENCH_CLASSES          (10)
+#define BENCH_IDLE_TAIL        (4)     /* idle datasets after a swipe */
+#define BENCH_LIGHT_SAMPLES    (4096)
+#define BENCH_LIGHT_ROUNDS     (100)
+#define BENCH_LIGHT_IR         (150)   /* IR counts added to every channel */
+#define BENCH_LIGHT_READS      (64)
+#define BENCH_RECORD_MAX       (65536) /* datasets of a recorded file */
+#define BENCH_RECORD_FILE_ENV  "APDS9960_GFIFO_FILE"
+#define BENCH_RECORD_CLASS_ENV "APDS9960_GFIFO_GESTURE"
+
+static const char *s_gesture_names[BENCH_CLASSES + 1] = {
+    "none", "UP", "DOWN", "LEFT", "RIGHT", "NEAR", "FAR", "UP_LEFT", "UP_RIGHT", "DOWN_LEFT", "DOWN_RIGHT",
+};
+
+static uint32_t s_seed = 1;
+
+static int64_t bench_now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/* uniform in [0, 1), the same sequence on every host */
+static double bench_rand(void)
+{
+    s_seed = s_seed * 1103515245 + 12345;
+    return ((s_seed >> 8) & 0xFFFFFF) / (double) 0x1000000;
+}
+
+static double bench_gauss(void)
+{
+    double a = bench_rand() + 1e-9;
+    double b = bench_rand();
+    return sqrt(-2 * log(a)) * cos(6.283185307179586 * b);
+}
+
+static uint8_t bench_clamp(double v)
+{
+    return (uint8_t) fmax(0, fmin(255, v));
+}
+
+/*
+ * Synthetic swipe of a gesture class: a few idle datasets, the hand crossing the UDLR photodiodes
+ * (U on top, UP means U sees the hand first) at a random speed, height, offset and noise, then idle datasets.
+ * NEAR and FAR move the hand towards or away from the sensor instead.
+ */
+static size_t bench_gesture_trace(uint8_t gesture, uint8_t (*trace)[4], size_t max)
+{
+    static const double diode[4][2] = {{0, 1}, {0, -1}, {-1, 0}, {1, 0}};
+    const double s2 = 0.7071;
+    double amp = 60 + bench_rand() * 190;
+    double sigma = 0.8 + bench_rand() * 0.8;
+    double noise = 1 + bench_rand() * 4;
+    double wobble = (bench_rand() - 0.5) * 0.6;
+    int steps = 4 + (int)(bench_rand() * 60);
+    double dx = 0, dy = 0;
+    size_t n = 0;
+
+    switch (gesture) {
+    case APDS9960_UP:         dy = -1; break;
+    case APDS9960_DOWN:       dy = 1; break;
+    case APDS9960_LEFT:       dx = 1; break;
+    case APDS9960_RIGHT:      dx = -1; break;
+    case APDS9960_UP_LEFT:    dx = s2; dy = -s2; break;
+    case APDS9960_UP_RIGHT:   dx = -s2; dy = -s2; break;
+    case APDS9960_DOWN_LEFT:  dx = s2; dy = s2; break;
+    case APDS9960_DOWN_RIGHT: dx = -s2; dy = s2; break;
+    default: break;
+    }
+
+    for (int i = 0; i < 3; i++, n++) {
+        for (int c = 0; c < 4; c++) {
+            trace[n][c] = bench_clamp(noise * bench_gauss() + 2);
+        }
+    }
+
+    for (int k = 0; k < steps && n < max - BENCH_IDLE_TAIL; k++, n++) {
+        double t = (double) k / (steps - 1);
+        bool depth = (gesture == APDS9960_NEAR || gesture == APDS9960_FAR);
+        double height = (gesture == APDS9960_NEAR) ? 1.0 - 0.8 * t : 0.2 + 0.8 * t;
+        double p = -2.5 + 5 * t;
+        double px = depth ? wobble * 0.3 : dx * p - dy * wobble;
+        double py = depth ? 0 : dy * p + dx * wobble;
+
+        for (int c = 0; c < 4; c++) {
+            double ddx = px - diode[c][0];
+            double ddy = py - diode[c][1];
+            double v = depth ? amp * (0.6 + 0.4 * exp(-(ddx * ddx + ddy * ddy) / 4)) / (16 * height * height)
+                       : amp * exp(-(ddx * ddx + ddy * ddy) / (sigma * sigma));
+            trace[n][c] = bench_clamp(v + noise * bench_gauss());
+        }
+    }
+
+    /* a NEAR hand is held above the sensor until the window is full */
+    for (int k = 0; gesture == APDS9960_NEAR && k < 140 && n < max - BENCH_IDLE_TAIL; k++, n++) {
+        memcpy(trace[n], trace[n - 1], 4);
+    }
+
+    for (int i = 0; i < BENCH_IDLE_TAIL; i++, n++) {
+        for (int c = 0; c < 4; c++) {
+            trace[n][c] = bench_clamp(noise * bench_gauss() + 2);
+        }
+    }
+
+    return n;
+}
+
+/* the counter recogniser the window engine replaced, kept for comparison */
+typedef struct {
+    int up;
+    int down;
+    int left;
+    int right;
+} bench_legacy_t;
+
+static uint8_t bench_legacy_feed(bench_legacy_t *legacy, const uint8_t dataset[4])
+{
+    int ud = abs(dataset[0] - dataset[1]) > 13 ? dataset[0] - dataset[1] : 0;
+    int lr = abs(dataset[2] - dataset[3]) > 13 ? dataset[2] - dataset[3] : 0;
+    uint8_t gesture = 0;
+
+    if (ud < 0) {
+        gesture = legacy->down > 0 ? APDS9960_UP : gesture;
+        legacy->up += legacy->down > 0 ? 0 : 1;
+    } else if (ud > 0) {
+        gesture = legacy->up > 0 ? APDS9960_DOWN : gesture;
+        legacy->down += legacy->up > 0 ? 0 : 1;
+    }
+
+    if (lr < 0) {
+        gesture = legacy->right > 0 ? APDS9960_LEFT : gesture;
+        legacy->left += legacy->right > 0 ? 0 : 1;
+    } else if (lr > 0) {
+        gesture = legacy->left > 0 ? APDS9960_RIGHT : gesture;
+        legacy->right += legacy->left > 0 ? 0 : 1;
+    }
+
+    return gesture;
+}
+
+static uint8_t bench_engine_run(const uint8_t (*trace)[4], size_t n)
+{
+    apds9960_gesture_engine_t engine;
+    uint8_t gesture = 0;
+    apds9960_gesture_engine_reset(&engine);
+
+    for (size_t i = 0; i < n && gesture == 0; i++) {
+        apds9960_gesture_dataset_t dataset = {trace[i][0], trace[i][1], trace[i][2], trace[i][3]};
+        gesture = apds9960_gesture_engine_feed(&engine, &dataset);
+    }
+
+    return gesture != 0 ? gesture : apds9960_gesture_engine_flush(&engine);
+}
+
+static void bench_gesture_engine(void)
+{
+    static uint8_t trace[BENCH_TRACE_MAX][4];
+    int hits[BENCH_CLASSES + 1] = {0};
+    int legacy_hits[BENCH_CLASSES + 1] = {0};
+    int trials[BENCH_CLASSES + 1] = {0};
+    int64_t engine_ns = 0;
+    size_t datasets = 0;
+    int idle_false = 0;
+
+    for (int i = 0; i < BENCH_GESTURE_TRIALS; i++) {
+        uint8_t gesture = 1 + i % BENCH_CLASSES;
+        size_t n = bench_gesture_trace(gesture, trace, BENCH_TRACE_MAX);
+        int64_t start = bench_now_ns();
+        uint8_t found = bench_engine_run(trace, n);
+        engine_ns += bench_now_ns() - start;
+        datasets += n;
+
+        bench_legacy_t legacy = {0};
+        uint8_t legacy_found = 0;
+
+        for (size_t k = 0; k < n && legacy_found == 0; k++) {
+            legacy_found = bench_legacy_feed(&legacy, trace[k]);
+        }
+
+        trials[gesture]++;
+        hits[gesture] += (found == gesture);
+        legacy_hits[gesture] += (legacy_found == gesture);
+
+        /* idle noise of the same length, nothing must be recognised */
+        double noise = 1 + bench_rand() * 4;
+
+        for (size_t k = 0; k < n; k++) {
+            for (int c = 0; c < 4; c++) {
+                trace[k][c] = bench_clamp(noise * bench_gauss() + 2);
+            }
+        }
+
+        idle_false += (bench_engine_run(trace, n) != 0);
+    }
+
+    printf("gesture engine, %d synthetic swipes, %d per class\n", BENCH_GESTURE_TRIALS, BENCH_GESTURE_TRIALS / BENCH_CLASSES);
+    printf("%-11s %8s %8s\n", "class", "window", "counter");
+
+    for (int c = 1; c <= BENCH_CLASSES; c++) {
+        printf("%-11s %7d%% %7d%%\n", s_gesture_names[c], hits[c] * 100 / trials[c], legacy_hits[c] * 100 / trials[c]);
+    }
+
+    printf("window engine %.1f ns per dataset, %d gestures on %d idle traces\n\n", (double) engine_ns / datasets,
+           idle_false, BENCH_GESTURE_TRIALS);
+}
+
+/*
+ * Recorded datasets: the bytes read from GFIFO_U..GFIFO_R written as is, 4 per dataset in FIFO order,
+ * loaded the way test_apps/trace_replay of the bus component loads a trace dump (traces hold no data).
+ * Swipes are separated by datasets without a hand in view. If APDS9960_GFIFO_GESTURE names the class
+ * all swipes of the file belong to (e.g. UP), recognised gestures of another class are counted as wrong.
+ */
+static size_t bench_record_load(const char *path, uint8_t (*datasets)[4], size_t max)
+{
+    FILE *f = fopen(path, "rb");
+
+    if (f == NULL) {
+        printf("can not open %s\n", path);
+        return 0;
+    }
+
+    size_t num = fread(datasets, 4, max, f);
+    fclose(f);
+    return num;
+}
+
+static void bench_gesture_record(void)
+{
+    static uint8_t datasets[BENCH_RECORD_MAX][4];
+    const char *path = getenv(BENCH_RECORD_FILE_ENV);
+    const char *name = getenv(BENCH_RECORD_CLASS_ENV);
+    int found[BENCH_CLASSES + 1] = {0};
+    int legacy_found[BENCH_CLASSES + 1] = {0};
+    apds9960_gesture_engine_t engine;
+    bench_legacy_t legacy = {0};
+    uint8_t expected = 0;
+
+    if (path == NULL) {
+        return;
+    }
+
+    size_t num = bench_record_load(path, datasets, BENCH_RECORD_MAX);
+
+    for (int c = 1; name != NULL && c <= BENCH_CLASSES; c++) {
+        expected = strcasecmp(name, s_gesture_names[c]) == 0 ? c : expected;
+    }
+
+    apds9960_gesture_engine_reset(&engine);
+
+    for (size_t i = 0; i < num; i++) {
+        apds9960_gesture_dataset_t dataset = {datasets[i][0], datasets[i][1], datasets[i][2], datasets[i][3]};
+        uint8_t gesture = apds9960_gesture_engine_feed(&engine, &dataset);
+        uint8_t legacy_gesture = bench_legacy_feed(&legacy, datasets[i]);
+        found[gesture]++;
+        legacy_found[legacy_gesture]++;
+
+        /* the driver cleared the counters of the former recogniser at a gesture and when the FIFO ran dry */
+        if (legacy_gesture != 0 || datasets[i][0] + datasets[i][1] + datasets[i][2] + datasets[i][3] <= 4 * GESTURE_THRESHOLD_OUT) {
+            memset(&legacy, 0, sizeof(legacy));
+        }
+    }
+
+    found[apds9960_gesture_engine_flush(&engine)]++;
+    printf("recorded gestures of %s, %u datasets\n", path, (unsigned int) num);
+    printf("%-11s %8s %8s\n", "class", "window", "counter");
+
+    for (int c = 1; c <= BENCH_CLASSES; c++) {
+        printf("%-11s %8d %8d%s\n", s_gesture_names[c], found[c], legacy_found[c], c == expected ? "  expected" : "");
+    }
+
+    printf("\n");
+}
+
+/* the same swipes through the simulated sensor, one dataset every GWTIME, read by the polling driver */
+static void bench_gesture_replay(apds9960_sim_handle_t sim, apds9960_handle_t sensor)
+{
+    static uint8_t trace[BENCH_TRACE_MAX][4];
+    int hits = 0;
+    int total = 0;
+    uint32_t transactions = 0;
+    int64_t delay_us = 0;
+
+    apds9960_gesture_init(sensor);
+
+    for (int i = 0; i < BENCH_REPLAY_TRIALS * BENCH_CLASSES; i++) {
+        uint8_t gesture = 1 + i % BENCH_CLASSES;
+        size_t n = bench_gesture_trace(gesture, trace, BENCH_TRACE_MAX);
+        i2c_bus_sim_stats_t stats = {0};
+        uint8_t found = 0;
+        i2c_bus_sim_reset_stats(BENCH_PORT);
+        int64_t start_us = i2c_bus_sim_get_time_us();
+        apds9960_sim_play_gesture(sim, (const uint8_t (*)[4]) trace, n, BENCH_DATASET_US);
+
+        while (found == 0 && i2c_bus_sim_get_time_us() - start_us < (int64_t) n * BENCH_DATASET_US + 1000000) {
+            found = apds9960_read_gesture(sensor);
+        }
+
+        /* time from the hand leaving, the last swipe dataset entering the FIFO, to the gesture */
+        delay_us += i2c_bus_sim_get_time_us() - start_us - (int64_t)(n - BENCH_IDLE_TAIL) * BENCH_DATASET_US;
+        i2c_bus_sim_get_stats(BENCH_PORT, &stats);
+        transactions += stats.transactions;
+        hits += (found == gesture);
+        total++;
+    }
+
+    printf("gesture replay through the driver, %d swipes\n", total);
+    printf("recognised %d%%, %.1f bus transactions and %.1f ms after the hand left per swipe\n\n",
+           hits * 100 / total, (double) transactions / total, (double) delay_us / total / 1000);
+}
+
+/* the conversion calculate_light replaced, kept for comparison: x is X / X and the cubic goes through pow */
+static uint16_t bench_legacy_cct(uint16_t r, uint16_t g, uint16_t b)
+{
+    float X = (-0.14282F * r) + (1.54924F * g) + (-0.95641F * b);
+    float Y = (-0.32466F * r) + (1.57837F * g) + (-0.73191F * b);
+    float Z = (-0.68202F * r) + (0.77073F * g) + (0.56332F * b);
+    float xc = X / X;
+    float yc = Y / (X + Y + Z);
+    float n = (xc - 0.3320F) / (0.1858F - yc);
+    float cct = (449.0F * (float) pow(n, 3)) + (3525.0F * (float) pow(n, 2)) + (6823.3F * n) + 5520.33F;
+    return (uint16_t) cct;
+}
+
+static uint16_t bench_legacy_lux(uint16_t r, uint16_t g, uint16_t b)
+{
+    return (uint16_t)((-0.32466F * r) + (1.57837F * g) + (-0.73191F * b));
+}
+
+/* McCamy's formula in double, the reference of the CCT error */
+static double bench_reference_cct(double r, double g, double b)
+{
+    double X = -0.14282 * r + 1.54924 * g - 0.95641 * b;
+    double Y = -0.32466 * r + 1.57837 * g - 0.73191 * b;
+    double Z = -0.68202 * r + 0.77073 * g + 0.56332 * b;
+    double sum = X + Y + Z;
+
+    if (sum <= 0 || Y / sum >= 0.1858) {
+        return 0;
+    }
+
+    double n = (X / sum - 0.3320) / (0.1858 - Y / sum);
+    return fmax(0, fmin(65535, 449 * n * n * n + 3525 * n * n + 6823.3 * n + 5520.33));
+}
+
+/* daylight to incandescent light at a random level, ir counts added to every channel, clear sees them once */
+static void bench_light_sample(double t, double level, double ir, apds9960_color_sample_t *sample)
+{
+    double r = 200 + 800 * t;
+    double g = 300 + 300 * (1 - fabs(t - 0.5));
+    double b = 900 - 700 * t;
+    sample->r = (uint16_t)((r + ir) * level);
+    sample->g = (uint16_t)((g + ir) * level);
+    sample->b = (uint16_t)((b + ir) * level);
+    sample->c = (uint16_t)((r + g + b + ir) * level);
+}
+
+static void bench_light(apds9960_sim_handle_t sim, apds9960_handle_t sensor)
+{
+    static apds9960_color_sample_t samples[BENCH_LIGHT_SAMPLES];
+    static apds9960_light_t results[BENCH_LIGHT_SAMPLES];
+    static uint16_t cct[BENCH_LIGHT_SAMPLES];
+    static uint16_t lux[BENCH_LIGHT_SAMPLES];
+    const double total = (double) BENCH_LIGHT_SAMPLES * BENCH_LIGHT_ROUNDS;
+    double legacy_err = 0;
+    double batch_err = 0;
+    double plain_shift = 0;
+    double batch_shift = 0;
+    int single_matched = 0;
+
+    for (int i = 0; i < BENCH_LIGHT_SAMPLES; i++) {
+        bench_light_sample(bench_rand(), 0.5 + bench_rand() * 4, 0, &samples[i]);
+    }
+
+    int64_t start = bench_now_ns();
+
+    for (int k = 0; k < BENCH_LIGHT_ROUNDS; k++) {
+        for (int i = 0; i < BENCH_LIGHT_SAMPLES; i++) {
+            cct[i] = bench_legacy_cct(samples[i].r, samples[i].g, samples[i].b);
+            lux[i] = bench_legacy_lux(samples[i].r, samples[i].g, samples[i].b);
+        }
+    }
+
+    int64_t legacy_ns = bench_now_ns() - start;
+
+    for (int i = 0; i < BENCH_LIGHT_SAMPLES; i++) {
+        legacy_err = fmax(legacy_err, fabs(cct[i] - bench_reference_cct(samples[i].r, samples[i].g, samples[i].b)));
+    }
+
+    start = bench_now_ns();
+
+    for (int k = 0; k < BENCH_LIGHT_ROUNDS; k++) {
+        apds9960_calculate_light(samples, results, BENCH_LIGHT_SAMPLES);
+    }
+
+    int64_t batch_ns = bench_now_ns() - start;
+    start = bench_now_ns();
+
+    for (int k = 0; k < BENCH_LIGHT_ROUNDS; k++) {
+        for (int i = 0; i < BENCH_LIGHT_SAMPLES; i++) {
+            cct[i] = apds9960_calculate_color_temperature_ir(samples[i].r, samples[i].g, samples[i].b, samples[i].c);
+            lux[i] = apds9960_calculate_lux_ir(samples[i].r, samples[i].g, samples[i].b, samples[i].c);
+        }
+    }
+
+    int64_t single_ns = bench_now_ns() - start;
+
+    /* the samples have no IR, compensation leaves them as they are */
+    for (int i = 0; i < BENCH_LIGHT_SAMPLES; i++) {
+        single_matched += (cct[i] == results[i].cct && lux[i] == results[i].lux);
+        batch_err = fmax(batch_err, fabs(results[i].cct - bench_reference_cct(samples[i].r, samples[i].g, samples[i].b)));
+    }
+
+    /* the same light with and without IR */
+    for (int i = 0; i < BENCH_LIGHT_SAMPLES; i++) {
+        apds9960_color_sample_t pair[2];
+        apds9960_light_t light[2];
+        bench_light_sample((double) i / BENCH_LIGHT_SAMPLES, 1, 0, &pair[0]);
+        bench_light_sample((double) i / BENCH_LIGHT_SAMPLES, 1, BENCH_LIGHT_IR, &pair[1]);
+        apds9960_calculate_light(pair, light, 2);
+        plain_shift += fabs(bench_reference_cct(pair[0].r, pair[0].g, pair[0].b)
+                            - bench_reference_cct(pair[1].r, pair[1].g, pair[1].b));
+        batch_shift += fabs((double) light[0].cct - light[1].cct);
+    }
+
+    printf("light conversion, %d samples\n", BENCH_LIGHT_SAMPLES);
+    printf("%-8s %10s %14s\n", "", "ns/sample", "max CCT error");
+    printf("%-8s %10.1f %12.0f K\n", "pow", legacy_ns / total, legacy_err);
+    printf("%-8s %10.1f %12.0f K\n", "batch", batch_ns / total, batch_err);
+    printf("%-8s %10.1f, same result as batch for %d samples\n", "single", single_ns / total, single_matched);
+    printf("mean CCT shift from %d IR counts, without compensation %.0f K, compensated %.0f K\n",
+           BENCH_LIGHT_IR, plain_shift / BENCH_LIGHT_SAMPLES, batch_shift / BENCH_LIGHT_SAMPLES);
+
+    /* samples read through the simulated sensor and the driver */
+    i2c_bus_sim_stats_t stats = {0};
+    int matched = 0;
+    i2c_bus_sim_reset_stats(BENCH_PORT);
+
+    for (int i = 0; i < BENCH_LIGHT_READS; i++) {
+        apds9960_color_sample_t sample;
+        apds9960_light_t light;
+        apds9960_light_t expected;
+        bench_light_sample(bench_rand(), 1, bench_rand() * BENCH_LIGHT_IR, &samples[i]);
+        apds9960_sim_set_color(sim, samples[i].c, samples[i].r, samples[i].g, samples[i].b);
+        esp_err_t ret = apds9960_read_color_sample(sensor, &sample);
+
+        if ((ret == ESP_OK || ret == ESP_ERR_INVALID_STATE) && apds9960_calculate_light(&sample, &light, 1) == ESP_OK) {
+            apds9960_calculate_light(&samples[i], &expected, 1);
+            matched += (light.cct == expected.cct && light.lux == expected.lux);
+        }
+    }
+
+    i2c_bus_sim_get_stats(BENCH_PORT, &stats);
+    printf("light through the driver, %d reads, %d matched, %.1f bus transactions per read\n\n",
+           BENCH_LIGHT_READS, matched, (double) stats.transactions / BENCH_LIGHT_READS);
+}
+
+void app_main(void)
+{
+    apds9960_sim_handle_t sim = apds9960_sim_create(BENCH_PORT, APDS9960_I2C_ADDRESS);
+    i2c_config_t conf = {
+        .mode = I2C_MODE_MASTER,
+        .sda_io_num = 1,
+        .scl_io_num = 2,
+        .sda_pullup_en = true,
+        .scl_pullup_en = true,
+        .master.clk_speed = 400000,
+    };
+    i2c_bus_handle_t bus = i2c_bus_create(BENCH_PORT, &conf);
+    apds9960_handle_t sensor = apds9960_create(bus, APDS9960_I2C_ADDRESS);
+
+    bench_gesture_engine();
+    bench_gesture_record();
+    bench_gesture_replay(sim, sensor);
+    bench_light(sim, sensor);
+
+    apds9960_delete(&sensor);
+    i2c_bus_delete(&bus);
+    apds9960_sim_delete(&sim);
+    exit(EXIT_SUCCESS);
+}
@@ -16,10 +16,23 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
 
 #include "esp_log.h"
 #include "i2c_bus.h"
 
+#ifdef CONFIG_IDF_TARGET_LINUX
+#define I2C_BUS_TIME_US() i2c_bus_sim_get_time_us() /*!<simulated time, wire time of simulated transfers included*/
+#define I2C_BUS_DELAY_US(us) i2c_bus_sim_delay_us(us)
+#else
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
+#include "driver/gpio.h"
+#define I2C_BUS_TIME_US() esp_timer_get_time()
+#define I2C_BUS_DELAY_US(us) esp_rom_delay_us(us)
+#endif
+
 #define I2C_ACK_CHECK_EN 0x1  /*!< I2C master will check ack from slave*/
 #define I2C_ACK_CHECK_DIS 0x0 /*!< I2C master will not check ack from slave */
 #define I2C_BUS_FLG_DEFAULT (0)
@@ -27,23 +40,205 @@
 #define I2C_BUS_MS_TO_WAIT 200
 #define I2C_BUS_TICKS_TO_WAIT (I2C_BUS_MS_TO_WAIT / portTICK_RATE_MS)
 #define I2C_BUS_MUTEX_TICKS_TO_WAIT (I2C_BUS_MS_TO_WAIT / portTICK_RATE_MS)
+#define I2C_BUS_MS_TO_TICKS(ms) (((ms) + portTICK_RATE_MS - 1) / portTICK_RATE_MS) /*!<rounded up, a short budget never becomes 0*/
+#define I2C_BUS_PROBE_READS 16 /*!<reads of the known register at each clock speed step*/
+#define I2C_BUS_RECOVERY_PULSES 9      /*!<SCL pulses to let a slave finish the byte it is sending*/
+#define I2C_BUS_RECOVERY_HALF_CYCLE_US 5 /*!<half period of recovery SCL pulses, 100 kHz*/
+#ifdef CONFIG_I2C_BUS_RECOVERY
+#define I2C_BUS_RECOVERY_TIMEOUTS CONFIG_I2C_BUS_RECOVERY_TIMEOUTS
+#endif
+#define I2C_BUS_RETRY_BACKOFF_MAX_US (100 * 1000) /*!<longest wait between two retries*/
+#define I2C_BUS_CMD_FLAG_NO_RETRY 0x80 /*!<i2c_bus_device_cmd_begin flag, the link is sent once, not recorded in the trace*/
+#ifdef CONFIG_I2C_BUS_DEFAULT_RETRIES
+#define I2C_BUS_DEFAULT_RETRIES CONFIG_I2C_BUS_DEFAULT_RETRIES
+#define I2C_BUS_DEFAULT_RETRY_BACKOFF_US CONFIG_I2C_BUS_DEFAULT_RETRY_BACKOFF_US
+#else
+#define I2C_BUS_DEFAULT_RETRIES 0
+#define I2C_BUS_DEFAULT_RETRY_BACKOFF_US 0
+#endif
+
+#if defined(CONFIG_I2C_BUS_STATIC_CMD_LINK) && defined(I2C_LINK_RECOMMENDED_SIZE)
+#define I2C_BUS_STATIC_CMD_LINK_EN 1
+/*I2C_LINK_RECOMMENDED_SIZE counts transactions of 5 commands, the buffer is sized per command instead*/
+#define I2C_BUS_CMD_LINK_BUF_LEN (I2C_LINK_RECOMMENDED_SIZE(0) + I2C_INTERNAL_STRUCT_SIZE * CONFIG_I2C_BUS_CMD_LINK_MAX_CMDS)
+#define I2C_BUS_TXN_LINK_MAX_CMDS CONFIG_I2C_BUS_CMD_LINK_MAX_CMDS /*!<commands one transaction link can hold*/
+#else
+#define I2C_BUS_TXN_LINK_MAX_CMDS (UINT16_MAX) /*!<heap command link grows on demand*/
+#endif
+
+#ifdef CONFIG_I2C_BUS_DYNAMIC_RETIME
+#include "soc/soc.h"
+#define I2C_BUS_SCLK_FREQ APB_CLK_FREQ /*!<I2C controller source clock*/
+/*SCL cycles not held in the period registers, 1 of the low period and 13 of the high period with the 7 cycle filter
+i2c_param_config enables on ESP32*/
+#define I2C_BUS_SCL_PERIOD_ADJUST 14
+#define I2C_BUS_RETIME_TOLERANCE_PCT 5 /*!<max deviation of the retimed SCL frequency*/
+#endif
+
+#ifdef CONFIG_I2C_BUS_PRIORITY_ARBITRATION
+#define I2C_BUS_PRIO_AGING_TICKS ((CONFIG_I2C_BUS_PRIORITY_AGING_MS / portTICK_RATE_MS) > 0 ? (CONFIG_I2C_BUS_PRIORITY_AGING_MS / portTICK_RATE_MS) : 1)
+
+typedef struct i2c_bus_waiter
+{
+    struct i2c_bus_waiter *next; /*next waiter in arrival order*/
+    SemaphoreHandle_t sem;       /*given when the bus is handed over to this waiter*/
+    StaticSemaphore_t sem_buf;   /*storage of sem, waiters live on the waiting task stack*/
+    TaskHandle_t task;           /*waiting task*/
+    UBaseType_t task_priority;   /*task priority of the waiting task when it started waiting*/
+    i2c_bus_priority_t priority; /*priority class of the waiting device*/
+    TickType_t since;            /*tick the waiter was queued*/
+    bool granted;                /*bus is handed over, set with lock_spinlock taken*/
+} i2c_bus_waiter_t;
+#endif
+
+#ifdef CONFIG_I2C_BUS_SCHED
+#define I2C_BUS_SCHED_XFER_OVERHEAD_US CONFIG_I2C_BUS_SCHED_XFER_OVERHEAD_US
+#define I2C_BUS_SCHED_READ_CLOCKS(len) ((3 + (len)) * 9 + 3) /*!<address, register, address and data bytes, START, repeated START and STOP*/
+#endif
 
 typedef struct
 {
     i2c_port_t i2c_port;      /*!<I2C port number */
     bool is_init;             /*if bus is initialized*/
     i2c_config_t conf_active; /*!<I2C active configuration */
+    i2c_config_t conf_bus;    /*configuration of i2c_bus_create, applied to transfers without a device*/
+#ifndef CONFIG_I2C_BUS_PRIORITY_ARBITRATION
     SemaphoreHandle_t mutex;  /* mutex to achive thread-safe*/
+#endif
     int32_t ref_counter;      /*reference count*/
+#ifdef I2C_BUS_STATIC_CMD_LINK_EN
+    uint8_t cmd_link_buf[I2C_BUS_CMD_LINK_BUF_LEN]; /*static command link buffer, only used with mutex taken*/
+#endif
+    i2c_bus_cmd_link_stats_t cmd_link_stats; /*command link allocation counters*/
+#ifdef CONFIG_I2C_BUS_PRIORITY_ARBITRATION
+    portMUX_TYPE lock_spinlock; /*protects locked and waiters*/
+    bool locked;                /*bus is owned by a task, waiters is never empty when unlocked*/
+    i2c_bus_waiter_t *waiters;  /*tasks waiting for the bus in arrival order*/
+    TaskHandle_t owner;         /*task owning the bus, NULL if unlocked*/
+    UBaseType_t owner_base;     /*task priority of the owner when it got the bus, restored on release*/
+    UBaseType_t owner_priority; /*task priority the owner runs at, raised to the best waiting task*/
+    bool owner_boosting;        /*a task is raising the owner to owner_priority*/
+    i2c_bus_waiter_t *boost_waiters; /*releasing tasks waiting for owner_boosting to clear, woken by the booster*/
+#endif
+    i2c_bus_prio_stats_t prio_stats[I2C_BUS_PRIO_MAX]; /*bus wait time of device transfers per priority class*/
+#ifdef CONFIG_I2C_BUS_STATS
+    i2c_bus_stats_t stats;     /*counters of all devices on the bus*/
+    uint32_t lock_wait_us;     /*wait of the current bus owner, charged to the device on its first transfer*/
+#endif
+#ifdef CONFIG_I2C_BUS_TRACE
+    i2c_bus_trace_entry_t trace[CONFIG_I2C_BUS_TRACE_LEN]; /*ring buffer of the last transfers, only written with mutex taken*/
+    uint16_t trace_next;       /*entry written next*/
+    uint16_t trace_count;      /*valid entries*/
+    bool trace_enabled;        /*transfers are recorded*/
+#endif
+    uint8_t timeout_count;    /*consecutive timeouts, bus is recovered when it reaches I2C_BUS_RECOVERY_TIMEOUTS*/
+    TickType_t budget_start;  /*time the bus owner started waiting for the bus*/
+    TickType_t budget_ticks;  /*time budget of the bus owner, bus wait and transfers included*/
+    portMUX_TYPE scan_spinlock; /*protects scan_present and scan_probed, cache lookups do not wait for the bus*/
+    uint32_t scan_present[4]; /*scan cache, bit set if a device acked at the address*/
+    uint32_t scan_probed[4];  /*scan cache, bit set if the address was probed*/
+#ifdef CONFIG_I2C_BUS_ASYNC
+    QueueHandle_t req_queue;       /*pending asynchronous requests*/
+    TaskHandle_t worker;           /*worker task serving req_queue, NULL if not started*/
+    SemaphoreHandle_t worker_exit; /*given by the worker task before it deletes itself*/
+    BaseType_t worker_core;        /*core the worker task is pinned to, tskNO_AFFINITY if not pinned*/
+#endif
+#ifdef CONFIG_I2C_BUS_IRQ
+    portMUX_TYPE irq_spinlock;          /*protects irq_devices and the interrupt state of its devices*/
+    struct i2c_bus_device *irq_devices; /*devices with a bound interrupt line*/
+    uint8_t irq_posting;                /*ISRs posting to req_queue after leaving irq_spinlock, the queue is kept meanwhile*/
+#endif
 } i2c_bus_t;
 
+#define I2C_BUS_REG_CACHE_SIZE 256 /*!<8-bit internal address space*/
+#define I2C_BUS_REG_BITMAP_LEN (I2C_BUS_REG_CACHE_SIZE / 32)
+
 typedef struct
 {
-    uint8_t dev_addr;   /*device address*/
-    i2c_config_t conf;  /*!<I2C active configuration */
-    i2c_bus_t *i2c_bus; /*!<I2C bus*/
+    uint8_t value[I2C_BUS_REG_CACHE_SIZE];        /*shadow of register values*/
+    uint32_t valid[I2C_BUS_REG_BITMAP_LEN];       /*bitmap of registers with a known value*/
+    uint32_t is_volatile[I2C_BUS_REG_BITMAP_LEN]; /*bitmap of registers changed by the device, never cached*/
+    uint32_t coalesce[I2C_BUS_REG_BITMAP_LEN];    /*bitmap of volatile registers whose reads are coalesced*/
+    uint32_t fresh[I2C_BUS_REG_BITMAP_LEN];       /*bitmap of coalesced registers with a value read from the device*/
+    uint32_t window_us;                           /*coalesced values are served this long after the read, 0 if disabled*/
+    uint32_t read_us[];                           /*time of the last read of each register, only allocated with window_us*/
+} i2c_bus_reg_cache_t;
+
+typedef struct i2c_bus_device
+{
+    uint8_t dev_addr;               /*device address*/
+    i2c_config_t conf;              /*!<I2C active configuration */
+    bool clk_default;               /*created with clock speed 0, runs at the bus clock of its creation*/
+    i2c_bus_t *i2c_bus;             /*!<I2C bus*/
+    i2c_bus_priority_t priority;    /*priority class in bus arbitration*/
+    uint8_t retries;                /*retries of a failed transfer*/
+    uint32_t retry_backoff_us;      /*wait before the first retry, doubled at each retry*/
+    TickType_t ticks_to_wait;       /*default time budget of a call, bus wait and transfer included*/
+#ifdef CONFIG_I2C_BUS_STATS
+    i2c_bus_stats_t stats;          /*counters of the device, only updated with mutex taken*/
+#endif
+    i2c_bus_reg_cache_t *reg_cache; /*register shadow cache, NULL if disabled, only used with mutex taken*/
+    struct i2c_bus_group *group;    /*bus group the device was created by, NULL if none*/
+    struct i2c_bus_device *group_next; /*next device of the bus group, protected by the group spinlock*/
+    uint32_t group_load;            /*load declared to the bus group*/
+#ifdef CONFIG_I2C_BUS_IRQ
+    struct i2c_bus_device *irq_next; /*next device with a bound interrupt line on the bus*/
+    i2c_bus_request_t *irq_req;      /*request queued on interrupt, NULL if not bound*/
+    int irq_gpio;                    /*GPIO of the interrupt line*/
+    bool irq_queued;                 /*irq_req is queued or being served, line is masked*/
+    SemaphoreHandle_t irq_unbind;    /*given when irq_queued is cleared, set while i2c_bus_device_unbind_irq waits*/
+    bool irq_stalled;                /*request queue was full at the interrupt, line is masked*/
+    int64_t irq_time_us;             /*time of the last interrupt*/
+    i2c_bus_irq_stats_t irq_stats;   /*interrupt counters, protected by the bus irq_spinlock*/
+#endif
 } i2c_bus_device_t;
 
+typedef struct i2c_bus_group
+{
+    uint8_t num;                              /*number of buses*/
+    i2c_bus_t *buses[I2C_NUM_MAX];            /*buses in creation order*/
+    portMUX_TYPE spinlock;                    /*protects members, devices, load, taken and the utilisation window*/
+    i2c_bus_device_t *members;                /*devices created through the group*/
+    uint8_t devices[I2C_NUM_MAX];             /*devices created through the group per bus*/
+    uint32_t load[I2C_NUM_MAX];               /*sum of declared device loads per bus*/
+    uint32_t taken[I2C_NUM_MAX][4];           /*bitmap of addresses with a group device per bus*/
+    uint64_t last_busy_us[I2C_NUM_MAX];       /*bus wire time at the previous utilisation query*/
+    int64_t last_query_us;                    /*time of the previous utilisation query*/
+} i2c_bus_group_t;
+
+#ifdef CONFIG_I2C_BUS_SCHED
+typedef struct i2c_bus_sched_job
+{
+    struct i2c_bus_sched_job *next; /*next job in increasing relative deadline order*/
+    i2c_bus_device_t *i2c_device;   /*device read*/
+    uint8_t mem_address;            /*first register read*/
+    size_t data_len;                /*bytes read*/
+    uint32_t period_us;             /*release period*/
+    uint32_t deadline_us;           /*relative deadline, at most period_us*/
+    uint32_t cost_us;               /*estimated bus time of one read*/
+    int64_t release_us;             /*release time of the next read*/
+    i2c_bus_sched_cb_t callback;    /*consumer of the registers read*/
+    void *user_ctx;                 /*user context passed to callback*/
+    uint8_t data[];                 /*read buffer*/
+} i2c_bus_sched_job_t;
+
+typedef struct
+{
+    i2c_bus_t *i2c_bus;             /*bus of all jobs*/
+    SemaphoreHandle_t mutex;        /*protects jobs and stats, not held during reads and callbacks*/
+    SemaphoreHandle_t serve_lock;   /*held by the scheduler task while a job is served, taken before mutex*/
+    i2c_bus_sched_job_t *jobs;      /*admitted jobs in increasing relative deadline order*/
+    uint16_t util_limit_permille;   /*admission limit*/
+    TaskHandle_t task;              /*scheduler task*/
+    SemaphoreHandle_t task_exit;    /*given by the scheduler task before it deletes itself*/
+    volatile bool running;          /*cleared to stop the scheduler task*/
+#ifndef CONFIG_IDF_TARGET_LINUX
+    esp_timer_handle_t timer;       /*wakes the scheduler task at the next release*/
+#endif
+    i2c_bus_sched_stats_t stats;    /*counters, protected by mutex*/
+} i2c_bus_sched_t;
+#endif
+
 static const char *TAG = "i2c_bus";
 static i2c_bus_t s_i2c_bus[I2C_NUM_MAX];
 
@@ -68,32 +263,90 @@ static i2c_bus_t s_i2c_bus[I2C_NUM_MAX];
         return (ret);                                                                         \
     }
 
-#define I2C_BUS_MUTEX_TAKE(mutex, ret)                                                              \
-    if (!xSemaphoreTake(mutex, I2C_BUS_MUTEX_TICKS_TO_WAIT))                                        \
+#define I2C_BUS_MUTEX_TAKE(i2c_bus, prio, ret)                                                      \
+    if (i2c_bus_lock_take(i2c_bus, prio, I2C_BUS_MUTEX_TICKS_TO_WAIT) != ESP_OK)                    \
     {                                                                                               \
         ESP_LOGE(TAG, "i2c_bus take mutex timeout, max wait = %d ms", I2C_BUS_MUTEX_TICKS_TO_WAIT); \
         return (ret);                                                                               \
     }
 
-#define I2C_BUS_MUTEX_TAKE_MAX_DELAY(mutex, ret)                                      \
-    if (!xSemaphoreTake(mutex, portMAX_DELAY))                                        \
+#define I2C_BUS_MUTEX_TAKE_MAX_DELAY(i2c_bus, prio, ret)                              \
+    if (i2c_bus_lock_take(i2c_bus, prio, portMAX_DELAY) != ESP_OK)                    \
     {                                                                                 \
         ESP_LOGE(TAG, "i2c_bus take mutex timeout, max wait = %d ms", portMAX_DELAY); \
         return (ret);                                                                 \
     }
 
-#define I2C_BUS_MUTEX_GIVE(mutex, ret)              \
-    if (!xSemaphoreGive(mutex))                     \
+#define I2C_BUS_DEVICE_MUTEX_TAKE(i2c_device, timeout_ms, ret)                               \
+    if (i2c_bus_device_lock_take(i2c_device, timeout_ms) != ESP_OK)                            \
+    {                                                                                        \
+        ESP_LOGE(TAG, "i2c_bus take mutex timeout, device 0x%02x", (i2c_device)->dev_addr); \
+        return (ret);                                                                        \
+    }
+
+#define I2C_BUS_MUTEX_GIVE(i2c_bus, ret)            \
+    if (i2c_bus_lock_give(i2c_bus) != ESP_OK)       \
     {                                               \
         ESP_LOGE(TAG, "i2c_bus give mutex failed"); \
         return (ret);                               \
     }
 
+static esp_err_t i2c_bus_lock_take(i2c_bus_t *i2c_bus, i2c_bus_priority_t priority, TickType_t ticks_to_wait);
+static esp_err_t i2c_bus_lock_give(i2c_bus_t *i2c_bus);
+static esp_err_t i2c_bus_device_lock_take(i2c_bus_device_t *i2c_device, uint32_t timeout_ms);
+inline static TickType_t i2c_bus_budget_left(const i2c_bus_t *i2c_bus);
 static esp_err_t i2c_driver_reinit(i2c_port_t port, const i2c_config_t *conf);
+static esp_err_t i2c_driver_retime(i2c_port_t port, uint32_t clk_speed);
+static esp_err_t i2c_bus_line_recover(i2c_bus_t *i2c_bus);
 static esp_err_t i2c_driver_deinit(i2c_port_t port);
-static esp_err_t i2c_bus_write_reg8(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, size_t data_len, const uint8_t *data);
-static esp_err_t i2c_bus_read_reg8(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, size_t data_len, uint8_t *data);
+static esp_err_t i2c_bus_write_reg8(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, size_t data_len, const uint8_t *data, uint32_t timeout_ms);
+static esp_err_t i2c_bus_read_reg8(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, size_t data_len, uint8_t *data, uint32_t timeout_ms);
+static esp_err_t i2c_bus_read_raw(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, size_t data_len, uint8_t *data);
+static esp_err_t i2c_bus_device_read(i2c_bus_device_t *i2c_device, uint8_t mem_address, size_t data_len, uint8_t *data, uint8_t cmd_flags);
+static i2c_bus_txn_op_t *i2c_bus_txn_op_alloc(i2c_bus_txn_t *txn, i2c_bus_txn_op_type_t type, uint8_t mem_address);
+static uint32_t i2c_bus_txn_op_cmds(const i2c_bus_txn_op_t *op);
+static esp_err_t i2c_bus_txn_op_append(i2c_bus_device_t *i2c_device, i2c_cmd_handle_t cmd, const i2c_bus_txn_op_t *op);
+static esp_err_t i2c_bus_txn_link_send(i2c_bus_device_t *i2c_device, i2c_cmd_handle_t *cmd, const i2c_bus_txn_t *txn, uint8_t from, uint8_t to);
+static void i2c_bus_txn_ops_done(i2c_bus_device_t *i2c_device, i2c_bus_txn_t *txn, uint8_t from, uint8_t to, esp_err_t ret);
+static esp_err_t i2c_bus_regmap_xfer(i2c_bus_device_handle_t dev_handle, const i2c_bus_regmap_t *map, uint8_t *values, bool write);
+static void i2c_bus_group_leave(i2c_bus_device_t *i2c_device);
+static esp_err_t i2c_bus_trace_replay_entry(i2c_bus_device_handle_t dev_handle, const i2c_bus_trace_entry_t *entry, uint8_t *buf);
+static bool i2c_bus_reg_cache_read(i2c_bus_reg_cache_t *cache, uint8_t mem_address, size_t data_len, uint8_t *data);
+static void i2c_bus_reg_cache_write(i2c_bus_reg_cache_t *cache, uint8_t mem_address, size_t data_len, const uint8_t *data);
+static void i2c_bus_reg_cache_drop(i2c_bus_reg_cache_t *cache, uint8_t mem_address, size_t data_len);
+static bool i2c_bus_reg_cache_read_coalesced(i2c_bus_reg_cache_t *cache, uint8_t mem_address, size_t data_len, uint8_t *data);
+static void i2c_bus_reg_cache_coalesce(i2c_bus_reg_cache_t *cache, uint8_t mem_address, size_t data_len, const uint8_t *data);
+static void i2c_bus_reg_cache_expire(i2c_bus_reg_cache_t *cache);
+#ifdef CONFIG_I2C_BUS_ASYNC
+static esp_err_t i2c_bus_worker_start(i2c_bus_t *i2c_bus);
+static void i2c_bus_worker_stop(i2c_bus_t *i2c_bus);
+static void i2c_bus_worker_queue_delete(i2c_bus_t *i2c_bus, QueueHandle_t req_queue);
+static esp_err_t i2c_bus_worker_pin(i2c_bus_t *i2c_bus, BaseType_t core_id);
+static void i2c_bus_worker_serve(i2c_bus_request_t *req);
+static void i2c_bus_worker_task(void *arg);
+#endif
+#ifdef CONFIG_I2C_BUS_IRQ
+static void i2c_bus_irq_isr(void *arg);
+static void i2c_bus_irq_rearm(i2c_bus_t *i2c_bus, const i2c_bus_request_t *req);
+#endif
+#ifdef CONFIG_I2C_BUS_SCHED
+static bool i2c_bus_sched_admit(const i2c_bus_sched_t *sched, uint16_t *util_permille);
+static void i2c_bus_sched_job_serve(i2c_bus_sched_t *sched, i2c_bus_sched_job_t *job);
+static void i2c_bus_sched_wait(i2c_bus_sched_t *sched, int64_t wake_us);
+static void i2c_bus_sched_task(void *arg);
+#ifndef CONFIG_IDF_TARGET_LINUX
+static void i2c_bus_sched_timer_cb(void *arg);
+#endif
+#endif
 inline static bool i2c_config_compare(i2c_port_t port, const i2c_config_t *conf);
+inline static bool i2c_config_compare_pins(i2c_port_t port, const i2c_config_t *conf);
+inline static esp_err_t i2c_bus_conf_apply(i2c_port_t i2c_num, const i2c_config_t *conf);
+inline static esp_err_t i2c_bus_device_cmd_begin(i2c_bus_device_t *i2c_device, i2c_cmd_handle_t cmd, uint16_t mem_address, uint8_t trace_flags, size_t rx_len, size_t tx_len);
+#ifdef CONFIG_I2C_BUS_STATS
+static void i2c_bus_stats_record(i2c_bus_stats_t *stats, esp_err_t ret, uint32_t xfer_us, size_t rx_len, size_t tx_len);
+#endif
+inline static i2c_cmd_handle_t i2c_bus_cmd_link_take(i2c_bus_t *i2c_bus);
+inline static void i2c_bus_cmd_link_release(i2c_bus_t *i2c_bus, i2c_cmd_handle_t cmd);
 /**************************************** Public Functions (Application level)*********************************************/
 
 i2c_bus_handle_t i2c_bus_create(i2c_port_t port, const i2c_config_t *conf)
@@ -101,6 +354,7 @@ i2c_bus_handle_t i2c_bus_create(i2c_port_t port, const i2c_config_t *conf)
     I2C_BUS_CHECK(port < I2C_NUM_MAX, "I2C port error", NULL);
     I2C_BUS_CHECK(conf != NULL, "pointer = NULL error", NULL);
     I2C_BUS_CHECK(conf->mode == I2C_MODE_MASTER, "i2c_bus only supports master mode", NULL);
+    I2C_BUS_CHECK(conf->master.clk_speed <= I2C_BUS_CLK_SPEED_MAX, "clk_speed must <= I2C_BUS_CLK_SPEED_MAX", NULL);
 
     if (s_i2c_bus[port].is_init)
     {
@@ -113,14 +367,41 @@ i2c_bus_handle_t i2c_bus_create(i2c_port_t port, const i2c_config_t *conf)
     }
     else
     {
+        s_i2c_bus[port].ref_counter = 0;
+        portMUX_TYPE scan_spinlock_init = portMUX_INITIALIZER_UNLOCKED;
+        s_i2c_bus[port].scan_spinlock = scan_spinlock_init;
+#ifdef CONFIG_I2C_BUS_PRIORITY_ARBITRATION
+        portMUX_TYPE spinlock_init = portMUX_INITIALIZER_UNLOCKED;
+        s_i2c_bus[port].lock_spinlock = spinlock_init;
+        s_i2c_bus[port].locked = false;
+        s_i2c_bus[port].waiters = NULL;
+        s_i2c_bus[port].owner = NULL;
+        s_i2c_bus[port].owner_boosting = false;
+        s_i2c_bus[port].boost_waiters = NULL;
+#else
         s_i2c_bus[port].mutex = xSemaphoreCreateMutex();
         I2C_BUS_CHECK(s_i2c_bus[port].mutex != NULL, "i2c_bus xSemaphoreCreateMutex failed", NULL);
-        s_i2c_bus[port].ref_counter = 0;
+#endif
+#ifdef CONFIG_I2C_BUS_TRACE
+        s_i2c_bus[port].trace_next = 0;
+        s_i2c_bus[port].trace_count = 0;
+        s_i2c_bus[port].trace_enabled = true;
+#endif
+#ifdef CONFIG_I2C_BUS_IRQ
+        portMUX_TYPE irq_spinlock_init = portMUX_INITIALIZER_UNLOCKED;
+        s_i2c_bus[port].irq_spinlock = irq_spinlock_init;
+        s_i2c_bus[port].irq_devices = NULL;
+        s_i2c_bus[port].irq_posting = 0;
+#endif
+#ifdef CONFIG_I2C_BUS_ASYNC
+        s_i2c_bus[port].worker_core = CONFIG_I2C_BUS_ASYNC_TASK_CORE_ID < 0 ? tskNO_AFFINITY : CONFIG_I2C_BUS_ASYNC_TASK_CORE_ID;
+#endif
     }
 
     esp_err_t ret = i2c_driver_reinit(port, conf);
     I2C_BUS_CHECK(ret == ESP_OK, "init error", NULL);
     s_i2c_bus[port].conf_active = *conf;
+    s_i2c_bus[port].conf_bus = *conf;
     s_i2c_bus[port].i2c_port = port;
     return (i2c_bus_handle_t)&s_i2c_bus[port];
 }
@@ -130,53 +411,242 @@ esp_err_t i2c_bus_delete(i2c_bus_handle_t *p_bus)
     I2C_BUS_CHECK(p_bus != NULL && *p_bus != NULL, "pointer = NULL error", ESP_ERR_INVALID_ARG);
     i2c_bus_t *i2c_bus = (i2c_bus_t *)(*p_bus);
     I2C_BUS_INIT_CHECK(i2c_bus->is_init, ESP_FAIL);
-    I2C_BUS_MUTEX_TAKE_MAX_DELAY(i2c_bus->mutex, ESP_ERR_TIMEOUT);
+#ifdef CONFIG_I2C_BUS_ASYNC
+    I2C_BUS_MUTEX_TAKE_MAX_DELAY(i2c_bus, I2C_BUS_PRIO_NORMAL, ESP_ERR_TIMEOUT);
+    int32_t ref_counter = i2c_bus->ref_counter;
+    I2C_BUS_MUTEX_GIVE(i2c_bus, ESP_FAIL);
+
+    /*no device left means no pending request, the worker needs the bus to finish so it is stopped unlocked*/
+    if (ref_counter == 0)
+    {
+        i2c_bus_worker_stop(i2c_bus);
+    }
+#endif
+    I2C_BUS_MUTEX_TAKE_MAX_DELAY(i2c_bus, I2C_BUS_PRIO_NORMAL, ESP_ERR_TIMEOUT);
 
     /** if ref_counter == 0, de-init the bus**/
     if ((i2c_bus->ref_counter) > 0)
     {
         ESP_LOGW(TAG, "i2c%d is also handled by others ref_counter=%u, won't be de-inited", i2c_bus->i2c_port, i2c_bus->ref_counter);
+        I2C_BUS_MUTEX_GIVE(i2c_bus, ESP_FAIL);
         return ESP_OK;
     }
 
     esp_err_t ret = i2c_driver_deinit(i2c_bus->i2c_port);
-    I2C_BUS_CHECK(ret == ESP_OK, "deinit error", ret);
+
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "i2c%d deinit error", i2c_bus->i2c_port);
+        I2C_BUS_MUTEX_GIVE(i2c_bus, ESP_FAIL);
+        return ret;
+    }
+
+#ifdef CONFIG_I2C_BUS_PRIORITY_ARBITRATION
+    /*no device is left to wait for the bus, the lock is left clear for the next i2c_bus_create*/
+    portENTER_CRITICAL(&i2c_bus->lock_spinlock);
+    i2c_bus->locked = false;
+    i2c_bus->owner = NULL;
+    i2c_bus->waiters = NULL;
+    portEXIT_CRITICAL(&i2c_bus->lock_spinlock);
+#else
     vSemaphoreDelete(i2c_bus->mutex);
+#endif
     *p_bus = NULL;
     return ESP_OK;
 }
 
+esp_err_t i2c_bus_recover(i2c_bus_handle_t bus_handle)
+{
+    I2C_BUS_CHECK(bus_handle != NULL, "Null Bus Handle", ESP_ERR_INVALID_ARG);
+    i2c_bus_t *i2c_bus = (i2c_bus_t *)bus_handle;
+    I2C_BUS_INIT_CHECK(i2c_bus->is_init, ESP_ERR_INVALID_STATE);
+    I2C_BUS_MUTEX_TAKE(i2c_bus, I2C_BUS_PRIO_CRITICAL, ESP_ERR_TIMEOUT);
+    esp_err_t ret = i2c_bus_line_recover(i2c_bus);
+    I2C_BUS_MUTEX_GIVE(i2c_bus, ESP_FAIL);
+    return ret;
+}
+
 uint8_t i2c_bus_scan(i2c_bus_handle_t bus_handle, uint8_t *buf, uint8_t num)
 {
-    I2C_BUS_CHECK(bus_handle != NULL, "Handle error", 0);
+    i2c_bus_scan_config_t scan_conf = {
+        .addr_min = 0x01,
+        .addr_max = 0x7E,
+        .probe_timeout_ms = I2C_BUS_MS_TO_WAIT,
+        .incremental = false,
+    };
+    uint8_t device_count = 0;
+    return i2c_bus_scan_with_config(bus_handle, &scan_conf, buf, num, &device_count) == ESP_OK ? device_count : 0;
+}
+
+esp_err_t i2c_bus_scan_with_config(i2c_bus_handle_t bus_handle, const i2c_bus_scan_config_t *scan_conf, uint8_t *buf, uint8_t num, uint8_t *device_num)
+{
+    I2C_BUS_CHECK(bus_handle != NULL, "Handle error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(device_num != NULL, "pointer = NULL error", ESP_ERR_INVALID_ARG);
     i2c_bus_t *i2c_bus = (i2c_bus_t *)bus_handle;
-    I2C_BUS_INIT_CHECK(i2c_bus->is_init, 0);
+    I2C_BUS_INIT_CHECK(i2c_bus->is_init, ESP_ERR_INVALID_STATE);
+    const i2c_bus_scan_config_t scan_conf_default = I2C_BUS_SCAN_CONFIG_DEFAULT();
+
+    if (scan_conf == NULL)
+    {
+        scan_conf = &scan_conf_default;
+    }
+
+    I2C_BUS_CHECK(scan_conf->allow_list != NULL || scan_conf->addr_min <= scan_conf->addr_max, "address range error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(scan_conf->allow_list != NULL || scan_conf->addr_max < 0x80, "address range error", ESP_ERR_INVALID_ARG);
+    TickType_t probe_ticks = scan_conf->probe_timeout_ms / portTICK_RATE_MS;
+    probe_ticks = probe_ticks > 0 ? probe_ticks : 1;
+    size_t probe_num = scan_conf->allow_list != NULL ? scan_conf->allow_list_len : scan_conf->addr_max - scan_conf->addr_min + 1;
     uint8_t device_count = 0;
-    I2C_BUS_MUTEX_TAKE_MAX_DELAY(i2c_bus->mutex, 0);
-    for (uint8_t dev_address = 1; dev_address < 127; dev_address++)
+    esp_err_t ret = ESP_OK;
+    *device_num = 0;
+    /*probes go through the device path at the bus clock, so they are counted, traced and restore the bus config*/
+    i2c_bus_device_t probe = {
+        .conf = i2c_bus->conf_bus,
+        .i2c_bus = i2c_bus,
+        .priority = I2C_BUS_PRIO_LOW,
+    };
+
+    if (!scan_conf->incremental)
+    {
+        I2C_BUS_MUTEX_TAKE_MAX_DELAY(i2c_bus, I2C_BUS_PRIO_LOW, ESP_ERR_TIMEOUT);
+    }
+
+    for (size_t i = 0; i < probe_num; i++)
     {
-        i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+        uint8_t dev_address = scan_conf->allow_list != NULL ? scan_conf->allow_list[i] : scan_conf->addr_min + i;
+
+        if (dev_address >= 0x80)
+        {
+            continue;
+        }
+
+        if (scan_conf->incremental && i2c_bus_lock_take(i2c_bus, I2C_BUS_PRIO_LOW, I2C_BUS_MUTEX_TICKS_TO_WAIT) != ESP_OK)
+        {
+            ESP_LOGW(TAG, "i2c%d scan stopped at 0x%02x, bus busy", i2c_bus->i2c_port, dev_address);
+            *device_num = device_count;
+            return ESP_ERR_TIMEOUT;
+        }
+
+        i2c_cmd_handle_t cmd = i2c_bus_cmd_link_take(i2c_bus);
+
+        if (cmd == NULL)
+        {
+            ESP_LOGE(TAG, "i2c command link create failed");
+            ret = ESP_ERR_NO_MEM;
+            break;
+        }
+
         i2c_master_start(cmd);
         i2c_master_write_byte(cmd, (dev_address << 1) | I2C_MASTER_WRITE, I2C_ACK_CHECK_EN);
         i2c_master_stop(cmd);
-        esp_err_t ret = i2c_master_cmd_begin(i2c_bus->i2c_port, cmd, I2C_BUS_TICKS_TO_WAIT);
+        probe.dev_addr = dev_address;
+        i2c_bus->budget_start = xTaskGetTickCount();
+        i2c_bus->budget_ticks = probe_ticks;
+        esp_err_t probe_ret = i2c_bus_device_cmd_begin(&probe, cmd, NULL_I2C_MEM_ADDR, 0, 0, 0);
+        i2c_bus_cmd_link_release(i2c_bus, cmd);
+        uint32_t bit = 1UL << (dev_address % 32);
+        portENTER_CRITICAL(&i2c_bus->scan_spinlock);
+        bool was_present = (i2c_bus->scan_present[dev_address / 32] & bit) != 0;
+        bool was_probed = (i2c_bus->scan_probed[dev_address / 32] & bit) != 0;
+        i2c_bus->scan_probed[dev_address / 32] |= bit;
 
-        if (ret == ESP_OK)
+        if (probe_ret == ESP_OK)
+        {
+            i2c_bus->scan_present[dev_address / 32] |= bit;
+        }
+        else
+        {
+            i2c_bus->scan_present[dev_address / 32] &= ~bit;
+        }
+
+        portEXIT_CRITICAL(&i2c_bus->scan_spinlock);
+
+        if (probe_ret == ESP_OK)
         {
-            ESP_LOGI(TAG, "found i2c device address = 0x%02x", dev_address);
+
+            if (!scan_conf->incremental)
+            {
+                ESP_LOGI(TAG, "found i2c device address = 0x%02x", dev_address);
+            }
+            else if (!was_present)
+            {
+                ESP_LOGI(TAG, "i2c device attached, address = 0x%02x", dev_address);
+            }
+
             if (buf != NULL && device_count < num)
             {
                 *(buf + device_count) = dev_address;
             }
             device_count++;
         }
+        else if (scan_conf->incremental && was_probed && was_present)
+        {
+            ESP_LOGI(TAG, "i2c device detached, address = 0x%02x", dev_address);
+        }
+
+        if (scan_conf->incremental)
+        {
+            I2C_BUS_MUTEX_GIVE(i2c_bus, ESP_FAIL);
+        }
+    }
+
+    /*the bus is still taken if the whole scan holds it or the last incremental probe stopped early*/
+    if (!scan_conf->incremental || ret != ESP_OK)
+    {
+        I2C_BUS_MUTEX_GIVE(i2c_bus, ESP_FAIL);
+    }
+
+    *device_num = device_count;
+    return ret;
+}
+
+uint8_t i2c_bus_scan_get_cached(i2c_bus_handle_t bus_handle, uint8_t *buf, uint8_t num)
+{
+    I2C_BUS_CHECK(bus_handle != NULL, "Handle error", 0);
+    i2c_bus_t *i2c_bus = (i2c_bus_t *)bus_handle;
+    uint32_t present[4];
+    uint8_t device_count = 0;
+    portENTER_CRITICAL(&i2c_bus->scan_spinlock);
+    memcpy(present, i2c_bus->scan_present, sizeof(present));
+    portEXIT_CRITICAL(&i2c_bus->scan_spinlock);
 
-        i2c_cmd_link_delete(cmd);
+    for (uint8_t dev_address = 0; dev_address < 0x80; dev_address++)
+    {
+        if (present[dev_address / 32] & (1UL << (dev_address % 32)))
+        {
+            if (buf != NULL && device_count < num)
+            {
+                *(buf + device_count) = dev_address;
+            }
+            device_count++;
+        }
     }
-    I2C_BUS_MUTEX_GIVE(i2c_bus->mutex, 0);
+
     return device_count;
 }
 
+bool i2c_bus_scan_is_present(i2c_bus_handle_t bus_handle, uint8_t dev_addr)
+{
+    I2C_BUS_CHECK(bus_handle != NULL, "Handle error", false);
+    I2C_BUS_CHECK(dev_addr < 0x80, "address error", false);
+    i2c_bus_t *i2c_bus = (i2c_bus_t *)bus_handle;
+    portENTER_CRITICAL(&i2c_bus->scan_spinlock);
+    bool present = (i2c_bus->scan_present[dev_addr / 32] & (1UL << (dev_addr % 32))) != 0;
+    portEXIT_CRITICAL(&i2c_bus->scan_spinlock);
+    return present;
+}
+
+esp_err_t i2c_bus_scan_cache_clear(i2c_bus_handle_t bus_handle)
+{
+    I2C_BUS_CHECK(bus_handle != NULL, "Handle error", ESP_ERR_INVALID_ARG);
+    i2c_bus_t *i2c_bus = (i2c_bus_t *)bus_handle;
+    portENTER_CRITICAL(&i2c_bus->scan_spinlock);
+    memset(i2c_bus->scan_present, 0, sizeof(i2c_bus->scan_present));
+    memset(i2c_bus->scan_probed, 0, sizeof(i2c_bus->scan_probed));
+    portEXIT_CRITICAL(&i2c_bus->scan_spinlock);
+    return ESP_OK;
+}
+
 uint32_t i2c_bus_get_current_clk_speed(i2c_bus_handle_t bus_handle)
 {
     I2C_BUS_CHECK(bus_handle != NULL, "Null Bus Handle", 0);
@@ -193,324 +663,3572 @@ uint8_t i2c_bus_get_created_device_num(i2c_bus_handle_t bus_handle)
     return i2c_bus->ref_counter;
 }
 
-i2c_bus_device_handle_t i2c_bus_device_create(i2c_bus_handle_t bus_handle, uint8_t dev_addr, uint32_t clk_speed)
+esp_err_t i2c_bus_get_cmd_link_stats(i2c_bus_handle_t bus_handle, i2c_bus_cmd_link_stats_t *stats)
 {
-    I2C_BUS_CHECK(bus_handle != NULL, "Null Bus Handle", NULL);
-    I2C_BUS_CHECK(clk_speed <= 400000, "clk_speed must <= 400000", NULL);
+    I2C_BUS_CHECK(bus_handle != NULL, "Null Bus Handle", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(stats != NULL, "pointer = NULL error", ESP_ERR_INVALID_ARG);
     i2c_bus_t *i2c_bus = (i2c_bus_t *)bus_handle;
-    I2C_BUS_INIT_CHECK(i2c_bus->is_init, NULL);
-    i2c_bus_device_t *i2c_device = calloc(1, sizeof(i2c_bus_device_t));
-    I2C_BUS_CHECK(i2c_device != NULL, "calloc memory failed", NULL);
-    I2C_BUS_MUTEX_TAKE_MAX_DELAY(i2c_bus->mutex, NULL);
-    i2c_device->dev_addr = dev_addr;
-    i2c_device->conf = i2c_bus->conf_active;
+    I2C_BUS_INIT_CHECK(i2c_bus->is_init, ESP_ERR_INVALID_STATE);
+    I2C_BUS_MUTEX_TAKE(i2c_bus, I2C_BUS_PRIO_NORMAL, ESP_ERR_TIMEOUT);
+    *stats = i2c_bus->cmd_link_stats;
+    I2C_BUS_MUTEX_GIVE(i2c_bus, ESP_FAIL);
+    return ESP_OK;
+}
 
-    /*if clk_speed == 0, current active clock speed will be used, else set a specified value*/
-    if (clk_speed != 0)
-    {
-        i2c_device->conf.master.clk_speed = clk_speed;
-    }
+esp_err_t i2c_bus_get_prio_stats(i2c_bus_handle_t bus_handle, i2c_bus_priority_t priority, i2c_bus_prio_stats_t *stats)
+{
+    I2C_BUS_CHECK(bus_handle != NULL, "Null Bus Handle", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(priority < I2C_BUS_PRIO_MAX, "priority error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(stats != NULL, "pointer = NULL error", ESP_ERR_INVALID_ARG);
+    i2c_bus_t *i2c_bus = (i2c_bus_t *)bus_handle;
+    I2C_BUS_INIT_CHECK(i2c_bus->is_init, ESP_ERR_INVALID_STATE);
+    I2C_BUS_MUTEX_TAKE(i2c_bus, I2C_BUS_PRIO_NORMAL, ESP_ERR_TIMEOUT);
+    *stats = i2c_bus->prio_stats[priority];
+    I2C_BUS_MUTEX_GIVE(i2c_bus, ESP_FAIL);
+    return ESP_OK;
+}
 
-    i2c_device->i2c_bus = i2c_bus;
-    i2c_bus->ref_counter++;
-    I2C_BUS_MUTEX_GIVE(i2c_bus->mutex, NULL);
-    return (i2c_bus_device_handle_t)i2c_device;
+esp_err_t i2c_bus_reset_prio_stats(i2c_bus_handle_t bus_handle)
+{
+    I2C_BUS_CHECK(bus_handle != NULL, "Null Bus Handle", ESP_ERR_INVALID_ARG);
+    i2c_bus_t *i2c_bus = (i2c_bus_t *)bus_handle;
+    I2C_BUS_INIT_CHECK(i2c_bus->is_init, ESP_ERR_INVALID_STATE);
+    I2C_BUS_MUTEX_TAKE(i2c_bus, I2C_BUS_PRIO_NORMAL, ESP_ERR_TIMEOUT);
+    memset(i2c_bus->prio_stats, 0, sizeof(i2c_bus->prio_stats));
+    I2C_BUS_MUTEX_GIVE(i2c_bus, ESP_FAIL);
+    return ESP_OK;
 }
 
-esp_err_t i2c_bus_device_delete(i2c_bus_device_handle_t *p_dev_handle)
+esp_err_t i2c_bus_get_stats(i2c_bus_handle_t bus_handle, i2c_bus_stats_t *stats)
 {
-    I2C_BUS_CHECK(p_dev_handle != NULL && *p_dev_handle != NULL, "Null Device Handle", ESP_ERR_INVALID_ARG);
-    i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)(*p_dev_handle);
-    I2C_BUS_MUTEX_TAKE_MAX_DELAY(i2c_device->i2c_bus->mutex, ESP_ERR_TIMEOUT);
-    i2c_device->i2c_bus->ref_counter--;
-    I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus->mutex, ESP_FAIL);
-    free(i2c_device);
-    *p_dev_handle = NULL;
+    I2C_BUS_CHECK(bus_handle != NULL, "Null Bus Handle", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(stats != NULL, "pointer = NULL error", ESP_ERR_INVALID_ARG);
+#ifdef CONFIG_I2C_BUS_STATS
+    i2c_bus_t *i2c_bus = (i2c_bus_t *)bus_handle;
+    I2C_BUS_INIT_CHECK(i2c_bus->is_init, ESP_ERR_INVALID_STATE);
+    I2C_BUS_MUTEX_TAKE(i2c_bus, I2C_BUS_PRIO_NORMAL, ESP_ERR_TIMEOUT);
+    *stats = i2c_bus->stats;
+    I2C_BUS_MUTEX_GIVE(i2c_bus, ESP_FAIL);
     return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
 }
 
-uint8_t i2c_bus_device_get_address(i2c_bus_device_handle_t dev_handle)
+esp_err_t i2c_bus_reset_stats(i2c_bus_handle_t bus_handle)
 {
-    I2C_BUS_CHECK(dev_handle != NULL, "device handle error", NULL_I2C_DEV_ADDR);
-    i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)dev_handle;
-    return i2c_device->dev_addr;
+    I2C_BUS_CHECK(bus_handle != NULL, "Null Bus Handle", ESP_ERR_INVALID_ARG);
+#ifdef CONFIG_I2C_BUS_STATS
+    i2c_bus_t *i2c_bus = (i2c_bus_t *)bus_handle;
+    I2C_BUS_INIT_CHECK(i2c_bus->is_init, ESP_ERR_INVALID_STATE);
+    I2C_BUS_MUTEX_TAKE(i2c_bus, I2C_BUS_PRIO_NORMAL, ESP_ERR_TIMEOUT);
+    memset(&i2c_bus->stats, 0, sizeof(i2c_bus_stats_t));
+    I2C_BUS_MUTEX_GIVE(i2c_bus, ESP_FAIL);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
 }
 
-esp_err_t i2c_bus_read_bytes(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, size_t data_len, uint8_t *data)
+esp_err_t i2c_bus_device_get_stats(i2c_bus_device_handle_t dev_handle, i2c_bus_stats_t *stats)
 {
-    return i2c_bus_read_reg8(dev_handle, mem_address, data_len, data);
+    I2C_BUS_CHECK(dev_handle != NULL, "device handle error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(stats != NULL, "pointer = NULL error", ESP_ERR_INVALID_ARG);
+#ifdef CONFIG_I2C_BUS_STATS
+    i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)dev_handle;
+    I2C_BUS_INIT_CHECK(i2c_device->i2c_bus->is_init, ESP_ERR_INVALID_STATE);
+    I2C_BUS_MUTEX_TAKE(i2c_device->i2c_bus, I2C_BUS_PRIO_NORMAL, ESP_ERR_TIMEOUT);
+    *stats = i2c_device->stats;
+    I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus, ESP_FAIL);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
 }
 
-esp_err_t i2c_bus_read_byte(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, uint8_t *data)
+esp_err_t i2c_bus_device_reset_stats(i2c_bus_device_handle_t dev_handle)
 {
-    return i2c_bus_read_reg8(dev_handle, mem_address, 1, data);
+    I2C_BUS_CHECK(dev_handle != NULL, "device handle error", ESP_ERR_INVALID_ARG);
+#ifdef CONFIG_I2C_BUS_STATS
+    i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)dev_handle;
+    I2C_BUS_INIT_CHECK(i2c_device->i2c_bus->is_init, ESP_ERR_INVALID_STATE);
+    I2C_BUS_MUTEX_TAKE(i2c_device->i2c_bus, I2C_BUS_PRIO_NORMAL, ESP_ERR_TIMEOUT);
+    memset(&i2c_device->stats, 0, sizeof(i2c_bus_stats_t));
+    I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus, ESP_FAIL);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
 }
 
-esp_err_t i2c_bus_read_bit(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, uint8_t bit_num, uint8_t *data)
+esp_err_t i2c_bus_trace_enable(i2c_bus_handle_t bus_handle, bool enable)
 {
-    uint8_t byte = 0;
-    esp_err_t ret = i2c_bus_read_reg8(dev_handle, mem_address, 1, &byte);
-    *data = byte & (1 << bit_num);
-    *data = (*data != 0) ? 1 : 0;
-    return ret;
+    I2C_BUS_CHECK(bus_handle != NULL, "Null Bus Handle", ESP_ERR_INVALID_ARG);
+#ifdef CONFIG_I2C_BUS_TRACE
+    i2c_bus_t *i2c_bus = (i2c_bus_t *)bus_handle;
+    I2C_BUS_INIT_CHECK(i2c_bus->is_init, ESP_ERR_INVALID_STATE);
+    I2C_BUS_MUTEX_TAKE(i2c_bus, I2C_BUS_PRIO_NORMAL, ESP_ERR_TIMEOUT);
+    i2c_bus->trace_enabled = enable;
+    I2C_BUS_MUTEX_GIVE(i2c_bus, ESP_FAIL);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
 }
 
-esp_err_t i2c_bus_read_bits(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, uint8_t bit_start, uint8_t length, uint8_t *data)
+esp_err_t i2c_bus_trace_dump(i2c_bus_handle_t bus_handle, i2c_bus_trace_entry_t *entries, size_t *num)
 {
-    uint8_t byte = 0;
-    esp_err_t ret = i2c_bus_read_byte(dev_handle, mem_address, &byte);
+    I2C_BUS_CHECK(bus_handle != NULL, "Null Bus Handle", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(entries != NULL && num != NULL, "pointer = NULL error", ESP_ERR_INVALID_ARG);
+#ifdef CONFIG_I2C_BUS_TRACE
+    i2c_bus_t *i2c_bus = (i2c_bus_t *)bus_handle;
+    I2C_BUS_INIT_CHECK(i2c_bus->is_init, ESP_ERR_INVALID_STATE);
+    I2C_BUS_MUTEX_TAKE(i2c_bus, I2C_BUS_PRIO_LOW, ESP_ERR_TIMEOUT);
+    size_t count = *num < i2c_bus->trace_count ? *num : i2c_bus->trace_count;
+    /*the newest count entries, oldest first*/
+    size_t start = (i2c_bus->trace_next + CONFIG_I2C_BUS_TRACE_LEN - count) % CONFIG_I2C_BUS_TRACE_LEN;
 
-    if (ret != ESP_OK)
+    for (size_t i = 0; i < count; i++)
     {
-        return ret;
+        entries[i] = i2c_bus->trace[(start + i) % CONFIG_I2C_BUS_TRACE_LEN];
     }
 
-    uint8_t mask = ((1 << length) - 1) << (bit_start - length + 1);
-    byte &= mask;
-    byte >>= (bit_start - length + 1);
-    *data = byte;
-    return ret;
-}
-
-esp_err_t i2c_bus_write_byte(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, uint8_t data)
-{
-    return i2c_bus_write_reg8(dev_handle, mem_address, 1, &data);
+    *num = count;
+    I2C_BUS_MUTEX_GIVE(i2c_bus, ESP_FAIL);
+    return ESP_OK;
+#else
+    *num = 0;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
 }
 
-esp_err_t i2c_bus_write_bytes(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, size_t data_len, const uint8_t *data)
+esp_err_t i2c_bus_trace_clear(i2c_bus_handle_t bus_handle)
 {
-    return i2c_bus_write_reg8(dev_handle, mem_address, data_len, data);
+    I2C_BUS_CHECK(bus_handle != NULL, "Null Bus Handle", ESP_ERR_INVALID_ARG);
+#ifdef CONFIG_I2C_BUS_TRACE
+    i2c_bus_t *i2c_bus = (i2c_bus_t *)bus_handle;
+    I2C_BUS_INIT_CHECK(i2c_bus->is_init, ESP_ERR_INVALID_STATE);
+    I2C_BUS_MUTEX_TAKE(i2c_bus, I2C_BUS_PRIO_NORMAL, ESP_ERR_TIMEOUT);
+    i2c_bus->trace_next = 0;
+    i2c_bus->trace_count = 0;
+    I2C_BUS_MUTEX_GIVE(i2c_bus, ESP_FAIL);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
 }
 
-esp_err_t i2c_bus_write_bit(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, uint8_t bit_num, uint8_t data)
+esp_err_t i2c_bus_trace_replay(i2c_bus_handle_t bus_handle, const i2c_bus_trace_entry_t *entries, size_t num, i2c_bus_trace_replay_stats_t *stats)
 {
-    uint8_t byte = 0;
-    esp_err_t ret = i2c_bus_read_byte(dev_handle, mem_address, &byte);
+    I2C_BUS_CHECK(bus_handle != NULL, "Null Bus Handle", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK((entries != NULL || num == 0) && stats != NULL, "pointer = NULL error", ESP_ERR_INVALID_ARG);
+    memset(stats, 0, sizeof(i2c_bus_trace_replay_stats_t));
+#ifdef CONFIG_IDF_TARGET_LINUX
+    i2c_bus_t *i2c_bus = (i2c_bus_t *)bus_handle;
+    I2C_BUS_INIT_CHECK(i2c_bus->is_init, ESP_ERR_INVALID_STATE);
+    size_t buf_len = 1;
 
-    if (ret != ESP_OK)
+    for (size_t i = 0; i < num; i++)
     {
-        return ret;
+        buf_len = entries[i].rx_len > buf_len ? entries[i].rx_len : buf_len;
+        buf_len = entries[i].tx_len > buf_len ? entries[i].tx_len : buf_len;
     }
 
-    byte = (data != 0) ? (byte | (1 << bit_num)) : (byte & ~(1 << bit_num));
-    return i2c_bus_write_byte(dev_handle, mem_address, byte);
-}
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    struct
+    {
+        i2c_bus_device_handle_t handle;
+        uint32_t clk_speed;
+    } *devices = calloc(0x80, sizeof(*devices)); /*created on first use, by address*/
+    uint8_t *buf = calloc(1, buf_len);
+    I2C_BUS_CHECK_GOTO(devices != NULL && buf != NULL, "calloc memory failed", replay_end);
+    int64_t start_us = I2C_BUS_TIME_US();
 
-esp_err_t i2c_bus_write_bits(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, uint8_t bit_start, uint8_t length, uint8_t data)
-{
-    uint8_t byte = 0;
-    esp_err_t ret = i2c_bus_read_byte(dev_handle, mem_address, &byte);
+    for (size_t i = 0; i < num; i++)
+    {
+        const i2c_bus_trace_entry_t *entry = &entries[i];
 
-    if (ret != ESP_OK)
+        /*raw command links carry nothing to send again*/
+        if (entry->attempt > 0 || entry->dev_addr >= 0x80 || (entry->rx_len == 0 && entry->tx_len == 0))
+        {
+            stats->skipped++;
+            continue;
+        }
+
+        /*replay at the recorded clock, 0 from dumps without it means the bus clock*/
+        uint32_t clk_speed = entry->clk_speed <= I2C_BUS_CLK_SPEED_MAX ? entry->clk_speed : I2C_BUS_CLK_SPEED_MAX;
+
+        if (devices[entry->dev_addr].handle != NULL && devices[entry->dev_addr].clk_speed != clk_speed)
+        {
+            i2c_bus_device_delete(&devices[entry->dev_addr].handle);
+        }
+
+        if (devices[entry->dev_addr].handle == NULL)
+        {
+            devices[entry->dev_addr].handle = i2c_bus_device_create(bus_handle, entry->dev_addr, clk_speed);
+            devices[entry->dev_addr].clk_speed = clk_speed;
+            I2C_BUS_CHECK_GOTO(devices[entry->dev_addr].handle != NULL, "i2c_bus device create failed", replay_end);
+        }
+
+        /*keep the recorded spacing, a replay running late is not slowed down further*/
+        int64_t wait_us = start_us + (uint32_t)(entry->timestamp_us - entries[0].timestamp_us) - I2C_BUS_TIME_US();
+
+        if (wait_us >= portTICK_RATE_MS * 1000)
+        {
+            vTaskDelay(wait_us / 1000 / portTICK_RATE_MS);
+        }
+        else if (wait_us > 0)
+        {
+            I2C_BUS_DELAY_US(wait_us);
+        }
+
+        int64_t call_start = I2C_BUS_TIME_US();
+        esp_err_t xfer_ret = i2c_bus_trace_replay_entry(devices[entry->dev_addr].handle, entry, buf);
+        uint32_t call_us = (uint32_t)(I2C_BUS_TIME_US() - call_start);
+        stats->replayed++;
+        stats->failed += (xfer_ret != ESP_OK) ? 1 : 0;
+        stats->recorded_us += entry->duration_us;
+        stats->replay_us += call_us;
+        stats->recorded_max_us = entry->duration_us > stats->recorded_max_us ? entry->duration_us : stats->recorded_max_us;
+        stats->replay_max_us = call_us > stats->replay_max_us ? call_us : stats->replay_max_us;
+    }
+
+    ret = ESP_OK;
+
+replay_end:
+    for (size_t i = 0; devices != NULL && i < 0x80; i++)
     {
-        return ret;
+        if (devices[i].handle != NULL)
+        {
+            i2c_bus_device_delete(&devices[i].handle);
+        }
     }
 
-    uint8_t mask = ((1 << length) - 1) << (bit_start - length + 1);
-    data <<= (bit_start - length + 1); // shift data into correct position
-    data &= mask;                      // zero all non-important bits in data
-    byte &= ~(mask);                   // zero all important bits in existing byte
-    byte |= data;                      // combine data with existing byte
-    return i2c_bus_write_byte(dev_handle, mem_address, byte);
+    free(devices);
+    free(buf);
+    return ret;
+#else
+    /*traces carry no data, writing zeros to the registers of real devices is never safe*/
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
 }
 
-/**
- * @brief I2C master send queued commands.
- *        This function will trigger sending all queued commands.
- *        The task will be blocked until all the commands have been sent out.
- *        If I2C_BUS_DYNAMIC_CONFIG enable, i2c_bus will dynamically check configs and re-install i2c driver before each transfer,
- *        hence multiple devices with different configs on a single bus can be supported.
- *        @note
- *        Only call this function in I2C master mode
- *
- * @param i2c_num I2C port number
- * @param cmd_handle I2C command handler
- * @param ticks_to_wait maximum wait ticks.
- * @param conf pointer to I2C parameter settings
- * @return esp_err_t
- */
-inline static esp_err_t i2c_master_cmd_begin_with_conf(i2c_port_t i2c_num, i2c_cmd_handle_t cmd_handle, TickType_t ticks_to_wait, const i2c_config_t *conf)
+i2c_bus_device_handle_t i2c_bus_device_create(i2c_bus_handle_t bus_handle, uint8_t dev_addr, uint32_t clk_speed)
 {
-    esp_err_t ret;
-#ifdef CONFIG_I2C_BUS_DYNAMIC_CONFIG
-    /*if configs changed, i2c driver will reinit with new configuration*/
-    if (conf != NULL && false == i2c_config_compare(i2c_num, conf))
+    i2c_bus_device_config_t dev_conf = {
+        .dev_addr = dev_addr,
+        .clk_speed = clk_speed,
+        .priority = I2C_BUS_PRIO_NORMAL,
+        .retries = I2C_BUS_DEFAULT_RETRIES,
+        .retry_backoff_us = I2C_BUS_DEFAULT_RETRY_BACKOFF_US,
+    };
+    return i2c_bus_device_create_with_config(bus_handle, &dev_conf);
+}
+
+i2c_bus_device_handle_t i2c_bus_device_create_with_config(i2c_bus_handle_t bus_handle, const i2c_bus_device_config_t *dev_conf)
+{
+    I2C_BUS_CHECK(bus_handle != NULL, "Null Bus Handle", NULL);
+    I2C_BUS_CHECK(dev_conf != NULL, "pointer = NULL error", NULL);
+    I2C_BUS_CHECK(dev_conf->clk_speed <= I2C_BUS_CLK_SPEED_MAX, "clk_speed must <= I2C_BUS_CLK_SPEED_MAX", NULL);
+    I2C_BUS_CHECK(dev_conf->priority < I2C_BUS_PRIO_MAX, "priority error", NULL);
+    i2c_bus_t *i2c_bus = (i2c_bus_t *)bus_handle;
+    I2C_BUS_INIT_CHECK(i2c_bus->is_init, NULL);
+    i2c_bus_device_t *i2c_device = calloc(1, sizeof(i2c_bus_device_t));
+    I2C_BUS_CHECK(i2c_device != NULL, "calloc memory failed", NULL);
+    I2C_BUS_MUTEX_TAKE_MAX_DELAY(i2c_bus, I2C_BUS_PRIO_NORMAL, NULL);
+    i2c_device->dev_addr = dev_conf->dev_addr;
+    i2c_device->conf = i2c_bus->conf_active;
+    i2c_device->priority = dev_conf->priority;
+    i2c_device->retries = dev_conf->retries;
+    i2c_device->retry_backoff_us = dev_conf->retry_backoff_us;
+    i2c_device->ticks_to_wait = I2C_BUS_MS_TO_TICKS(dev_conf->timeout_ms != 0 ? dev_conf->timeout_ms : I2C_BUS_MS_TO_WAIT);
+
+    /*if clk_speed == 0, current active clock speed will be used, else set a specified value*/
+    if (dev_conf->clk_speed != 0)
     {
-        ret = i2c_driver_reinit(i2c_num, conf);
-        I2C_BUS_CHECK(ret == ESP_OK, "reinit error", ret);
-        s_i2c_bus[i2c_num].conf_active = *conf;
+        i2c_device->conf.master.clk_speed = dev_conf->clk_speed;
+    }
+
+    i2c_device->clk_default = (dev_conf->clk_speed == 0);
+    i2c_device->i2c_bus = i2c_bus;
+    i2c_bus->ref_counter++;
+    I2C_BUS_MUTEX_GIVE(i2c_bus, NULL);
+    return (i2c_bus_device_handle_t)i2c_device;
+}
+
+esp_err_t i2c_bus_device_delete(i2c_bus_device_handle_t *p_dev_handle)
+{
+    I2C_BUS_CHECK(p_dev_handle != NULL && *p_dev_handle != NULL, "Null Device Handle", ESP_ERR_INVALID_ARG);
+    i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)(*p_dev_handle);
+#ifdef CONFIG_I2C_BUS_IRQ
+    if (i2c_device->irq_req != NULL)
+    {
+        i2c_bus_device_unbind_irq(i2c_device);
     }
 #endif
-    ret = i2c_master_cmd_begin(i2c_num, cmd_handle, ticks_to_wait);
-    return ret;
+    I2C_BUS_MUTEX_TAKE_MAX_DELAY(i2c_device->i2c_bus, i2c_device->priority, ESP_ERR_TIMEOUT);
+    i2c_device->i2c_bus->ref_counter--;
+    I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus, ESP_FAIL);
+
+    if (i2c_device->group != NULL)
+    {
+        i2c_bus_group_leave(i2c_device);
+    }
+
+    free(i2c_device->reg_cache);
+    free(i2c_device);
+    *p_dev_handle = NULL;
+    return ESP_OK;
 }
 
-/**************************************** Public Functions (Low level)*********************************************/
+esp_err_t i2c_bus_device_probe_clk_speed(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, uint8_t expected, uint32_t clk_max, uint32_t *clk_speed)
+{
+    I2C_BUS_CHECK(dev_handle != NULL, "device handle error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(mem_address != NULL_I2C_MEM_ADDR, "probe needs an internal address", ESP_ERR_INVALID_ARG);
+#ifndef CONFIG_I2C_BUS_DYNAMIC_CONFIG
+    /*the bus clock is never switched, every step would be read at the same speed*/
+    return ESP_ERR_NOT_SUPPORTED;
+#else
+    static const uint32_t clk_steps[] = {100000, 200000, 400000, 600000, 800000, 1000000};
+    i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)dev_handle;
+    I2C_BUS_INIT_CHECK(i2c_device->i2c_bus->is_init, ESP_ERR_INVALID_STATE);
+    clk_max = clk_max < I2C_BUS_CLK_SPEED_MAX ? clk_max : I2C_BUS_CLK_SPEED_MAX;
+    I2C_BUS_DEVICE_MUTEX_TAKE(i2c_device, 0, ESP_ERR_TIMEOUT);
+    uint32_t clk_origin = i2c_device->conf.master.clk_speed;
+    uint32_t clk_found = 0;
 
-esp_err_t i2c_bus_cmd_begin(i2c_bus_device_handle_t dev_handle, i2c_cmd_handle_t cmd)
+    /*steps below the limit, then the limit itself*/
+    for (size_t i = 0; i < sizeof(clk_steps) / sizeof(clk_steps[0]); i++)
+    {
+        bool pass = true;
+        uint32_t clk_step = clk_steps[i] < clk_max ? clk_steps[i] : clk_max;
+        i2c_device->conf.master.clk_speed = clk_step;
+
+        for (int n = 0; n < I2C_BUS_PROBE_READS && pass; n++)
+        {
+            uint8_t data = ~expected;
+            i2c_cmd_handle_t cmd = i2c_bus_cmd_link_take(i2c_device->i2c_bus);
+
+            if (cmd == NULL)
+            {
+                pass = false;
+                break;
+            }
+
+            i2c_master_start(cmd);
+            i2c_master_write_byte(cmd, (i2c_device->dev_addr << 1) | I2C_MASTER_WRITE, I2C_ACK_CHECK_EN);
+            i2c_master_write_byte(cmd, mem_address, I2C_ACK_CHECK_EN);
+            i2c_master_start(cmd);
+            i2c_master_write_byte(cmd, (i2c_device->dev_addr << 1) | I2C_MASTER_READ, I2C_ACK_CHECK_EN);
+            i2c_master_read(cmd, &data, 1, I2C_MASTER_LAST_NACK);
+            i2c_master_stop(cmd);
+            esp_err_t ret = i2c_bus_device_cmd_begin(i2c_device, cmd, mem_address, 0, 1, 0);
+            i2c_bus_cmd_link_release(i2c_device->i2c_bus, cmd);
+            pass = (ret == ESP_OK && data == expected);
+        }
+
+        if (!pass)
+        {
+            break;
+        }
+
+        clk_found = clk_step;
+
+        if (clk_step == clk_max)
+        {
+            break;
+        }
+    }
+
+    /*a device on the bus default clock keeps it, the speed found is only reported*/
+    i2c_device->conf.master.clk_speed = (clk_found != 0 && !i2c_device->clk_default) ? clk_found : clk_origin;
+    I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus, ESP_FAIL);
+
+    if (clk_found == 0)
+    {
+        ESP_LOGW(TAG, "device 0x%02x register 0x%02x mismatch at %u Hz", i2c_device->dev_addr, mem_address, (unsigned int)(clk_steps[0] < clk_max ? clk_steps[0] : clk_max));
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    ESP_LOGI(TAG, "device 0x%02x highest clock speed %u Hz%s", i2c_device->dev_addr, (unsigned int)clk_found, i2c_device->clk_default ? "" : ", set");
+
+    if (clk_speed != NULL)
+    {
+        *clk_speed = clk_found;
+    }
+
+    return ESP_OK;
+#endif
+}
+
+esp_err_t i2c_bus_device_set_retry(i2c_bus_device_handle_t dev_handle, uint8_t retries, uint32_t backoff_us)
 {
     I2C_BUS_CHECK(dev_handle != NULL, "device handle error", ESP_ERR_INVALID_ARG);
-    I2C_BUS_CHECK(cmd != NULL, "I2C command error", ESP_ERR_INVALID_ARG);
     i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)dev_handle;
     I2C_BUS_INIT_CHECK(i2c_device->i2c_bus->is_init, ESP_ERR_INVALID_STATE);
-    I2C_BUS_MUTEX_TAKE(i2c_device->i2c_bus->mutex, ESP_ERR_TIMEOUT);
-    esp_err_t ret = i2c_master_cmd_begin_with_conf(i2c_device->i2c_bus->i2c_port, cmd, I2C_BUS_TICKS_TO_WAIT, &i2c_device->conf);
-    I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus->mutex, ESP_FAIL);
-    return ret;
+    I2C_BUS_DEVICE_MUTEX_TAKE(i2c_device, 0, ESP_ERR_TIMEOUT);
+    i2c_device->retries = retries;
+    i2c_device->retry_backoff_us = backoff_us;
+    I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus, ESP_FAIL);
+    return ESP_OK;
 }
 
-static esp_err_t i2c_bus_read_reg8(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, size_t data_len, uint8_t *data)
+esp_err_t i2c_bus_device_set_timeout(i2c_bus_device_handle_t dev_handle, uint32_t timeout_ms)
 {
     I2C_BUS_CHECK(dev_handle != NULL, "device handle error", ESP_ERR_INVALID_ARG);
-    I2C_BUS_CHECK(data != NULL, "data pointer error", ESP_ERR_INVALID_ARG);
     i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)dev_handle;
     I2C_BUS_INIT_CHECK(i2c_device->i2c_bus->is_init, ESP_ERR_INVALID_STATE);
-    I2C_BUS_MUTEX_TAKE(i2c_device->i2c_bus->mutex, ESP_ERR_TIMEOUT);
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    I2C_BUS_DEVICE_MUTEX_TAKE(i2c_device, 0, ESP_ERR_TIMEOUT);
+    i2c_device->ticks_to_wait = I2C_BUS_MS_TO_TICKS(timeout_ms != 0 ? timeout_ms : I2C_BUS_MS_TO_WAIT);
+    I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus, ESP_FAIL);
+    return ESP_OK;
+}
 
-    if (mem_address != NULL_I2C_MEM_ADDR)
+uint8_t i2c_bus_device_get_address(i2c_bus_device_handle_t dev_handle)
+{
+    I2C_BUS_CHECK(dev_handle != NULL, "device handle error", NULL_I2C_DEV_ADDR);
+    i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)dev_handle;
+    return i2c_device->dev_addr;
+}
+
+esp_err_t i2c_bus_reg_cache_enable(i2c_bus_device_handle_t dev_handle, const uint8_t *volatile_regs, size_t num)
+{
+    I2C_BUS_CHECK(dev_handle != NULL, "device handle error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(volatile_regs != NULL || num == 0, "volatile register list error", ESP_ERR_INVALID_ARG);
+    i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)dev_handle;
+    i2c_bus_reg_cache_t *cache = calloc(1, sizeof(i2c_bus_reg_cache_t));
+    I2C_BUS_CHECK(cache != NULL, "calloc memory failed", ESP_ERR_NO_MEM);
+
+    for (size_t i = 0; i < num; i++)
     {
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, (i2c_device->dev_addr << 1) | I2C_MASTER_WRITE, I2C_ACK_CHECK_EN);
-        i2c_master_write_byte(cmd, mem_address, I2C_ACK_CHECK_EN);
+        cache->is_volatile[volatile_regs[i] / 32] |= (1UL << (volatile_regs[i] % 32));
     }
 
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (i2c_device->dev_addr << 1) | I2C_MASTER_READ, I2C_ACK_CHECK_EN);
-    i2c_master_read(cmd, data, data_len, I2C_MASTER_LAST_NACK);
-    i2c_master_stop(cmd);
-    esp_err_t ret = i2c_master_cmd_begin_with_conf(i2c_device->i2c_bus->i2c_port, cmd, I2C_BUS_TICKS_TO_WAIT, &i2c_device->conf);
-    i2c_cmd_link_delete(cmd);
-    I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus->mutex, ESP_FAIL);
-    return ret;
+    if (i2c_bus_device_lock_take(i2c_device, 0) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "i2c_bus take mutex timeout, device 0x%02x", i2c_device->dev_addr);
+        free(cache);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    i2c_bus_reg_cache_t *old = i2c_device->reg_cache;
+    i2c_device->reg_cache = cache;
+    I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus, ESP_FAIL);
+    free(old);
+    return ESP_OK;
 }
 
-esp_err_t i2c_bus_read_reg16(i2c_bus_device_handle_t dev_handle, uint16_t mem_address, size_t data_len, uint8_t *data)
+esp_err_t i2c_bus_reg_cache_disable(i2c_bus_device_handle_t dev_handle)
 {
     I2C_BUS_CHECK(dev_handle != NULL, "device handle error", ESP_ERR_INVALID_ARG);
-    I2C_BUS_CHECK(data != NULL, "data pointer error", ESP_ERR_INVALID_ARG);
     i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)dev_handle;
-    I2C_BUS_INIT_CHECK(i2c_device->i2c_bus->is_init, ESP_ERR_INVALID_STATE);
-    uint8_t memAddress8[2];
-    memAddress8[0] = (uint8_t)((mem_address >> 8) & 0x00FF);
-    memAddress8[1] = (uint8_t)(mem_address & 0x00FF);
-    I2C_BUS_MUTEX_TAKE(i2c_device->i2c_bus->mutex, ESP_ERR_TIMEOUT);
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    I2C_BUS_DEVICE_MUTEX_TAKE(i2c_device, 0, ESP_ERR_TIMEOUT);
+    i2c_bus_reg_cache_t *old = i2c_device->reg_cache;
+    i2c_device->reg_cache = NULL;
+    I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus, ESP_FAIL);
+    free(old);
+    return ESP_OK;
+}
 
-    if (mem_address != NULL_I2C_MEM_ADDR)
+esp_err_t i2c_bus_reg_cache_invalidate(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, size_t data_len)
+{
+    I2C_BUS_CHECK(dev_handle != NULL, "device handle error", ESP_ERR_INVALID_ARG);
+    i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)dev_handle;
+    I2C_BUS_DEVICE_MUTEX_TAKE(i2c_device, 0, ESP_ERR_TIMEOUT);
+    i2c_bus_reg_cache_drop(i2c_device->reg_cache, mem_address, data_len);
+    I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus, ESP_FAIL);
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_reg_cache_invalidate_all(i2c_bus_device_handle_t dev_handle)
+{
+    I2C_BUS_CHECK(dev_handle != NULL, "device handle error", ESP_ERR_INVALID_ARG);
+    i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)dev_handle;
+    I2C_BUS_DEVICE_MUTEX_TAKE(i2c_device, 0, ESP_ERR_TIMEOUT);
+
+    if (i2c_device->reg_cache != NULL)
     {
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, (i2c_device->dev_addr << 1) | I2C_MASTER_WRITE, I2C_ACK_CHECK_EN);
-        i2c_master_write(cmd, memAddress8, 2, I2C_ACK_CHECK_EN);
+        memset(i2c_device->reg_cache->valid, 0, sizeof(i2c_device->reg_cache->valid));
     }
 
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (i2c_device->dev_addr << 1) | I2C_MASTER_READ, I2C_ACK_CHECK_EN);
-    i2c_master_read(cmd, data, data_len, I2C_MASTER_LAST_NACK);
-    i2c_master_stop(cmd);
-    esp_err_t ret = i2c_master_cmd_begin_with_conf(i2c_device->i2c_bus->i2c_port, cmd, I2C_BUS_TICKS_TO_WAIT, &i2c_device->conf);
-    i2c_cmd_link_delete(cmd);
-    I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus->mutex, ESP_FAIL);
-    return ret;
+    i2c_bus_reg_cache_expire(i2c_device->reg_cache);
+
+    I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus, ESP_FAIL);
+    return ESP_OK;
 }
 
-static esp_err_t i2c_bus_write_reg8(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, size_t data_len, const uint8_t *data)
+esp_err_t i2c_bus_reg_cache_set_coalesce(i2c_bus_device_handle_t dev_handle, const uint8_t *regs, size_t num, uint32_t window_us)
 {
     I2C_BUS_CHECK(dev_handle != NULL, "device handle error", ESP_ERR_INVALID_ARG);
-    I2C_BUS_CHECK(data != NULL, "data pointer error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(regs != NULL || num == 0, "coalesced register list error", ESP_ERR_INVALID_ARG);
     i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)dev_handle;
-    I2C_BUS_INIT_CHECK(i2c_device->i2c_bus->is_init, ESP_ERR_INVALID_STATE);
-    I2C_BUS_MUTEX_TAKE(i2c_device->i2c_bus->mutex, ESP_ERR_TIMEOUT);
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (i2c_device->dev_addr << 1) | I2C_MASTER_WRITE, I2C_ACK_CHECK_EN);
+    bool enable = num > 0 && window_us > 0;
+    i2c_bus_reg_cache_t *cache = calloc(1, sizeof(i2c_bus_reg_cache_t) + (enable ? I2C_BUS_REG_CACHE_SIZE * sizeof(uint32_t) : 0));
+    I2C_BUS_CHECK(cache != NULL, "calloc memory failed", ESP_ERR_NO_MEM);
 
-    if (mem_address != NULL_I2C_MEM_ADDR)
+    if (i2c_bus_device_lock_take(i2c_device, 0) != ESP_OK)
     {
-        i2c_master_write_byte(cmd, mem_address, I2C_ACK_CHECK_EN);
+        ESP_LOGE(TAG, "i2c_bus take mutex timeout, device 0x%02x", i2c_device->dev_addr);
+        free(cache);
+        return ESP_ERR_TIMEOUT;
     }
 
-    i2c_master_write(cmd, (uint8_t *)data, data_len, I2C_ACK_CHECK_EN);
-    i2c_master_stop(cmd);
-    esp_err_t ret = i2c_master_cmd_begin_with_conf(i2c_device->i2c_bus->i2c_port, cmd, I2C_BUS_TICKS_TO_WAIT, &i2c_device->conf);
-    i2c_cmd_link_delete(cmd);
-    I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus->mutex, ESP_FAIL);
-    return ret;
+    i2c_bus_reg_cache_t *old = i2c_device->reg_cache;
+
+    if (old == NULL)
+    {
+        I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus, ESP_FAIL);
+        free(cache);
+        ESP_LOGE(TAG, "register cache not enabled, device 0x%02x", i2c_device->dev_addr);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    /*shadowed values are kept, coalesced values of the previous list are dropped*/
+    memcpy(cache->value, old->value, sizeof(cache->value));
+    memcpy(cache->valid, old->valid, sizeof(cache->valid));
+    memcpy(cache->is_volatile, old->is_volatile, sizeof(cache->is_volatile));
+
+    for (size_t i = 0; i < num && enable; i++)
+    {
+        /*non-volatile registers are cached anyway*/
+        cache->coalesce[regs[i] / 32] |= cache->is_volatile[regs[i] / 32] & (1UL << (regs[i] % 32));
+    }
+
+    cache->window_us = enable ? window_us : 0;
+    i2c_device->reg_cache = cache;
+    I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus, ESP_FAIL);
+    free(old);
+    return ESP_OK;
 }
 
-esp_err_t i2c_bus_write_reg16(i2c_bus_device_handle_t dev_handle, uint16_t mem_address, size_t data_len, const uint8_t *data)
+esp_err_t i2c_bus_reg_cache_sync(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, size_t data_len)
 {
     I2C_BUS_CHECK(dev_handle != NULL, "device handle error", ESP_ERR_INVALID_ARG);
-    I2C_BUS_CHECK(data != NULL, "data pointer error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(mem_address != NULL_I2C_MEM_ADDR && data_len > 0 && mem_address + data_len <= I2C_BUS_REG_CACHE_SIZE, "register range error", ESP_ERR_INVALID_ARG);
     i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)dev_handle;
-    I2C_BUS_INIT_CHECK(i2c_device->i2c_bus->is_init, ESP_ERR_INVALID_STATE);
-    uint8_t memAddress8[2];
-    memAddress8[0] = (uint8_t)((mem_address >> 8) & 0x00FF);
-    memAddress8[1] = (uint8_t)(mem_address & 0x00FF);
-    I2C_BUS_MUTEX_TAKE(i2c_device->i2c_bus->mutex, ESP_ERR_TIMEOUT);
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (i2c_device->dev_addr << 1) | I2C_MASTER_WRITE, I2C_ACK_CHECK_EN);
+    I2C_BUS_CHECK(i2c_device->reg_cache != NULL, "register cache not enabled", ESP_ERR_INVALID_STATE);
+    uint8_t data[16];
+    esp_err_t ret = i2c_bus_reg_cache_invalidate(dev_handle, mem_address, data_len);
 
-    if (mem_address != NULL_I2C_MEM_ADDR)
+    /*registers are invalid now, reads go to the device and refresh the cache*/
+    for (size_t i = 0; i < data_len && ret == ESP_OK; i += sizeof(data))
     {
-        i2c_master_write(cmd, memAddress8, 2, I2C_ACK_CHECK_EN);
+        size_t len = (data_len - i) < sizeof(data) ? (data_len - i) : sizeof(data);
+        ret = i2c_bus_read_reg8(dev_handle, mem_address + i, len, data, 0);
     }
 
-    i2c_master_write(cmd, (uint8_t *)data, data_len, I2C_ACK_CHECK_EN);
-    i2c_master_stop(cmd);
-    esp_err_t ret = i2c_master_cmd_begin_with_conf(i2c_device->i2c_bus->i2c_port, cmd, I2C_BUS_TICKS_TO_WAIT, &i2c_device->conf);
-    i2c_cmd_link_delete(cmd);
-    I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus->mutex, ESP_FAIL);
     return ret;
 }
 
-/**************************************** Private Functions*********************************************/
-static esp_err_t i2c_driver_reinit(i2c_port_t port, const i2c_config_t *conf)
+esp_err_t i2c_bus_read_bytes(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, size_t data_len, uint8_t *data)
 {
-    I2C_BUS_CHECK(port < I2C_NUM_MAX, "i2c port error", ESP_ERR_INVALID_ARG);
-    I2C_BUS_CHECK(conf != NULL, "pointer = NULL error", ESP_ERR_INVALID_ARG);
+    return i2c_bus_read_reg8(dev_handle, mem_address, data_len, data, 0);
+}
 
-    if (s_i2c_bus[port].is_init)
+esp_err_t i2c_bus_read_bytes_timeout(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, size_t data_len, uint8_t *data, uint32_t timeout_ms)
+{
+    return i2c_bus_read_reg8(dev_handle, mem_address, data_len, data, timeout_ms);
+}
+
+esp_err_t i2c_bus_read_byte(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, uint8_t *data)
+{
+    return i2c_bus_read_reg8(dev_handle, mem_address, 1, data, 0);
+}
+
+esp_err_t i2c_bus_read_bit(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, uint8_t bit_num, uint8_t *data)
+{
+    uint8_t byte = 0;
+    esp_err_t ret = i2c_bus_read_reg8(dev_handle, mem_address, 1, &byte, 0);
+    *data = byte & (1 << bit_num);
+    *data = (*data != 0) ? 1 : 0;
+    return ret;
+}
+
+esp_err_t i2c_bus_read_bits(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, uint8_t bit_start, uint8_t length, uint8_t *data)
+{
+    uint8_t byte = 0;
+    esp_err_t ret = i2c_bus_read_byte(dev_handle, mem_address, &byte);
+
+    if (ret != ESP_OK)
     {
-        i2c_driver_delete(port);
-        s_i2c_bus[port].is_init = false;
-        ESP_LOGI(TAG, "i2c%d bus deinited", port);
+        return ret;
     }
 
-    esp_err_t ret = i2c_param_config(port, conf);
-    I2C_BUS_CHECK(ret == ESP_OK, "i2c param config failed", ret);
-    ret = i2c_driver_install(port, conf->mode, I2C_BUS_MASTER_BUF_LEN, I2C_BUS_MASTER_BUF_LEN, I2C_BUS_FLG_DEFAULT);
-    I2C_BUS_CHECK(ret == ESP_OK, "i2c driver install failed", ret);
-    s_i2c_bus[port].is_init = true;
-    ESP_LOGI(TAG, "i2c%d bus inited", port);
-    return ESP_OK;
+    *data = I2C_BUS_FIELD_GET(byte, bit_start - length + 1, length);
+    return ret;
 }
 
-static esp_err_t i2c_driver_deinit(i2c_port_t port)
+esp_err_t i2c_bus_write_byte(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, uint8_t data)
 {
-    I2C_BUS_CHECK(port < I2C_NUM_MAX, "i2c port error", ESP_ERR_INVALID_ARG);
-    I2C_BUS_CHECK(s_i2c_bus[port].is_init == true, "i2c not inited", ESP_ERR_INVALID_STATE);
-    i2c_driver_delete(port); // always return ESP_OK
-    s_i2c_bus[port].is_init = false;
-    ESP_LOGI(TAG, "i2c%d bus deinited", port);
-    return ESP_OK;
+    return i2c_bus_write_reg8(dev_handle, mem_address, 1, &data, 0);
 }
 
-/**
- * @brief compare with active i2c_bus configuration
- *
- * @param port choose which i2c_port's configuration will be compared
- * @param conf new configuration
- * @return true new configuration is equal to active configuration
- * @return false new configuration is not equal to active configuration
- */
-inline static bool i2c_config_compare(i2c_port_t port, const i2c_config_t *conf)
+esp_err_t i2c_bus_write_bytes(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, size_t data_len, const uint8_t *data)
 {
-    if (s_i2c_bus[port].conf_active.master.clk_speed == conf->master.clk_speed && s_i2c_bus[port].conf_active.sda_io_num == conf->sda_io_num && s_i2c_bus[port].conf_active.scl_io_num == conf->scl_io_num && s_i2c_bus[port].conf_active.scl_pullup_en == conf->scl_pullup_en && s_i2c_bus[port].conf_active.sda_pullup_en == conf->sda_pullup_en)
+    return i2c_bus_write_reg8(dev_handle, mem_address, data_len, data, 0);
+}
+
+esp_err_t i2c_bus_write_bytes_timeout(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, size_t data_len, const uint8_t *data, uint32_t timeout_ms)
+{
+    return i2c_bus_write_reg8(dev_handle, mem_address, data_len, data, timeout_ms);
+}
+
+esp_err_t i2c_bus_write_bit(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, uint8_t bit_num, uint8_t data)
+{
+    uint8_t byte = 0;
+    esp_err_t ret = i2c_bus_read_byte(dev_handle, mem_address, &byte);
+
+    if (ret != ESP_OK)
     {
-        return true;
+        return ret;
     }
 
-    return false;
-}
\ No newline at end of file
+    byte = (data != 0) ? (byte | (1 << bit_num)) : (byte & ~(1 << bit_num));
+    return i2c_bus_write_byte(dev_handle, mem_address, byte);
+}
+
+esp_err_t i2c_bus_write_bits(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, uint8_t bit_start, uint8_t length, uint8_t data)
+{
+    uint8_t byte = 0;
+    esp_err_t ret = i2c_bus_read_byte(dev_handle, mem_address, &byte);
+
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    byte = I2C_BUS_FIELD_SET(byte, bit_start - length + 1, length, data);
+    return i2c_bus_write_byte(dev_handle, mem_address, byte);
+}
+
+esp_err_t i2c_bus_txn_begin(i2c_bus_txn_t *txn, i2c_bus_device_handle_t dev_handle)
+{
+    I2C_BUS_CHECK(txn != NULL, "transaction pointer error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(dev_handle != NULL, "device handle error", ESP_ERR_INVALID_ARG);
+    txn->dev_handle = dev_handle;
+    txn->ret = ESP_OK;
+    txn->num_ops = 0;
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_txn_add_read(i2c_bus_txn_t *txn, uint8_t mem_address, size_t data_len, uint8_t *data)
+{
+    I2C_BUS_CHECK(txn != NULL, "transaction pointer error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(data != NULL && data_len > 0, "data pointer error", ESP_ERR_INVALID_ARG);
+    i2c_bus_txn_op_t *op = i2c_bus_txn_op_alloc(txn, I2C_BUS_TXN_OP_READ, mem_address);
+    I2C_BUS_CHECK(op != NULL, "transaction is full", ESP_ERR_NO_MEM);
+    op->data_len = data_len;
+    op->rx_data = data;
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_txn_add_write(i2c_bus_txn_t *txn, uint8_t mem_address, size_t data_len, const uint8_t *data)
+{
+    I2C_BUS_CHECK(txn != NULL, "transaction pointer error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(data != NULL, "data pointer error", ESP_ERR_INVALID_ARG);
+    i2c_bus_txn_op_t *op = i2c_bus_txn_op_alloc(txn, I2C_BUS_TXN_OP_WRITE, mem_address);
+    I2C_BUS_CHECK(op != NULL, "transaction is full", ESP_ERR_NO_MEM);
+    op->data_len = data_len;
+    op->tx_data = data;
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_txn_add_write_byte(i2c_bus_txn_t *txn, uint8_t mem_address, uint8_t data)
+{
+    I2C_BUS_CHECK(txn != NULL, "transaction pointer error", ESP_ERR_INVALID_ARG);
+    i2c_bus_txn_op_t *op = i2c_bus_txn_op_alloc(txn, I2C_BUS_TXN_OP_WRITE, mem_address);
+    I2C_BUS_CHECK(op != NULL, "transaction is full", ESP_ERR_NO_MEM);
+    op->data_len = 1;
+    op->byte = data;
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_txn_add_rmw(i2c_bus_txn_t *txn, uint8_t mem_address, uint8_t mask, uint8_t data)
+{
+    I2C_BUS_CHECK(txn != NULL, "transaction pointer error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(mem_address != NULL_I2C_MEM_ADDR, "RMW needs an internal address", ESP_ERR_INVALID_ARG);
+    i2c_bus_txn_op_t *op = i2c_bus_txn_op_alloc(txn, I2C_BUS_TXN_OP_RMW, mem_address);
+    I2C_BUS_CHECK(op != NULL, "transaction is full", ESP_ERR_NO_MEM);
+    op->data_len = 1;
+    op->mask = mask;
+    op->byte = data & mask;
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_txn_commit(i2c_bus_txn_t *txn)
+{
+    I2C_BUS_CHECK(txn != NULL && txn->dev_handle != NULL, "transaction error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(txn->ret == ESP_OK, "transaction add operation failed", txn->ret);
+    i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)txn->dev_handle;
+    I2C_BUS_INIT_CHECK(i2c_device->i2c_bus->is_init, ESP_ERR_INVALID_STATE);
+    I2C_BUS_DEVICE_MUTEX_TAKE(i2c_device, 0, ESP_ERR_TIMEOUT);
+    esp_err_t ret = ESP_OK;
+    i2c_cmd_handle_t cmd = NULL;
+    uint32_t cmd_num = 0; /*commands in current link*/
+    uint8_t first = 0;    /*first operation in current link*/
+
+    for (uint8_t i = 0; i < txn->num_ops; i++)
+    {
+        i2c_bus_txn_op_t *op = &txn->ops[i];
+        uint32_t op_cmds = i2c_bus_txn_op_cmds(op);
+        uint8_t rmw_byte = 0;
+        bool rmw_read = false;
+
+        /*RMW of a cached register needs no read, it becomes a single write*/
+        if (op->type == I2C_BUS_TXN_OP_RMW)
+        {
+            if (i2c_bus_reg_cache_read(i2c_device->reg_cache, op->mem_address, 1, &rmw_byte))
+            {
+                op->byte = (rmw_byte & ~op->mask) | (op->byte & op->mask);
+            }
+            else
+            {
+                rmw_read = true;
+                op->rx_data = &rmw_byte; /*append the read part first*/
+            }
+        }
+
+        /*send the pending operations if this one does not fit, one command is kept for the stop*/
+        if (cmd != NULL && cmd_num + op_cmds + 1 > I2C_BUS_TXN_LINK_MAX_CMDS)
+        {
+            ret = i2c_bus_txn_link_send(i2c_device, &cmd, txn, first, i);
+            i2c_bus_txn_ops_done(i2c_device, txn, first, i, ret);
+
+            if (ret != ESP_OK)
+            {
+                op->rx_data = NULL;
+                break;
+            }
+        }
+
+        if (cmd == NULL)
+        {
+            first = i;
+            cmd_num = 0;
+            cmd = i2c_bus_cmd_link_take(i2c_device->i2c_bus);
+            I2C_BUS_CHECK_GOTO(cmd != NULL, "i2c command link create failed", txn_no_mem);
+        }
+
+        ret = i2c_bus_txn_op_append(i2c_device, cmd, op);
+        cmd_num += op_cmds;
+
+        if (ret == ESP_OK && rmw_read)
+        {
+            /*the written value depends on the read one, send the link up to the RMW read*/
+            ret = i2c_bus_txn_link_send(i2c_device, &cmd, txn, first, i + 1);
+            op->rx_data = NULL;
+            i2c_bus_txn_ops_done(i2c_device, txn, first, i, ret);
+
+            if (ret != ESP_OK)
+            {
+                op->ret = ret;
+                break;
+            }
+
+            op->byte = (rmw_byte & ~op->mask) | (op->byte & op->mask);
+            first = i;
+            cmd = i2c_bus_cmd_link_take(i2c_device->i2c_bus);
+            I2C_BUS_CHECK_GOTO(cmd != NULL, "i2c command link create failed", txn_no_mem);
+            ret = i2c_bus_txn_op_append(i2c_device, cmd, op);
+            cmd_num = op_cmds;
+        }
+
+        if (ret != ESP_OK)
+        {
+            /*link building failed, drop it without sending*/
+            op->rx_data = NULL;
+            i2c_bus_cmd_link_release(i2c_device->i2c_bus, cmd);
+            cmd = NULL;
+            i2c_bus_txn_ops_done(i2c_device, txn, first, i + 1, ret);
+            break;
+        }
+    }
+
+    if (cmd != NULL && ret == ESP_OK)
+    {
+        ret = i2c_bus_txn_link_send(i2c_device, &cmd, txn, first, txn->num_ops);
+        i2c_bus_txn_ops_done(i2c_device, txn, first, txn->num_ops, ret);
+    }
+
+    I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus, ESP_FAIL);
+    return ret;
+
+txn_no_mem:
+    txn->ops[first].rx_data = NULL;
+    i2c_bus_txn_ops_done(i2c_device, txn, first, txn->num_ops, ESP_ERR_NO_MEM);
+    I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus, ESP_FAIL);
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t i2c_bus_txn_reset(i2c_bus_txn_t *txn)
+{
+    I2C_BUS_CHECK(txn != NULL && txn->dev_handle != NULL, "transaction error", ESP_ERR_INVALID_ARG);
+    txn->ret = ESP_OK;
+    txn->num_ops = 0;
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_regmap_read(i2c_bus_device_handle_t dev_handle, const i2c_bus_regmap_t *map, uint8_t *values)
+{
+    return i2c_bus_regmap_xfer(dev_handle, map, values, false);
+}
+
+esp_err_t i2c_bus_regmap_write(i2c_bus_device_handle_t dev_handle, const i2c_bus_regmap_t *map, const uint8_t *values)
+{
+    return i2c_bus_regmap_xfer(dev_handle, map, (uint8_t *)values, true);
+}
+
+esp_err_t i2c_bus_submit(i2c_bus_request_t *req, TickType_t ticks_to_wait)
+{
+    I2C_BUS_CHECK(req != NULL, "request pointer error", ESP_ERR_INVALID_ARG);
+#ifdef CONFIG_I2C_BUS_ASYNC
+    i2c_bus_device_handle_t dev_handle = req->dev_handle;
+
+    if (req->type == I2C_BUS_REQ_TXN)
+    {
+        I2C_BUS_CHECK(req->txn != NULL, "transaction pointer error", ESP_ERR_INVALID_ARG);
+        dev_handle = req->txn->dev_handle;
+    }
+    else
+    {
+        I2C_BUS_CHECK(req->type == I2C_BUS_REQ_READ || req->type == I2C_BUS_REQ_WRITE || req->type == I2C_BUS_REQ_READ_RAW, "request type error", ESP_ERR_INVALID_ARG);
+        I2C_BUS_CHECK(req->data != NULL, "data pointer error", ESP_ERR_INVALID_ARG);
+    }
+
+    I2C_BUS_CHECK(dev_handle != NULL, "device handle error", ESP_ERR_INVALID_ARG);
+    i2c_bus_t *i2c_bus = ((i2c_bus_device_t *)dev_handle)->i2c_bus;
+    I2C_BUS_INIT_CHECK(i2c_bus->is_init, ESP_ERR_INVALID_STATE);
+
+    if (i2c_bus->worker == NULL)
+    {
+        esp_err_t ret = i2c_bus_worker_start(i2c_bus);
+        I2C_BUS_CHECK(ret == ESP_OK, "i2c_bus worker start failed", ret);
+    }
+
+    req->ret = ESP_ERR_INVALID_STATE;
+
+    if (xQueueSend(i2c_bus->req_queue, &req, ticks_to_wait) != pdTRUE)
+    {
+        ESP_LOGW(TAG, "i2c%d request queue full", i2c_bus->i2c_port);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    return ESP_OK;
+#else
+    ESP_LOGE(TAG, "asynchronous requests not enabled");
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t i2c_bus_submit_sync(i2c_bus_request_t *req, TickType_t ticks_to_wait)
+{
+    I2C_BUS_CHECK(req != NULL, "request pointer error", ESP_ERR_INVALID_ARG);
+#ifdef CONFIG_I2C_BUS_ASYNC
+    i2c_bus_device_handle_t dev_handle = (req->type == I2C_BUS_REQ_TXN && req->txn != NULL) ? req->txn->dev_handle : req->dev_handle;
+    I2C_BUS_CHECK(dev_handle != NULL, "device handle error", ESP_ERR_INVALID_ARG);
+    /*a callback waiting for a request only its own worker can serve never returns*/
+    I2C_BUS_CHECK(xTaskGetCurrentTaskHandle() != ((i2c_bus_device_t *)dev_handle)->i2c_bus->worker, "synchronous request from the worker task", ESP_ERR_INVALID_STATE);
+#endif
+    StaticSemaphore_t done_buf;
+    SemaphoreHandle_t done = xSemaphoreCreateBinaryStatic(&done_buf);
+    req->done = done;
+    esp_err_t ret = i2c_bus_submit(req, ticks_to_wait);
+
+    if (ret == ESP_OK)
+    {
+        xSemaphoreTake(done, portMAX_DELAY);
+        ret = req->ret;
+    }
+
+    req->done = NULL;
+    vSemaphoreDelete(done);
+    return ret;
+}
+
+esp_err_t i2c_bus_read_stream(i2c_bus_device_handle_t dev_handle, const i2c_bus_stream_config_t *stream_conf, size_t data_len)
+{
+    I2C_BUS_CHECK(dev_handle != NULL, "device handle error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(stream_conf != NULL && stream_conf->buf != NULL && stream_conf->on_chunk != NULL, "stream config error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(stream_conf->chunk_len > 0, "chunk length error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(stream_conf->fixed_address || stream_conf->mem_address + data_len <= I2C_BUS_REG_CACHE_SIZE, "address range error", ESP_ERR_INVALID_ARG);
+    size_t chunk_len = stream_conf->chunk_len;
+    size_t chunks = (data_len + chunk_len - 1) / chunk_len;
+    esp_err_t ret = ESP_OK;
+#ifdef CONFIG_I2C_BUS_ASYNC
+    /*double buffering, the worker fills one half while the consumer reads the other*/
+    i2c_bus_request_t req[2] = {0};
+    StaticSemaphore_t done_buf[2];
+
+    for (int i = 0; i < 2; i++)
+    {
+        req[i].type = I2C_BUS_REQ_READ_RAW;
+        req[i].dev_handle = dev_handle;
+        req[i].data = stream_conf->buf + i * chunk_len;
+        req[i].done = xSemaphoreCreateBinaryStatic(&done_buf[i]);
+    }
+
+    for (size_t i = 0; i < chunks && ret == ESP_OK; i++)
+    {
+        i2c_bus_request_t *cur = &req[i % 2];
+
+        /*chunk 0 is submitted here, the next ones while the previous one is consumed*/
+        if (i == 0)
+        {
+            cur->mem_address = stream_conf->mem_address;
+            cur->data_len = chunk_len < data_len ? chunk_len : data_len;
+            ret = i2c_bus_submit(cur, ((i2c_bus_device_t *)dev_handle)->ticks_to_wait);
+
+            if (ret != ESP_OK)
+            {
+                break;
+            }
+        }
+
+        xSemaphoreTake((SemaphoreHandle_t)cur->done, portMAX_DELAY);
+        ret = cur->ret;
+
+        if (ret != ESP_OK)
+        {
+            break;
+        }
+
+        if (i + 1 < chunks)
+        {
+            i2c_bus_request_t *next = &req[(i + 1) % 2];
+            size_t offset = (i + 1) * chunk_len;
+            next->mem_address = stream_conf->fixed_address ? stream_conf->mem_address : stream_conf->mem_address + offset;
+            next->data_len = (data_len - offset) < chunk_len ? (data_len - offset) : chunk_len;
+            ret = i2c_bus_submit(next, ((i2c_bus_device_t *)dev_handle)->ticks_to_wait);
+        }
+
+        stream_conf->on_chunk(cur->data, cur->data_len, stream_conf->user_ctx);
+    }
+
+    for (int i = 0; i < 2; i++)
+    {
+        vSemaphoreDelete((SemaphoreHandle_t)req[i].done);
+    }
+#else
+    for (size_t i = 0; i < chunks && ret == ESP_OK; i++)
+    {
+        size_t offset = i * chunk_len;
+        size_t len = (data_len - offset) < chunk_len ? (data_len - offset) : chunk_len;
+        uint8_t *chunk = stream_conf->buf + (i % 2) * chunk_len;
+        uint8_t mem_address = stream_conf->fixed_address ? stream_conf->mem_address : stream_conf->mem_address + offset;
+        ret = i2c_bus_read_raw(dev_handle, mem_address, len, chunk);
+
+        if (ret == ESP_OK)
+        {
+            stream_conf->on_chunk(chunk, len, stream_conf->user_ctx);
+        }
+    }
+#endif
+    return ret;
+}
+
+esp_err_t i2c_bus_device_bind_irq(i2c_bus_device_handle_t dev_handle, const i2c_bus_irq_config_t *irq_conf)
+{
+    I2C_BUS_CHECK(dev_handle != NULL, "device handle error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(irq_conf != NULL && irq_conf->req != NULL, "pointer = NULL error", ESP_ERR_INVALID_ARG);
+#ifdef CONFIG_I2C_BUS_IRQ
+    i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)dev_handle;
+    i2c_bus_t *i2c_bus = i2c_device->i2c_bus;
+    i2c_bus_request_t *req = irq_conf->req;
+    I2C_BUS_CHECK(GPIO_IS_VALID_GPIO(irq_conf->gpio_num), "GPIO number error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK((req->type == I2C_BUS_REQ_TXN ? (req->txn != NULL ? req->txn->dev_handle : NULL) : req->dev_handle) == dev_handle,
+                  "request is not for the device", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(req->type == I2C_BUS_REQ_TXN || req->data != NULL, "data pointer error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_INIT_CHECK(i2c_bus->is_init, ESP_ERR_INVALID_STATE);
+    I2C_BUS_CHECK(i2c_device->irq_req == NULL, "device interrupt already bound", ESP_ERR_INVALID_STATE);
+    esp_err_t ret = i2c_bus_worker_start(i2c_bus);
+    I2C_BUS_CHECK(ret == ESP_OK, "i2c_bus worker start failed", ret);
+    gpio_config_t io_conf = {
+        .pin_bit_mask = 1ULL << irq_conf->gpio_num,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = (irq_conf->pull_en && !irq_conf->active_high) ? GPIO_PULLUP_ENABLE : GPIO_PULLUP_DISABLE,
+        .pull_down_en = (irq_conf->pull_en && irq_conf->active_high) ? GPIO_PULLDOWN_ENABLE : GPIO_PULLDOWN_DISABLE,
+        /*level triggered, the line is masked until the request is served so an event is never lost*/
+        .intr_type = irq_conf->active_high ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL,
+    };
+    ret = gpio_config(&io_conf);
+    I2C_BUS_CHECK(ret == ESP_OK, "gpio config failed", ret);
+    ret = gpio_install_isr_service(0);
+    I2C_BUS_CHECK(ret == ESP_OK || ret == ESP_ERR_INVALID_STATE, "gpio isr service install failed", ret); /*already installed by another driver*/
+    gpio_intr_disable(irq_conf->gpio_num);
+    portENTER_CRITICAL(&i2c_bus->irq_spinlock);
+    i2c_device->irq_req = req;
+    i2c_device->irq_gpio = irq_conf->gpio_num;
+    i2c_device->irq_queued = false;
+    i2c_device->irq_stalled = false;
+    i2c_device->irq_unbind = NULL;
+    memset(&i2c_device->irq_stats, 0, sizeof(i2c_bus_irq_stats_t));
+    i2c_device->irq_next = i2c_bus->irq_devices;
+    i2c_bus->irq_devices = i2c_device;
+    portEXIT_CRITICAL(&i2c_bus->irq_spinlock);
+    ret = gpio_isr_handler_add(irq_conf->gpio_num, i2c_bus_irq_isr, i2c_device);
+
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "gpio isr handler add failed");
+        i2c_bus_device_unbind_irq(i2c_device);
+        return ret;
+    }
+
+    gpio_intr_enable(irq_conf->gpio_num);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t i2c_bus_device_unbind_irq(i2c_bus_device_handle_t dev_handle)
+{
+    I2C_BUS_CHECK(dev_handle != NULL, "device handle error", ESP_ERR_INVALID_ARG);
+#ifdef CONFIG_I2C_BUS_IRQ
+    i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)dev_handle;
+    i2c_bus_t *i2c_bus = i2c_device->i2c_bus;
+    I2C_BUS_CHECK(i2c_device->irq_req != NULL, "device interrupt not bound", ESP_ERR_INVALID_ARG);
+    gpio_intr_disable(i2c_device->irq_gpio);
+    gpio_isr_handler_remove(i2c_device->irq_gpio);
+    StaticSemaphore_t unbind_buf;
+    SemaphoreHandle_t unbind = xSemaphoreCreateBinaryStatic(&unbind_buf);
+    portENTER_CRITICAL(&i2c_bus->irq_spinlock);
+    bool queued = i2c_device->irq_queued;
+    i2c_device->irq_unbind = queued ? unbind : NULL;
+    portEXIT_CRITICAL(&i2c_bus->irq_spinlock);
+
+    /*the request may still be in the worker queue, it must not be released before it is served*/
+    if (queued)
+    {
+        xSemaphoreTake(unbind, portMAX_DELAY);
+    }
+
+    vSemaphoreDelete(unbind);
+    portENTER_CRITICAL(&i2c_bus->irq_spinlock);
+    struct i2c_bus_device **node = &i2c_bus->irq_devices;
+
+    while (*node != NULL && *node != i2c_device)
+    {
+        node = &(*node)->irq_next;
+    }
+
+    if (*node != NULL)
+    {
+        *node = i2c_device->irq_next;
+    }
+
+    i2c_device->irq_next = NULL;
+    i2c_device->irq_req = NULL;
+    i2c_device->irq_stalled = false;
+    portEXIT_CRITICAL(&i2c_bus->irq_spinlock);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t i2c_bus_device_get_irq_stats(i2c_bus_device_handle_t dev_handle, i2c_bus_irq_stats_t *stats)
+{
+    I2C_BUS_CHECK(dev_handle != NULL, "device handle error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(stats != NULL, "pointer = NULL error", ESP_ERR_INVALID_ARG);
+#ifdef CONFIG_I2C_BUS_IRQ
+    i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)dev_handle;
+    portENTER_CRITICAL(&i2c_device->i2c_bus->irq_spinlock);
+    *stats = i2c_device->irq_stats;
+    portEXIT_CRITICAL(&i2c_device->i2c_bus->irq_spinlock);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+i2c_bus_group_handle_t i2c_bus_group_create(const i2c_bus_handle_t *buses, uint8_t num)
+{
+    I2C_BUS_CHECK(buses != NULL, "pointer = NULL error", NULL);
+    I2C_BUS_CHECK(num > 0 && num <= I2C_NUM_MAX, "bus number error", NULL);
+
+    for (uint8_t i = 0; i < num; i++)
+    {
+        I2C_BUS_CHECK(buses[i] != NULL, "Null Bus Handle", NULL);
+        I2C_BUS_INIT_CHECK(((i2c_bus_t *)buses[i])->is_init, NULL);
+
+        for (uint8_t j = 0; j < i; j++)
+        {
+            I2C_BUS_CHECK(buses[j] != buses[i], "bus added twice", NULL);
+        }
+    }
+
+    i2c_bus_group_t *group = calloc(1, sizeof(i2c_bus_group_t));
+    I2C_BUS_CHECK(group != NULL, "calloc memory failed", NULL);
+    portMUX_TYPE spinlock_init = portMUX_INITIALIZER_UNLOCKED;
+    group->spinlock = spinlock_init;
+    group->num = num;
+
+    for (uint8_t i = 0; i < num; i++)
+    {
+        group->buses[i] = (i2c_bus_t *)buses[i];
+#ifdef CONFIG_I2C_BUS_ASYNC
+        /*one controller per core, the workers never wait for each other's CPU*/
+        esp_err_t ret = i2c_bus_worker_pin(group->buses[i], i % portNUM_PROCESSORS);
+        I2C_BUS_CHECK_GOTO(ret == ESP_OK, "i2c_bus worker start failed", group_fail);
+#endif
+    }
+
+    /*the first utilisation window starts now*/
+    I2C_BUS_CHECK_GOTO(i2c_bus_group_get_util(group, NULL, 0) == ESP_OK, "i2c_bus group utilisation failed", group_fail);
+    return (i2c_bus_group_handle_t)group;
+
+group_fail:
+    free(group);
+    return NULL;
+}
+
+esp_err_t i2c_bus_group_delete(i2c_bus_group_handle_t *p_group)
+{
+    I2C_BUS_CHECK(p_group != NULL && *p_group != NULL, "Null Group Handle", ESP_ERR_INVALID_ARG);
+    i2c_bus_group_t *group = (i2c_bus_group_t *)(*p_group);
+    portENTER_CRITICAL(&group->spinlock);
+
+    /*devices left are kept as plain devices of their bus*/
+    while (group->members != NULL)
+    {
+        i2c_bus_device_t *i2c_device = group->members;
+        group->members = i2c_device->group_next;
+        i2c_device->group_next = NULL;
+        i2c_device->group = NULL;
+    }
+
+    portEXIT_CRITICAL(&group->spinlock);
+    free(group);
+    *p_group = NULL;
+    return ESP_OK;
+}
+
+i2c_bus_device_handle_t i2c_bus_group_device_create(i2c_bus_group_handle_t group_handle, const i2c_bus_device_config_t *dev_conf, uint32_t load)
+{
+    I2C_BUS_CHECK(group_handle != NULL, "Null Group Handle", NULL);
+    I2C_BUS_CHECK(dev_conf != NULL, "pointer = NULL error", NULL);
+    I2C_BUS_CHECK(dev_conf->dev_addr < 0x80, "address error", NULL);
+    i2c_bus_group_t *group = (i2c_bus_group_t *)group_handle;
+    uint8_t dev_addr = dev_conf->dev_addr;
+    uint32_t bit = 1UL << (dev_addr % 32);
+    const i2c_bus_scan_config_t scan_conf = {
+        .allow_list = &dev_addr,
+        .allow_list_len = 1,
+        .probe_timeout_ms = 10,
+        .incremental = true,
+    };
+    bool present[I2C_NUM_MAX] = {false};
+    int best = -1;
+
+    /*probe outside the spinlock, the choice and the reservation are made at once under it*/
+    for (uint8_t i = 0; i < group->num; i++)
+    {
+        uint8_t found = 0;
+        present[i] = i2c_bus_scan_with_config(group->buses[i], &scan_conf, NULL, 0, &found) == ESP_OK && found > 0;
+    }
+
+    portENTER_CRITICAL(&group->spinlock);
+
+    for (uint8_t i = 0; i < group->num; i++)
+    {
+        if (!present[i] || (group->taken[i][dev_addr / 32] & bit))
+        {
+            continue;
+        }
+
+        if (best < 0 || group->load[i] < group->load[best] ||
+                (group->load[i] == group->load[best] && group->devices[i] < group->devices[best]))
+        {
+            best = i;
+        }
+    }
+
+    if (best >= 0)
+    {
+        group->taken[best][dev_addr / 32] |= bit;
+        group->load[best] += load;
+        group->devices[best]++;
+    }
+
+    portEXIT_CRITICAL(&group->spinlock);
+
+    if (best < 0)
+    {
+        ESP_LOGW(TAG, "device 0x%02x answers on no free bus of the group", dev_addr);
+        return NULL;
+    }
+
+    i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)i2c_bus_device_create_with_config(group->buses[best], dev_conf);
+
+    if (i2c_device == NULL)
+    {
+        portENTER_CRITICAL(&group->spinlock);
+        group->taken[best][dev_addr / 32] &= ~bit;
+        group->load[best] -= load;
+        group->devices[best]--;
+        portEXIT_CRITICAL(&group->spinlock);
+        return NULL;
+    }
+
+    portENTER_CRITICAL(&group->spinlock);
+    i2c_device->group = group;
+    i2c_device->group_load = load;
+    i2c_device->group_next = group->members;
+    group->members = i2c_device;
+    portEXIT_CRITICAL(&group->spinlock);
+    ESP_LOGI(TAG, "device 0x%02x placed on i2c%d, bus load %u", dev_addr, group->buses[best]->i2c_port, (unsigned)group->load[best]);
+    return (i2c_bus_device_handle_t)i2c_device;
+}
+
+esp_err_t i2c_bus_group_device_delete(i2c_bus_group_handle_t group_handle, i2c_bus_device_handle_t *p_dev_handle)
+{
+    I2C_BUS_CHECK(group_handle != NULL, "Null Group Handle", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(p_dev_handle != NULL && *p_dev_handle != NULL, "Null Device Handle", ESP_ERR_INVALID_ARG);
+    i2c_bus_group_t *group = (i2c_bus_group_t *)group_handle;
+    i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)(*p_dev_handle);
+    I2C_BUS_CHECK(i2c_device->group == group, "device not created by the group", ESP_ERR_INVALID_ARG);
+    /*the device leaves the group as it is deleted*/
+    return i2c_bus_device_delete(p_dev_handle);
+}
+
+esp_err_t i2c_bus_group_get_util(i2c_bus_group_handle_t group_handle, i2c_bus_group_util_t *util, uint8_t num)
+{
+    I2C_BUS_CHECK(group_handle != NULL, "Null Group Handle", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(util != NULL || num == 0, "pointer = NULL error", ESP_ERR_INVALID_ARG);
+    i2c_bus_group_t *group = (i2c_bus_group_t *)group_handle;
+    uint64_t busy_us[I2C_NUM_MAX] = {0};
+    uint64_t window_busy_us[I2C_NUM_MAX] = {0};
+    uint8_t devices[I2C_NUM_MAX] = {0};
+    uint32_t load[I2C_NUM_MAX] = {0};
+
+    for (uint8_t i = 0; i < group->num; i++)
+    {
+#ifdef CONFIG_I2C_BUS_STATS
+        I2C_BUS_MUTEX_TAKE(group->buses[i], I2C_BUS_PRIO_LOW, ESP_ERR_TIMEOUT);
+        busy_us[i] = group->buses[i]->stats.xfer_us;
+        I2C_BUS_MUTEX_GIVE(group->buses[i], ESP_FAIL);
+#endif
+    }
+
+    /*the window of all buses moves at once, a concurrent query gets what is left of it*/
+    int64_t now = I2C_BUS_TIME_US();
+    portENTER_CRITICAL(&group->spinlock);
+    uint64_t window_us = (uint64_t)(now - group->last_query_us);
+    group->last_query_us = now;
+
+    for (uint8_t i = 0; i < group->num; i++)
+    {
+        /*counters reset by i2c_bus_reset_stats restart from 0*/
+        window_busy_us[i] = busy_us[i] >= group->last_busy_us[i] ? busy_us[i] - group->last_busy_us[i] : busy_us[i];
+        group->last_busy_us[i] = busy_us[i];
+        devices[i] = group->devices[i];
+        load[i] = group->load[i];
+    }
+
+    portEXIT_CRITICAL(&group->spinlock);
+
+    for (uint8_t i = 0; i < group->num && i < num; i++)
+    {
+        i2c_bus_t *i2c_bus = group->buses[i];
+        util[i].port = i2c_bus->i2c_port;
+        util[i].core_id = -1;
+        util[i].pending = 0;
+#ifdef CONFIG_I2C_BUS_ASYNC
+        util[i].core_id = i2c_bus->worker_core == tskNO_AFFINITY ? -1 : i2c_bus->worker_core;
+        util[i].pending = i2c_bus->req_queue != NULL ? uxQueueMessagesWaiting(i2c_bus->req_queue) : 0;
+#endif
+        util[i].devices = devices[i];
+        util[i].load = load[i];
+        util[i].busy_us = window_busy_us[i];
+        util[i].window_us = window_us;
+        util[i].util_permille = window_us == 0 ? 0 : (window_busy_us[i] >= window_us ? 1000 : window_busy_us[i] * 1000 / window_us);
+    }
+
+    return ESP_OK;
+}
+
+i2c_bus_sched_handle_t i2c_bus_sched_create(i2c_bus_handle_t bus_handle, const i2c_bus_sched_config_t *sched_conf)
+{
+    I2C_BUS_CHECK(bus_handle != NULL, "Null Bus Handle", NULL);
+#ifdef CONFIG_I2C_BUS_SCHED
+    i2c_bus_t *i2c_bus = (i2c_bus_t *)bus_handle;
+    I2C_BUS_INIT_CHECK(i2c_bus->is_init, NULL);
+    I2C_BUS_CHECK(sched_conf == NULL || sched_conf->util_limit_permille <= 1000, "utilisation limit error", NULL);
+    i2c_bus_sched_t *sched = calloc(1, sizeof(i2c_bus_sched_t));
+    I2C_BUS_CHECK(sched != NULL, "calloc memory failed", NULL);
+    sched->i2c_bus = i2c_bus;
+    sched->util_limit_permille = (sched_conf != NULL && sched_conf->util_limit_permille > 0) ? sched_conf->util_limit_permille : CONFIG_I2C_BUS_SCHED_UTIL_LIMIT;
+    sched->running = true;
+    sched->stats.min_latency_us = UINT32_MAX;
+    sched->mutex = xSemaphoreCreateMutex();
+    sched->serve_lock = xSemaphoreCreateMutex();
+    sched->task_exit = xSemaphoreCreateBinary();
+    I2C_BUS_CHECK_GOTO(sched->mutex != NULL && sched->serve_lock != NULL && sched->task_exit != NULL, "create scheduler mutex failed", sched_fail);
+#ifndef CONFIG_IDF_TARGET_LINUX
+    const esp_timer_create_args_t timer_args = {
+        .callback = i2c_bus_sched_timer_cb,
+        .arg = sched,
+        .name = "i2c_sched",
+    };
+    I2C_BUS_CHECK_GOTO(esp_timer_create(&timer_args, &sched->timer) == ESP_OK, "create scheduler timer failed", sched_fail);
+#endif
+    char name[16];
+    snprintf(name, sizeof(name), "i2c%d_sched", i2c_bus->i2c_port);
+    BaseType_t core_id = (sched_conf != NULL && sched_conf->core_id >= 0) ? sched_conf->core_id : tskNO_AFFINITY;
+    BaseType_t created = xTaskCreatePinnedToCore(i2c_bus_sched_task, name, CONFIG_I2C_BUS_SCHED_TASK_STACK, sched,
+                         CONFIG_I2C_BUS_SCHED_TASK_PRIORITY, &sched->task, core_id);
+    I2C_BUS_CHECK_GOTO(created == pdPASS, "create scheduler task failed", sched_fail);
+    ESP_LOGI(TAG, "i2c%d scheduler started", i2c_bus->i2c_port);
+    return (i2c_bus_sched_handle_t)sched;
+
+sched_fail:
+#ifndef CONFIG_IDF_TARGET_LINUX
+    if (sched->timer != NULL)
+    {
+        esp_timer_delete(sched->timer);
+    }
+#endif
+
+    if (sched->mutex != NULL)
+    {
+        vSemaphoreDelete(sched->mutex);
+    }
+
+    if (sched->serve_lock != NULL)
+    {
+        vSemaphoreDelete(sched->serve_lock);
+    }
+
+    if (sched->task_exit != NULL)
+    {
+        vSemaphoreDelete(sched->task_exit);
+    }
+
+    free(sched);
+    return NULL;
+#else
+    ESP_LOGE(TAG, "periodic read scheduler not enabled");
+    return NULL;
+#endif
+}
+
+esp_err_t i2c_bus_sched_delete(i2c_bus_sched_handle_t *p_sched)
+{
+    I2C_BUS_CHECK(p_sched != NULL && *p_sched != NULL, "Null Scheduler Handle", ESP_ERR_INVALID_ARG);
+#ifdef CONFIG_I2C_BUS_SCHED
+    i2c_bus_sched_t *sched = (i2c_bus_sched_t *)(*p_sched);
+    sched->running = false;
+    xTaskNotifyGive(sched->task);
+    xSemaphoreTake(sched->task_exit, portMAX_DELAY);
+#ifndef CONFIG_IDF_TARGET_LINUX
+    esp_timer_stop(sched->timer);
+    esp_timer_delete(sched->timer);
+#endif
+
+    while (sched->jobs != NULL)
+    {
+        i2c_bus_sched_job_t *job = sched->jobs;
+        sched->jobs = job->next;
+        free(job);
+    }
+
+    vSemaphoreDelete(sched->mutex);
+    vSemaphoreDelete(sched->serve_lock);
+    vSemaphoreDelete(sched->task_exit);
+    ESP_LOGI(TAG, "i2c%d scheduler stopped", sched->i2c_bus->i2c_port);
+    free(sched);
+    *p_sched = NULL;
+    return ESP_OK;
+#else
+    ESP_LOGE(TAG, "periodic read scheduler not enabled");
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t i2c_bus_sched_add_job(i2c_bus_sched_handle_t sched_handle, const i2c_bus_sched_job_config_t *job_conf, i2c_bus_sched_job_handle_t *p_job)
+{
+    I2C_BUS_CHECK(sched_handle != NULL, "Null Scheduler Handle", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(job_conf != NULL && p_job != NULL, "pointer = NULL error", ESP_ERR_INVALID_ARG);
+#ifdef CONFIG_I2C_BUS_SCHED
+    i2c_bus_sched_t *sched = (i2c_bus_sched_t *)sched_handle;
+    i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)job_conf->dev_handle;
+    I2C_BUS_CHECK(i2c_device != NULL && i2c_device->i2c_bus == sched->i2c_bus, "device not on the scheduler bus", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(job_conf->data_len > 0 && job_conf->callback != NULL, "job read or callback error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(job_conf->period_us > 0 && job_conf->deadline_us <= job_conf->period_us, "job period or deadline error", ESP_ERR_INVALID_ARG);
+    i2c_bus_sched_job_t *job = calloc(1, sizeof(i2c_bus_sched_job_t) + job_conf->data_len);
+    I2C_BUS_CHECK(job != NULL, "calloc memory failed", ESP_ERR_NO_MEM);
+    job->i2c_device = i2c_device;
+    job->mem_address = job_conf->mem_address;
+    job->data_len = job_conf->data_len;
+    job->period_us = job_conf->period_us;
+    job->deadline_us = job_conf->deadline_us > 0 ? job_conf->deadline_us : job_conf->period_us;
+    job->callback = job_conf->callback;
+    job->user_ctx = job_conf->user_ctx;
+    uint64_t clk_speed = i2c_device->conf.master.clk_speed;
+    job->cost_us = (uint32_t)((I2C_BUS_SCHED_READ_CLOCKS((uint64_t)job->data_len) * 1000000 + clk_speed - 1) / clk_speed) + I2C_BUS_SCHED_XFER_OVERHEAD_US;
+
+    xSemaphoreTake(sched->mutex, portMAX_DELAY);
+    i2c_bus_sched_job_t **link = &sched->jobs;
+
+    while (*link != NULL && (*link)->deadline_us <= job->deadline_us)
+    {
+        link = &(*link)->next;
+    }
+
+    job->next = *link;
+    *link = job;
+    uint16_t util_permille = 0;
+
+    if (!i2c_bus_sched_admit(sched, &util_permille))
+    {
+        *link = job->next;
+        xSemaphoreGive(sched->mutex);
+        ESP_LOGW(TAG, "i2c%d job of device 0x%02x not schedulable, read %u us every %u us", sched->i2c_bus->i2c_port,
+                 i2c_device->dev_addr, (unsigned int)job->cost_us, (unsigned int)job->period_us);
+        free(job);
+        return ESP_FAIL;
+    }
+
+    sched->stats.util_permille = util_permille;
+    job->release_us = I2C_BUS_TIME_US();
+    xSemaphoreGive(sched->mutex);
+    xTaskNotifyGive(sched->task); /*recompute the next wake up*/
+    *p_job = (i2c_bus_sched_job_handle_t)job;
+    return ESP_OK;
+#else
+    ESP_LOGE(TAG, "periodic read scheduler not enabled");
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t i2c_bus_sched_remove_job(i2c_bus_sched_handle_t sched_handle, i2c_bus_sched_job_handle_t *p_job)
+{
+    I2C_BUS_CHECK(sched_handle != NULL, "Null Scheduler Handle", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(p_job != NULL && *p_job != NULL, "Null Job Handle", ESP_ERR_INVALID_ARG);
+#ifdef CONFIG_I2C_BUS_SCHED
+    i2c_bus_sched_t *sched = (i2c_bus_sched_t *)sched_handle;
+    i2c_bus_sched_job_t *job = (i2c_bus_sched_job_t *)(*p_job);
+    xSemaphoreTake(sched->serve_lock, portMAX_DELAY); /*a read in progress may be of this job*/
+    xSemaphoreTake(sched->mutex, portMAX_DELAY);
+    i2c_bus_sched_job_t **link = &sched->jobs;
+
+    while (*link != NULL && *link != job)
+    {
+        link = &(*link)->next;
+    }
+
+    if (*link == NULL)
+    {
+        xSemaphoreGive(sched->mutex);
+        xSemaphoreGive(sched->serve_lock);
+        ESP_LOGE(TAG, "job not in the scheduler");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *link = job->next;
+    i2c_bus_sched_admit(sched, &sched->stats.util_permille);
+    xSemaphoreGive(sched->mutex);
+    xSemaphoreGive(sched->serve_lock);
+    free(job);
+    *p_job = NULL;
+    return ESP_OK;
+#else
+    ESP_LOGE(TAG, "periodic read scheduler not enabled");
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t i2c_bus_sched_get_stats(i2c_bus_sched_handle_t sched_handle, i2c_bus_sched_stats_t *stats)
+{
+    I2C_BUS_CHECK(sched_handle != NULL, "Null Scheduler Handle", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(stats != NULL, "pointer = NULL error", ESP_ERR_INVALID_ARG);
+#ifdef CONFIG_I2C_BUS_SCHED
+    i2c_bus_sched_t *sched = (i2c_bus_sched_t *)sched_handle;
+    xSemaphoreTake(sched->mutex, portMAX_DELAY);
+    *stats = sched->stats;
+    xSemaphoreGive(sched->mutex);
+
+    if (stats->reads == 0)
+    {
+        stats->min_latency_us = 0;
+    }
+
+    return ESP_OK;
+#else
+    ESP_LOGE(TAG, "periodic read scheduler not enabled");
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * @brief apply a device configuration to the bus before a transfer.
+ *        If I2C_BUS_DYNAMIC_CONFIG enable, i2c_bus will dynamically check configs and re-install i2c driver,
+ *        if I2C_BUS_DYNAMIC_RETIME enable and only clock speed changed, SCL timing is updated without re-install.
+ *
+ * @param i2c_num I2C port number
+ * @param conf pointer to I2C parameter settings, NULL to keep the active one
+ * @return esp_err_t
+ */
+inline static esp_err_t i2c_bus_conf_apply(i2c_port_t i2c_num, const i2c_config_t *conf)
+{
+#ifdef CONFIG_I2C_BUS_DYNAMIC_CONFIG
+    esp_err_t ret;
+
+    /*if configs changed, i2c driver will reinit with new configuration*/
+    if (conf != NULL && false == i2c_config_compare(i2c_num, conf))
+    {
+        /*only clock changed, SCL timing is updated in place without driver reinstall*/
+        if (i2c_config_compare_pins(i2c_num, conf))
+        {
+            ret = i2c_driver_retime(i2c_num, conf->master.clk_speed);
+        }
+        else
+        {
+            ret = ESP_ERR_NOT_SUPPORTED;
+        }
+
+        if (ret != ESP_OK)
+        {
+            ret = i2c_driver_reinit(i2c_num, conf);
+            I2C_BUS_CHECK(ret == ESP_OK, "reinit error", ret);
+        }
+
+        s_i2c_bus[i2c_num].conf_active = *conf;
+    }
+#endif
+    return ESP_OK;
+}
+
+/**
+ * @brief send a command link of a device and update its performance counters and trace, must be called with bus mutex taken.
+ *
+ * @param i2c_device the device
+ * @param cmd I2C command handler
+ * @param mem_address first register accessed by the link, traced only
+ * @param trace_flags I2C_BUS_TRACE_FLAG_TXN or I2C_BUS_TRACE_FLAG_REG16, read and write flags are added from the lengths,
+ *        I2C_BUS_CMD_FLAG_NO_RETRY to send the link once
+ * @param rx_len data bytes read by the link
+ * @param tx_len data bytes written by the link, register address excluded
+ * @return esp_err_t result of the transfer
+ */
+inline static esp_err_t i2c_bus_device_cmd_begin(i2c_bus_device_t *i2c_device, i2c_cmd_handle_t cmd, uint16_t mem_address, uint8_t trace_flags, size_t rx_len, size_t tx_len)
+{
+    i2c_bus_t *i2c_bus = i2c_device->i2c_bus;
+    esp_err_t ret = i2c_bus_conf_apply(i2c_bus->i2c_port, &i2c_device->conf);
+
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    for (uint32_t attempt = 0; ; attempt++)
+    {
+#if defined(CONFIG_I2C_BUS_STATS) || defined(CONFIG_I2C_BUS_TRACE)
+        int64_t xfer_start = I2C_BUS_TIME_US();
+#endif
+        /*the first attempt always gets a tick, even if the bus wait used the whole budget*/
+        TickType_t ticks_left = i2c_bus_budget_left(i2c_bus);
+        ret = i2c_master_cmd_begin(i2c_bus->i2c_port, cmd, ticks_left > 0 ? ticks_left : 1);
+#if defined(CONFIG_I2C_BUS_STATS) || defined(CONFIG_I2C_BUS_TRACE)
+        uint32_t xfer_us = (uint32_t)(I2C_BUS_TIME_US() - xfer_start);
+#endif
+#ifdef CONFIG_I2C_BUS_TRACE
+        if (i2c_bus->trace_enabled)
+        {
+            i2c_bus_trace_entry_t *entry = &i2c_bus->trace[i2c_bus->trace_next];
+            entry->timestamp_us = (uint32_t)xfer_start;
+            entry->duration_us = xfer_us;
+            entry->clk_speed = i2c_device->conf.master.clk_speed;
+            entry->ret = ret;
+            entry->mem_address = mem_address;
+            entry->rx_len = rx_len < UINT16_MAX ? rx_len : UINT16_MAX;
+            entry->tx_len = tx_len < UINT16_MAX ? tx_len : UINT16_MAX;
+            entry->dev_addr = i2c_device->dev_addr;
+            entry->flags = (trace_flags & ~I2C_BUS_CMD_FLAG_NO_RETRY) | (rx_len > 0 ? I2C_BUS_TRACE_FLAG_READ : 0) | (tx_len > 0 ? I2C_BUS_TRACE_FLAG_WRITE : 0);
+            entry->attempt = attempt < UINT8_MAX ? attempt : UINT8_MAX;
+            entry->port = i2c_bus->i2c_port;
+            i2c_bus->trace_next = (i2c_bus->trace_next + 1) % CONFIG_I2C_BUS_TRACE_LEN;
+            i2c_bus->trace_count += (i2c_bus->trace_count < CONFIG_I2C_BUS_TRACE_LEN) ? 1 : 0;
+        }
+#endif
+#ifdef CONFIG_I2C_BUS_STATS
+        i2c_bus_stats_record(&i2c_bus->stats, ret, xfer_us, rx_len, tx_len);
+        i2c_bus_stats_record(&i2c_device->stats, ret, xfer_us, rx_len, tx_len);
+        i2c_device->stats.lock_wait_us += i2c_bus->lock_wait_us;
+        i2c_bus->lock_wait_us = 0;
+#endif
+        /*a timeout cut short by a call budget below the default says nothing about the bus, it does not count for recovery*/
+        if (ret != ESP_ERR_TIMEOUT)
+        {
+            i2c_bus->timeout_count = 0;
+        }
+        else if (i2c_bus->budget_ticks >= I2C_BUS_TICKS_TO_WAIT)
+        {
+            i2c_bus->timeout_count++;
+        }
+#ifdef I2C_BUS_RECOVERY_TIMEOUTS
+        /*a slave holding SDA low times out every transfer, clock it free before trying again*/
+        if (i2c_bus->timeout_count >= I2C_BUS_RECOVERY_TIMEOUTS)
+        {
+            i2c_bus_line_recover(i2c_bus);
+        }
+#endif
+
+        /*exponential backoff, short waits spin instead of sleeping a whole tick*/
+        uint64_t backoff = (uint64_t)i2c_device->retry_backoff_us << (attempt < 16 ? attempt : 16);
+        uint32_t backoff_us = backoff < I2C_BUS_RETRY_BACKOFF_MAX_US ? backoff : I2C_BUS_RETRY_BACKOFF_MAX_US;
+
+        /*only pure reads are sent again, a write may have reached the device before failing.
+        no retry that would end after the deadline of the call*/
+        if (ret == ESP_OK || attempt >= i2c_device->retries || rx_len == 0 || tx_len != 0 || (trace_flags & I2C_BUS_CMD_FLAG_NO_RETRY) ||
+                backoff_us / 1000 / portTICK_RATE_MS >= i2c_bus_budget_left(i2c_bus))
+        {
+            break;
+        }
+
+        if (backoff_us >= portTICK_RATE_MS * 1000)
+        {
+            vTaskDelay(backoff_us / 1000 / portTICK_RATE_MS);
+        }
+        else if (backoff_us > 0)
+        {
+            I2C_BUS_DELAY_US(backoff_us);
+        }
+
+#ifdef CONFIG_I2C_BUS_STATS
+        i2c_bus->stats.retries++;
+        i2c_device->stats.retries++;
+#endif
+    }
+
+    return ret;
+}
+
+/**************************************** Public Functions (Low level)*********************************************/
+
+esp_err_t i2c_bus_cmd_begin(i2c_bus_device_handle_t dev_handle, i2c_cmd_handle_t cmd)
+{
+    I2C_BUS_CHECK(dev_handle != NULL, "device handle error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(cmd != NULL, "I2C command error", ESP_ERR_INVALID_ARG);
+    i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)dev_handle;
+    I2C_BUS_INIT_CHECK(i2c_device->i2c_bus->is_init, ESP_ERR_INVALID_STATE);
+    I2C_BUS_DEVICE_MUTEX_TAKE(i2c_device, 0, ESP_ERR_TIMEOUT);
+    esp_err_t ret = i2c_bus_device_cmd_begin(i2c_device, cmd, NULL_I2C_MEM_ADDR, 0, 0, 0);
+    /*the link may read-to-clear or write anything, coalesced values are not served past it*/
+    i2c_bus_reg_cache_expire(i2c_device->reg_cache);
+    I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus, ESP_FAIL);
+    return ret;
+}
+
+static esp_err_t i2c_bus_read_reg8(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, size_t data_len, uint8_t *data, uint32_t timeout_ms)
+{
+    I2C_BUS_CHECK(dev_handle != NULL, "device handle error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(data != NULL, "data pointer error", ESP_ERR_INVALID_ARG);
+    i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)dev_handle;
+    I2C_BUS_INIT_CHECK(i2c_device->i2c_bus->is_init, ESP_ERR_INVALID_STATE);
+    I2C_BUS_DEVICE_MUTEX_TAKE(i2c_device, timeout_ms, ESP_ERR_TIMEOUT);
+
+    /*non-volatile registers with a known value are served from the shadow cache*/
+    if (mem_address != NULL_I2C_MEM_ADDR && i2c_bus_reg_cache_read(i2c_device->reg_cache, mem_address, data_len, data))
+    {
+        I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus, ESP_FAIL);
+        return ESP_OK;
+    }
+
+    /*coalesced registers read within the window, e.g. by the caller we waited for the bus behind, are not read again*/
+    if (mem_address != NULL_I2C_MEM_ADDR && i2c_bus_reg_cache_read_coalesced(i2c_device->reg_cache, mem_address, data_len, data))
+    {
+#ifdef CONFIG_I2C_BUS_STATS
+        i2c_device->stats.coalesced++;
+        i2c_device->i2c_bus->stats.coalesced++;
+#endif
+        I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus, ESP_FAIL);
+        return ESP_OK;
+    }
+
+    esp_err_t ret = i2c_bus_device_read(i2c_device, mem_address, data_len, data, 0);
+
+    if (ret == ESP_OK && mem_address != NULL_I2C_MEM_ADDR)
+    {
+        i2c_bus_reg_cache_write(i2c_device->reg_cache, mem_address, data_len, data);
+        i2c_bus_reg_cache_coalesce(i2c_device->reg_cache, mem_address, data_len, data);
+    }
+    else if (mem_address == NULL_I2C_MEM_ADDR)
+    {
+        i2c_bus_reg_cache_expire(i2c_device->reg_cache); /*registers read are unknown*/
+    }
+
+    I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus, ESP_FAIL);
+    return ret;
+}
+
+static esp_err_t i2c_bus_read_raw(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, size_t data_len, uint8_t *data)
+{
+    I2C_BUS_CHECK(dev_handle != NULL, "device handle error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(data != NULL, "data pointer error", ESP_ERR_INVALID_ARG);
+    i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)dev_handle;
+    I2C_BUS_INIT_CHECK(i2c_device->i2c_bus->is_init, ESP_ERR_INVALID_STATE);
+    I2C_BUS_DEVICE_MUTEX_TAKE(i2c_device, 0, ESP_ERR_TIMEOUT);
+    esp_err_t ret = i2c_bus_device_read(i2c_device, mem_address, data_len, data, I2C_BUS_CMD_FLAG_NO_RETRY);
+    i2c_bus_reg_cache_expire(i2c_device->reg_cache); /*a stream read may clear flags of coalesced registers*/
+    I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus, ESP_FAIL);
+    return ret;
+}
+
+esp_err_t i2c_bus_read_reg16(i2c_bus_device_handle_t dev_handle, uint16_t mem_address, size_t data_len, uint8_t *data)
+{
+    return i2c_bus_read_reg16_timeout(dev_handle, mem_address, data_len, data, 0);
+}
+
+esp_err_t i2c_bus_read_reg16_timeout(i2c_bus_device_handle_t dev_handle, uint16_t mem_address, size_t data_len, uint8_t *data, uint32_t timeout_ms)
+{
+    I2C_BUS_CHECK(dev_handle != NULL, "device handle error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(data != NULL, "data pointer error", ESP_ERR_INVALID_ARG);
+    i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)dev_handle;
+    I2C_BUS_INIT_CHECK(i2c_device->i2c_bus->is_init, ESP_ERR_INVALID_STATE);
+    uint8_t memAddress8[2];
+    memAddress8[0] = (uint8_t)((mem_address >> 8) & 0x00FF);
+    memAddress8[1] = (uint8_t)(mem_address & 0x00FF);
+    I2C_BUS_DEVICE_MUTEX_TAKE(i2c_device, timeout_ms, ESP_ERR_TIMEOUT);
+    i2c_cmd_handle_t cmd = i2c_bus_cmd_link_take(i2c_device->i2c_bus);
+
+    if (cmd == NULL)
+    {
+        ESP_LOGE(TAG, "i2c command link create failed");
+        I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus, ESP_FAIL);
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (mem_address != NULL_I2C_MEM_ADDR)
+    {
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, (i2c_device->dev_addr << 1) | I2C_MASTER_WRITE, I2C_ACK_CHECK_EN);
+        i2c_master_write(cmd, memAddress8, 2, I2C_ACK_CHECK_EN);
+    }
+
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (i2c_device->dev_addr << 1) | I2C_MASTER_READ, I2C_ACK_CHECK_EN);
+    i2c_master_read(cmd, data, data_len, I2C_MASTER_LAST_NACK);
+    i2c_master_stop(cmd);
+    esp_err_t ret = i2c_bus_device_cmd_begin(i2c_device, cmd, mem_address, I2C_BUS_TRACE_FLAG_REG16, data_len, 0);
+    i2c_bus_cmd_link_release(i2c_device->i2c_bus, cmd);
+    i2c_bus_reg_cache_expire(i2c_device->reg_cache); /*16-bit addresses are not mapped, any register may be read*/
+    I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus, ESP_FAIL);
+    return ret;
+}
+
+static esp_err_t i2c_bus_write_reg8(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, size_t data_len, const uint8_t *data, uint32_t timeout_ms)
+{
+    I2C_BUS_CHECK(dev_handle != NULL, "device handle error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(data != NULL, "data pointer error", ESP_ERR_INVALID_ARG);
+    i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)dev_handle;
+    I2C_BUS_INIT_CHECK(i2c_device->i2c_bus->is_init, ESP_ERR_INVALID_STATE);
+    I2C_BUS_DEVICE_MUTEX_TAKE(i2c_device, timeout_ms, ESP_ERR_TIMEOUT);
+    i2c_cmd_handle_t cmd = i2c_bus_cmd_link_take(i2c_device->i2c_bus);
+
+    if (cmd == NULL)
+    {
+        ESP_LOGE(TAG, "i2c command link create failed");
+        I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus, ESP_FAIL);
+        return ESP_ERR_NO_MEM;
+    }
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (i2c_device->dev_addr << 1) | I2C_MASTER_WRITE, I2C_ACK_CHECK_EN);
+
+    if (mem_address != NULL_I2C_MEM_ADDR)
+    {
+        i2c_master_write_byte(cmd, mem_address, I2C_ACK_CHECK_EN);
+    }
+
+    i2c_master_write(cmd, (uint8_t *)data, data_len, I2C_ACK_CHECK_EN);
+    i2c_master_stop(cmd);
+    esp_err_t ret = i2c_bus_device_cmd_begin(i2c_device, cmd, mem_address, 0, 0, data_len);
+    i2c_bus_cmd_link_release(i2c_device->i2c_bus, cmd);
+
+    /*keep the shadow cache coherent, a failed write leaves the registers unknown*/
+    if (mem_address != NULL_I2C_MEM_ADDR && ret == ESP_OK)
+    {
+        i2c_bus_reg_cache_write(i2c_device->reg_cache, mem_address, data_len, data);
+    }
+    else if (mem_address != NULL_I2C_MEM_ADDR)
+    {
+        i2c_bus_reg_cache_drop(i2c_device->reg_cache, mem_address, data_len);
+    }
+    else
+    {
+        i2c_bus_reg_cache_expire(i2c_device->reg_cache); /*e.g. a special function write clearing interrupt flags*/
+    }
+
+    I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus, ESP_FAIL);
+    return ret;
+}
+
+esp_err_t i2c_bus_write_reg16(i2c_bus_device_handle_t dev_handle, uint16_t mem_address, size_t data_len, const uint8_t *data)
+{
+    return i2c_bus_write_reg16_timeout(dev_handle, mem_address, data_len, data, 0);
+}
+
+esp_err_t i2c_bus_write_reg16_timeout(i2c_bus_device_handle_t dev_handle, uint16_t mem_address, size_t data_len, const uint8_t *data, uint32_t timeout_ms)
+{
+    I2C_BUS_CHECK(dev_handle != NULL, "device handle error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(data != NULL, "data pointer error", ESP_ERR_INVALID_ARG);
+    i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)dev_handle;
+    I2C_BUS_INIT_CHECK(i2c_device->i2c_bus->is_init, ESP_ERR_INVALID_STATE);
+    uint8_t memAddress8[2];
+    memAddress8[0] = (uint8_t)((mem_address >> 8) & 0x00FF);
+    memAddress8[1] = (uint8_t)(mem_address & 0x00FF);
+    I2C_BUS_DEVICE_MUTEX_TAKE(i2c_device, timeout_ms, ESP_ERR_TIMEOUT);
+    i2c_cmd_handle_t cmd = i2c_bus_cmd_link_take(i2c_device->i2c_bus);
+
+    if (cmd == NULL)
+    {
+        ESP_LOGE(TAG, "i2c command link create failed");
+        I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus, ESP_FAIL);
+        return ESP_ERR_NO_MEM;
+    }
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (i2c_device->dev_addr << 1) | I2C_MASTER_WRITE, I2C_ACK_CHECK_EN);
+
+    if (mem_address != NULL_I2C_MEM_ADDR)
+    {
+        i2c_master_write(cmd, memAddress8, 2, I2C_ACK_CHECK_EN);
+    }
+
+    i2c_master_write(cmd, (uint8_t *)data, data_len, I2C_ACK_CHECK_EN);
+    i2c_master_stop(cmd);
+    esp_err_t ret = i2c_bus_device_cmd_begin(i2c_device, cmd, mem_address, I2C_BUS_TRACE_FLAG_REG16, 0, data_len);
+    i2c_bus_cmd_link_release(i2c_device->i2c_bus, cmd);
+    i2c_bus_reg_cache_expire(i2c_device->reg_cache);
+    I2C_BUS_MUTEX_GIVE(i2c_device->i2c_bus, ESP_FAIL);
+    return ret;
+}
+
+/**************************************** Private Functions*********************************************/
+static esp_err_t i2c_driver_reinit(i2c_port_t port, const i2c_config_t *conf)
+{
+    I2C_BUS_CHECK(port < I2C_NUM_MAX, "i2c port error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(conf != NULL, "pointer = NULL error", ESP_ERR_INVALID_ARG);
+
+    if (s_i2c_bus[port].is_init)
+    {
+        i2c_driver_delete(port);
+        s_i2c_bus[port].is_init = false;
+        ESP_LOGI(TAG, "i2c%d bus deinited", port);
+    }
+
+    esp_err_t ret = i2c_param_config(port, conf);
+    I2C_BUS_CHECK(ret == ESP_OK, "i2c param config failed", ret);
+    ret = i2c_driver_install(port, conf->mode, I2C_BUS_MASTER_BUF_LEN, I2C_BUS_MASTER_BUF_LEN, I2C_BUS_FLG_DEFAULT);
+    I2C_BUS_CHECK(ret == ESP_OK, "i2c driver install failed", ret);
+    s_i2c_bus[port].is_init = true;
+    ESP_LOGI(TAG, "i2c%d bus inited", port);
+    return ESP_OK;
+}
+
+/**
+ * @brief set SCL frequency of an installed driver without reinstall. With the i2c_master backend next transfers
+ *        use device handles of the new frequency. With the legacy driver the port is configured again by
+ *        i2c_param_config, which reprograms bus timing, filter and timeout of an installed driver in place,
+ *        and the SCL frequency read back from the period registers is checked.
+ *
+ * @param port i2c port
+ * @param clk_speed new SCL frequency
+ * @return esp_err_t ESP_OK, ESP_ERR_NOT_SUPPORTED if not supported, then driver should be reinstalled
+ */
+static esp_err_t i2c_driver_retime(i2c_port_t port, uint32_t clk_speed)
+{
+#if defined(CONFIG_I2C_BUS_BACKEND_I2C_MASTER)
+    if (!s_i2c_bus[port].is_init || clk_speed == 0)
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    /*i2c_master devices carry their own SCL frequency, next transfers use handles of the new one*/
+    return i2c_bus_master_set_clk_speed(port, clk_speed) == ESP_OK ? ESP_OK : ESP_ERR_NOT_SUPPORTED;
+#elif defined(CONFIG_I2C_BUS_DYNAMIC_RETIME)
+    if (!s_i2c_bus[port].is_init || clk_speed == 0)
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    i2c_config_t conf = s_i2c_bus[port].conf_active;
+    int high_period = 0;
+    int low_period = 0;
+    uint32_t scl_freq = 0;
+    conf.master.clk_speed = clk_speed;
+    esp_err_t ret = i2c_param_config(port, &conf);
+    ret = (ret == ESP_OK) ? i2c_get_period(port, &high_period, &low_period) : ret;
+
+    if (ret == ESP_OK)
+    {
+        scl_freq = I2C_BUS_SCLK_FREQ / (high_period + low_period + I2C_BUS_SCL_PERIOD_ADJUST);
+    }
+
+    if (ret != ESP_OK || (scl_freq > clk_speed ? scl_freq - clk_speed : clk_speed - scl_freq) * 100 > clk_speed * I2C_BUS_RETIME_TOLERANCE_PCT)
+    {
+        ESP_LOGW(TAG, "i2c%d retime to %u Hz failed, SCL at %u Hz", port, (unsigned int)clk_speed, (unsigned int)scl_freq);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    ESP_LOGD(TAG, "i2c%d retimed to %u Hz", port, (unsigned int)clk_speed);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * @brief free a bus held by a slave, must be called with bus mutex taken.
+ *        The driver is removed, SCL is pulsed up to 9 times until the slave releases SDA, then a STOP is generated
+ *        by hand and the driver is installed again with the active configuration.
+ *
+ * @param i2c_bus the bus
+ * @return esp_err_t ESP_OK, ESP_FAIL if SDA is still held low
+ */
+static esp_err_t i2c_bus_line_recover(i2c_bus_t *i2c_bus)
+{
+    i2c_port_t port = i2c_bus->i2c_port;
+    const i2c_config_t *conf = &i2c_bus->conf_active;
+    bool sda_free = true;
+    ESP_LOGW(TAG, "i2c%d bus stuck, recovering", port);
+    i2c_driver_deinit(port);
+#ifdef CONFIG_IDF_TARGET_LINUX
+    sda_free = i2c_bus_sim_line_recover(port, I2C_BUS_RECOVERY_PULSES);
+#else
+    gpio_config_t io_conf = {
+        .pin_bit_mask = (1ULL << conf->scl_io_num) | (1ULL << conf->sda_io_num),
+        .mode = GPIO_MODE_INPUT_OUTPUT_OD,
+        .pull_up_en = (conf->scl_pullup_en || conf->sda_pullup_en) ? GPIO_PULLUP_ENABLE : GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE,
+    };
+    gpio_set_level(conf->sda_io_num, 1);
+    gpio_set_level(conf->scl_io_num, 1);
+    gpio_config(&io_conf);
+
+    for (int i = 0; i < I2C_BUS_RECOVERY_PULSES && gpio_get_level(conf->sda_io_num) == 0; i++)
+    {
+        gpio_set_level(conf->scl_io_num, 0);
+        I2C_BUS_DELAY_US(I2C_BUS_RECOVERY_HALF_CYCLE_US);
+        gpio_set_level(conf->scl_io_num, 1);
+        I2C_BUS_DELAY_US(I2C_BUS_RECOVERY_HALF_CYCLE_US);
+    }
+
+    /*STOP: SDA rises while SCL is high*/
+    gpio_set_level(conf->scl_io_num, 0);
+    I2C_BUS_DELAY_US(I2C_BUS_RECOVERY_HALF_CYCLE_US);
+    gpio_set_level(conf->sda_io_num, 0);
+    I2C_BUS_DELAY_US(I2C_BUS_RECOVERY_HALF_CYCLE_US);
+    gpio_set_level(conf->scl_io_num, 1);
+    I2C_BUS_DELAY_US(I2C_BUS_RECOVERY_HALF_CYCLE_US);
+    gpio_set_level(conf->sda_io_num, 1);
+    I2C_BUS_DELAY_US(I2C_BUS_RECOVERY_HALF_CYCLE_US);
+    sda_free = gpio_get_level(conf->sda_io_num) != 0;
+#endif
+    esp_err_t ret = i2c_driver_reinit(port, conf);
+    i2c_bus->timeout_count = 0;
+#ifdef CONFIG_I2C_BUS_STATS
+    i2c_bus->stats.recoveries++;
+#endif
+
+    if (ret != ESP_OK || !sda_free)
+    {
+        ESP_LOGE(TAG, "i2c%d bus recovery failed, SDA %s", port, sda_free ? "free" : "held low");
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t i2c_driver_deinit(i2c_port_t port)
+{
+    I2C_BUS_CHECK(port < I2C_NUM_MAX, "i2c port error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(s_i2c_bus[port].is_init == true, "i2c not inited", ESP_ERR_INVALID_STATE);
+    i2c_driver_delete(port); // always return ESP_OK
+    s_i2c_bus[port].is_init = false;
+    ESP_LOGI(TAG, "i2c%d bus deinited", port);
+    return ESP_OK;
+}
+
+/**
+ * @brief compare with active i2c_bus configuration
+ *
+ * @param port choose which i2c_port's configuration will be compared
+ * @param conf new configuration
+ * @return true new configuration is equal to active configuration
+ * @return false new configuration is not equal to active configuration
+ */
+inline static bool i2c_config_compare(i2c_port_t port, const i2c_config_t *conf)
+{
+    if (s_i2c_bus[port].conf_active.master.clk_speed == conf->master.clk_speed && s_i2c_bus[port].conf_active.sda_io_num == conf->sda_io_num && s_i2c_bus[port].conf_active.scl_io_num == conf->scl_io_num && s_i2c_bus[port].conf_active.scl_pullup_en == conf->scl_pullup_en && s_i2c_bus[port].conf_active.sda_pullup_en == conf->sda_pullup_en)
+    {
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief compare pins and pull-ups with active i2c_bus configuration, clock is ignored
+ *
+ * @param port choose which i2c_port's configuration will be compared
+ * @param conf new configuration
+ * @return true pins and pull-ups of new configuration are equal to active configuration
+ * @return false pins or pull-ups differ
+ */
+inline static bool i2c_config_compare_pins(i2c_port_t port, const i2c_config_t *conf)
+{
+    if (s_i2c_bus[port].conf_active.sda_io_num == conf->sda_io_num && s_i2c_bus[port].conf_active.scl_io_num == conf->scl_io_num && s_i2c_bus[port].conf_active.scl_pullup_en == conf->scl_pullup_en && s_i2c_bus[port].conf_active.sda_pullup_en == conf->sda_pullup_en)
+    {
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief get a command link for one transfer, must be called with bus mutex taken.
+ *        If static command link is enabled the bus owned buffer is used, else a link is allocated from heap.
+ *
+ * @param i2c_bus the bus the transfer will be sent on
+ * @return i2c_cmd_handle_t command link handle, NULL if failed
+ */
+inline static i2c_cmd_handle_t i2c_bus_cmd_link_take(i2c_bus_t *i2c_bus)
+{
+#ifdef I2C_BUS_STATIC_CMD_LINK_EN
+    i2c_bus->cmd_link_stats.static_uses++;
+    return i2c_cmd_link_create_static(i2c_bus->cmd_link_buf, I2C_BUS_CMD_LINK_BUF_LEN);
+#else
+    i2c_bus->cmd_link_stats.heap_allocs++;
+    return i2c_cmd_link_create();
+#endif
+}
+
+/**
+ * @brief release a command link got from i2c_bus_cmd_link_take, must be called with bus mutex taken.
+ *
+ * @param i2c_bus the bus the transfer was sent on
+ * @param cmd command link handle
+ */
+inline static void i2c_bus_cmd_link_release(i2c_bus_t *i2c_bus, i2c_cmd_handle_t cmd)
+{
+#ifdef I2C_BUS_STATIC_CMD_LINK_EN
+    i2c_cmd_link_delete_static(cmd);
+#else
+    i2c_bus->cmd_link_stats.heap_frees++;
+    i2c_cmd_link_delete(cmd);
+#endif
+}
+
+/**
+ * @brief read registers of a device on the wire, the register cache is not used, must be called with bus mutex taken
+ *
+ * @param i2c_device the device
+ * @param mem_address internal reg/mem address, NULL_I2C_MEM_ADDR if no internal address
+ * @param data_len number of bytes to read
+ * @param data read buffer
+ * @param cmd_flags I2C_BUS_CMD_FLAG_NO_RETRY or 0
+ * @return esp_err_t result of the transfer
+ */
+static esp_err_t i2c_bus_device_read(i2c_bus_device_t *i2c_device, uint8_t mem_address, size_t data_len, uint8_t *data, uint8_t cmd_flags)
+{
+    i2c_cmd_handle_t cmd = i2c_bus_cmd_link_take(i2c_device->i2c_bus);
+
+    if (cmd == NULL)
+    {
+        ESP_LOGE(TAG, "i2c command link create failed");
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (mem_address != NULL_I2C_MEM_ADDR)
+    {
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, (i2c_device->dev_addr << 1) | I2C_MASTER_WRITE, I2C_ACK_CHECK_EN);
+        i2c_master_write_byte(cmd, mem_address, I2C_ACK_CHECK_EN);
+    }
+
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (i2c_device->dev_addr << 1) | I2C_MASTER_READ, I2C_ACK_CHECK_EN);
+    i2c_master_read(cmd, data, data_len, I2C_MASTER_LAST_NACK);
+    i2c_master_stop(cmd);
+    esp_err_t ret = i2c_bus_device_cmd_begin(i2c_device, cmd, mem_address, cmd_flags, data_len, 0);
+    i2c_bus_cmd_link_release(i2c_device->i2c_bus, cmd);
+    return ret;
+}
+
+/**
+ * @brief take the next free operation of a transaction and init it as not executed
+ *
+ * @param txn the transaction
+ * @param type operation type
+ * @param mem_address internal reg/mem address
+ * @return i2c_bus_txn_op_t* operation, NULL if the transaction is full
+ */
+static i2c_bus_txn_op_t *i2c_bus_txn_op_alloc(i2c_bus_txn_t *txn, i2c_bus_txn_op_type_t type, uint8_t mem_address)
+{
+    if (txn->num_ops >= I2C_BUS_TXN_MAX_OPS)
+    {
+        txn->ret = ESP_ERR_NO_MEM;
+        return NULL;
+    }
+
+    i2c_bus_txn_op_t *op = &txn->ops[txn->num_ops++];
+    memset(op, 0, sizeof(i2c_bus_txn_op_t));
+    op->type = type;
+    op->mem_address = mem_address;
+    op->ret = ESP_ERR_INVALID_STATE;
+    return op;
+}
+
+/**
+ * @brief number of link commands an operation needs, stop is not included
+ *
+ * @param op the operation
+ * @return uint32_t number of commands
+ */
+static uint32_t i2c_bus_txn_op_cmds(const i2c_bus_txn_op_t *op)
+{
+    uint32_t cmds = 2; /*start + address*/
+
+    if (op->mem_address != NULL_I2C_MEM_ADDR)
+    {
+        cmds++;
+    }
+
+    if (op->type == I2C_BUS_TXN_OP_WRITE)
+    {
+        return cmds + (op->data_len > 0 ? 1 : 0);
+    }
+
+    /*read and RMW read: repeated start + address when mem_address is written, last byte is read with nack*/
+    if (op->mem_address != NULL_I2C_MEM_ADDR)
+    {
+        cmds += 2;
+    }
+
+    return cmds + (op->data_len > 1 ? 2 : 1);
+}
+
+/**
+ * @brief append an operation to a command link, operations in one link are separated by repeated start.
+ *        RMW is appended as read if op->rx_data is set, else as write of op->byte.
+ *
+ * @param i2c_device device the link is sent to
+ * @param cmd command link
+ * @param op the operation
+ * @return esp_err_t ESP_OK or error of the link building functions
+ */
+static esp_err_t i2c_bus_txn_op_append(i2c_bus_device_t *i2c_device, i2c_cmd_handle_t cmd, const i2c_bus_txn_op_t *op)
+{
+    bool is_read = op->type == I2C_BUS_TXN_OP_READ || (op->type == I2C_BUS_TXN_OP_RMW && op->rx_data != NULL);
+    esp_err_t ret = i2c_master_start(cmd);
+
+    if (is_read && op->mem_address != NULL_I2C_MEM_ADDR)
+    {
+        ret = (ret == ESP_OK) ? i2c_master_write_byte(cmd, (i2c_device->dev_addr << 1) | I2C_MASTER_WRITE, I2C_ACK_CHECK_EN) : ret;
+        ret = (ret == ESP_OK) ? i2c_master_write_byte(cmd, op->mem_address, I2C_ACK_CHECK_EN) : ret;
+        ret = (ret == ESP_OK) ? i2c_master_start(cmd) : ret;
+    }
+
+    if (is_read)
+    {
+        ret = (ret == ESP_OK) ? i2c_master_write_byte(cmd, (i2c_device->dev_addr << 1) | I2C_MASTER_READ, I2C_ACK_CHECK_EN) : ret;
+        ret = (ret == ESP_OK) ? i2c_master_read(cmd, op->rx_data, op->data_len, I2C_MASTER_LAST_NACK) : ret;
+        return ret;
+    }
+
+    ret = (ret == ESP_OK) ? i2c_master_write_byte(cmd, (i2c_device->dev_addr << 1) | I2C_MASTER_WRITE, I2C_ACK_CHECK_EN) : ret;
+
+    if (op->mem_address != NULL_I2C_MEM_ADDR)
+    {
+        ret = (ret == ESP_OK) ? i2c_master_write_byte(cmd, op->mem_address, I2C_ACK_CHECK_EN) : ret;
+    }
+
+    if (op->tx_data == NULL)
+    {
+        ret = (ret == ESP_OK) ? i2c_master_write_byte(cmd, op->byte, I2C_ACK_CHECK_EN) : ret;
+    }
+    else if (op->data_len > 0)
+    {
+        ret = (ret == ESP_OK) ? i2c_master_write(cmd, (uint8_t *)op->tx_data, op->data_len, I2C_ACK_CHECK_EN) : ret;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief terminate a transaction command link with stop, send and release it. Must be called with bus mutex taken.
+ *
+ * @param i2c_device device the link is sent to
+ * @param cmd pointer to the command link, set to NULL after release
+ * @param txn the transaction
+ * @param from first operation in the link
+ * @param to operation after the last one in the link, an RMW with rx_data set only has its read part in the link
+ * @return esp_err_t result of the transfer
+ */
+static esp_err_t i2c_bus_txn_link_send(i2c_bus_device_t *i2c_device, i2c_cmd_handle_t *cmd, const i2c_bus_txn_t *txn, uint8_t from, uint8_t to)
+{
+    esp_err_t ret = i2c_master_stop(*cmd);
+    size_t rx_len = 0;
+    size_t tx_len = 0;
+
+    for (uint8_t i = from; i < to; i++)
+    {
+        const i2c_bus_txn_op_t *op = &txn->ops[i];
+
+        if (op->type == I2C_BUS_TXN_OP_READ || (op->type == I2C_BUS_TXN_OP_RMW && op->rx_data != NULL))
+        {
+            rx_len += op->data_len;
+        }
+        else
+        {
+            tx_len += op->data_len;
+        }
+    }
+
+    if (ret == ESP_OK)
+    {
+        ret = i2c_bus_device_cmd_begin(i2c_device, *cmd, txn->ops[from].mem_address, I2C_BUS_TRACE_FLAG_TXN, rx_len, tx_len);
+    }
+
+    i2c_bus_cmd_link_release(i2c_device->i2c_bus, *cmd);
+    *cmd = NULL;
+    return ret;
+}
+
+/**
+ * @brief read or write a register map as transactions, a run of consecutive addresses is one operation
+ *
+ * @param dev_handle the device
+ * @param map the register map
+ * @param values register values in map order
+ * @param write true to write, false to read
+ * @return esp_err_t result of the first failed transaction
+ */
+static esp_err_t i2c_bus_regmap_xfer(i2c_bus_device_handle_t dev_handle, const i2c_bus_regmap_t *map, uint8_t *values, bool write)
+{
+    I2C_BUS_CHECK(map != NULL && (map->regs != NULL || map->num == 0), "register map error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CHECK(values != NULL, "data pointer error", ESP_ERR_INVALID_ARG);
+    i2c_bus_txn_t txn;
+    esp_err_t ret = i2c_bus_txn_begin(&txn, dev_handle);
+    uint8_t i = 0;
+
+    while (i < map->num && ret == ESP_OK)
+    {
+        uint8_t run = 1;
+
+        while (i + run < map->num && map->regs[i + run] == map->regs[i] + run)
+        {
+            run++;
+        }
+
+        ret = write ? i2c_bus_txn_add_write(&txn, map->regs[i], run, &values[i]) : i2c_bus_txn_add_read(&txn, map->regs[i], run, &values[i]);
+        i += run;
+
+        /*a full transaction is sent, the map goes on in a new one*/
+        if (ret == ESP_OK && (txn.num_ops == I2C_BUS_TXN_MAX_OPS || i == map->num))
+        {
+            ret = i2c_bus_txn_commit(&txn);
+            ret = (ret == ESP_OK) ? i2c_bus_txn_reset(&txn) : ret;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * @brief save the result of sent transaction operations and update the register cache with their data.
+ *        Must be called with bus mutex taken.
+ *
+ * @param i2c_device device the operations were sent to
+ * @param txn the transaction
+ * @param from first operation
+ * @param to operation after the last one
+ * @param ret result of the transfer
+ */
+static void i2c_bus_txn_ops_done(i2c_bus_device_t *i2c_device, i2c_bus_txn_t *txn, uint8_t from, uint8_t to, esp_err_t ret)
+{
+    for (uint8_t i = from; i < to; i++)
+    {
+        i2c_bus_txn_op_t *op = &txn->ops[i];
+        op->ret = ret;
+
+        if (op->mem_address == NULL_I2C_MEM_ADDR)
+        {
+            continue;
+        }
+
+        if (ret != ESP_OK)
+        {
+            i2c_bus_reg_cache_drop(i2c_device->reg_cache, op->mem_address, op->data_len);
+        }
+        else if (op->type == I2C_BUS_TXN_OP_READ)
+        {
+            i2c_bus_reg_cache_write(i2c_device->reg_cache, op->mem_address, op->data_len, op->rx_data);
+            i2c_bus_reg_cache_coalesce(i2c_device->reg_cache, op->mem_address, op->data_len, op->rx_data);
+        }
+        else
+        {
+            i2c_bus_reg_cache_write(i2c_device->reg_cache, op->mem_address, op->data_len, op->tx_data != NULL ? op->tx_data : &op->byte);
+        }
+    }
+}
+
+/**
+ * @brief send one traced transfer again, with the same device, address and lengths
+ *
+ * @param dev_handle device of the entry
+ * @param entry the traced transfer
+ * @param buf scratch data, large enough for the entry lengths, zeros are written
+ * @return esp_err_t result of the transfer
+ */
+static esp_err_t i2c_bus_trace_replay_entry(i2c_bus_device_handle_t dev_handle, const i2c_bus_trace_entry_t *entry, uint8_t *buf)
+{
+    if (entry->flags & I2C_BUS_TRACE_FLAG_REG16)
+    {
+        return entry->rx_len > 0 ? i2c_bus_read_reg16(dev_handle, entry->mem_address, entry->rx_len, buf)
+               : i2c_bus_write_reg16(dev_handle, entry->mem_address, entry->tx_len, buf);
+    }
+
+    if (entry->flags & I2C_BUS_TRACE_FLAG_TXN)
+    {
+        i2c_bus_txn_t txn;
+        esp_err_t ret = i2c_bus_txn_begin(&txn, dev_handle);
+
+        if (entry->rx_len > 0)
+        {
+            ret = (ret == ESP_OK) ? i2c_bus_txn_add_read(&txn, (uint8_t)entry->mem_address, entry->rx_len, buf) : ret;
+        }
+
+        if (entry->tx_len > 0)
+        {
+            ret = (ret == ESP_OK) ? i2c_bus_txn_add_write(&txn, (uint8_t)entry->mem_address, entry->tx_len, buf) : ret;
+        }
+
+        return (ret == ESP_OK) ? i2c_bus_txn_commit(&txn) : ret;
+    }
+
+    return entry->rx_len > 0 ? i2c_bus_read_reg8(dev_handle, (uint8_t)entry->mem_address, entry->rx_len, buf, 0)
+           : i2c_bus_write_reg8(dev_handle, (uint8_t)entry->mem_address, entry->tx_len, buf, 0);
+}
+
+/**
+ * @brief read registers from the shadow cache, must be called with bus mutex taken
+ *
+ * @param cache register cache, NULL if disabled
+ * @param mem_address first register
+ * @param data_len number of registers, auto-increment addressing is assumed
+ * @param data buffer to save the values
+ * @return true all registers are non-volatile with a known value, data is filled
+ * @return false at least one register must be read from the device
+ */
+static bool i2c_bus_reg_cache_read(i2c_bus_reg_cache_t *cache, uint8_t mem_address, size_t data_len, uint8_t *data)
+{
+    if (cache == NULL || data_len == 0 || mem_address + data_len > I2C_BUS_REG_CACHE_SIZE)
+    {
+        return false;
+    }
+
+    for (size_t i = mem_address; i < mem_address + data_len; i++)
+    {
+        uint32_t bit = 1UL << (i % 32);
+
+        if ((cache->is_volatile[i / 32] & bit) || !(cache->valid[i / 32] & bit))
+        {
+            return false;
+        }
+    }
+
+    memcpy(data, &cache->value[mem_address], data_len);
+    return true;
+}
+
+/**
+ * @brief save register values written to or read from the device, volatile registers are skipped
+ *        and lose their coalesced value. Must be called with bus mutex taken.
+ *
+ * @param cache register cache, NULL if disabled
+ * @param mem_address first register
+ * @param data_len number of registers, auto-increment addressing is assumed
+ * @param data register values
+ */
+static void i2c_bus_reg_cache_write(i2c_bus_reg_cache_t *cache, uint8_t mem_address, size_t data_len, const uint8_t *data)
+{
+    if (cache == NULL)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < data_len && mem_address + i < I2C_BUS_REG_CACHE_SIZE; i++)
+    {
+        size_t reg = mem_address + i;
+        uint32_t bit = 1UL << (reg % 32);
+
+        if (!(cache->is_volatile[reg / 32] & bit))
+        {
+            cache->value[reg] = data[i];
+            cache->valid[reg / 32] |= bit;
+        }
+        else
+        {
+            cache->fresh[reg / 32] &= ~bit;
+        }
+    }
+}
+
+/**
+ * @brief mark registers as unknown, must be called with bus mutex taken
+ *
+ * @param cache register cache, NULL if disabled
+ * @param mem_address first register
+ * @param data_len number of registers
+ */
+static void i2c_bus_reg_cache_drop(i2c_bus_reg_cache_t *cache, uint8_t mem_address, size_t data_len)
+{
+    if (cache == NULL)
+    {
+        return;
+    }
+
+    for (size_t i = mem_address; i < mem_address + data_len && i < I2C_BUS_REG_CACHE_SIZE; i++)
+    {
+        cache->valid[i / 32] &= ~(1UL << (i % 32));
+        cache->fresh[i / 32] &= ~(1UL << (i % 32));
+    }
+}
+
+/**
+ * @brief read registers which are either shadowed or coalesced and read within the window,
+ *        must be called with bus mutex taken. Not used for RMW, which needs the current value of the device.
+ *
+ * @param cache register cache, NULL if disabled
+ * @param mem_address first register
+ * @param data_len number of registers, auto-increment addressing is assumed
+ * @param data buffer to save the values
+ * @return true all registers have a value to serve, data is filled
+ * @return false at least one register must be read from the device
+ */
+static bool i2c_bus_reg_cache_read_coalesced(i2c_bus_reg_cache_t *cache, uint8_t mem_address, size_t data_len, uint8_t *data)
+{
+    if (cache == NULL || cache->window_us == 0 || data_len == 0 || mem_address + data_len > I2C_BUS_REG_CACHE_SIZE)
+    {
+        return false;
+    }
+
+    uint32_t now_us = (uint32_t)I2C_BUS_TIME_US();
+
+    for (size_t i = mem_address; i < mem_address + data_len; i++)
+    {
+        uint32_t bit = 1UL << (i % 32);
+
+        if (!(cache->is_volatile[i / 32] & bit) && (cache->valid[i / 32] & bit))
+        {
+            continue;
+        }
+
+        /*32-bit time wraps after 71 minutes, the difference stays correct for windows below that*/
+        if (!(cache->fresh[i / 32] & bit) || now_us - cache->read_us[i] >= cache->window_us)
+        {
+            cache->fresh[i / 32] &= ~bit;
+            return false;
+        }
+    }
+
+    memcpy(data, &cache->value[mem_address], data_len);
+    return true;
+}
+
+/**
+ * @brief save values of coalesced registers read from the device and start their window.
+ *        A read of other volatile registers (data, FIFO) may clear flags of status registers, even of those read
+ *        before them in the same burst, it drops all coalesced values instead. Must be called with bus mutex taken.
+ *
+ * @param cache register cache, NULL if disabled
+ * @param mem_address first register
+ * @param data_len number of registers, auto-increment addressing is assumed
+ * @param data register values
+ */
+static void i2c_bus_reg_cache_coalesce(i2c_bus_reg_cache_t *cache, uint8_t mem_address, size_t data_len, const uint8_t *data)
+{
+    if (cache == NULL || cache->window_us == 0)
+    {
+        return;
+    }
+
+    uint32_t now_us = (uint32_t)I2C_BUS_TIME_US();
+
+    for (size_t i = 0; i < data_len && mem_address + i < I2C_BUS_REG_CACHE_SIZE; i++)
+    {
+        size_t reg = mem_address + i;
+        uint32_t bit = 1UL << (reg % 32);
+
+        if ((cache->is_volatile[reg / 32] & ~cache->coalesce[reg / 32]) & bit)
+        {
+            i2c_bus_reg_cache_expire(cache);
+            return;
+        }
+    }
+
+    for (size_t i = 0; i < data_len && mem_address + i < I2C_BUS_REG_CACHE_SIZE; i++)
+    {
+        size_t reg = mem_address + i;
+        uint32_t bit = 1UL << (reg % 32);
+
+        if (cache->coalesce[reg / 32] & bit)
+        {
+            cache->value[reg] = data[i];
+            cache->read_us[reg] = now_us;
+            cache->fresh[reg / 32] |= bit;
+        }
+    }
+}
+
+/**
+ * @brief drop all coalesced values, after transfers whose effect on the registers is unknown.
+ *        Must be called with bus mutex taken.
+ *
+ * @param cache register cache, NULL if disabled
+ */
+static void i2c_bus_reg_cache_expire(i2c_bus_reg_cache_t *cache)
+{
+    if (cache != NULL)
+    {
+        memset(cache->fresh, 0, sizeof(cache->fresh));
+    }
+}
+
+/**
+ * @brief remove a device from its bus group and release its address and load there
+ *
+ * @param i2c_device the device, group is NULL once it returns
+ */
+static void i2c_bus_group_leave(i2c_bus_device_t *i2c_device)
+{
+    i2c_bus_group_t *group = i2c_device->group;
+    uint8_t dev_addr = i2c_device->dev_addr;
+    portENTER_CRITICAL(&group->spinlock);
+    i2c_bus_device_t **node = &group->members;
+
+    while (*node != NULL && *node != i2c_device)
+    {
+        node = &(*node)->group_next;
+    }
+
+    if (*node != NULL)
+    {
+        *node = i2c_device->group_next;
+    }
+
+    for (uint8_t i = 0; i < group->num; i++)
+    {
+        if (group->buses[i] == i2c_device->i2c_bus)
+        {
+            group->taken[i][dev_addr / 32] &= ~(1UL << (dev_addr % 32));
+            group->load[i] -= i2c_device->group_load;
+            group->devices[i]--;
+        }
+    }
+
+    i2c_device->group_next = NULL;
+    i2c_device->group = NULL;
+    portEXIT_CRITICAL(&group->spinlock);
+}
+
+#ifdef CONFIG_I2C_BUS_ASYNC
+/**
+ * @brief create request queue and worker task of a bus if not created yet
+ *
+ * @param i2c_bus the bus
+ * @return esp_err_t ESP_OK or ESP_ERR_NO_MEM
+ */
+static esp_err_t i2c_bus_worker_start(i2c_bus_t *i2c_bus)
+{
+    esp_err_t ret = ESP_OK;
+    I2C_BUS_MUTEX_TAKE_MAX_DELAY(i2c_bus, I2C_BUS_PRIO_NORMAL, ESP_ERR_TIMEOUT);
+
+    if (i2c_bus->worker != NULL)
+    {
+        I2C_BUS_MUTEX_GIVE(i2c_bus, ESP_FAIL);
+        return ESP_OK;
+    }
+
+    QueueHandle_t req_queue = xQueueCreate(CONFIG_I2C_BUS_ASYNC_QUEUE_LEN, sizeof(i2c_bus_request_t *));
+    i2c_bus->worker_exit = xSemaphoreCreateBinary();
+    I2C_BUS_CHECK_GOTO(req_queue != NULL && i2c_bus->worker_exit != NULL, "create request queue failed", worker_fail);
+#ifdef CONFIG_I2C_BUS_IRQ
+    /*the interrupt handler reads the queue under the irq spinlock, lines masked while there was none fire again*/
+    portENTER_CRITICAL(&i2c_bus->irq_spinlock);
+    i2c_bus->req_queue = req_queue;
+    portEXIT_CRITICAL(&i2c_bus->irq_spinlock);
+#else
+    i2c_bus->req_queue = req_queue;
+#endif
+    char name[16];
+    snprintf(name, sizeof(name), "i2c%d_worker", i2c_bus->i2c_port);
+    BaseType_t created = xTaskCreatePinnedToCore(i2c_bus_worker_task, name, CONFIG_I2C_BUS_ASYNC_TASK_STACK, i2c_bus,
+                         CONFIG_I2C_BUS_ASYNC_TASK_PRIORITY, &i2c_bus->worker, i2c_bus->worker_core);
+    I2C_BUS_CHECK_GOTO(created == pdPASS, "create worker task failed", worker_fail);
+    ESP_LOGI(TAG, "i2c%d worker started", i2c_bus->i2c_port);
+#ifdef CONFIG_I2C_BUS_IRQ
+    i2c_bus_irq_rearm(i2c_bus, NULL);
+#endif
+    I2C_BUS_MUTEX_GIVE(i2c_bus, ESP_FAIL);
+    return ret;
+
+worker_fail:
+    i2c_bus_worker_queue_delete(i2c_bus, req_queue);
+
+    if (i2c_bus->worker_exit != NULL)
+    {
+        vSemaphoreDelete(i2c_bus->worker_exit);
+        i2c_bus->worker_exit = NULL;
+    }
+
+    i2c_bus->worker = NULL;
+    I2C_BUS_MUTEX_GIVE(i2c_bus, ESP_FAIL);
+    return ESP_ERR_NO_MEM;
+}
+
+/**
+ * @brief unpublish and delete the request queue of a bus. Interrupt requests queued after the worker exited are
+ *        dropped, their lines stay masked as stalled and are unmasked by the next worker.
+ *
+ * @param i2c_bus the bus
+ * @param req_queue the queue, may be NULL
+ */
+static void i2c_bus_worker_queue_delete(i2c_bus_t *i2c_bus, QueueHandle_t req_queue)
+{
+#ifdef CONFIG_I2C_BUS_IRQ
+    bool posting = true;
+    portENTER_CRITICAL(&i2c_bus->irq_spinlock);
+    i2c_bus->req_queue = NULL;
+    portEXIT_CRITICAL(&i2c_bus->irq_spinlock);
+
+    /*an ISR of the other core may be posting to the queue, it is done within one queue call*/
+    while (posting)
+    {
+        portENTER_CRITICAL(&i2c_bus->irq_spinlock);
+        posting = (i2c_bus->irq_posting != 0);
+        portEXIT_CRITICAL(&i2c_bus->irq_spinlock);
+    }
+
+    i2c_bus_request_t *req = NULL;
+
+    while (req_queue != NULL && xQueueReceive(req_queue, &req, 0) == pdTRUE)
+    {
+        SemaphoreHandle_t unbind = NULL;
+        portENTER_CRITICAL(&i2c_bus->irq_spinlock);
+
+        for (i2c_bus_device_t *i2c_device = i2c_bus->irq_devices; i2c_device != NULL; i2c_device = i2c_device->irq_next)
+        {
+            if (i2c_device->irq_req == req && i2c_device->irq_queued)
+            {
+                i2c_device->irq_queued = false;
+                i2c_device->irq_stalled = true;
+                unbind = i2c_device->irq_unbind;
+                i2c_device->irq_unbind = NULL;
+            }
+        }
+
+        portEXIT_CRITICAL(&i2c_bus->irq_spinlock);
+
+        if (unbind != NULL)
+        {
+            xSemaphoreGive(unbind);
+        }
+    }
+#else
+    i2c_bus->req_queue = NULL;
+#endif
+
+    if (req_queue != NULL)
+    {
+        vQueueDelete(req_queue);
+    }
+}
+
+/**
+ * @brief stop worker task of a bus after all queued requests are served
+ *
+ * @param i2c_bus the bus
+ */
+static void i2c_bus_worker_stop(i2c_bus_t *i2c_bus)
+{
+    if (i2c_bus->worker == NULL)
+    {
+        return;
+    }
+
+    i2c_bus_request_t *stop = NULL; /*NULL request asks the worker to exit*/
+    xQueueSend(i2c_bus->req_queue, &stop, portMAX_DELAY);
+    xSemaphoreTake(i2c_bus->worker_exit, portMAX_DELAY);
+    i2c_bus_worker_queue_delete(i2c_bus, i2c_bus->req_queue);
+    vSemaphoreDelete(i2c_bus->worker_exit);
+    i2c_bus->worker_exit = NULL;
+    i2c_bus->worker = NULL;
+    ESP_LOGI(TAG, "i2c%d worker stopped", i2c_bus->i2c_port);
+}
+
+/**
+ * @brief pin the worker task of a bus to a core, a running worker serves its queued requests and is restarted there
+ *
+ * @param i2c_bus the bus
+ * @param core_id core to run on, tskNO_AFFINITY for none
+ * @return esp_err_t ESP_OK or ESP_ERR_NO_MEM
+ */
+static esp_err_t i2c_bus_worker_pin(i2c_bus_t *i2c_bus, BaseType_t core_id)
+{
+    if (i2c_bus->worker != NULL && i2c_bus->worker_core == core_id)
+    {
+        return ESP_OK;
+    }
+
+    i2c_bus_worker_stop(i2c_bus);
+    i2c_bus->worker_core = core_id;
+    return i2c_bus_worker_start(i2c_bus);
+}
+
+/**
+ * @brief serve one asynchronous request and signal its completion
+ *
+ * @param req the request
+ */
+static void i2c_bus_worker_serve(i2c_bus_request_t *req)
+{
+#ifdef CONFIG_I2C_BUS_IRQ
+    i2c_bus_device_handle_t dev_handle = (req->type == I2C_BUS_REQ_TXN) ? req->txn->dev_handle : req->dev_handle;
+    i2c_bus_t *i2c_bus = ((i2c_bus_device_t *)dev_handle)->i2c_bus;
+#endif
+
+    switch (req->type)
+    {
+    case I2C_BUS_REQ_READ:
+        req->ret = i2c_bus_read_reg8(req->dev_handle, req->mem_address, req->data_len, req->data, 0);
+        break;
+    case I2C_BUS_REQ_WRITE:
+        req->ret = i2c_bus_write_reg8(req->dev_handle, req->mem_address, req->data_len, req->data, 0);
+        break;
+    case I2C_BUS_REQ_TXN:
+        req->ret = i2c_bus_txn_commit(req->txn);
+        break;
+    case I2C_BUS_REQ_READ_RAW:
+        req->ret = i2c_bus_read_raw(req->dev_handle, req->mem_address, req->data_len, req->data);
+        break;
+    default:
+        req->ret = ESP_ERR_INVALID_ARG;
+        break;
+    }
+
+    /*request may be released by its owner once completion is signaled*/
+    SemaphoreHandle_t done = (SemaphoreHandle_t)req->done;
+    TaskHandle_t notify_task = (TaskHandle_t)req->notify_task;
+
+    if (req->callback != NULL)
+    {
+        req->callback(req, req->user_ctx);
+    }
+
+    if (notify_task != NULL)
+    {
+        xTaskNotifyGive(notify_task);
+    }
+
+    if (done != NULL)
+    {
+        xSemaphoreGive(done);
+    }
+
+#ifdef CONFIG_I2C_BUS_IRQ
+    i2c_bus_irq_rearm(i2c_bus, req);
+#endif
+}
+
+#ifdef CONFIG_I2C_BUS_ASYNC_CLK_GROUPING
+/**
+ * @brief clock speed a request will be sent with
+ *
+ * @param req the request
+ * @return uint32_t SCL frequency
+ */
+static uint32_t i2c_bus_req_clk_speed(const i2c_bus_request_t *req)
+{
+    i2c_bus_device_handle_t dev_handle = (req->type == I2C_BUS_REQ_TXN) ? req->txn->dev_handle : req->dev_handle;
+    return ((i2c_bus_device_t *)dev_handle)->conf.master.clk_speed;
+}
+
+/**
+ * @brief check if a request was queued by an interrupt line
+ *
+ * @param i2c_bus the bus
+ * @param req the request
+ * @return true the request is the bound request of a device and was queued by its interrupt
+ */
+static bool i2c_bus_req_is_irq(i2c_bus_t *i2c_bus, const i2c_bus_request_t *req)
+{
+    bool irq = false;
+#ifdef CONFIG_I2C_BUS_IRQ
+    portENTER_CRITICAL(&i2c_bus->irq_spinlock);
+
+    for (i2c_bus_device_t *i2c_device = i2c_bus->irq_devices; i2c_device != NULL; i2c_device = i2c_device->irq_next)
+    {
+        irq = irq || (i2c_device->irq_req == req && i2c_device->irq_queued);
+    }
+
+    portEXIT_CRITICAL(&i2c_bus->irq_spinlock);
+#endif
+    return irq;
+}
+#endif
+
+/**
+ * @brief worker task, serves asynchronous requests of one bus in queue order.
+ *        With CONFIG_I2C_BUS_ASYNC_CLK_GROUPING, all pending requests are taken at once and served grouped by
+ *        clock speed, requests at the active clock first, so the bus clock is switched once per group.
+ *        Requests of one device always keep their order. Interrupt requests are never held back for a group,
+ *        they are served at once, also when queued while a batch is served.
+ *
+ * @param arg the bus
+ */
+static void i2c_bus_worker_task(void *arg)
+{
+    i2c_bus_t *i2c_bus = (i2c_bus_t *)arg;
+    i2c_bus_request_t *req = NULL;
+#ifdef CONFIG_I2C_BUS_ASYNC_CLK_GROUPING
+    i2c_bus_request_t *batch[CONFIG_I2C_BUS_ASYNC_QUEUE_LEN];
+    bool stop = false;
+
+    while (!stop && xQueueReceive(i2c_bus->req_queue, &req, portMAX_DELAY) == pdTRUE && req != NULL)
+    {
+        size_t num = 0;
+        batch[num++] = req;
+
+        while (num < CONFIG_I2C_BUS_ASYNC_QUEUE_LEN && xQueueReceive(i2c_bus->req_queue, &req, 0) == pdTRUE)
+        {
+            if (req == NULL)
+            {
+                stop = true; /*serve what is taken, then exit*/
+                break;
+            }
+
+            batch[num++] = req;
+        }
+
+        uint32_t clk_speed = i2c_bus->conf_active.master.clk_speed;
+
+        while (num > 0)
+        {
+            size_t left = 0;
+
+            for (size_t i = 0; i < num; i++)
+            {
+                /*interrupt requests are queued to the front, the batch starts with them*/
+                if (i2c_bus_req_is_irq(i2c_bus, batch[i]) || i2c_bus_req_clk_speed(batch[i]) == clk_speed)
+                {
+                    i2c_bus_worker_serve(batch[i]);
+                }
+                else
+                {
+                    batch[left++] = batch[i];
+                }
+            }
+
+            num = left;
+#ifdef CONFIG_I2C_BUS_IRQ
+            /*an interrupt request queued meanwhile goes before the next group*/
+            while (num > 0 && xQueuePeek(i2c_bus->req_queue, &req, 0) == pdTRUE && req != NULL && i2c_bus_req_is_irq(i2c_bus, req) &&
+                    xQueueReceive(i2c_bus->req_queue, &req, 0) == pdTRUE)
+            {
+                i2c_bus_worker_serve(req);
+            }
+#endif
+
+            /*next group is the clock of the oldest request left*/
+            if (num > 0)
+            {
+                clk_speed = i2c_bus_req_clk_speed(batch[0]);
+            }
+        }
+    }
+#else
+    while (xQueueReceive(i2c_bus->req_queue, &req, portMAX_DELAY) == pdTRUE && req != NULL)
+    {
+        i2c_bus_worker_serve(req);
+    }
+#endif
+
+    xSemaphoreGive(i2c_bus->worker_exit);
+    vTaskDelete(NULL);
+}
+#endif
+
+#ifdef CONFIG_I2C_BUS_IRQ
+/**
+ * @brief interrupt line of a device asserted, mask it and queue the bound request ahead of the others
+ *
+ * @param arg the device
+ */
+static void i2c_bus_irq_isr(void *arg)
+{
+    i2c_bus_device_t *i2c_device = (i2c_bus_device_t *)arg;
+    i2c_bus_t *i2c_bus = i2c_device->i2c_bus;
+    i2c_bus_request_t *req = NULL;
+    QueueHandle_t req_queue = NULL;
+    BaseType_t task_woken = pdFALSE;
+    gpio_intr_disable(i2c_device->irq_gpio);
+    portENTER_CRITICAL_ISR(&i2c_bus->irq_spinlock);
+    i2c_device->irq_time_us = I2C_BUS_TIME_US();
+
+    if (i2c_device->irq_req != NULL && !i2c_device->irq_queued)
+    {
+        req = i2c_device->irq_req;
+        req->ret = ESP_ERR_INVALID_STATE;
+
+        if (i2c_bus->req_queue == NULL)
+        {
+            /*worker being restarted, the new one unmasks the line*/
+            i2c_device->irq_stalled = true;
+        }
+        else
+        {
+            /*claimed here, posted once the spinlock is released*/
+            i2c_device->irq_queued = true;
+            i2c_bus->irq_posting++;
+            req_queue = i2c_bus->req_queue;
+        }
+    }
+
+    portEXIT_CRITICAL_ISR(&i2c_bus->irq_spinlock);
+
+    if (req_queue != NULL)
+    {
+        BaseType_t sent = xQueueSendToFrontFromISR(req_queue, &req, &task_woken);
+        SemaphoreHandle_t unbind = NULL;
+        portENTER_CRITICAL_ISR(&i2c_bus->irq_spinlock);
+        i2c_bus->irq_posting--;
+
+        if (sent != pdTRUE)
+        {
+            /*line stays masked, it is unmasked when the worker completes a request and fires again*/
+            i2c_device->irq_queued = false;
+            i2c_device->irq_stalled = true;
+            i2c_device->irq_stats.overruns++;
+            unbind = i2c_device->irq_unbind;
+            i2c_device->irq_unbind = NULL;
+        }
+
+        portEXIT_CRITICAL_ISR(&i2c_bus->irq_spinlock);
+
+        if (unbind != NULL)
+        {
+            xSemaphoreGiveFromISR(unbind, &task_woken);
+        }
+    }
+
+    if (task_woken == pdTRUE)
+    {
+        portYIELD_FROM_ISR();
+    }
+}
+
+/**
+ * @brief unmask the interrupt lines of a bus once a request is completed, called from the worker task
+ *
+ * @param i2c_bus the bus
+ * @param req the completed request, NULL to only unmask stalled lines, e.g. when a worker is started
+ */
+static void i2c_bus_irq_rearm(i2c_bus_t *i2c_bus, const i2c_bus_request_t *req)
+{
+    int64_t now = I2C_BUS_TIME_US();
+    SemaphoreHandle_t unbind = NULL;
+    portENTER_CRITICAL(&i2c_bus->irq_spinlock);
+
+    for (i2c_bus_device_t *i2c_device = i2c_bus->irq_devices; i2c_device != NULL; i2c_device = i2c_device->irq_next)
+    {
+        bool served = (i2c_device->irq_req == req && i2c_device->irq_queued);
+
+        if (served)
+        {
+            uint32_t latency_us = (uint32_t)(now - i2c_device->irq_time_us);
+            i2c_bus_irq_stats_t *stats = &i2c_device->irq_stats;
+            stats->count++;
+            stats->total_latency_us += latency_us;
+            stats->max_latency_us = latency_us > stats->max_latency_us ? latency_us : stats->max_latency_us;
+            i2c_device->irq_queued = false;
+            unbind = i2c_device->irq_unbind != NULL ? i2c_device->irq_unbind : unbind;
+            i2c_device->irq_unbind = NULL;
+        }
+
+        if (served || i2c_device->irq_stalled)
+        {
+            i2c_device->irq_stalled = false;
+            gpio_intr_enable(i2c_device->irq_gpio);
+        }
+    }
+
+    portEXIT_CRITICAL(&i2c_bus->irq_spinlock);
+
+    /*i2c_bus_device_unbind_irq waits for the request to be served*/
+    if (unbind != NULL)
+    {
+        xSemaphoreGive(unbind);
+    }
+}
+#endif
+
+#ifdef CONFIG_I2C_BUS_SCHED
+/**
+ * @brief schedulability test of the job set under non-preemptive EDF, must be called with scheduler mutex taken.
+ *        Jobs are sorted by relative deadline D, for each job k the density sum C/D of the jobs up to k plus the
+ *        blocking B/D_k of the longest read C with a longer deadline must not exceed the utilisation limit.
+ *
+ * @param sched the scheduler
+ * @param util_permille pointer to save the utilisation sum C/T of the job set
+ * @return true every deadline is met
+ * @return false the job set is not schedulable
+ */
+static bool i2c_bus_sched_admit(const i2c_bus_sched_t *sched, uint16_t *util_permille)
+{
+    uint64_t limit_ppm = (uint64_t)sched->util_limit_permille * 1000;
+    uint64_t util_ppm = 0;
+    uint64_t density_ppm = 0;
+    bool schedulable = true;
+
+    for (const i2c_bus_sched_job_t *job = sched->jobs; job != NULL; job = job->next)
+    {
+        util_ppm += ((uint64_t)job->cost_us * 1000000 + job->period_us - 1) / job->period_us;
+        density_ppm += ((uint64_t)job->cost_us * 1000000 + job->deadline_us - 1) / job->deadline_us;
+        uint32_t blocking_us = 0;
+
+        /*a read in progress is never preempted, the longest read with a later deadline delays this one*/
+        for (const i2c_bus_sched_job_t *later = job->next; later != NULL; later = later->next)
+        {
+            if (later->deadline_us > job->deadline_us && later->cost_us > blocking_us)
+            {
+                blocking_us = later->cost_us;
+            }
+        }
+
+        if (density_ppm + ((uint64_t)blocking_us * 1000000 + job->deadline_us - 1) / job->deadline_us > limit_ppm)
+        {
+            schedulable = false;
+        }
+    }
+
+    *util_permille = util_ppm >= 1000000 ? 1000 : (util_ppm + 999) / 1000;
+    return schedulable;
+}
+
+/**
+ * @brief read the registers of a released job, release its next read and hand the registers to its callback.
+ *        Must be called with serve lock taken and scheduler mutex not taken, the mutex is only taken for
+ *        the counters and the release, so jobs can be added and counters read while the bus is busy.
+ *
+ * @param sched the scheduler
+ * @param job the job
+ */
+static void i2c_bus_sched_job_serve(i2c_bus_sched_t *sched, i2c_bus_sched_job_t *job)
+{
+    esp_err_t ret = i2c_bus_read_reg8(job->i2c_device, job->mem_address, job->data_len, job->data, 0);
+    int64_t done_us = I2C_BUS_TIME_US();
+    xSemaphoreTake(sched->mutex, portMAX_DELAY);
+    int64_t release_us = job->release_us;
+    uint32_t latency_us = (uint32_t)(done_us - release_us);
+    sched->stats.reads++;
+    sched->stats.errors += (ret != ESP_OK);
+    sched->stats.misses += (latency_us > job->deadline_us);
+    sched->stats.total_latency_us += latency_us;
+
+    if (latency_us < sched->stats.min_latency_us)
+    {
+        sched->stats.min_latency_us = latency_us;
+    }
+
+    if (latency_us > sched->stats.max_latency_us)
+    {
+        sched->stats.max_latency_us = latency_us;
+    }
+
+    release_us += job->period_us;
+
+    /*a late job is not caught up with a burst of reads, releases already past their deadline are dropped*/
+    while (release_us + job->deadline_us < done_us)
+    {
+        release_us += job->period_us;
+        sched->stats.skipped++;
+    }
+
+    job->release_us = release_us;
+    xSemaphoreGive(sched->mutex);
+    job->callback(job->data, job->data_len, done_us, ret, job->user_ctx);
+}
+
+/**
+ * @brief sleep until the next release or until notified of a job change or of a stop
+ *
+ * @param sched the scheduler
+ * @param wake_us time of the next release, INT64_MAX if there is no job
+ */
+static void i2c_bus_sched_wait(i2c_bus_sched_t *sched, int64_t wake_us)
+{
+    if (wake_us == INT64_MAX)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        return;
+    }
+
+    int64_t wait_us = wake_us - I2C_BUS_TIME_US();
+
+    if (wait_us <= 0)
+    {
+        return;
+    }
+
+#ifdef CONFIG_IDF_TARGET_LINUX
+    /*whole ticks are slept, the rest advances the simulated clock*/
+    TickType_t ticks = wait_us / (portTICK_RATE_MS * 1000);
+
+    if (ticks > 0 && ulTaskNotifyTake(pdTRUE, ticks) > 0)
+    {
+        return;
+    }
+
+    wait_us = wake_us - I2C_BUS_TIME_US();
+
+    if (wait_us > 0)
+    {
+        I2C_BUS_DELAY_US((uint32_t)wait_us);
+    }
+#else
+    /*a tick is too coarse for the timestamp jitter, esp_timer wakes the task at the release time*/
+    esp_timer_start_once(sched->timer, (uint64_t)wait_us);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    esp_timer_stop(sched->timer);
+#endif
+}
+
+#ifndef CONFIG_IDF_TARGET_LINUX
+/**
+ * @brief release time reached, wake the scheduler task
+ *
+ * @param arg the scheduler
+ */
+static void i2c_bus_sched_timer_cb(void *arg)
+{
+    xTaskNotifyGive(((i2c_bus_sched_t *)arg)->task);
+}
+#endif
+
+/**
+ * @brief scheduler task, serves released jobs earliest absolute deadline first, one read at a time
+ *
+ * @param arg the scheduler
+ */
+static void i2c_bus_sched_task(void *arg)
+{
+    i2c_bus_sched_t *sched = (i2c_bus_sched_t *)arg;
+
+    while (sched->running)
+    {
+        xSemaphoreTake(sched->serve_lock, portMAX_DELAY);
+        xSemaphoreTake(sched->mutex, portMAX_DELAY);
+        int64_t now_us = I2C_BUS_TIME_US();
+        int64_t wake_us = INT64_MAX;
+        i2c_bus_sched_job_t *next = NULL;
+
+        for (i2c_bus_sched_job_t *job = sched->jobs; job != NULL; job = job->next)
+        {
+            if (job->release_us > now_us)
+            {
+                wake_us = job->release_us < wake_us ? job->release_us : wake_us;
+            }
+            else if (next == NULL || job->release_us + job->deadline_us < next->release_us + next->deadline_us)
+            {
+                next = job;
+            }
+        }
+
+        xSemaphoreGive(sched->mutex);
+
+        if (next != NULL)
+        {
+            i2c_bus_sched_job_serve(sched, next);
+        }
+
+        xSemaphoreGive(sched->serve_lock);
+
+        if (next == NULL)
+        {
+            i2c_bus_sched_wait(sched, wake_us);
+        }
+    }
+
+    xSemaphoreGive(sched->task_exit);
+    vTaskDelete(NULL);
+}
+#endif
+
+/**
+ * @brief take the bus for a device and start the time budget of the call, the bus wait is added to the
+ *        statistics of the device priority class
+ *
+ * @param i2c_device the device
+ * @param timeout_ms budget of the call, bus wait and transfers included, 0 for the device default
+ * @return esp_err_t ESP_OK, ESP_ERR_TIMEOUT if the bus was not free within the budget
+ */
+static esp_err_t i2c_bus_device_lock_take(i2c_bus_device_t *i2c_device, uint32_t timeout_ms)
+{
+    i2c_bus_t *i2c_bus = i2c_device->i2c_bus;
+    TickType_t ticks_to_wait = timeout_ms != 0 ? I2C_BUS_MS_TO_TICKS(timeout_ms) : i2c_device->ticks_to_wait;
+    TickType_t start = xTaskGetTickCount();
+    int64_t wait_start = I2C_BUS_TIME_US();
+    esp_err_t ret = i2c_bus_lock_take(i2c_bus, i2c_device->priority, ticks_to_wait);
+
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    i2c_bus->budget_start = start;
+    i2c_bus->budget_ticks = ticks_to_wait;
+    /*the bus is owned now, statistics need no extra lock*/
+    uint32_t wait_us = (uint32_t)(I2C_BUS_TIME_US() - wait_start);
+#ifdef CONFIG_I2C_BUS_STATS
+    i2c_bus->stats.lock_wait_us += wait_us;
+    i2c_bus->lock_wait_us = wait_us;
+#endif
+    i2c_bus_prio_stats_t *stats = &i2c_bus->prio_stats[i2c_device->priority];
+    stats->count++;
+    stats->total_wait_us += wait_us;
+
+    if (wait_us > stats->max_wait_us)
+    {
+        stats->max_wait_us = wait_us;
+    }
+
+    return ESP_OK;
+}
+
+/**
+ * @brief time left in the budget of the bus owner, must be called with bus mutex taken
+ *
+ * @param i2c_bus the bus
+ * @return TickType_t ticks left, 0 if the budget is used
+ */
+inline static TickType_t i2c_bus_budget_left(const i2c_bus_t *i2c_bus)
+{
+    TickType_t elapsed = xTaskGetTickCount() - i2c_bus->budget_start;
+    return elapsed < i2c_bus->budget_ticks ? i2c_bus->budget_ticks - elapsed : 0;
+}
+
+#ifdef CONFIG_I2C_BUS_PRIORITY_ARBITRATION
+/**
+ * @brief raise the bus owner to owner_priority, called by the task which set owner_boosting.
+ *        Other waiters may raise the target or the bus may be handed over meanwhile, the owner is raised
+ *        again until it matches.
+ *
+ * @param i2c_bus the bus
+ */
+static void i2c_bus_owner_boost(i2c_bus_t *i2c_bus)
+{
+    TaskHandle_t task = NULL;
+    UBaseType_t applied = 0;
+    portENTER_CRITICAL(&i2c_bus->lock_spinlock);
+
+    while (i2c_bus->owner != NULL && (i2c_bus->owner != task || i2c_bus->owner_priority != applied))
+    {
+        task = i2c_bus->owner;
+        applied = i2c_bus->owner_priority;
+        portEXIT_CRITICAL(&i2c_bus->lock_spinlock);
+        vTaskPrioritySet(task, applied);
+        portENTER_CRITICAL(&i2c_bus->lock_spinlock);
+    }
+
+    i2c_bus_waiter_t *waiters = i2c_bus->boost_waiters;
+    i2c_bus->owner_boosting = false;
+    i2c_bus->boost_waiters = NULL;
+    portEXIT_CRITICAL(&i2c_bus->lock_spinlock);
+
+    while (waiters != NULL)
+    {
+        /*a waiter returns as soon as its semaphore is given, next is read before*/
+        i2c_bus_waiter_t *next = waiters->next;
+        xSemaphoreGive(waiters->sem);
+        waiters = next;
+    }
+}
+#endif
+
+/**
+ * @brief take the bus for a transfer. With priority arbitration enabled the bus is handed over to the waiter with
+ *        the highest priority class on release, a waiter is raised one class every CONFIG_I2C_BUS_PRIORITY_AGING_MS
+ *        to avoid starvation, waiters of the same class are served in arrival order.
+ *        As with a mutex, the owner task inherits the task priority of its highest priority waiter until release.
+ *        The new owner starts with the default 200 ms time budget.
+ *
+ * @param i2c_bus the bus
+ * @param priority priority class of the caller
+ * @param ticks_to_wait max ticks to wait
+ * @return esp_err_t ESP_OK or ESP_ERR_TIMEOUT
+ */
+static esp_err_t i2c_bus_lock_take(i2c_bus_t *i2c_bus, i2c_bus_priority_t priority, TickType_t ticks_to_wait)
+{
+#ifdef CONFIG_I2C_BUS_PRIORITY_ARBITRATION
+    bool acquired = false;
+    bool boost = false;
+    i2c_bus_waiter_t waiter = {
+        .task = xTaskGetCurrentTaskHandle(),
+        .task_priority = uxTaskPriorityGet(NULL),
+        .priority = priority,
+        .since = xTaskGetTickCount(),
+    };
+
+    portENTER_CRITICAL(&i2c_bus->lock_spinlock);
+
+    if (!i2c_bus->locked)
+    {
+        i2c_bus->locked = true;
+        i2c_bus->owner = waiter.task;
+        i2c_bus->owner_base = waiter.task_priority;
+        i2c_bus->owner_priority = waiter.task_priority;
+        acquired = true;
+    }
+
+    portEXIT_CRITICAL(&i2c_bus->lock_spinlock);
+
+    if (!acquired)
+    {
+        waiter.sem = xSemaphoreCreateBinaryStatic(&waiter.sem_buf);
+        portENTER_CRITICAL(&i2c_bus->lock_spinlock);
+
+        /*the bus may have been released while the semaphore was created*/
+        if (!i2c_bus->locked)
+        {
+            i2c_bus->locked = true;
+            i2c_bus->owner = waiter.task;
+            i2c_bus->owner_base = waiter.task_priority;
+            i2c_bus->owner_priority = waiter.task_priority;
+            acquired = true;
+        }
+        else
+        {
+            i2c_bus_waiter_t **tail = &i2c_bus->waiters;
+
+            while (*tail != NULL)
+            {
+                tail = &(*tail)->next;
+            }
+
+            *tail = &waiter;
+
+            /*a waiter leaving on timeout does not lower the owner again, the owner is restored on release*/
+            if (waiter.task_priority > i2c_bus->owner_priority)
+            {
+                i2c_bus->owner_priority = waiter.task_priority;
+                boost = !i2c_bus->owner_boosting;
+                i2c_bus->owner_boosting = true;
+            }
+        }
+
+        portEXIT_CRITICAL(&i2c_bus->lock_spinlock);
+
+        if (boost)
+        {
+            i2c_bus_owner_boost(i2c_bus);
+        }
+
+        if (!acquired)
+        {
+            acquired = (xSemaphoreTake(waiter.sem, ticks_to_wait) == pdTRUE);
+        }
+
+        if (!acquired)
+        {
+            bool granted;
+            portENTER_CRITICAL(&i2c_bus->lock_spinlock);
+            granted = waiter.granted;
+
+            if (!granted)
+            {
+                i2c_bus_waiter_t **node = &i2c_bus->waiters;
+
+                while (*node != NULL && *node != &waiter)
+                {
+                    node = &(*node)->next;
+                }
+
+                if (*node != NULL)
+                {
+                    *node = waiter.next;
+                }
+            }
+
+            portEXIT_CRITICAL(&i2c_bus->lock_spinlock);
+
+            /*handed over right at timeout, wait for the in-flight give before the semaphore is released*/
+            if (granted)
+            {
+                xSemaphoreTake(waiter.sem, portMAX_DELAY);
+                acquired = true;
+            }
+        }
+
+        vSemaphoreDelete(waiter.sem);
+    }
+
+    esp_err_t ret = acquired ? ESP_OK : ESP_ERR_TIMEOUT;
+#else
+    esp_err_t ret = xSemaphoreTake(i2c_bus->mutex, ticks_to_wait) == pdTRUE ? ESP_OK : ESP_ERR_TIMEOUT;
+#endif
+
+    if (ret == ESP_OK)
+    {
+        /*a new owner never inherits the budget of the previous one, device calls set their own after this*/
+        i2c_bus->budget_start = xTaskGetTickCount();
+        i2c_bus->budget_ticks = I2C_BUS_TICKS_TO_WAIT;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief release the bus, it is handed over to the best waiter if any and the owner task priority is restored
+ *
+ * @param i2c_bus the bus
+ * @return esp_err_t ESP_OK or ESP_FAIL
+ */
+static esp_err_t i2c_bus_lock_give(i2c_bus_t *i2c_bus)
+{
+#ifdef CONFIG_I2C_BUS_PRIORITY_ARBITRATION
+    TickType_t now = xTaskGetTickCount();
+    i2c_bus_waiter_t *next = NULL;
+    bool boost = false;
+    portENTER_CRITICAL(&i2c_bus->lock_spinlock);
+    i2c_bus_waiter_t **best = NULL;
+    uint32_t best_level = 0;
+    UBaseType_t waiter_priority = 0;
+    UBaseType_t base = i2c_bus->owner_base;
+    bool restore = i2c_bus->owner_priority != base;
+
+    for (i2c_bus_waiter_t **node = &i2c_bus->waiters; *node != NULL; node = &(*node)->next)
+    {
+        uint32_t level = (*node)->priority + (now - (*node)->since) / I2C_BUS_PRIO_AGING_TICKS;
+
+        if (best == NULL || level > best_level)
+        {
+            best = node;
+            best_level = level;
+        }
+    }
+
+    if (best != NULL)
+    {
+        next = *best;
+        *best = next->next;
+        next->granted = true;
+
+        /*the new owner inherits the task priority of the waiters left*/
+        for (i2c_bus_waiter_t *node = i2c_bus->waiters; node != NULL; node = node->next)
+        {
+            waiter_priority = node->task_priority > waiter_priority ? node->task_priority : waiter_priority;
+        }
+
+        i2c_bus->owner = next->task;
+        i2c_bus->owner_base = next->task_priority;
+        i2c_bus->owner_priority = waiter_priority > next->task_priority ? waiter_priority : next->task_priority;
+
+        if (i2c_bus->owner_priority != i2c_bus->owner_base)
+        {
+            boost = !i2c_bus->owner_boosting;
+            i2c_bus->owner_boosting = true;
+        }
+    }
+    else
+    {
+        i2c_bus->locked = false;
+        i2c_bus->owner = NULL;
+    }
+
+    portEXIT_CRITICAL(&i2c_bus->lock_spinlock);
+
+    if (next != NULL)
+    {
+        xSemaphoreGive(next->sem);
+    }
+
+    if (boost)
+    {
+        i2c_bus_owner_boost(i2c_bus);
+    }
+
+    if (restore)
+    {
+        i2c_bus_waiter_t waiter = {0};
+        bool boosting = false;
+        waiter.sem = xSemaphoreCreateBinaryStatic(&waiter.sem_buf);
+        portENTER_CRITICAL(&i2c_bus->lock_spinlock);
+
+        /*a waiter may still be raising this task, it is restored after the booster is done*/
+        if (i2c_bus->owner_boosting)
+        {
+            waiter.next = i2c_bus->boost_waiters;
+            i2c_bus->boost_waiters = &waiter;
+            boosting = true;
+        }
+
+        portEXIT_CRITICAL(&i2c_bus->lock_spinlock);
+
+        if (boosting)
+        {
+            xSemaphoreTake(waiter.sem, portMAX_DELAY);
+        }
+
+        vSemaphoreDelete(waiter.sem);
+        vTaskPrioritySet(NULL, base);
+    }
+
+    return ESP_OK;
+#else
+    return xSemaphoreGive(i2c_bus->mutex) ? ESP_OK : ESP_FAIL;
+#endif
+}
+
+#ifdef CONFIG_I2C_BUS_STATS
+/**
+ * @brief add one transfer to performance counters, must be called with bus mutex taken
+ *
+ * @param stats counters to update
+ * @param ret result of the transfer
+ * @param xfer_us on-wire duration of the transfer
+ * @param rx_len data bytes read
+ * @param tx_len data bytes written
+ */
+static void i2c_bus_stats_record(i2c_bus_stats_t *stats, esp_err_t ret, uint32_t xfer_us, size_t rx_len, size_t tx_len)
+{
+    stats->transactions++;
+    stats->xfer_us += xfer_us;
+
+    if (ret == ESP_OK)
+    {
+        stats->bytes_read += rx_len;
+        stats->bytes_written += tx_len;
+    }
+    else if (ret == ESP_FAIL)
+    {
+        /*the driver reports a missing ACK as ESP_FAIL*/
+        stats->nacks++;
+    }
+    else if (ret == ESP_ERR_TIMEOUT)
+    {
+        stats->timeouts++;
+    }
+    else
+    {
+        stats->errors++;
+    }
+
+    /*bin n holds latencies in [2^(n-1), 2^n) us, the last bin holds all longer ones*/
+    uint32_t bin = (xfer_us == 0) ? 0 : 32 - __builtin_clz(xfer_us);
+    stats->latency_hist[bin < I2C_BUS_STATS_HIST_BINS ? bin : I2C_BUS_STATS_HIST_BINS - 1]++;
+}
+#endif
@@ -0,0 +1,150 @@
+// Copyright 2020-2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdlib.h>
+
+#include "sdkconfig.h"
+#include "esp_log.h"
+#ifdef CONFIG_IDF_TARGET_LINUX
+#include "i2c_bus_sim.h"
+#else
+#include "i2c_bus_master.h"
+#endif
+
+#define I2C_BUS_CMD_LINK_GROW 16 /*commands added when a heap link is full*/
+
+static const char *TAG = "i2c_bus_cmd_link";
+
+#define I2C_BUS_CMD_CHECK(a, str, ret)                                         \
+    if (!(a))                                                                  \
+    {                                                                          \
+        ESP_LOGE(TAG, "%s:%d (%s):%s", __FILE__, __LINE__, __FUNCTION__, str); \
+        return (ret);                                                          \
+    }
+
+static esp_err_t i2c_bus_cmd_add(i2c_cmd_handle_t cmd_handle, const i2c_bus_cmd_t *cmd);
+
+/**************************************** Legacy driver subset *********************************************/
+
+i2c_cmd_handle_t i2c_cmd_link_create(void)
+{
+    i2c_bus_cmd_link_t *link = calloc(1, sizeof(i2c_bus_cmd_link_t));
+    return (i2c_cmd_handle_t)link;
+}
+
+i2c_cmd_handle_t i2c_cmd_link_create_static(uint8_t *buffer, uint32_t size)
+{
+    /*the user buffer may be unaligned, the link is placed at the next pointer boundary*/
+    uintptr_t aligned = ((uintptr_t)buffer + sizeof(void *) - 1) & ~(uintptr_t)(sizeof(void *) - 1);
+    size_t offset = aligned - (uintptr_t)buffer;
+    I2C_BUS_CMD_CHECK(buffer != NULL && size >= offset + sizeof(i2c_bus_cmd_link_t), "static buffer too small", NULL);
+    i2c_bus_cmd_link_t *link = (i2c_bus_cmd_link_t *)aligned;
+    link->cmds = (i2c_bus_cmd_t *)(link + 1);
+    link->num = 0;
+    link->max = (size - offset - sizeof(i2c_bus_cmd_link_t)) / sizeof(i2c_bus_cmd_t);
+    link->is_static = true;
+    return (i2c_cmd_handle_t)link;
+}
+
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd_handle)
+{
+    i2c_bus_cmd_link_t *link = (i2c_bus_cmd_link_t *)cmd_handle;
+
+    if (link == NULL || link->is_static)
+    {
+        return;
+    }
+
+    free(link->cmds);
+    free(link);
+}
+
+void i2c_cmd_link_delete_static(i2c_cmd_handle_t cmd_handle)
+{
+    /*nothing allocated, the link lives in the user buffer*/
+}
+
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd_handle)
+{
+    i2c_bus_cmd_t cmd = {.type = I2C_BUS_CMD_TYPE_START};
+    return i2c_bus_cmd_add(cmd_handle, &cmd);
+}
+
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd_handle, uint8_t data, bool ack_en)
+{
+    i2c_bus_cmd_t cmd = {.type = I2C_BUS_CMD_TYPE_WRITE, .ack = ack_en, .byte = data, .data = NULL, .data_len = 1};
+    return i2c_bus_cmd_add(cmd_handle, &cmd);
+}
+
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd_handle, const uint8_t *data, size_t data_len, bool ack_en)
+{
+    I2C_BUS_CMD_CHECK(data != NULL, "i2c data address error", ESP_ERR_INVALID_ARG);
+    i2c_bus_cmd_t cmd = {.type = I2C_BUS_CMD_TYPE_WRITE, .ack = ack_en, .data = (uint8_t *)data, .data_len = data_len};
+    return i2c_bus_cmd_add(cmd_handle, &cmd);
+}
+
+esp_err_t i2c_master_read_byte(i2c_cmd_handle_t cmd_handle, uint8_t *data, i2c_ack_type_t ack)
+{
+    return i2c_master_read(cmd_handle, data, 1, ack == I2C_MASTER_LAST_NACK ? I2C_MASTER_NACK : ack);
+}
+
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd_handle, uint8_t *data, size_t data_len, i2c_ack_type_t ack)
+{
+    I2C_BUS_CMD_CHECK(data != NULL, "i2c data address error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CMD_CHECK(ack < I2C_MASTER_ACK_MAX, "i2c ack type error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_CMD_CHECK(data_len > 0, "i2c data read length error", ESP_ERR_INVALID_ARG);
+    i2c_bus_cmd_t cmd = {.type = I2C_BUS_CMD_TYPE_READ, .ack = ack, .data = data, .data_len = data_len};
+    return i2c_bus_cmd_add(cmd_handle, &cmd);
+}
+
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd_handle)
+{
+    i2c_bus_cmd_t cmd = {.type = I2C_BUS_CMD_TYPE_STOP};
+    return i2c_bus_cmd_add(cmd_handle, &cmd);
+}
+
+/**************************************** Private Functions*********************************************/
+
+/**
+ * @brief append a command to a link, heap links grow on demand
+ *
+ * @param cmd_handle the link
+ * @param cmd command to append
+ * @return esp_err_t ESP_OK or ESP_ERR_NO_MEM
+ */
+static esp_err_t i2c_bus_cmd_add(i2c_cmd_handle_t cmd_handle, const i2c_bus_cmd_t *cmd)
+{
+    I2C_BUS_CMD_CHECK(cmd_handle != NULL, "i2c command link error", ESP_ERR_INVALID_ARG);
+    i2c_bus_cmd_link_t *link = (i2c_bus_cmd_link_t *)cmd_handle;
+
+    if (link->num == link->max)
+    {
+        if (link->is_static)
+        {
+            return ESP_ERR_NO_MEM;
+        }
+
+        i2c_bus_cmd_t *cmds = realloc(link->cmds, (link->max + I2C_BUS_CMD_LINK_GROW) * sizeof(i2c_bus_cmd_t));
+
+        if (cmds == NULL)
+        {
+            return ESP_ERR_NO_MEM;
+        }
+
+        link->cmds = cmds;
+        link->max += I2C_BUS_CMD_LINK_GROW;
+    }
+
+    link->cmds[link->num++] = *cmd;
+    return ESP_OK;
+}
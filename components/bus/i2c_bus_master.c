@@ -0,0 +1,564 @@
+// Copyright 2020-2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_idf_version.h"
+#include "sdkconfig.h"
+#include "i2c_bus_master.h"
+
+#if ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 2, 0)
+#error "I2C_BUS_BACKEND_I2C_MASTER requires ESP-IDF v5.2 or later, select the legacy driver backend"
+#endif
+
+#define I2C_BUS_MASTER_DEV_CACHE 8       /*device handles kept per bus, one per address, clock speed and ack check*/
+#define I2C_BUS_MASTER_GLITCH_IGNORE 7   /*glitch filter of the i2c_master bus, in source clock cycles*/
+#define I2C_BUS_MASTER_DRAIN_MS 50       /*time queued transfers are given to end after a timeout*/
+#ifdef CONFIG_I2C_BUS_I2C_MASTER_QUEUE_DEPTH
+#define I2C_BUS_MASTER_QUEUE_DEPTH CONFIG_I2C_BUS_I2C_MASTER_QUEUE_DEPTH
+#else
+#define I2C_BUS_MASTER_QUEUE_DEPTH 0
+#endif
+
+typedef struct
+{
+    i2c_master_dev_handle_t handle; /*device handle on the bus, NULL if the slot is free*/
+    uint16_t dev_addr;              /*7-bit device address*/
+    bool ack_check;                 /*written bytes must be acknowledged*/
+    uint32_t clk_speed;             /*SCL frequency of the handle*/
+    uint32_t last_link;             /*link the handle was last used by, the least recently used slot is replaced*/
+} i2c_bus_master_dev_t;
+
+typedef struct
+{
+    i2c_port_t port;                                     /*port number of the bus*/
+    bool is_init;                                        /*driver installed*/
+    i2c_config_t conf;                                   /*set with i2c_param_config, clock speed applies to next links*/
+    i2c_master_bus_handle_t bus;                         /*i2c_master bus, NULL if not installed*/
+    i2c_bus_master_dev_t devs[I2C_BUS_MASTER_DEV_CACHE]; /*cached device handles*/
+    uint32_t links;                                      /*links sent, ages the device slots*/
+    uint8_t *buf;                                        /*written bytes of a link gathered per segment*/
+    size_t buf_len;                                      /*capacity of buf, grows to the largest link and is kept*/
+#if I2C_BUS_MASTER_QUEUE_DEPTH > 0
+    SemaphoreHandle_t done;                              /*given by the ISR done callback of each queued transfer*/
+    StaticSemaphore_t done_buf;                          /*storage of done*/
+    volatile bool nacked;                                /*a queued transfer of the link was not acknowledged*/
+    volatile bool timed_out;                             /*a queued transfer of the link did not complete*/
+    uint32_t pending;                                    /*queued transfers of the link not done yet*/
+#endif
+} i2c_bus_master_t;
+
+/**
+ * @brief START..START/STOP part of a command link, sent as one i2c_master transfer
+ */
+typedef struct
+{
+    uint16_t dev_addr; /*7-bit device address*/
+    bool read;         /*addressed for read*/
+    bool ack_check;    /*every write of the segment checks ack*/
+    size_t first;      /*index of the address command*/
+    size_t end;        /*index of the START or STOP ending the segment, number of commands if none*/
+    size_t len;        /*data bytes written or read, address excluded*/
+} i2c_bus_master_seg_t;
+
+static const char *TAG = "i2c_bus_master";
+static i2c_bus_master_t s_i2c_bus_master[I2C_NUM_MAX];
+
+#define I2C_BUS_MASTER_CHECK(a, str, ret)                                      \
+    if (!(a))                                                                  \
+    {                                                                          \
+        ESP_LOGE(TAG, "%s:%d (%s):%s", __FILE__, __LINE__, __FUNCTION__, str); \
+        return (ret);                                                          \
+    }
+
+static esp_err_t i2c_bus_master_seg_parse(const i2c_bus_cmd_link_t *link, size_t start, i2c_bus_master_seg_t *seg);
+static void i2c_bus_master_seg_gather(const i2c_bus_cmd_link_t *link, const i2c_bus_master_seg_t *seg, uint8_t *dst);
+static esp_err_t i2c_bus_master_dev_get(i2c_bus_master_t *i2c_master, uint16_t dev_addr, bool ack_check, TickType_t start_tick, TickType_t ticks_to_wait, i2c_master_dev_handle_t *ret_handle);
+static void i2c_bus_master_dev_clear(i2c_bus_master_t *i2c_master);
+static esp_err_t i2c_bus_master_wait(i2c_bus_master_t *i2c_master, TickType_t start_tick, TickType_t ticks_to_wait);
+static TickType_t i2c_bus_master_ticks_left(TickType_t start_tick, TickType_t ticks_to_wait);
+static esp_err_t i2c_bus_master_err(esp_err_t ret);
+
+/**************************************** Legacy driver subset *********************************************/
+
+esp_err_t i2c_param_config(i2c_port_t i2c_num, const i2c_config_t *i2c_conf)
+{
+    I2C_BUS_MASTER_CHECK(i2c_num < I2C_NUM_MAX, "i2c port error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_MASTER_CHECK(i2c_conf != NULL, "pointer = NULL error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_MASTER_CHECK(i2c_conf->mode == I2C_MODE_MASTER, "only master mode is supported", ESP_ERR_NOT_SUPPORTED);
+    s_i2c_bus_master[i2c_num].conf = *i2c_conf;
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_install(i2c_port_t i2c_num, i2c_mode_t mode, size_t slv_rx_buf_len, size_t slv_tx_buf_len, int intr_alloc_flags)
+{
+    I2C_BUS_MASTER_CHECK(i2c_num < I2C_NUM_MAX, "i2c port error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_MASTER_CHECK(mode == I2C_MODE_MASTER, "only master mode is supported", ESP_ERR_NOT_SUPPORTED);
+    i2c_bus_master_t *i2c_master = &s_i2c_bus_master[i2c_num];
+    I2C_BUS_MASTER_CHECK(!i2c_master->is_init, "i2c driver already installed", ESP_FAIL);
+    i2c_master_bus_config_t bus_conf = {
+        .i2c_port = i2c_num,
+        .sda_io_num = i2c_master->conf.sda_io_num,
+        .scl_io_num = i2c_master->conf.scl_io_num,
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .glitch_ignore_cnt = I2C_BUS_MASTER_GLITCH_IGNORE,
+        .trans_queue_depth = I2C_BUS_MASTER_QUEUE_DEPTH,
+        .flags.enable_internal_pullup = i2c_master->conf.sda_pullup_en || i2c_master->conf.scl_pullup_en,
+    };
+#if I2C_BUS_MASTER_QUEUE_DEPTH > 0
+
+    if (i2c_master->done == NULL)
+    {
+        i2c_master->done = xSemaphoreCreateCountingStatic(UINT16_MAX, 0, &i2c_master->done_buf);
+    }
+
+#endif
+    esp_err_t ret = i2c_new_master_bus(&bus_conf, &i2c_master->bus);
+    I2C_BUS_MASTER_CHECK(ret == ESP_OK, "i2c_master bus create failed", ret);
+    i2c_master->port = i2c_num;
+    i2c_master->is_init = true;
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_delete(i2c_port_t i2c_num)
+{
+    I2C_BUS_MASTER_CHECK(i2c_num < I2C_NUM_MAX, "i2c port error", ESP_ERR_INVALID_ARG);
+    i2c_bus_master_t *i2c_master = &s_i2c_bus_master[i2c_num];
+
+    if (!i2c_master->is_init)
+    {
+        return ESP_OK;
+    }
+
+    i2c_bus_master_dev_clear(i2c_master);
+    i2c_del_master_bus(i2c_master->bus);
+    i2c_master->bus = NULL;
+    free(i2c_master->buf);
+    i2c_master->buf = NULL;
+    i2c_master->buf_len = 0;
+    i2c_master->is_init = false;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_cmd_begin(i2c_port_t i2c_num, i2c_cmd_handle_t cmd_handle, TickType_t ticks_to_wait)
+{
+    I2C_BUS_MASTER_CHECK(i2c_num < I2C_NUM_MAX, "i2c port error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_MASTER_CHECK(cmd_handle != NULL, "i2c command link error", ESP_ERR_INVALID_ARG);
+    i2c_bus_cmd_link_t *link = (i2c_bus_cmd_link_t *)cmd_handle;
+    i2c_bus_master_t *i2c_master = &s_i2c_bus_master[i2c_num];
+    I2C_BUS_MASTER_CHECK(i2c_master->is_init, "i2c driver not installed", ESP_ERR_INVALID_STATE);
+    I2C_BUS_MASTER_CHECK(link->num > 0 && link->cmds[0].type == I2C_BUS_CMD_TYPE_START, "command link must begin with a start", ESP_ERR_INVALID_ARG);
+    TickType_t start_tick = xTaskGetTickCount();
+    i2c_bus_master_seg_t seg;
+    i2c_bus_master_seg_t next;
+    size_t tx_len = 0;
+    esp_err_t ret = ESP_OK;
+
+    /*written bytes of all segments are gathered first, queued transfers reference them until the link is done*/
+    for (size_t i = 0; i < link->num && link->cmds[i].type == I2C_BUS_CMD_TYPE_START; i = seg.end)
+    {
+        ret = i2c_bus_master_seg_parse(link, i, &seg);
+
+        if (ret != ESP_OK)
+        {
+            return ret;
+        }
+
+        tx_len += seg.read ? 0 : seg.len;
+    }
+
+    if (tx_len > i2c_master->buf_len)
+    {
+        uint8_t *buf = realloc(i2c_master->buf, tx_len);
+        I2C_BUS_MASTER_CHECK(buf != NULL, "i2c link buffer alloc failed", ESP_ERR_NO_MEM);
+        i2c_master->buf = buf;
+        i2c_master->buf_len = tx_len;
+    }
+
+    i2c_master->links++;
+#if I2C_BUS_MASTER_QUEUE_DEPTH > 0
+
+    /*done counts of transfers abandoned by a previous timeout*/
+    while (xSemaphoreTake(i2c_master->done, 0) == pdTRUE)
+    {
+    }
+
+    i2c_master->nacked = false;
+    i2c_master->timed_out = false;
+    i2c_master->pending = 0;
+#endif
+    uint8_t *tx = i2c_master->buf;
+
+    for (size_t i = 0; ret == ESP_OK && i < link->num && link->cmds[i].type == I2C_BUS_CMD_TYPE_START; i = seg.end)
+    {
+        i2c_bus_master_seg_parse(link, i, &seg);
+        TickType_t ticks_left = i2c_bus_master_ticks_left(start_tick, ticks_to_wait);
+        int timeout_ms = (ticks_to_wait == portMAX_DELAY) ? -1 : (int)(ticks_left * portTICK_PERIOD_MS);
+        bool joined = false;
+
+        if (ticks_left == 0)
+        {
+            ret = ESP_ERR_TIMEOUT;
+            break;
+        }
+
+        /*write followed by a read of the same device is one transmit-receive with a repeated start*/
+        if (!seg.read && seg.end < link->num && link->cmds[seg.end].type == I2C_BUS_CMD_TYPE_START)
+        {
+            i2c_bus_master_seg_parse(link, seg.end, &next);
+            joined = next.read && next.dev_addr == seg.dev_addr;
+        }
+
+        if (!seg.read && !joined && seg.len == 0)
+        {
+            /*address only, a probe. It is not queued, transfers queued before must be done*/
+            ret = i2c_bus_master_wait(i2c_master, start_tick, ticks_to_wait);
+            ret = (ret == ESP_OK) ? i2c_bus_master_err(i2c_master_probe(i2c_master->bus, seg.dev_addr, timeout_ms)) : ret;
+            continue;
+        }
+
+        i2c_master_dev_handle_t dev = NULL;
+        ret = i2c_bus_master_dev_get(i2c_master, seg.dev_addr, seg.ack_check && (!joined || next.ack_check), start_tick, ticks_to_wait, &dev);
+
+        if (ret != ESP_OK)
+        {
+            break;
+        }
+
+        if (!seg.read)
+        {
+            i2c_bus_master_seg_gather(link, &seg, tx);
+        }
+
+        if (joined)
+        {
+            ret = i2c_master_transmit_receive(dev, tx, seg.len, link->cmds[next.first + 1].data, next.len, timeout_ms);
+            tx += seg.len;
+            seg.end = next.end;
+        }
+        else if (seg.read)
+        {
+            ret = i2c_master_receive(dev, link->cmds[seg.first + 1].data, seg.len, timeout_ms);
+        }
+        else
+        {
+            ret = i2c_master_transmit(dev, tx, seg.len, timeout_ms);
+            tx += seg.len;
+        }
+
+        ret = i2c_bus_master_err(ret);
+#if I2C_BUS_MASTER_QUEUE_DEPTH > 0
+        i2c_master->pending += (ret == ESP_OK) ? 1 : 0;
+#endif
+    }
+
+    /*queued transfers reference the link and the gathered bytes, they must be done whatever the result*/
+    esp_err_t wait_ret = i2c_bus_master_wait(i2c_master, start_tick, ticks_to_wait);
+    return (ret == ESP_OK) ? wait_ret : ret;
+}
+
+/**************************************** Backend extensions *********************************************/
+
+esp_err_t i2c_bus_master_set_clk_speed(i2c_port_t port, uint32_t clk_speed)
+{
+    I2C_BUS_MASTER_CHECK(port < I2C_NUM_MAX, "i2c port error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_MASTER_CHECK(clk_speed > 0, "i2c clock speed error", ESP_ERR_INVALID_ARG);
+    I2C_BUS_MASTER_CHECK(s_i2c_bus_master[port].is_init, "i2c driver not installed", ESP_ERR_INVALID_STATE);
+    s_i2c_bus_master[port].conf.master.clk_speed = clk_speed;
+    return ESP_OK;
+}
+
+/**************************************** Private Functions*********************************************/
+
+/**
+ * @brief parse the segment of a link starting at a START command.
+ *        A write segment may hold any number of write commands, a read segment exactly one read command.
+ *
+ * @param link the link
+ * @param start index of the START command
+ * @param seg parsed segment
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_ARG if the address is missing,
+ *         ESP_ERR_NOT_SUPPORTED if the segment can not be sent as one i2c_master transfer
+ */
+static esp_err_t i2c_bus_master_seg_parse(const i2c_bus_cmd_link_t *link, size_t start, i2c_bus_master_seg_t *seg)
+{
+    size_t i = start + 1;
+    I2C_BUS_MASTER_CHECK(i < link->num && link->cmds[i].type == I2C_BUS_CMD_TYPE_WRITE && link->cmds[i].data_len > 0, "start is not followed by an address", ESP_ERR_INVALID_ARG);
+    const i2c_bus_cmd_t *cmd = &link->cmds[i];
+    uint8_t addr_byte = (cmd->data != NULL) ? cmd->data[0] : cmd->byte;
+    size_t tx_len = cmd->data_len - 1; /*bytes written after the address by the same command*/
+    size_t rx_len = 0;
+    size_t reads = 0;
+    seg->dev_addr = addr_byte >> 1;
+    seg->read = (addr_byte & 0x01) == I2C_MASTER_READ;
+    seg->ack_check = cmd->ack;
+    seg->first = i;
+
+    for (i++; i < link->num && link->cmds[i].type != I2C_BUS_CMD_TYPE_START && link->cmds[i].type != I2C_BUS_CMD_TYPE_STOP; i++)
+    {
+        cmd = &link->cmds[i];
+
+        if (cmd->type == I2C_BUS_CMD_TYPE_WRITE)
+        {
+            tx_len += cmd->data_len;
+            seg->ack_check = seg->ack_check && cmd->ack;
+        }
+        else
+        {
+            rx_len += cmd->data_len;
+            reads++;
+        }
+    }
+
+    seg->end = i;
+    seg->len = seg->read ? rx_len : tx_len;
+    I2C_BUS_MASTER_CHECK(seg->read ? (reads == 1 && tx_len == 0) : reads == 0, "segment must be writes only or one read", ESP_ERR_NOT_SUPPORTED);
+    return ESP_OK;
+}
+
+/**
+ * @brief copy the bytes written by a write segment, address excluded
+ *
+ * @param link the link
+ * @param seg a write segment
+ * @param dst destination, seg->len bytes
+ */
+static void i2c_bus_master_seg_gather(const i2c_bus_cmd_link_t *link, const i2c_bus_master_seg_t *seg, uint8_t *dst)
+{
+    for (size_t i = seg->first; i < seg->end; i++)
+    {
+        const i2c_bus_cmd_t *cmd = &link->cmds[i];
+        const uint8_t *src = (cmd->data != NULL) ? cmd->data : &cmd->byte;
+        size_t skip = (i == seg->first) ? 1 : 0;
+        memcpy(dst, src + skip, cmd->data_len - skip);
+        dst += cmd->data_len - skip;
+    }
+}
+
+#if I2C_BUS_MASTER_QUEUE_DEPTH > 0
+/**
+ * @brief i2c_master ISR callback of a queued transfer
+ *
+ * @param i2c_dev device the transfer was sent to
+ * @param evt_data result of the transfer
+ * @param arg the bus
+ * @return true a higher priority task was woken
+ */
+static bool IRAM_ATTR i2c_bus_master_on_trans_done(i2c_master_dev_handle_t i2c_dev, const i2c_master_event_data_t *evt_data, void *arg)
+{
+    i2c_bus_master_t *i2c_master = (i2c_bus_master_t *)arg;
+    BaseType_t task_woken = pdFALSE;
+
+    if (evt_data->event == I2C_EVENT_ALIVE)
+    {
+        return false;
+    }
+
+    if (evt_data->event == I2C_EVENT_NACK)
+    {
+        i2c_master->nacked = true;
+    }
+    else if (evt_data->event != I2C_EVENT_DONE)
+    {
+        /*I2C_EVENT_TIMEOUT (IDF v5.3 and later), the bus may be stuck and must reach recovery as a timeout*/
+        i2c_master->timed_out = true;
+    }
+
+    xSemaphoreGiveFromISR(i2c_master->done, &task_woken);
+    return task_woken == pdTRUE;
+}
+#endif
+
+/**
+ * @brief get the device handle of an address at the current clock speed, added to the bus if not cached.
+ *        When the cache is full the least recently used handle is removed.
+ *
+ * @param i2c_master the bus
+ * @param dev_addr 7-bit device address
+ * @param ack_check written bytes must be acknowledged
+ * @param start_tick tick the link was started
+ * @param ticks_to_wait time budget of the link
+ * @param ret_handle device handle
+ * @return esp_err_t ESP_OK or error of the i2c_master driver
+ */
+static esp_err_t i2c_bus_master_dev_get(i2c_bus_master_t *i2c_master, uint16_t dev_addr, bool ack_check, TickType_t start_tick, TickType_t ticks_to_wait, i2c_master_dev_handle_t *ret_handle)
+{
+    uint32_t clk_speed = i2c_master->conf.master.clk_speed;
+    i2c_bus_master_dev_t *slot = &i2c_master->devs[0];
+
+    for (int i = 0; i < I2C_BUS_MASTER_DEV_CACHE; i++)
+    {
+        i2c_bus_master_dev_t *dev = &i2c_master->devs[i];
+
+        if (dev->handle != NULL && dev->dev_addr == dev_addr && dev->ack_check == ack_check && dev->clk_speed == clk_speed)
+        {
+            dev->last_link = i2c_master->links;
+            *ret_handle = dev->handle;
+            return ESP_OK;
+        }
+
+        if (slot->handle != NULL && (dev->handle == NULL || dev->last_link < slot->last_link))
+        {
+            slot = dev;
+        }
+    }
+
+    esp_err_t ret = ESP_OK;
+
+    if (slot->handle != NULL)
+    {
+        /*queued transfers of this link may still use the handle*/
+        ret = i2c_bus_master_wait(i2c_master, start_tick, ticks_to_wait);
+
+        if (ret != ESP_OK)
+        {
+            return ret;
+        }
+
+        i2c_master_bus_rm_device(slot->handle);
+        slot->handle = NULL;
+    }
+
+    i2c_device_config_t dev_conf = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = dev_addr,
+        .scl_speed_hz = clk_speed,
+        .flags.disable_ack_check = !ack_check,
+    };
+    ret = i2c_master_bus_add_device(i2c_master->bus, &dev_conf, &slot->handle);
+    I2C_BUS_MASTER_CHECK(ret == ESP_OK, "i2c_master device add failed", ret);
+#if I2C_BUS_MASTER_QUEUE_DEPTH > 0
+    i2c_master_event_callbacks_t cbs = {
+        .on_trans_done = i2c_bus_master_on_trans_done,
+    };
+    ret = i2c_master_register_event_callbacks(slot->handle, &cbs, i2c_master);
+
+    if (ret != ESP_OK)
+    {
+        i2c_master_bus_rm_device(slot->handle);
+        slot->handle = NULL;
+        ESP_LOGE(TAG, "i2c%d callback register failed", i2c_master->port);
+        return ret;
+    }
+
+#endif
+    slot->dev_addr = dev_addr;
+    slot->ack_check = ack_check;
+    slot->clk_speed = clk_speed;
+    slot->last_link = i2c_master->links;
+    *ret_handle = slot->handle;
+    return ESP_OK;
+}
+
+/**
+ * @brief remove all cached device handles of a bus
+ *
+ * @param i2c_master the bus
+ */
+static void i2c_bus_master_dev_clear(i2c_bus_master_t *i2c_master)
+{
+    for (int i = 0; i < I2C_BUS_MASTER_DEV_CACHE; i++)
+    {
+        if (i2c_master->devs[i].handle != NULL)
+        {
+            i2c_master_bus_rm_device(i2c_master->devs[i].handle);
+            i2c_master->devs[i].handle = NULL;
+        }
+    }
+}
+
+/**
+ * @brief wait until the queued transfers of the current link are done.
+ *        On timeout the bus is reset, so no transfer references the link after return.
+ *
+ * @param i2c_master the bus
+ * @param start_tick tick the link was started
+ * @param ticks_to_wait time budget of the link
+ * @return esp_err_t ESP_OK, ESP_FAIL if a transfer was not acknowledged,
+ *         ESP_ERR_TIMEOUT if the wait or a transfer timed out
+ */
+static esp_err_t i2c_bus_master_wait(i2c_bus_master_t *i2c_master, TickType_t start_tick, TickType_t ticks_to_wait)
+{
+#if I2C_BUS_MASTER_QUEUE_DEPTH > 0
+    while (i2c_master->pending > 0)
+    {
+        TickType_t ticks_left = i2c_bus_master_ticks_left(start_tick, ticks_to_wait);
+
+        if (ticks_left == 0 || xSemaphoreTake(i2c_master->done, ticks_left) != pdTRUE)
+        {
+            ESP_LOGW(TAG, "i2c%d %u queued transfers timed out", i2c_master->port, (unsigned int)i2c_master->pending);
+            i2c_master_bus_reset(i2c_master->bus);
+            i2c_master_bus_wait_all_done(i2c_master->bus, I2C_BUS_MASTER_DRAIN_MS);
+            i2c_master->pending = 0;
+            return ESP_ERR_TIMEOUT;
+        }
+
+        i2c_master->pending--;
+    }
+
+    if (i2c_master->timed_out)
+    {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    return i2c_master->nacked ? ESP_FAIL : ESP_OK;
+#else
+    return ESP_OK;
+#endif
+}
+
+/**
+ * @brief time left of a link budget
+ *
+ * @param start_tick tick the link was started
+ * @param ticks_to_wait time budget of the link
+ * @return TickType_t ticks left, portMAX_DELAY for no limit
+ */
+static TickType_t i2c_bus_master_ticks_left(TickType_t start_tick, TickType_t ticks_to_wait)
+{
+    if (ticks_to_wait == portMAX_DELAY)
+    {
+        return portMAX_DELAY;
+    }
+
+    TickType_t elapsed = xTaskGetTickCount() - start_tick;
+    return (elapsed < ticks_to_wait) ? ticks_to_wait - elapsed : 0;
+}
+
+/**
+ * @brief map an i2c_master result to the result of the legacy driver, which i2c_bus statistics and recovery expect:
+ *        ESP_FAIL for a missing ack, ESP_ERR_TIMEOUT for a bus that does not complete the transfer
+ *
+ * @param ret i2c_master result
+ * @return esp_err_t legacy result
+ */
+static esp_err_t i2c_bus_master_err(esp_err_t ret)
+{
+    switch (ret)
+    {
+    case ESP_OK:
+    case ESP_ERR_TIMEOUT:
+    case ESP_ERR_INVALID_ARG:
+    case ESP_ERR_NO_MEM:
+        return ret;
+    default:
+        return ESP_FAIL;
+    }
+}
@@ -0,0 +1,405 @@
+// Copyright 2020-2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "esp_log.h"
+#include "i2c_bus_sim.h"
+
+#define I2C_SIM_REG_NUM 256
+
+struct i2c_bus_sim_dev
+{
+    struct i2c_bus_sim_dev *next;      /*next device on the same bus*/
+    i2c_port_t port;                   /*bus the device is attached to*/
+    uint8_t dev_addr;                  /*7-bit device address*/
+    uint8_t reg_ptr;                   /*register pointer, kept between transfers like real devices*/
+    uint8_t regs[I2C_SIM_REG_NUM];     /*register map*/
+    const i2c_bus_sim_dev_ops_t *ops;  /*scripted behaviour, NULL for a plain register map*/
+    void *ctx;                         /*user context of ops*/
+    uint32_t max_clk_speed;            /*reads fail above it, 0 for no limit*/
+    uint8_t stuck_pulses;              /*SCL pulses needed to release SDA, 0 if not holding it*/
+};
+
+typedef struct
+{
+    bool is_init;                /*driver installed*/
+    uint32_t clk_speed;          /*SCL frequency set with i2c_param_config*/
+    uint32_t byte_time_ns;       /*wire time override of one byte, 0 to derive it from clk_speed*/
+    i2c_bus_sim_dev_t *devs;     /*attached virtual devices*/
+    i2c_bus_sim_stats_t stats;   /*bus counters*/
+} i2c_bus_sim_t;
+
+typedef enum
+{
+    I2C_SIM_STATE_IDLE,    /*no start sent*/
+    I2C_SIM_STATE_ADDR,    /*start sent, next byte is the address*/
+    I2C_SIM_STATE_REG,     /*addressed for write, next byte is the register pointer*/
+    I2C_SIM_STATE_WRITE,   /*register pointer set, bytes are written to registers*/
+    I2C_SIM_STATE_READ,    /*addressed for read*/
+    I2C_SIM_STATE_NACKED,  /*address not acknowledged, wait for start or stop*/
+} i2c_sim_state_t;
+
+static const char *TAG = "i2c_bus_sim";
+static i2c_bus_sim_t s_i2c_sim[I2C_NUM_MAX];
+static pthread_mutex_t s_i2c_sim_lock = PTHREAD_MUTEX_INITIALIZER;
+static int64_t s_i2c_sim_wire_us = 0; /*simulated wire time of all buses, accessed atomically*/
+
+#define I2C_SIM_CHECK(a, str, ret)                                             \
+    if (!(a))                                                                  \
+    {                                                                          \
+        ESP_LOGE(TAG, "%s:%d (%s):%s", __FILE__, __LINE__, __FUNCTION__, str); \
+        return (ret);                                                          \
+    }
+
+static i2c_bus_sim_dev_t *i2c_sim_dev_find(i2c_port_t port, uint8_t dev_addr);
+static uint32_t i2c_sim_byte_time_ns(const i2c_bus_sim_t *sim);
+static bool i2c_sim_bus_stuck(i2c_port_t port);
+
+/**************************************** Legacy driver subset *********************************************/
+
+esp_err_t i2c_param_config(i2c_port_t i2c_num, const i2c_config_t *i2c_conf)
+{
+    I2C_SIM_CHECK(i2c_num < I2C_NUM_MAX, "i2c port error", ESP_ERR_INVALID_ARG);
+    I2C_SIM_CHECK(i2c_conf != NULL, "pointer = NULL error", ESP_ERR_INVALID_ARG);
+    I2C_SIM_CHECK(i2c_conf->mode == I2C_MODE_MASTER, "only master mode is simulated", ESP_ERR_NOT_SUPPORTED);
+    pthread_mutex_lock(&s_i2c_sim_lock);
+    s_i2c_sim[i2c_num].clk_speed = i2c_conf->master.clk_speed;
+    pthread_mutex_unlock(&s_i2c_sim_lock);
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_install(i2c_port_t i2c_num, i2c_mode_t mode, size_t slv_rx_buf_len, size_t slv_tx_buf_len, int intr_alloc_flags)
+{
+    I2C_SIM_CHECK(i2c_num < I2C_NUM_MAX, "i2c port error", ESP_ERR_INVALID_ARG);
+    I2C_SIM_CHECK(mode == I2C_MODE_MASTER, "only master mode is simulated", ESP_ERR_NOT_SUPPORTED);
+    I2C_SIM_CHECK(!s_i2c_sim[i2c_num].is_init, "i2c driver already installed", ESP_FAIL);
+    s_i2c_sim[i2c_num].is_init = true;
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_delete(i2c_port_t i2c_num)
+{
+    I2C_SIM_CHECK(i2c_num < I2C_NUM_MAX, "i2c port error", ESP_ERR_INVALID_ARG);
+    s_i2c_sim[i2c_num].is_init = false;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_cmd_begin(i2c_port_t i2c_num, i2c_cmd_handle_t cmd_handle, TickType_t ticks_to_wait)
+{
+    I2C_SIM_CHECK(i2c_num < I2C_NUM_MAX, "i2c port error", ESP_ERR_INVALID_ARG);
+    I2C_SIM_CHECK(cmd_handle != NULL, "i2c command link error", ESP_ERR_INVALID_ARG);
+    i2c_bus_cmd_link_t *link = (i2c_bus_cmd_link_t *)cmd_handle;
+    i2c_bus_sim_t *sim = &s_i2c_sim[i2c_num];
+    I2C_SIM_CHECK(sim->is_init, "i2c driver not installed", ESP_ERR_INVALID_STATE);
+
+    if (i2c_sim_bus_stuck(i2c_num))
+    {
+        /*SDA held low, the transfer waits for the whole timeout*/
+        __atomic_add_fetch(&s_i2c_sim_wire_us, (int64_t)ticks_to_wait * portTICK_PERIOD_MS * 1000, __ATOMIC_RELAXED);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    esp_err_t ret = ESP_OK;
+    i2c_sim_state_t state = I2C_SIM_STATE_IDLE;
+    i2c_bus_sim_dev_t *dev = NULL;
+    uint32_t bytes = 0;
+    uint32_t conditions = 0; /*start and stop conditions, one clock each*/
+    pthread_mutex_lock(&s_i2c_sim_lock);
+
+    for (size_t i = 0; i < link->num && ret == ESP_OK; i++)
+    {
+        i2c_bus_cmd_t *cmd = &link->cmds[i];
+
+        switch (cmd->type)
+        {
+        case I2C_BUS_CMD_TYPE_START:
+            conditions++;
+            state = I2C_SIM_STATE_ADDR;
+            break;
+        case I2C_BUS_CMD_TYPE_STOP:
+            conditions++;
+            state = I2C_SIM_STATE_IDLE;
+            break;
+        case I2C_BUS_CMD_TYPE_WRITE:
+            for (size_t n = 0; n < cmd->data_len && ret == ESP_OK; n++)
+            {
+                uint8_t byte = cmd->data != NULL ? cmd->data[n] : cmd->byte;
+                bool ack = false;
+                bytes++;
+
+                if (state == I2C_SIM_STATE_ADDR)
+                {
+                    dev = i2c_sim_dev_find(i2c_num, byte >> 1);
+                    ack = (dev != NULL);
+                    state = !ack ? I2C_SIM_STATE_NACKED : ((byte & 0x01) == I2C_MASTER_READ ? I2C_SIM_STATE_READ : I2C_SIM_STATE_REG);
+                }
+                else if (state == I2C_SIM_STATE_REG)
+                {
+                    dev->reg_ptr = byte;
+                    ack = true;
+
+                    if (dev->ops != NULL && dev->ops->address != NULL)
+                    {
+                        dev->ops->address(dev, byte, dev->ctx);
+                    }
+
+                    state = I2C_SIM_STATE_WRITE;
+                }
+                else if (state == I2C_SIM_STATE_WRITE)
+                {
+                    uint8_t reg = dev->reg_ptr;
+                    dev->regs[reg] = byte;
+                    dev->reg_ptr = (dev->ops != NULL && dev->ops->write != NULL) ? dev->ops->write(dev, reg, byte, dev->ctx) : reg + 1;
+                    ack = true;
+                }
+
+                if (!ack && cmd->ack)
+                {
+                    sim->stats.nacks++;
+                    ret = ESP_FAIL;
+                }
+            }
+            break;
+        case I2C_BUS_CMD_TYPE_READ:
+            for (size_t n = 0; n < cmd->data_len; n++)
+            {
+                bytes++;
+
+                /*a device clocked beyond its limit does not drive SDA in time*/
+                if (state != I2C_SIM_STATE_READ || (dev->max_clk_speed != 0 && sim->clk_speed > dev->max_clk_speed))
+                {
+                    cmd->data[n] = 0xFF; /*nobody drives SDA*/
+                    continue;
+                }
+
+                uint8_t reg = dev->reg_ptr;
+                uint8_t value = dev->regs[reg];
+                dev->reg_ptr = (dev->ops != NULL && dev->ops->read != NULL) ? dev->ops->read(dev, reg, &value, dev->ctx) : reg + 1;
+                cmd->data[n] = value;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    uint64_t wire_ns = (uint64_t)bytes * i2c_sim_byte_time_ns(sim) + (uint64_t)conditions * i2c_sim_byte_time_ns(sim) / 9;
+    sim->stats.transactions++;
+    sim->stats.bytes += bytes;
+    sim->stats.bus_time_us += wire_ns / 1000;
+    __atomic_add_fetch(&s_i2c_sim_wire_us, (int64_t)(wire_ns / 1000), __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&s_i2c_sim_lock);
+    return ret;
+}
+
+/**************************************** Virtual devices *********************************************/
+
+i2c_bus_sim_dev_t *i2c_bus_sim_dev_create(i2c_port_t port, const i2c_bus_sim_dev_config_t *dev_conf)
+{
+    I2C_SIM_CHECK(port < I2C_NUM_MAX, "i2c port error", NULL);
+    I2C_SIM_CHECK(dev_conf != NULL, "pointer = NULL error", NULL);
+    I2C_SIM_CHECK(dev_conf->dev_addr < 0x80, "device address error", NULL);
+    i2c_bus_sim_dev_t *dev = calloc(1, sizeof(i2c_bus_sim_dev_t));
+    I2C_SIM_CHECK(dev != NULL, "calloc memory failed", NULL);
+    dev->port = port;
+    dev->dev_addr = dev_conf->dev_addr;
+    dev->ops = dev_conf->ops;
+    dev->ctx = dev_conf->ctx;
+    dev->max_clk_speed = dev_conf->max_clk_speed;
+
+    if (dev_conf->reg_init != NULL)
+    {
+        memcpy(dev->regs, dev_conf->reg_init, I2C_SIM_REG_NUM);
+    }
+
+    pthread_mutex_lock(&s_i2c_sim_lock);
+
+    if (i2c_sim_dev_find(port, dev->dev_addr) != NULL)
+    {
+        pthread_mutex_unlock(&s_i2c_sim_lock);
+        free(dev);
+        ESP_LOGE(TAG, "address 0x%02x already used on i2c%d", dev_conf->dev_addr, port);
+        return NULL;
+    }
+
+    dev->next = s_i2c_sim[port].devs;
+    s_i2c_sim[port].devs = dev;
+    pthread_mutex_unlock(&s_i2c_sim_lock);
+    return dev;
+}
+
+esp_err_t i2c_bus_sim_dev_delete(i2c_bus_sim_dev_t **p_dev)
+{
+    I2C_SIM_CHECK(p_dev != NULL && *p_dev != NULL, "pointer = NULL error", ESP_ERR_INVALID_ARG);
+    i2c_bus_sim_dev_t *dev = *p_dev;
+    pthread_mutex_lock(&s_i2c_sim_lock);
+
+    for (i2c_bus_sim_dev_t **node = &s_i2c_sim[dev->port].devs; *node != NULL; node = &(*node)->next)
+    {
+        if (*node == dev)
+        {
+            *node = dev->next;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&s_i2c_sim_lock);
+    free(dev);
+    *p_dev = NULL;
+    return ESP_OK;
+}
+
+uint8_t *i2c_bus_sim_dev_regs(i2c_bus_sim_dev_t *dev)
+{
+    I2C_SIM_CHECK(dev != NULL, "pointer = NULL error", NULL);
+    return dev->regs;
+}
+
+esp_err_t i2c_bus_sim_dev_set_stuck(i2c_bus_sim_dev_t *dev, uint8_t pulses)
+{
+    I2C_SIM_CHECK(dev != NULL, "pointer = NULL error", ESP_ERR_INVALID_ARG);
+    pthread_mutex_lock(&s_i2c_sim_lock);
+    dev->stuck_pulses = pulses;
+    pthread_mutex_unlock(&s_i2c_sim_lock);
+    return ESP_OK;
+}
+
+bool i2c_bus_sim_line_recover(i2c_port_t port, uint8_t pulses)
+{
+    I2C_SIM_CHECK(port < I2C_NUM_MAX, "i2c port error", false);
+    pthread_mutex_lock(&s_i2c_sim_lock);
+
+    for (i2c_bus_sim_dev_t *dev = s_i2c_sim[port].devs; dev != NULL; dev = dev->next)
+    {
+        dev->stuck_pulses = dev->stuck_pulses > pulses ? dev->stuck_pulses - pulses : 0;
+    }
+
+    pthread_mutex_unlock(&s_i2c_sim_lock);
+    return !i2c_sim_bus_stuck(port);
+}
+
+void i2c_bus_sim_delay_us(uint32_t us)
+{
+    __atomic_add_fetch(&s_i2c_sim_wire_us, (int64_t)us, __ATOMIC_RELAXED);
+}
+
+void i2c_bus_sim_lock(void)
+{
+    pthread_mutex_lock(&s_i2c_sim_lock);
+}
+
+void i2c_bus_sim_unlock(void)
+{
+    pthread_mutex_unlock(&s_i2c_sim_lock);
+}
+
+esp_err_t i2c_bus_sim_set_byte_time(i2c_port_t port, uint32_t byte_time_ns)
+{
+    I2C_SIM_CHECK(port < I2C_NUM_MAX, "i2c port error", ESP_ERR_INVALID_ARG);
+    pthread_mutex_lock(&s_i2c_sim_lock);
+    s_i2c_sim[port].byte_time_ns = byte_time_ns;
+    pthread_mutex_unlock(&s_i2c_sim_lock);
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_sim_get_stats(i2c_port_t port, i2c_bus_sim_stats_t *stats)
+{
+    I2C_SIM_CHECK(port < I2C_NUM_MAX, "i2c port error", ESP_ERR_INVALID_ARG);
+    I2C_SIM_CHECK(stats != NULL, "pointer = NULL error", ESP_ERR_INVALID_ARG);
+    pthread_mutex_lock(&s_i2c_sim_lock);
+    *stats = s_i2c_sim[port].stats;
+    pthread_mutex_unlock(&s_i2c_sim_lock);
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_sim_reset_stats(i2c_port_t port)
+{
+    I2C_SIM_CHECK(port < I2C_NUM_MAX, "i2c port error", ESP_ERR_INVALID_ARG);
+    pthread_mutex_lock(&s_i2c_sim_lock);
+    memset(&s_i2c_sim[port].stats, 0, sizeof(i2c_bus_sim_stats_t));
+    pthread_mutex_unlock(&s_i2c_sim_lock);
+    return ESP_OK;
+}
+
+int64_t i2c_bus_sim_get_time_us(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    /*lock free, so device callbacks can read the clock while a transfer runs*/
+    int64_t wire_us = __atomic_load_n(&s_i2c_sim_wire_us, __ATOMIC_RELAXED);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000 + wire_us;
+}
+
+/**************************************** Private Functions*********************************************/
+
+/**
+ * @brief find a virtual device by address, must be called with s_i2c_sim_lock taken
+ *
+ * @param port bus of the device
+ * @param dev_addr 7-bit address
+ * @return i2c_bus_sim_dev_t* the device, NULL if no device acks the address
+ */
+static i2c_bus_sim_dev_t *i2c_sim_dev_find(i2c_port_t port, uint8_t dev_addr)
+{
+    for (i2c_bus_sim_dev_t *dev = s_i2c_sim[port].devs; dev != NULL; dev = dev->next)
+    {
+        if (dev->dev_addr == dev_addr)
+        {
+            return dev;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief wire time of one byte plus ack, 9 SCL clocks
+ *
+ * @param sim the bus
+ * @return uint32_t time in ns
+ */
+static uint32_t i2c_sim_byte_time_ns(const i2c_bus_sim_t *sim)
+{
+    if (sim->byte_time_ns != 0)
+    {
+        return sim->byte_time_ns;
+    }
+
+    uint32_t clk_speed = sim->clk_speed > 0 ? sim->clk_speed : 100000;
+    return (uint32_t)(9ULL * 1000000000ULL / clk_speed);
+}
+
+/**
+ * @brief check if a device holds SDA low
+ *
+ * @param port the bus
+ * @return true bus is stuck
+ */
+static bool i2c_sim_bus_stuck(i2c_port_t port)
+{
+    bool stuck = false;
+    pthread_mutex_lock(&s_i2c_sim_lock);
+
+    for (i2c_bus_sim_dev_t *dev = s_i2c_sim[port].devs; dev != NULL; dev = dev->next)
+    {
+        stuck |= (dev->stuck_pulses > 0);
+    }
+
+    pthread_mutex_unlock(&s_i2c_sim_lock);
+    return stuck;
+}
@@ -13,12 +13,371 @@
 // limitations under the License.
 #ifndef _I2C_BUS_H_
 #define _I2C_BUS_H_
+#include "sdkconfig.h"
+#ifdef CONFIG_IDF_TARGET_LINUX
+#include "i2c_bus_sim.h"
+#elif defined(CONFIG_I2C_BUS_BACKEND_I2C_MASTER)
+#include "i2c_bus_master.h"
+#else
 #include "driver/i2c.h"
+#endif
 
 #define NULL_I2C_MEM_ADDR 0xFF /*!< set mem_address to NULL_I2C_MEM_ADDR if i2c device has no internal address during read/write */
 #define NULL_I2C_DEV_ADDR 0xFF /*!< invalid i2c device address */
+#ifdef CONFIG_I2C_BUS_TXN_MAX_OPS
+#define I2C_BUS_TXN_MAX_OPS CONFIG_I2C_BUS_TXN_MAX_OPS /*!< max operations in one i2c_bus_txn_t */
+#else
+#define I2C_BUS_TXN_MAX_OPS 24
+#endif
+#ifdef CONFIG_I2C_BUS_FAST_MODE_PLUS
+#define I2C_BUS_CLK_SPEED_MAX 1000000 /*!< max SCL frequency, Fast-mode Plus */
+#else
+#define I2C_BUS_CLK_SPEED_MAX 400000 /*!< max SCL frequency, Fast-mode */
+#endif
 typedef void *i2c_bus_handle_t; /*!< i2c bus handle */
 typedef void *i2c_bus_device_handle_t; /*!< i2c device handle */
+typedef void *i2c_bus_group_handle_t; /*!< i2c bus group handle */
+typedef void *i2c_bus_sched_handle_t; /*!< i2c periodic read scheduler handle */
+typedef void *i2c_bus_sched_job_handle_t; /*!< i2c periodic read job handle */
+
+/**
+ * @brief I2C device priority class in bus arbitration
+ */
+typedef enum
+{
+    I2C_BUS_PRIO_LOW = 0,  /*!< background transfers, e.g. bulk configuration and scan */
+    I2C_BUS_PRIO_NORMAL,   /*!< default priority */
+    I2C_BUS_PRIO_HIGH,     /*!< latency sensitive transfers */
+    I2C_BUS_PRIO_CRITICAL, /*!< latency critical transfers, e.g. FIFO drain */
+    I2C_BUS_PRIO_MAX,
+} i2c_bus_priority_t;
+
+/**
+ * @brief I2C device configuration
+ */
+typedef struct
+{
+    uint8_t dev_addr;            /*!< i2c device address */
+    uint32_t clk_speed;          /*!< device specified clock frequency, 0 if use current bus speed, max I2C_BUS_CLK_SPEED_MAX */
+    i2c_bus_priority_t priority; /*!< priority class in bus arbitration */
+    uint8_t retries;             /*!< retries of a failed register read, 0 to report failures at once */
+    uint32_t retry_backoff_us;   /*!< wait before the first retry, doubled at each following retry up to 100 ms */
+    uint32_t timeout_ms;         /*!< time budget of a call, bus wait and retries included, 0 for the default 200 ms */
+} i2c_bus_device_config_t;
+
+/**
+ * @brief Bus wait time statistics of a priority class
+ */
+typedef struct
+{
+    uint32_t count;         /*!< number of bus acquisitions */
+    uint32_t max_wait_us;   /*!< worst-case wait for the bus */
+    uint64_t total_wait_us; /*!< accumulated wait for the bus */
+} i2c_bus_prio_stats_t;
+
+/**
+ * @brief I2C bus scan configuration
+ */
+typedef struct
+{
+    uint8_t addr_min;          /*!< first 7-bit address to probe */
+    uint8_t addr_max;          /*!< last 7-bit address to probe */
+    const uint8_t *allow_list; /*!< addresses to probe, if not NULL addr_min and addr_max are ignored */
+    uint8_t allow_list_len;    /*!< number of addresses in allow_list */
+    uint32_t probe_timeout_ms; /*!< max wait of one probe, a stuck bus ends the probe after this time */
+    bool incremental;          /*!< release the bus between probes, so other devices' transfers keep flowing */
+} i2c_bus_scan_config_t;
+
+#define I2C_BUS_SCAN_CONFIG_DEFAULT() { \
+    .addr_min = 0x08,                   \
+    .addr_max = 0x77,                   \
+    .allow_list = NULL,                 \
+    .allow_list_len = 0,                \
+    .probe_timeout_ms = 10,             \
+    .incremental = false,               \
+}
+
+#define I2C_BUS_STATS_HIST_BINS 16 /*!< number of log2 latency histogram bins */
+
+/**
+ * @brief I2C bus or device performance counters
+ */
+typedef struct
+{
+    uint32_t transactions;                           /*!< number of transfers sent */
+    uint32_t nacks;                                  /*!< transfers failed for a missing ACK */
+    uint32_t timeouts;                               /*!< transfers failed for a timeout */
+    uint32_t errors;                                 /*!< transfers failed for any other reason, e.g. invalid state */
+    size_t bytes_read;                               /*!< data bytes read, register addresses excluded */
+    size_t bytes_written;                            /*!< data bytes written, register addresses excluded */
+    uint32_t retries;                                /*!< failed transfers sent again */
+    uint32_t recoveries;                             /*!< bus recoveries from a stuck SDA */
+    uint32_t coalesced;                              /*!< reads served from a coalesced register value, no transfer */
+    uint64_t lock_wait_us;                           /*!< time spent waiting for the bus */
+    uint64_t xfer_us;                                /*!< time spent on the wire */
+    uint32_t latency_hist[I2C_BUS_STATS_HIST_BINS]; /*!< transfer latency histogram, bin n counts [2^(n-1), 2^n) us */
+} i2c_bus_stats_t;
+
+#define I2C_BUS_TRACE_FLAG_READ 0x01  /*!< the transfer read data */
+#define I2C_BUS_TRACE_FLAG_WRITE 0x02 /*!< the transfer wrote data */
+#define I2C_BUS_TRACE_FLAG_TXN 0x04   /*!< command link of a transaction, mem_address is the first operation's */
+#define I2C_BUS_TRACE_FLAG_REG16 0x08 /*!< 16-bit internal address */
+
+/**
+ * @brief I2C trace entry, one per transfer on the wire, retries included.
+ *        A dump is an array of entries in recording order, it can be saved as is and replayed with i2c_bus_trace_replay.
+ */
+typedef struct
+{
+    uint32_t timestamp_us; /*!< start of the transfer, low 32 bits of the bus time */
+    uint32_t duration_us;  /*!< time on the wire */
+    uint32_t clk_speed;    /*!< SCL frequency of the transfer */
+    esp_err_t ret;         /*!< result of the transfer */
+    uint16_t mem_address;  /*!< first internal address, NULL_I2C_MEM_ADDR if none with 8-bit addresses */
+    uint16_t rx_len;       /*!< data bytes read */
+    uint16_t tx_len;       /*!< data bytes written, internal address excluded */
+    uint8_t dev_addr;      /*!< 7-bit device address */
+    uint8_t flags;         /*!< I2C_BUS_TRACE_FLAG_xx */
+    uint8_t attempt;       /*!< 0 for the first attempt, n for the n-th retry */
+    uint8_t port;          /*!< I2C port number */
+} i2c_bus_trace_entry_t;
+
+/**
+ * @brief Result of a trace replay
+ */
+typedef struct
+{
+    uint32_t replayed;        /*!< entries sent again */
+    uint32_t skipped;         /*!< retries and raw command links, not replayed */
+    uint32_t failed;          /*!< replayed entries that failed */
+    uint64_t recorded_us;     /*!< sum of the recorded durations of replayed entries */
+    uint64_t replay_us;       /*!< sum of the replay call durations, bus wait and retries included */
+    uint32_t recorded_max_us; /*!< longest recorded duration */
+    uint32_t replay_max_us;   /*!< longest replay call */
+} i2c_bus_trace_replay_stats_t;
+
+/**
+ * @brief I2C command link allocation counters of a bus
+ */
+typedef struct
+{
+    uint32_t static_uses; /*!< number of transfers built in the bus owned static command link buffer */
+    uint32_t heap_allocs; /*!< number of command links allocated from heap */
+    uint32_t heap_frees;  /*!< number of heap allocated command links released */
+} i2c_bus_cmd_link_stats_t;
+
+/**
+ * @brief I2C transaction operation type
+ */
+typedef enum
+{
+    I2C_BUS_TXN_OP_READ = 0, /*!< read bytes from a register */
+    I2C_BUS_TXN_OP_WRITE,    /*!< write bytes to a register */
+    I2C_BUS_TXN_OP_RMW,      /*!< read-modify-write bits of a register */
+} i2c_bus_txn_op_type_t;
+
+/**
+ * @brief I2C transaction operation, filled by i2c_bus_txn_add_xx
+ */
+typedef struct
+{
+    i2c_bus_txn_op_type_t type; /*!< operation type */
+    uint8_t mem_address;        /*!< internal reg/mem address, NULL_I2C_MEM_ADDR if no internal address */
+    uint8_t mask;               /*!< bits to modify, RMW only */
+    uint8_t byte;               /*!< byte to write for single byte write, final register value for RMW */
+    size_t data_len;            /*!< number of bytes to read/write */
+    uint8_t *rx_data;           /*!< read buffer, READ only */
+    const uint8_t *tx_data;     /*!< write buffer, must be valid until commit, NULL for single byte write */
+    esp_err_t ret;              /*!< result after commit, ESP_ERR_INVALID_STATE if not executed */
+} i2c_bus_txn_op_t;
+
+/**
+ * @brief I2C transaction, a batch of register operations on one device.
+ *        Usually allocated on stack, no heap is used by the transaction API.
+ */
+typedef struct
+{
+    i2c_bus_device_handle_t dev_handle;       /*!< device the operations are sent to */
+    esp_err_t ret;                            /*!< first error while adding operations */
+    uint8_t num_ops;                          /*!< number of added operations */
+    i2c_bus_txn_op_t ops[I2C_BUS_TXN_MAX_OPS]; /*!< operations in adding order */
+} i2c_bus_txn_t;
+
+/**
+ * @brief Register bitfield helpers, shift and width are compile-time constants in drivers so the masks fold.
+ *        I2C_BUS_FIELD_ACCESSORS generates prefix_name_get/prefix_name_set inline functions, usually expanded from an
+ *        X-macro list of the fields of a device, e.g.
+ *        #define FOO_FIELDS(X) X(pon, 0, 1) X(gain, 2, 2)
+ *        #define FOO_FIELD(name, shift, width) I2C_BUS_FIELD_ACCESSORS(foo_field, name, shift, width)
+ *        FOO_FIELDS(FOO_FIELD)
+ */
+#define I2C_BUS_FIELD_MASK(shift, width) ((uint8_t)(((1U << (width)) - 1) << (shift)))
+#define I2C_BUS_FIELD_GET(reg_value, shift, width) ((uint8_t)(((reg_value) >> (shift)) & ((1U << (width)) - 1)))
+#define I2C_BUS_FIELD_SET(reg_value, shift, width, value) \
+    ((uint8_t)(((reg_value) & ~I2C_BUS_FIELD_MASK(shift, width)) | (((value) << (shift)) & I2C_BUS_FIELD_MASK(shift, width))))
+
+#define I2C_BUS_FIELD_ACCESSORS(prefix, name, shift, width)                  \
+    static inline uint8_t prefix##_##name##_get(uint8_t reg_value)           \
+    {                                                                        \
+        return I2C_BUS_FIELD_GET(reg_value, shift, width);                   \
+    }                                                                        \
+    static inline uint8_t prefix##_##name##_set(uint8_t reg_value, uint8_t value) \
+    {                                                                        \
+        return I2C_BUS_FIELD_SET(reg_value, shift, width, value);            \
+    }
+
+/**
+ * @brief Register map, a set of 8-bit registers read or written together with i2c_bus_regmap_read/write.
+ *        Usually a static const table, values are kept by the driver in an array in the same order.
+ */
+typedef struct
+{
+    const uint8_t *regs; /*!< register addresses, consecutive addresses are sent as one burst */
+    uint8_t num;         /*!< number of registers */
+} i2c_bus_regmap_t;
+
+/**
+ * @brief I2C asynchronous request type
+ */
+typedef enum
+{
+    I2C_BUS_REQ_READ = 0, /*!< read bytes with 8-bit internal address, same as i2c_bus_read_bytes */
+    I2C_BUS_REQ_WRITE,    /*!< write bytes with 8-bit internal address, same as i2c_bus_write_bytes */
+    I2C_BUS_REQ_TXN,      /*!< commit a transaction, same as i2c_bus_txn_commit */
+    I2C_BUS_REQ_READ_RAW, /*!< read bytes with 8-bit internal address, register cache, coalescing and retries bypassed */
+} i2c_bus_req_type_t;
+
+typedef struct i2c_bus_request i2c_bus_request_t;
+
+/**
+ * @brief I2C asynchronous request completion callback, called from the bus worker task.
+ *        It should not block, other requests of the bus wait until it returns.
+ */
+typedef void (*i2c_bus_req_cb_t)(i2c_bus_request_t *req, void *user_ctx);
+
+/**
+ * @brief I2C asynchronous request, owned by the caller and must be valid until completion.
+ */
+struct i2c_bus_request
+{
+    i2c_bus_req_type_t type;            /*!< request type */
+    i2c_bus_device_handle_t dev_handle; /*!< device to access, ignored for I2C_BUS_REQ_TXN */
+    uint8_t mem_address;                /*!< internal reg/mem address, NULL_I2C_MEM_ADDR if no internal address */
+    size_t data_len;                    /*!< number of bytes to read/write */
+    uint8_t *data;                      /*!< read buffer or bytes to write */
+    i2c_bus_txn_t *txn;                 /*!< transaction to commit, I2C_BUS_REQ_TXN only */
+    i2c_bus_req_cb_t callback;          /*!< completion callback, NULL if not used */
+    void *user_ctx;                     /*!< user context passed to callback */
+    void *notify_task;                  /*!< TaskHandle_t notified with xTaskNotifyGive on completion, NULL if not used */
+    esp_err_t ret;                      /*!< result, valid after completion */
+    void *done;                         /*!< internal use */
+};
+
+/**
+ * @brief Stream chunk callback, called in the task running i2c_bus_read_stream while the next chunk is read.
+ *        The chunk is only valid until the callback returns.
+ */
+typedef void (*i2c_bus_stream_cb_t)(const uint8_t *chunk, size_t len, void *user_ctx);
+
+/**
+ * @brief Streaming read configuration
+ */
+typedef struct
+{
+    uint8_t mem_address;        /*!< internal reg/mem address to read from */
+    bool fixed_address;         /*!< true for a FIFO register read again by every chunk, false to advance by chunk_len */
+    size_t chunk_len;           /*!< bytes per transfer, the bus is released between chunks */
+    uint8_t *buf;               /*!< double buffer of 2 * chunk_len bytes */
+    i2c_bus_stream_cb_t on_chunk; /*!< consumer of the chunks, in read order */
+    void *user_ctx;             /*!< user context passed to on_chunk */
+} i2c_bus_stream_config_t;
+
+/**
+ * @brief Device interrupt line binding
+ */
+typedef struct
+{
+    int gpio_num;           /*!< GPIO of the device interrupt line */
+    bool active_high;       /*!< line is asserted high, false for the usual open-drain active low line */
+    bool pull_en;           /*!< enable the internal pull-up, or pull-down for an active high line */
+    i2c_bus_request_t *req; /*!< read or transaction queued when the line is asserted, valid until unbound */
+} i2c_bus_irq_config_t;
+
+/**
+ * @brief Interrupt-driven read counters of a device
+ */
+typedef struct
+{
+    uint32_t count;            /*!< interrupts served */
+    uint32_t overruns;         /*!< interrupts that found the request queue full, served once a request completes */
+    uint32_t max_latency_us;   /*!< worst time from interrupt to return of the request callback */
+    uint64_t total_latency_us; /*!< accumulated time from interrupt to return of the request callback */
+} i2c_bus_irq_stats_t;
+
+/**
+ * @brief Utilisation of one bus of a bus group, measured over the window since the previous query
+ */
+typedef struct
+{
+    i2c_port_t port;        /*!< I2C port number */
+    int core_id;            /*!< core the bus worker task is pinned to, -1 if not pinned */
+    uint8_t devices;        /*!< devices created through the group on this bus */
+    uint32_t load;          /*!< sum of the declared loads of those devices */
+    uint32_t pending;       /*!< asynchronous requests waiting in the queue */
+    uint64_t busy_us;       /*!< time on the wire in the window, 0 if CONFIG_I2C_BUS_STATS is disabled */
+    uint64_t window_us;     /*!< length of the window */
+    uint16_t util_permille; /*!< busy_us / window_us, in 1/1000 */
+} i2c_bus_group_util_t;
+
+/**
+ * @brief Periodic read callback, called from the scheduler task once per period with the registers read.
+ *        It should not block and must not add or remove jobs, the next reads wait until it returns.
+ *
+ * @param data Registers read, only valid until the callback returns
+ * @param len Number of bytes read
+ * @param timestamp_us Completion time of the read, esp_timer_get_time() time base, simulated time on the linux target
+ * @param ret Result of the read, data is not valid if it is not ESP_OK
+ * @param user_ctx User context of the job
+ */
+typedef void (*i2c_bus_sched_cb_t)(const uint8_t *data, size_t len, int64_t timestamp_us, esp_err_t ret, void *user_ctx);
+
+/**
+ * @brief Periodic read scheduler configuration
+ */
+typedef struct
+{
+    int core_id;                  /*!< core the scheduler task is pinned to, -1 for no affinity */
+    uint16_t util_limit_permille; /*!< max bus utilisation of the admitted jobs in 1/1000, 0 for the menuconfig default */
+} i2c_bus_sched_config_t;
+
+/**
+ * @brief Periodic read job, register block of a device read every period
+ */
+typedef struct
+{
+    i2c_bus_device_handle_t dev_handle; /*!< device to read, on the bus of the scheduler */
+    uint8_t mem_address;                /*!< first register of the block */
+    size_t data_len;                    /*!< number of bytes to read */
+    uint32_t period_us;                 /*!< read period */
+    uint32_t deadline_us;               /*!< read must complete within deadline_us after its release, 0 for period_us */
+    i2c_bus_sched_cb_t callback;        /*!< consumer of the registers read */
+    void *user_ctx;                     /*!< user context passed to callback */
+} i2c_bus_sched_job_config_t;
+
+/**
+ * @brief Periodic read scheduler counters
+ */
+typedef struct
+{
+    uint32_t reads;            /*!< periodic reads served */
+    uint32_t errors;           /*!< reads failed, their callback is called with the error */
+    uint32_t misses;           /*!< reads completed after their deadline */
+    uint32_t skipped;          /*!< releases dropped because their deadline passed before they could be served */
+    uint32_t min_latency_us;   /*!< best time from release to completion, max - min is the timestamp jitter */
+    uint32_t max_latency_us;   /*!< worst time from release to completion */
+    uint64_t total_latency_us; /*!< accumulated time from release to completion */
+    uint16_t util_permille;    /*!< bus utilisation of the admitted jobs, sum of read time / period in 1/1000 */
+} i2c_bus_sched_stats_t;
 
 #ifdef __cplusplus
 extern "C"
@@ -38,7 +397,7 @@ extern "C"
  * same i2c port, following parameter will override the previous one.
  *
  * @param port I2C port number
- * @param conf Pointer to I2C bus configuration
+ * @param conf Pointer to I2C bus configuration, clock speed up to I2C_BUS_CLK_SPEED_MAX
  * @return i2c_bus_handle_t Return the I2C bus handle if created successfully, return NULL if failed.
  */
 i2c_bus_handle_t i2c_bus_create(i2c_port_t port, const i2c_config_t *conf);
@@ -53,6 +412,21 @@ i2c_bus_handle_t i2c_bus_create(i2c_port_t port, const i2c_config_t *conf);
  */
 esp_err_t i2c_bus_delete(i2c_bus_handle_t *p_bus_handle);
 
+/**
+ * @brief Recover a bus held low by a slave. The I2C driver is removed, SCL is pulsed until the slave releases SDA
+ *        (9 pulses max), a STOP is generated and the driver is installed again.
+ *        Runs automatically after CONFIG_I2C_BUS_RECOVERY_TIMEOUTS consecutive timeouts if enabled in menuconfig,
+ *        timeouts of transfers cut short by a call budget below 200 ms are not counted.
+ *
+ * @param bus_handle I2C bus handle
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_TIMEOUT Take bus mutex timeout
+ *     - ESP_FAIL SDA still held low
+ */
+esp_err_t i2c_bus_recover(i2c_bus_handle_t bus_handle);
+
 /**
  * @brief Scan i2c devices attached on i2c bus
  *
@@ -64,6 +438,57 @@ esp_err_t i2c_bus_delete(i2c_bus_handle_t *p_bus_handle);
  */
 uint8_t i2c_bus_scan(i2c_bus_handle_t bus_handle, uint8_t *buf, uint8_t num);
 
+/**
+ * @brief Scan i2c devices attached on i2c bus with a scan configuration.
+ *        Probed addresses are recorded in the scan cache of the bus, an incremental scan logs devices attached
+ *        or detached since the last scan. Probes run at the configuration of i2c_bus_create and are counted in the
+ *        bus statistics and trace as transfers without data.
+ *
+ * @param bus_handle I2C bus handle
+ * @param scan_conf Pointer to scan configuration, NULL to use I2C_BUS_SCAN_CONFIG_DEFAULT
+ * @param buf Pointer to a buffer to save devices' address, if NULL no address will be saved.
+ * @param num Maximum number of addresses to save, invalid if buf set to NULL
+ * @param device_num Pointer to save the total number of devices found in the scanned addresses,
+ *        an incremental scan stopped by a busy bus reports the devices found up to there
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_INVALID_STATE i2c_bus not inited
+ *     - ESP_ERR_NO_MEM Create command link failed
+ *     - ESP_ERR_TIMEOUT Take bus mutex timeout, incremental scan only
+ */
+esp_err_t i2c_bus_scan_with_config(i2c_bus_handle_t bus_handle, const i2c_bus_scan_config_t *scan_conf, uint8_t *buf, uint8_t num, uint8_t *device_num);
+
+/**
+ * @brief Get devices found by previous scans from the scan cache, no transfer is made and the bus is not waited for.
+ *
+ * @param bus_handle I2C bus handle
+ * @param buf Pointer to a buffer to save devices' address, if NULL no address will be saved.
+ * @param num Maximum number of addresses to save, invalid if buf set to NULL
+ * @return uint8_t Total number of devices in the scan cache
+ */
+uint8_t i2c_bus_scan_get_cached(i2c_bus_handle_t bus_handle, uint8_t *buf, uint8_t num);
+
+/**
+ * @brief Check if an address was found by previous scans, the bus is not waited for
+ *
+ * @param bus_handle I2C bus handle
+ * @param dev_addr 7-bit device address
+ * @return true device found in the scan cache
+ * @return false device not found or address not scanned yet
+ */
+bool i2c_bus_scan_is_present(i2c_bus_handle_t bus_handle, uint8_t dev_addr);
+
+/**
+ * @brief Clear the scan cache of a bus
+ *
+ * @param bus_handle I2C bus handle
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ */
+esp_err_t i2c_bus_scan_cache_clear(i2c_bus_handle_t bus_handle);
+
 /**
  * @brief Get current active clock speed.
  * 
@@ -80,6 +505,167 @@ uint32_t i2c_bus_get_current_clk_speed(i2c_bus_handle_t bus_handle);
  */
 uint8_t i2c_bus_get_created_device_num(i2c_bus_handle_t bus_handle);
 
+/**
+ * @brief Get command link allocation counters of the bus.
+ *        With static command link enabled (menuconfig:Bus Options->I2C Bus Options->use static command link buffers),
+ *        heap_allocs stays unchanged while register read/write and scan traffic is running.
+ *
+ * @param bus_handle I2C bus handle
+ * @param stats Pointer to save the counters
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_INVALID_STATE i2c_bus not inited
+ *     - ESP_ERR_TIMEOUT Take bus mutex timeout
+ */
+esp_err_t i2c_bus_get_cmd_link_stats(i2c_bus_handle_t bus_handle, i2c_bus_cmd_link_stats_t *stats);
+
+/**
+ * @brief Get bus wait time statistics of a priority class, only device transfers are counted,
+ *        scans and other bus calls like this one are not.
+ *
+ * @param bus_handle I2C bus handle
+ * @param priority Priority class
+ * @param stats Pointer to save the statistics
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_INVALID_STATE i2c_bus not inited
+ *     - ESP_ERR_TIMEOUT Take bus mutex timeout
+ */
+esp_err_t i2c_bus_get_prio_stats(i2c_bus_handle_t bus_handle, i2c_bus_priority_t priority, i2c_bus_prio_stats_t *stats);
+
+/**
+ * @brief Reset bus wait time statistics of all priority classes
+ *
+ * @param bus_handle I2C bus handle
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_INVALID_STATE i2c_bus not inited
+ *     - ESP_ERR_TIMEOUT Take bus mutex timeout
+ */
+esp_err_t i2c_bus_reset_prio_stats(i2c_bus_handle_t bus_handle);
+
+/**
+ * @brief Get performance counters of all devices on a bus
+ *
+ * @param bus_handle I2C bus handle
+ * @param stats Pointer to save the counters
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_INVALID_STATE i2c_bus not inited
+ *     - ESP_ERR_TIMEOUT Take bus mutex timeout
+ *     - ESP_ERR_NOT_SUPPORTED CONFIG_I2C_BUS_STATS not enabled
+ */
+esp_err_t i2c_bus_get_stats(i2c_bus_handle_t bus_handle, i2c_bus_stats_t *stats);
+
+/**
+ * @brief Reset performance counters of a bus, counters of its devices are kept
+ *
+ * @param bus_handle I2C bus handle
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_INVALID_STATE i2c_bus not inited
+ *     - ESP_ERR_TIMEOUT Take bus mutex timeout
+ *     - ESP_ERR_NOT_SUPPORTED CONFIG_I2C_BUS_STATS not enabled
+ */
+esp_err_t i2c_bus_reset_stats(i2c_bus_handle_t bus_handle);
+
+/**
+ * @brief Get performance counters of a device
+ *
+ * @param dev_handle I2C device handle
+ * @param stats Pointer to save the counters
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_INVALID_STATE i2c_bus not inited
+ *     - ESP_ERR_TIMEOUT Take bus mutex timeout
+ *     - ESP_ERR_NOT_SUPPORTED CONFIG_I2C_BUS_STATS not enabled
+ */
+esp_err_t i2c_bus_device_get_stats(i2c_bus_device_handle_t dev_handle, i2c_bus_stats_t *stats);
+
+/**
+ * @brief Reset performance counters of a device
+ *
+ * @param dev_handle I2C device handle
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_INVALID_STATE i2c_bus not inited
+ *     - ESP_ERR_TIMEOUT Take bus mutex timeout
+ *     - ESP_ERR_NOT_SUPPORTED CONFIG_I2C_BUS_STATS not enabled
+ */
+esp_err_t i2c_bus_device_reset_stats(i2c_bus_device_handle_t dev_handle);
+
+/**
+ * @brief Start or stop recording the transfers of a bus in its trace ring buffer, recording is on after bus creation.
+ *        menuconfig:Bus Options->I2C Bus Options->enable transaction trace
+ *
+ * @param bus_handle I2C bus handle
+ * @param enable true to record
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_INVALID_STATE i2c_bus not inited
+ *     - ESP_ERR_TIMEOUT Take bus mutex timeout
+ *     - ESP_ERR_NOT_SUPPORTED CONFIG_I2C_BUS_TRACE not enabled
+ */
+esp_err_t i2c_bus_trace_enable(i2c_bus_handle_t bus_handle, bool enable);
+
+/**
+ * @brief Copy the last traced transfers of a bus, oldest first. The trace is kept, see i2c_bus_trace_clear.
+ *
+ * @param bus_handle I2C bus handle
+ * @param entries Array to save the entries
+ * @param num Length of entries as input, number of entries saved as output
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_INVALID_STATE i2c_bus not inited
+ *     - ESP_ERR_TIMEOUT Take bus mutex timeout
+ *     - ESP_ERR_NOT_SUPPORTED CONFIG_I2C_BUS_TRACE not enabled
+ */
+esp_err_t i2c_bus_trace_dump(i2c_bus_handle_t bus_handle, i2c_bus_trace_entry_t *entries, size_t *num);
+
+/**
+ * @brief Drop all traced transfers of a bus
+ *
+ * @param bus_handle I2C bus handle
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_INVALID_STATE i2c_bus not inited
+ *     - ESP_ERR_TIMEOUT Take bus mutex timeout
+ *     - ESP_ERR_NOT_SUPPORTED CONFIG_I2C_BUS_TRACE not enabled
+ */
+esp_err_t i2c_bus_trace_clear(i2c_bus_handle_t bus_handle);
+
+/**
+ * @brief Send the transfers of a trace again on a bus, with the recorded spacing, to reproduce field traffic.
+ *        Linux target only, where virtual devices stand in for the traced ones, so driver changes can be
+ *        benchmarked against real traffic, see test_apps/trace_replay. Devices are created on the bus as needed,
+ *        at the recorded clock speed, and deleted at the end.
+ *        Data is not traced: reads are discarded and writes send zeros, which is why real devices are never replayed to.
+ *        Transaction links are sent as one transaction reading then writing at their first address.
+ *        Retries are skipped, the driver under test makes its own.
+ *
+ * @param bus_handle I2C bus handle, the port of the entries is ignored
+ * @param entries Traced transfers, as saved by i2c_bus_trace_dump
+ * @param num Number of entries
+ * @param stats Pointer to save the replay result
+ * @return esp_err_t
+ *     - ESP_OK Replay done, failed transfers are counted in stats
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_INVALID_STATE i2c_bus not inited
+ *     - ESP_ERR_NO_MEM Out of memory
+ *     - ESP_ERR_NOT_SUPPORTED Not the linux target
+ */
+esp_err_t i2c_bus_trace_replay(i2c_bus_handle_t bus_handle, const i2c_bus_trace_entry_t *entries, size_t num, i2c_bus_trace_replay_stats_t *stats);
+
 /**
  * @brief Create an I2C device on specific bus.
  *        Dynamic configuration must be enable to achieve multiple devices with different configs on a single bus.
@@ -88,10 +674,21 @@ uint8_t i2c_bus_get_created_device_num(i2c_bus_handle_t bus_handle);
  * @param bus_handle Point to the I2C bus handle
  * @param dev_addr i2c device address
  * @param clk_speed device specified clock frequency the i2c_bus will switch to during each transfer. 0 if use current bus speed.
+ *        Up to I2C_BUS_CLK_SPEED_MAX, 1 MHz if Fast-mode Plus is enabled in menuconfig (ESP32 only).
  * @return i2c_bus_device_handle_t return a device handle if created successfully, return NULL if failed.
  */
 i2c_bus_device_handle_t i2c_bus_device_create(i2c_bus_handle_t bus_handle, uint8_t dev_addr, uint32_t clk_speed);
 
+/**
+ * @brief Create an I2C device on specific bus with extended configuration, e.g. priority class.
+ *        i2c_bus_device_create is the same with priority I2C_BUS_PRIO_NORMAL.
+ *
+ * @param bus_handle Point to the I2C bus handle
+ * @param dev_conf Pointer to the device configuration
+ * @return i2c_bus_device_handle_t return a device handle if created successfully, return NULL if failed.
+ */
+i2c_bus_device_handle_t i2c_bus_device_create_with_config(i2c_bus_handle_t bus_handle, const i2c_bus_device_config_t *dev_conf);
+
 /**
  * @brief Delete and release the I2C device resource, i2c_bus_device_delete should be used in pairs with i2c_bus_device_create.
  *
@@ -102,6 +699,59 @@ i2c_bus_device_handle_t i2c_bus_device_create(i2c_bus_handle_t bus_handle, uint8
  */
 esp_err_t i2c_bus_device_delete(i2c_bus_device_handle_t *p_dev_handle);
 
+/**
+ * @brief Set retry policy of a device. A failed register read (NACK or timeout) is sent again up to retries times,
+ *        waiting backoff_us before the first retry and twice longer before each next one, up to 100 ms.
+ *        Transfers writing data, including transactions with a write and raw command links, are never retried:
+ *        a write may have reached the device before the transfer failed.
+ *        Reads of registers with side effects (e.g. FIFO pop, clear on read) should not be used with retries.
+ *        Waits shorter than a tick are busy waits with the bus taken, so keep them in the microseconds range.
+ *
+ * @param dev_handle I2C device handle
+ * @param retries Number of retries, 0 to disable
+ * @param backoff_us Wait before the first retry
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_TIMEOUT Take bus mutex timeout
+ */
+esp_err_t i2c_bus_device_set_retry(i2c_bus_device_handle_t dev_handle, uint8_t retries, uint32_t backoff_us);
+
+/**
+ * @brief Set the default time budget of calls to a device, bus wait, transfer and retries included.
+ *        Calls fail with ESP_ERR_TIMEOUT when it is used, the *_timeout variants override it per call.
+ *
+ * @param dev_handle I2C device handle
+ * @param timeout_ms Time budget, 0 for the default 200 ms
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_TIMEOUT Take bus mutex timeout
+ */
+esp_err_t i2c_bus_device_set_timeout(i2c_bus_device_handle_t dev_handle, uint32_t timeout_ms);
+
+/**
+ * @brief Find the highest reliable clock speed of a device and use it for its following transfers.
+ *        The clock is stepped up from 100 kHz to clk_max, at each step a register with a known value (e.g. WHO_AM_I)
+ *        is read several times, stepping stops at the first wrong value or failed transfer.
+ *        Needs I2C_BUS_DYNAMIC_CONFIG, without it the bus clock is never switched.
+ *        Register cache is bypassed. Only use it with devices which tolerate reads above their rated speed.
+ *        A device created with clock speed 0 keeps the bus clock, the speed found is only reported.
+ *
+ * @param dev_handle I2C device handle
+ * @param mem_address Register with a known value
+ * @param expected Known value of the register
+ * @param clk_max Highest speed to try, limited to I2C_BUS_CLK_SPEED_MAX, always tried last, a limit below 100 kHz is probed alone
+ * @param clk_speed Pointer to save the speed found, can be NULL
+ * @return esp_err_t
+ *     - ESP_OK Success, device clock speed updated unless created with clock speed 0
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_NOT_FOUND Register value wrong even at the lowest speed, device clock speed unchanged
+ *     - ESP_ERR_NOT_SUPPORTED I2C_BUS_DYNAMIC_CONFIG disabled
+ *     - ESP_ERR_TIMEOUT Take bus mutex timeout
+ */
+esp_err_t i2c_bus_device_probe_clk_speed(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, uint8_t expected, uint32_t clk_max, uint32_t *clk_speed);
+
 /**
  * @brief Get device's I2C address
  * 
@@ -110,6 +760,98 @@ esp_err_t i2c_bus_device_delete(i2c_bus_device_handle_t *p_dev_handle);
  */
 uint8_t i2c_bus_device_get_address(i2c_bus_device_handle_t dev_handle);
 
+/**
+ * @brief Enable register shadow cache of an i2c device with 8-bit internal register address.
+ *        Values written to or read from non-volatile registers are kept in the cache, following reads of these registers
+ *        are served without bus access and i2c_bus_write_bit/i2c_bus_write_bits become a single write.
+ *        Multiple bytes accesses are assumed to auto-increment the register address, registers which do not
+ *        (e.g. FIFO ports) must be declared volatile. Transfers sent with i2c_bus_cmd_begin bypass the cache,
+ *        call i2c_bus_reg_cache_invalidate after them. Calling it again replaces the volatile list, drops all values and stops coalescing.
+ *
+ * @param dev_handle I2C device handle
+ * @param volatile_regs Registers which can be changed by the device (status, data, FIFO...), never cached
+ * @param num Number of volatile registers
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_NO_MEM Allocate cache failed
+ *     - ESP_ERR_TIMEOUT Take bus mutex timeout
+ */
+esp_err_t i2c_bus_reg_cache_enable(i2c_bus_device_handle_t dev_handle, const uint8_t *volatile_regs, size_t num);
+
+/**
+ * @brief Disable and release register shadow cache of an i2c device
+ *
+ * @param dev_handle I2C device handle
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_TIMEOUT Take bus mutex timeout
+ */
+esp_err_t i2c_bus_reg_cache_disable(i2c_bus_device_handle_t dev_handle);
+
+/**
+ * @brief Drop cached values of registers, next read of them goes to the device
+ *
+ * @param dev_handle I2C device handle
+ * @param mem_address First register to drop
+ * @param data_len Number of registers to drop
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_TIMEOUT Take bus mutex timeout
+ */
+esp_err_t i2c_bus_reg_cache_invalidate(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, size_t data_len);
+
+/**
+ * @brief Drop all cached register values of a device, e.g. after a device reset
+ *
+ * @param dev_handle I2C device handle
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_TIMEOUT Take bus mutex timeout
+ */
+esp_err_t i2c_bus_reg_cache_invalidate_all(i2c_bus_device_handle_t dev_handle);
+
+/**
+ * @brief Coalesce reads of volatile registers (status...) of a device with register cache enabled.
+ *        A read of coalesced registers within window_us after they were last read from the device returns that value
+ *        without bus access. A reader waiting for the bus while the same registers are on the wire gets the result of
+ *        that transfer, so concurrent identical reads cost one transfer. Writes to a coalesced register and
+ *        i2c_bus_reg_cache_invalidate drop its value, RMW always reads the device. A read of other volatile
+ *        registers drops all coalesced values, as read-to-clear flags may have changed, and so do transfers the cache
+ *        can not follow: i2c_bus_cmd_begin, 16-bit address accesses, streams and accesses without register address.
+ *        Registers changed by a write to another register (e.g. interrupt clear) must be invalidated by the caller.
+ *
+ * @param dev_handle I2C device handle
+ * @param regs Registers to coalesce, registers not in the volatile list of i2c_bus_reg_cache_enable are ignored
+ * @param num Number of registers, 0 to stop coalescing
+ * @param window_us Time a value read from the device is served, 0 to stop coalescing
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_INVALID_STATE Register cache not enabled
+ *     - ESP_ERR_NO_MEM Allocate cache failed
+ *     - ESP_ERR_TIMEOUT Take bus mutex timeout
+ */
+esp_err_t i2c_bus_reg_cache_set_coalesce(i2c_bus_device_handle_t dev_handle, const uint8_t *regs, size_t num, uint32_t window_us);
+
+/**
+ * @brief Read registers from the device and refresh their cached values
+ *
+ * @param dev_handle I2C device handle
+ * @param mem_address First register to read
+ * @param data_len Number of registers to read
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_INVALID_STATE Register cache not enabled
+ *     - ESP_FAIL Sending command error, slave doesn't ACK the transfer.
+ *     - ESP_ERR_TIMEOUT Operation timeout because the bus is busy.
+ */
+esp_err_t i2c_bus_reg_cache_sync(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, size_t data_len);
+
 /**
  * @brief Read single byte from i2c device with 8-bit internal register/memory address
  *
@@ -142,6 +884,24 @@ esp_err_t i2c_bus_read_byte(i2c_bus_device_handle_t dev_handle, uint8_t mem_addr
  */
 esp_err_t i2c_bus_read_bytes(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, size_t data_len, uint8_t *data);
 
+/**
+ * @brief Same as i2c_bus_read_bytes with a time budget for this call, instead of the device default.
+ *        The budget covers bus wait, transfer and retries, a retry that would end after it is not started.
+ *
+ * @param dev_handle I2C device handle
+ * @param mem_address The internal reg/mem address to read from, set to NULL_I2C_MEM_ADDR if no internal address.
+ * @param data_len Number of bytes to read
+ * @param data Pointer to a buffer to save the data that was read
+ * @param timeout_ms Time budget of the call, 0 for the device default
+ * @return esp_err_t 
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_FAIL Sending command error, slave doesn't ACK the transfer.
+ *     - ESP_ERR_INVALID_STATE I2C driver not installed or not in master mode.
+ *     - ESP_ERR_TIMEOUT Budget used before the bus was free or the transfer completed.
+ */
+esp_err_t i2c_bus_read_bytes_timeout(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, size_t data_len, uint8_t *data, uint32_t timeout_ms);
+
 /**
  * @brief Read single bit of a byte from i2c device with 8-bit internal register/memory address
  *
@@ -207,6 +967,24 @@ esp_err_t i2c_bus_write_byte(i2c_bus_device_handle_t dev_handle, uint8_t mem_add
  */
 esp_err_t i2c_bus_write_bytes(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, size_t data_len, const uint8_t *data);
 
+/**
+ * @brief Same as i2c_bus_write_bytes with a time budget for this call, instead of the device default.
+ *        The budget covers bus wait, transfer and retries, a retry that would end after it is not started.
+ *
+ * @param dev_handle I2C device handle
+ * @param mem_address The internal reg/mem address to write to, set to NULL_I2C_MEM_ADDR if no internal address.
+ * @param data_len Number of bytes to write
+ * @param data Pointer to the bytes to write.
+ * @param timeout_ms Time budget of the call, 0 for the device default
+ * @return esp_err_t 
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_FAIL Sending command error, slave doesn't ACK the transfer.
+ *     - ESP_ERR_INVALID_STATE I2C driver not installed or not in master mode.
+ *     - ESP_ERR_TIMEOUT Budget used before the bus was free or the transfer completed.
+ */
+esp_err_t i2c_bus_write_bytes_timeout(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, size_t data_len, const uint8_t *data, uint32_t timeout_ms);
+
 /**
  * @brief Write single bit of a byte to an i2c device with 8-bit internal register/memory address
  *
@@ -240,6 +1018,359 @@ esp_err_t i2c_bus_write_bit(i2c_bus_device_handle_t dev_handle, uint8_t mem_addr
  */
 esp_err_t i2c_bus_write_bits(i2c_bus_device_handle_t dev_handle, uint8_t mem_address, uint8_t bit_start, uint8_t length, uint8_t data);
 
+/**
+ * @brief Begin a transaction on an i2c device, operations are only queued in txn until i2c_bus_txn_commit.
+ *
+ * @param txn Pointer to the transaction to initialize
+ * @param dev_handle I2C device handle
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ */
+esp_err_t i2c_bus_txn_begin(i2c_bus_txn_t *txn, i2c_bus_device_handle_t dev_handle);
+
+/**
+ * @brief Add a multiple bytes read with 8-bit internal register/memory address to the transaction
+ *
+ * @param txn Pointer to the transaction
+ * @param mem_address The internal reg/mem address to read from, set to NULL_I2C_MEM_ADDR if no internal address.
+ * @param data_len Number of bytes to read
+ * @param data Pointer to a buffer to save the data, filled after commit
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_NO_MEM Transaction is full, I2C_BUS_TXN_MAX_OPS reached
+ */
+esp_err_t i2c_bus_txn_add_read(i2c_bus_txn_t *txn, uint8_t mem_address, size_t data_len, uint8_t *data);
+
+/**
+ * @brief Add a multiple bytes write with 8-bit internal register/memory address to the transaction
+ *
+ * @param txn Pointer to the transaction
+ * @param mem_address The internal reg/mem address to write to, set to NULL_I2C_MEM_ADDR if no internal address.
+ * @param data_len Number of bytes to write
+ * @param data Pointer to the bytes to write, must be valid until commit
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_NO_MEM Transaction is full, I2C_BUS_TXN_MAX_OPS reached
+ */
+esp_err_t i2c_bus_txn_add_write(i2c_bus_txn_t *txn, uint8_t mem_address, size_t data_len, const uint8_t *data);
+
+/**
+ * @brief Add a single byte write with 8-bit internal register/memory address to the transaction,
+ *        the byte is copied into the transaction.
+ *
+ * @param txn Pointer to the transaction
+ * @param mem_address The internal reg/mem address to write to, set to NULL_I2C_MEM_ADDR if no internal address.
+ * @param data The byte to write
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_NO_MEM Transaction is full, I2C_BUS_TXN_MAX_OPS reached
+ */
+esp_err_t i2c_bus_txn_add_write_byte(i2c_bus_txn_t *txn, uint8_t mem_address, uint8_t data);
+
+/**
+ * @brief Add a read-modify-write of a register to the transaction, register = (register & ~mask) | (data & mask)
+ *
+ * @param txn Pointer to the transaction
+ * @param mem_address The internal reg/mem address to modify
+ * @param mask The bits to modify
+ * @param data The new value of the masked bits
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_NO_MEM Transaction is full, I2C_BUS_TXN_MAX_OPS reached
+ */
+esp_err_t i2c_bus_txn_add_rmw(i2c_bus_txn_t *txn, uint8_t mem_address, uint8_t mask, uint8_t data);
+
+/**
+ * @brief Send all operations of the transaction with a single bus mutex acquisition.
+ *        Operations are packed into as few command links as possible, an RMW or a full command link splits the transfer.
+ *        RMW of a register held in the register shadow cache is sent as a single write.
+ *        Execution stops at the first failed transfer, result of each operation is saved in txn->ops[i].ret.
+ *
+ * @param txn Pointer to the transaction
+ * @return esp_err_t
+ *     - ESP_OK All operations succeed
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_NO_MEM Too many operations were added to the transaction
+ *     - ESP_FAIL Sending command error, slave doesn't ACK the transfer.
+ *     - ESP_ERR_INVALID_STATE I2C driver not installed or not in master mode.
+ *     - ESP_ERR_TIMEOUT Operation timeout because the bus is busy.
+ */
+esp_err_t i2c_bus_txn_commit(i2c_bus_txn_t *txn);
+
+/**
+ * @brief Drop all operations of a transaction, so it can be filled again for the same device, e.g. after a commit.
+ *
+ * @param txn Pointer to the transaction
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error or transaction not begun
+ */
+esp_err_t i2c_bus_txn_reset(i2c_bus_txn_t *txn);
+
+/**
+ * @brief Read all registers of a register map with one bus acquisition per I2C_BUS_TXN_MAX_OPS bursts.
+ *        Runs of consecutive addresses are read as a single burst.
+ *
+ * @param dev_handle I2C device handle
+ * @param map Pointer to the register map
+ * @param values Buffer of map->num bytes, values[i] is the value of map->regs[i]
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_FAIL Sending command error, slave doesn't ACK the transfer.
+ *     - ESP_ERR_TIMEOUT Operation timeout because the bus is busy.
+ */
+esp_err_t i2c_bus_regmap_read(i2c_bus_device_handle_t dev_handle, const i2c_bus_regmap_t *map, uint8_t *values);
+
+/**
+ * @brief Write all registers of a register map, in map order, runs of consecutive addresses as a single burst.
+ *
+ * @param dev_handle I2C device handle
+ * @param map Pointer to the register map
+ * @param values Values to write, values[i] goes to map->regs[i]
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_FAIL Sending command error, slave doesn't ACK the transfer.
+ *     - ESP_ERR_TIMEOUT Operation timeout because the bus is busy.
+ */
+esp_err_t i2c_bus_regmap_write(i2c_bus_device_handle_t dev_handle, const i2c_bus_regmap_t *map, const uint8_t *values);
+
+/**
+ * @brief Queue a request to the worker task of the bus and return immediately.
+ *        The worker task is created on the first submit, requests are served in submit order.
+ *        On completion req->ret is set, then req->callback is called and req->notify_task is notified.
+ *        menuconfig:Bus Options->I2C Bus Options->enable asynchronous requests
+ *
+ * @param req Pointer to the request, must be valid until completion
+ * @param ticks_to_wait Max ticks to wait for a free slot if the request queue is full
+ * @return esp_err_t
+ *     - ESP_OK Request queued
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_NO_MEM Create worker task failed
+ *     - ESP_ERR_TIMEOUT Request queue is full
+ *     - ESP_ERR_NOT_SUPPORTED Asynchronous requests not enabled
+ */
+esp_err_t i2c_bus_submit(i2c_bus_request_t *req, TickType_t ticks_to_wait);
+
+/**
+ * @brief Queue a request to the worker task of the bus and wait for its completion.
+ *        Must not be called from a request callback, the worker would wait for itself.
+ *
+ * @param req Pointer to the request
+ * @param ticks_to_wait Max ticks to wait for a free slot if the request queue is full
+ * @return esp_err_t
+ *     - req->ret Request completed
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_INVALID_STATE Called from the worker task of the bus
+ *     - ESP_ERR_NO_MEM Create worker task failed
+ *     - ESP_ERR_TIMEOUT Request queue is full
+ *     - ESP_ERR_NOT_SUPPORTED Asynchronous requests not enabled
+ */
+esp_err_t i2c_bus_submit_sync(i2c_bus_request_t *req, TickType_t ticks_to_wait);
+
+/**
+ * @brief Read a large burst, e.g. a sensor FIFO, in chunks handed to a consumer callback.
+ *        Every chunk is a separate transfer, other devices can take the bus between chunks.
+ *        Chunks are always read from the device: register cache, read coalescing and retries are bypassed,
+ *        a FIFO pop read twice would lose data.
+ *        With asynchronous requests enabled, chunk N+1 is read by the bus worker while on_chunk processes chunk N,
+ *        otherwise chunks are read and consumed in turn. Must not be called from a request callback.
+ *
+ * @param dev_handle I2C device handle
+ * @param stream_conf Pointer to the stream configuration
+ * @param data_len Total number of bytes to read, the last chunk may be shorter
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_FAIL Sending command error, slave doesn't ACK the transfer.
+ *     - ESP_ERR_INVALID_STATE I2C driver not installed or not in master mode.
+ *     - ESP_ERR_TIMEOUT Operation timeout because the bus is busy.
+ */
+esp_err_t i2c_bus_read_stream(i2c_bus_device_handle_t dev_handle, const i2c_bus_stream_config_t *stream_conf, size_t data_len);
+
+/**
+ * @brief Bind the interrupt line of a device to a request. While the line is asserted its interrupt is masked and
+ *        the request is queued to the bus worker ahead of other requests, the line is unmasked once the request
+ *        callback returns. The line is level triggered, the request callback or the request itself must clear
+ *        the interrupt condition of the device, else it is served again at once.
+ *        menuconfig:Bus Options->I2C Bus Options->enable interrupt-driven reads
+ *
+ * @param dev_handle I2C device handle
+ * @param irq_conf Pointer to the binding, irq_conf->req must access dev_handle
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_INVALID_STATE i2c_bus not inited or device already bound
+ *     - ESP_ERR_NO_MEM Create worker task failed
+ *     - ESP_ERR_NOT_SUPPORTED Interrupt-driven reads not enabled
+ */
+esp_err_t i2c_bus_device_bind_irq(i2c_bus_device_handle_t dev_handle, const i2c_bus_irq_config_t *irq_conf);
+
+/**
+ * @brief Unbind the interrupt line of a device, a request already queued is served first.
+ *        Must not be called from a request callback. Devices are unbound by i2c_bus_device_delete.
+ *
+ * @param dev_handle I2C device handle
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error or device not bound
+ *     - ESP_ERR_NOT_SUPPORTED Interrupt-driven reads not enabled
+ */
+esp_err_t i2c_bus_device_unbind_irq(i2c_bus_device_handle_t dev_handle);
+
+/**
+ * @brief Get interrupt-driven read counters of a device
+ *
+ * @param dev_handle I2C device handle
+ * @param stats Pointer to save the counters
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_NOT_SUPPORTED Interrupt-driven reads not enabled
+ */
+esp_err_t i2c_bus_device_get_irq_stats(i2c_bus_device_handle_t dev_handle, i2c_bus_irq_stats_t *stats);
+
+/**
+ * @brief Create a group of buses served in parallel, e.g. I2C_NUM_0 and I2C_NUM_1.
+ *        The worker task of each bus is pinned to its own core (bus i to core i % portNUM_PROCESSORS), so the
+ *        asynchronous requests of both controllers are served at the same time. Workers already running are
+ *        restarted on their new core, create the group before submitting requests.
+ *        Buses are not owned by the group, delete the group before the buses.
+ *
+ * @param buses Buses of the group, created with i2c_bus_create on different ports
+ * @param num Number of buses, max I2C_NUM_MAX
+ * @return i2c_bus_group_handle_t Return NULL if failed
+ */
+i2c_bus_group_handle_t i2c_bus_group_create(const i2c_bus_handle_t *buses, uint8_t num);
+
+/**
+ * @brief Delete a bus group, buses are left untouched. Devices created through the group are kept
+ *        as plain devices of their bus, delete them with i2c_bus_device_delete.
+ *
+ * @param p_group Point to the group handle, set to NULL if deleted
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ */
+esp_err_t i2c_bus_group_delete(i2c_bus_group_handle_t *p_group);
+
+/**
+ * @brief Create a device on the least loaded bus of the group it answers on.
+ *        Every bus is probed at dev_conf->dev_addr, buses that already have a device at this address created through
+ *        the group are skipped, so identical sensors with a fixed address wired to both ports are spread one per bus.
+ *
+ * @param group Bus group handle
+ * @param dev_conf Pointer to device configuration
+ * @param load Expected bus load of the device in any unit consistent across the group, e.g. bytes per second
+ * @return i2c_bus_device_handle_t Return NULL if failed or the device answers on no free bus
+ */
+i2c_bus_device_handle_t i2c_bus_group_device_create(i2c_bus_group_handle_t group, const i2c_bus_device_config_t *dev_conf, uint32_t load);
+
+/**
+ * @brief Delete a device created with i2c_bus_group_device_create, its load is removed from its bus.
+ *        i2c_bus_device_delete does the same for a device of a group.
+ *
+ * @param group Bus group handle
+ * @param p_dev_handle Point to the device handle, set to NULL if deleted
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error or the device is not in the group
+ */
+esp_err_t i2c_bus_group_device_delete(i2c_bus_group_handle_t group, i2c_bus_device_handle_t *p_dev_handle);
+
+/**
+ * @brief Get the utilisation of every bus of the group since the previous call, or since the group was created
+ *
+ * @param group Bus group handle
+ * @param util Array to save the utilisation, in the order of the buses given to i2c_bus_group_create
+ * @param num Length of util, buses beyond it are not reported
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_TIMEOUT Bus is busy
+ */
+esp_err_t i2c_bus_group_get_util(i2c_bus_group_handle_t group, i2c_bus_group_util_t *util, uint8_t num);
+
+/**
+ * @brief Create a periodic read scheduler on a bus. Its task serves the released reads of all its jobs earliest
+ *        deadline first and sleeps until the next release in between, reads take the bus with the priority of
+ *        their device. Use it instead of one polling task per sensor to keep sample timestamps regular.
+ *        menuconfig:Bus Options->I2C Bus Options->enable periodic read scheduler
+ *
+ * @param bus_handle I2C bus handle
+ * @param sched_conf Pointer to the scheduler configuration, NULL for defaults
+ * @return i2c_bus_sched_handle_t Return NULL if failed or the scheduler is not enabled
+ */
+i2c_bus_sched_handle_t i2c_bus_sched_create(i2c_bus_handle_t bus_handle, const i2c_bus_sched_config_t *sched_conf);
+
+/**
+ * @brief Stop the scheduler task and delete the scheduler with its jobs, a read in progress is completed first.
+ *        Must not be called from a job callback.
+ *
+ * @param p_sched Point to the scheduler handle, set to NULL if deleted
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_NOT_SUPPORTED Scheduler not enabled
+ */
+esp_err_t i2c_bus_sched_delete(i2c_bus_sched_handle_t *p_sched);
+
+/**
+ * @brief Add a periodic read, first released now. The read time is estimated from the device clock speed
+ *        and data_len. The job is rejected if the job set would no longer meet every deadline under
+ *        non-preemptive earliest deadline first scheduling within the utilisation limit: for each job,
+ *        the density (read time / deadline) of the jobs with shorter or equal deadlines plus the blocking
+ *        of the longest read with a longer deadline must stay below the limit.
+ *        Retries and other traffic on the bus are not accounted, keep the limit below 1000 to leave room for them.
+ *        The time from release to completion, hence the jitter of the sample timestamps, stays below the deadline,
+ *        a deadline close to the read time gives regular timestamps. This bound only holds if the scheduler is
+ *        alone on the bus: admission does not know transfers of other tasks, each of them can hold a release
+ *        back by its own duration and make the job miss its deadline (counted in i2c_bus_sched_stats_t).
+ *        Must not be called from a job callback.
+ *
+ * @param sched Scheduler handle
+ * @param job_conf Pointer to the job configuration
+ * @param p_job Pointer to save the job handle
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_NO_MEM Allocate job failed
+ *     - ESP_FAIL Job set not schedulable, job not added
+ *     - ESP_ERR_NOT_SUPPORTED Scheduler not enabled
+ */
+esp_err_t i2c_bus_sched_add_job(i2c_bus_sched_handle_t sched, const i2c_bus_sched_job_config_t *job_conf, i2c_bus_sched_job_handle_t *p_job);
+
+/**
+ * @brief Remove a periodic read, a read of the job in progress is completed first.
+ *        Jobs of a device must be removed before the device is deleted. Must not be called from a job callback.
+ *
+ * @param sched Scheduler handle
+ * @param p_job Point to the job handle, set to NULL if removed
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error or the job is not in the scheduler
+ *     - ESP_ERR_NOT_SUPPORTED Scheduler not enabled
+ */
+esp_err_t i2c_bus_sched_remove_job(i2c_bus_sched_handle_t sched, i2c_bus_sched_job_handle_t *p_job);
+
+/**
+ * @brief Get counters of a scheduler since it was created
+ *
+ * @param sched Scheduler handle
+ * @param stats Pointer to save the counters
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_NOT_SUPPORTED Scheduler not enabled
+ */
+esp_err_t i2c_bus_sched_get_stats(i2c_bus_sched_handle_t sched, i2c_bus_sched_stats_t *stats);
+
 /**************************************** Public Functions (Low level)*********************************************/
 
 /**
@@ -278,6 +1409,24 @@ esp_err_t i2c_bus_cmd_begin(i2c_bus_device_handle_t dev_handle, i2c_cmd_handle_t
  */
 esp_err_t i2c_bus_write_reg16(i2c_bus_device_handle_t dev_handle, uint16_t mem_address, size_t data_len, const uint8_t *data);
 
+/**
+ * @brief Same as i2c_bus_write_reg16 with a time budget for this call, instead of the device default.
+ *        The budget covers bus wait, transfer and retries, a retry that would end after it is not started.
+ *
+ * @param dev_handle I2C device handle
+ * @param mem_address The internal 16-bit reg/mem address to write to, set to NULL_I2C_MEM_ADDR if no internal address.
+ * @param data_len Number of bytes to write
+ * @param data Pointer to the bytes to write.
+ * @param timeout_ms Time budget of the call, 0 for the device default
+ * @return esp_err_t 
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_FAIL Sending command error, slave doesn't ACK the transfer.
+ *     - ESP_ERR_INVALID_STATE I2C driver not installed or not in master mode.
+ *     - ESP_ERR_TIMEOUT Budget used before the bus was free or the transfer completed.
+ */
+esp_err_t i2c_bus_write_reg16_timeout(i2c_bus_device_handle_t dev_handle, uint16_t mem_address, size_t data_len, const uint8_t *data, uint32_t timeout_ms);
+
 /**
  * @brief Read date from i2c device with 16-bit internal reg/mem address
  *
@@ -294,6 +1443,24 @@ esp_err_t i2c_bus_write_reg16(i2c_bus_device_handle_t dev_handle, uint16_t mem_a
  */
 esp_err_t i2c_bus_read_reg16(i2c_bus_device_handle_t dev_handle, uint16_t mem_address, size_t data_len, uint8_t *data);
 
+/**
+ * @brief Same as i2c_bus_read_reg16 with a time budget for this call, instead of the device default.
+ *        The budget covers bus wait, transfer and retries, a retry that would end after it is not started.
+ *
+ * @param dev_handle I2C device handle
+ * @param mem_address The internal 16-bit reg/mem address to read from, set to NULL_I2C_MEM_ADDR if no internal address.
+ * @param data_len Number of bytes to read
+ * @param data Pointer to a buffer to save the data that was read
+ * @param timeout_ms Time budget of the call, 0 for the device default
+ * @return esp_err_t 
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_FAIL Sending command error, slave doesn't ACK the transfer.
+ *     - ESP_ERR_INVALID_STATE I2C driver not installed or not in master mode.
+ *     - ESP_ERR_TIMEOUT Budget used before the bus was free or the transfer completed.
+ */
+esp_err_t i2c_bus_read_reg16_timeout(i2c_bus_device_handle_t dev_handle, uint16_t mem_address, size_t data_len, uint8_t *data, uint32_t timeout_ms);
+
 #ifdef __cplusplus
 }
 #endif
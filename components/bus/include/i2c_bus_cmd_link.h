@@ -0,0 +1,68 @@
+// Copyright 2020-2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _I2C_BUS_CMD_LINK_H_
+#define _I2C_BUS_CMD_LINK_H_
+
+/**
+ * Command link recorder of the backends replacing the legacy driver (linux simulation and i2c_master), internal use.
+ * i2c_cmd_link_create and i2c_master_start..i2c_master_stop record commands in memory (i2c_bus_cmd_link.c),
+ * i2c_master_cmd_begin of the backend walks them.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define I2C_BUS_CMD_TYPE_START 0 /*!< START or repeated START */
+#define I2C_BUS_CMD_TYPE_WRITE 1 /*!< bytes written */
+#define I2C_BUS_CMD_TYPE_READ 2  /*!< bytes read */
+#define I2C_BUS_CMD_TYPE_STOP 3  /*!< STOP */
+
+/**
+ * @brief one recorded command of a command link, internal use
+ */
+typedef struct
+{
+    uint8_t type;      /*!< start, write, read or stop */
+    uint8_t ack;       /*!< ack check of a write, ack type of a read */
+    uint8_t byte;      /*!< single byte written */
+    uint8_t *data;     /*!< data written or read buffer, NULL for single byte write */
+    size_t data_len;   /*!< data length */
+} i2c_bus_cmd_t;
+
+/**
+ * @brief recorded command link, internal use
+ */
+typedef struct
+{
+    i2c_bus_cmd_t *cmds; /*!< recorded commands */
+    size_t num;          /*!< number of recorded commands */
+    size_t max;          /*!< capacity of cmds */
+    bool is_static;      /*!< link is placed in a user buffer */
+} i2c_bus_cmd_link_t;
+
+#define I2C_INTERNAL_STRUCT_SIZE (sizeof(i2c_bus_cmd_t))
+#define I2C_LINK_RECOMMENDED_SIZE(TRANSACTIONS) (sizeof(i2c_bus_cmd_link_t) + sizeof(void *) + I2C_INTERNAL_STRUCT_SIZE * (5 * (TRANSACTIONS)))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
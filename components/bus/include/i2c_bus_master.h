@@ -0,0 +1,122 @@
+// Copyright 2020-2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef _I2C_BUS_MASTER_H_
+#define _I2C_BUS_MASTER_H_
+
+/**
+ * i2c_master backend, ESP-IDF v5.2 or later.
+ * Provides the subset of the legacy I2C master driver (driver/i2c.h) used by i2c_bus on top of driver/i2c_master.h.
+ * Command links are recorded in memory, each START..START/STOP segment of a link is sent as one i2c_master
+ * transmit, receive or transmit-receive to a device handle cached per address and clock speed.
+ * Port, mode, read/write and ack types come from hal/i2c_types.h, legacy names are mapped to i2c_bus_master_*
+ * symbols so the legacy driver can still be linked into the same image.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "i2c_bus_cmd_link.h"
+#include "driver/i2c_master.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**************************************** Legacy driver subset *********************************************/
+
+#ifndef I2C_SCLK_SRC_FLAG_FOR_NOMAL
+#define I2C_SCLK_SRC_FLAG_FOR_NOMAL (0) /*!< Any one clock source that is available for the specified frequency may be choosen */
+#endif
+
+/**
+ * @brief I2C initialization parameters, same layout as the legacy driver
+ */
+typedef struct
+{
+    i2c_mode_t mode;    /*!< I2C mode */
+    int sda_io_num;     /*!< GPIO number for I2C sda signal */
+    int scl_io_num;     /*!< GPIO number for I2C scl signal */
+    bool sda_pullup_en; /*!< Internal GPIO pull mode for I2C sda signal*/
+    bool scl_pullup_en; /*!< Internal GPIO pull mode for I2C scl signal*/
+
+    union
+    {
+        struct
+        {
+            uint32_t clk_speed; /*!< I2C clock frequency for master mode */
+        } master;
+        struct
+        {
+            uint8_t addr_10bit_en; /*!< I2C 10bit address mode enable for slave mode */
+            uint16_t slave_addr;   /*!< I2C address for slave mode */
+        } slave;
+    };
+    uint32_t clk_flags; /*!< Bitwise of ``I2C_SCLK_SRC_FLAG_**FOR_DFS**`` for clk source choice*/
+} i2c_config_t;
+
+typedef void *i2c_cmd_handle_t; /*!< I2C command handle  */
+
+#define i2c_param_config i2c_bus_master_param_config
+#define i2c_driver_install i2c_bus_master_driver_install
+#define i2c_driver_delete i2c_bus_master_driver_delete
+#define i2c_cmd_link_create i2c_bus_master_link_create
+#define i2c_cmd_link_create_static i2c_bus_master_link_create_static
+#define i2c_cmd_link_delete i2c_bus_master_link_delete
+#define i2c_cmd_link_delete_static i2c_bus_master_link_delete_static
+#define i2c_master_start i2c_bus_master_link_start
+#define i2c_master_write_byte i2c_bus_master_link_write_byte
+#define i2c_master_write i2c_bus_master_link_write
+#define i2c_master_read_byte i2c_bus_master_link_read_byte
+#define i2c_master_read i2c_bus_master_link_read
+#define i2c_master_stop i2c_bus_master_link_stop
+#define i2c_master_cmd_begin i2c_bus_master_link_begin
+
+esp_err_t i2c_param_config(i2c_port_t i2c_num, const i2c_config_t *i2c_conf);
+esp_err_t i2c_driver_install(i2c_port_t i2c_num, i2c_mode_t mode, size_t slv_rx_buf_len, size_t slv_tx_buf_len, int intr_alloc_flags);
+esp_err_t i2c_driver_delete(i2c_port_t i2c_num);
+i2c_cmd_handle_t i2c_cmd_link_create(void);
+i2c_cmd_handle_t i2c_cmd_link_create_static(uint8_t *buffer, uint32_t size);
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd_handle);
+void i2c_cmd_link_delete_static(i2c_cmd_handle_t cmd_handle);
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd_handle);
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd_handle, uint8_t data, bool ack_en);
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd_handle, const uint8_t *data, size_t data_len, bool ack_en);
+esp_err_t i2c_master_read_byte(i2c_cmd_handle_t cmd_handle, uint8_t *data, i2c_ack_type_t ack);
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd_handle, uint8_t *data, size_t data_len, i2c_ack_type_t ack);
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd_handle);
+esp_err_t i2c_master_cmd_begin(i2c_port_t i2c_num, i2c_cmd_handle_t cmd_handle, TickType_t ticks_to_wait);
+
+/**************************************** Backend extensions *********************************************/
+
+/**
+ * @brief Change the SCL frequency of next transfers without removing the bus.
+ *        Device handles of the previous frequency stay cached, switching back adds no device.
+ *
+ * @param port I2C port number
+ * @param clk_speed new SCL frequency
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ *     - ESP_ERR_INVALID_STATE Driver not installed
+ */
+esp_err_t i2c_bus_master_set_clk_speed(i2c_port_t port, uint32_t clk_speed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
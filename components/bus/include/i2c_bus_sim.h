@@ -0,0 +1,288 @@
+// Copyright 2020-2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef _I2C_BUS_SIM_H_
+#define _I2C_BUS_SIM_H_
+
+/**
+ * Simulated I2C bus for the linux target.
+ * Provides the subset of the legacy I2C master driver (driver/i2c.h) used by i2c_bus, transfers are served by
+ * virtual devices modelled as 256 byte register maps. No real time is spent on a transfer, a virtual clock is
+ * advanced by the wire time the transfer would take at the configured SCL frequency.
+ *
+ * The linux target needs ESP-IDF v5.0 or later, while the rest of the project is built with v4.x.
+ * i2c_bus keeps using the v4 names (e.g. portTICK_RATE_MS), so the FreeRTOS simulator has to be
+ * built with configENABLE_BACKWARD_COMPATIBILITY set, which is the default.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "i2c_bus_cmd_link.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**************************************** Legacy driver subset *********************************************/
+
+typedef int i2c_port_t; /*!< I2C port number */
+
+#define I2C_NUM_0 (0)                   /*!< I2C port 0 */
+#define I2C_NUM_1 (1)                   /*!< I2C port 1 */
+#define I2C_NUM_MAX (2)                 /*!< I2C port max */
+#define I2C_SCLK_SRC_FLAG_FOR_NOMAL (0) /*!< Any one clock source that is available for the specified frequency may be choosen */
+
+typedef enum
+{
+    I2C_MODE_SLAVE = 0, /*!< I2C slave mode */
+    I2C_MODE_MASTER,    /*!< I2C master mode */
+    I2C_MODE_MAX,
+} i2c_mode_t;
+
+typedef enum
+{
+    I2C_MASTER_WRITE = 0, /*!< I2C write data */
+    I2C_MASTER_READ,      /*!< I2C read data */
+} i2c_rw_t;
+
+typedef enum
+{
+    I2C_MASTER_ACK = 0x0,       /*!< I2C ack for each byte read */
+    I2C_MASTER_NACK = 0x1,      /*!< I2C nack for each byte read */
+    I2C_MASTER_LAST_NACK = 0x2, /*!< I2C nack for the last byte*/
+    I2C_MASTER_ACK_MAX,
+} i2c_ack_type_t;
+
+/**
+ * @brief I2C initialization parameters, same layout as the legacy driver
+ */
+typedef struct
+{
+    i2c_mode_t mode;    /*!< I2C mode */
+    int sda_io_num;     /*!< GPIO number for I2C sda signal */
+    int scl_io_num;     /*!< GPIO number for I2C scl signal */
+    bool sda_pullup_en; /*!< Internal GPIO pull mode for I2C sda signal*/
+    bool scl_pullup_en; /*!< Internal GPIO pull mode for I2C scl signal*/
+
+    union
+    {
+        struct
+        {
+            uint32_t clk_speed; /*!< I2C clock frequency for master mode */
+        } master;
+        struct
+        {
+            uint8_t addr_10bit_en; /*!< I2C 10bit address mode enable for slave mode */
+            uint16_t slave_addr;   /*!< I2C address for slave mode */
+        } slave;
+    };
+    uint32_t clk_flags; /*!< Bitwise of ``I2C_SCLK_SRC_FLAG_**FOR_DFS**`` for clk source choice*/
+} i2c_config_t;
+
+typedef void *i2c_cmd_handle_t; /*!< I2C command handle  */
+
+esp_err_t i2c_param_config(i2c_port_t i2c_num, const i2c_config_t *i2c_conf);
+esp_err_t i2c_driver_install(i2c_port_t i2c_num, i2c_mode_t mode, size_t slv_rx_buf_len, size_t slv_tx_buf_len, int intr_alloc_flags);
+esp_err_t i2c_driver_delete(i2c_port_t i2c_num);
+i2c_cmd_handle_t i2c_cmd_link_create(void);
+i2c_cmd_handle_t i2c_cmd_link_create_static(uint8_t *buffer, uint32_t size);
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd_handle);
+void i2c_cmd_link_delete_static(i2c_cmd_handle_t cmd_handle);
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd_handle);
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd_handle, uint8_t data, bool ack_en);
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd_handle, const uint8_t *data, size_t data_len, bool ack_en);
+esp_err_t i2c_master_read_byte(i2c_cmd_handle_t cmd_handle, uint8_t *data, i2c_ack_type_t ack);
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd_handle, uint8_t *data, size_t data_len, i2c_ack_type_t ack);
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd_handle);
+esp_err_t i2c_master_cmd_begin(i2c_port_t i2c_num, i2c_cmd_handle_t cmd_handle, TickType_t ticks_to_wait);
+
+/**************************************** Virtual devices *********************************************/
+
+typedef struct i2c_bus_sim_dev i2c_bus_sim_dev_t; /*!< virtual device handle */
+
+/**
+ * @brief Behaviour of a virtual device, every callback is optional
+ */
+typedef struct
+{
+    /**
+     * @brief Called when the master reads a register
+     *
+     * @param dev the device, registers can be accessed with i2c_bus_sim_dev_regs
+     * @param reg register read
+     * @param value value to return, preset to the register map content
+     * @param ctx user context
+     * @return uint8_t register read next, normally reg + 1
+     */
+    uint8_t (*read)(i2c_bus_sim_dev_t *dev, uint8_t reg, uint8_t *value, void *ctx);
+
+    /**
+     * @brief Called when the master writes a register, the register map is updated before the call
+     *
+     * @param dev the device
+     * @param reg register written
+     * @param value value written
+     * @param ctx user context
+     * @return uint8_t register written next, normally reg + 1
+     */
+    uint8_t (*write)(i2c_bus_sim_dev_t *dev, uint8_t reg, uint8_t value, void *ctx);
+
+    /**
+     * @brief Called when the master sets the register pointer, e.g. to model special function addresses
+     *        that act on the address write alone (i2c_bus_write_byte with NULL_I2C_MEM_ADDR)
+     *
+     * @param dev the device
+     * @param reg register address written
+     * @param ctx user context
+     */
+    void (*address)(i2c_bus_sim_dev_t *dev, uint8_t reg, void *ctx);
+} i2c_bus_sim_dev_ops_t;
+
+/**
+ * @brief Virtual device configuration
+ */
+typedef struct
+{
+    uint8_t dev_addr;                  /*!< 7-bit device address */
+    const uint8_t *reg_init;           /*!< 256 initial register values, NULL for all zero */
+    const i2c_bus_sim_dev_ops_t *ops;  /*!< scripted behaviour, NULL for a plain register map */
+    void *ctx;                         /*!< user context passed to ops */
+    uint32_t max_clk_speed;            /*!< above this SCL frequency reads return 0xFF, 0 for no limit */
+} i2c_bus_sim_dev_config_t;
+
+/**
+ * @brief Simulated bus counters
+ */
+typedef struct
+{
+    uint32_t transactions; /*!< command links executed */
+    uint32_t bytes;        /*!< bytes on the wire, address bytes included */
+    uint32_t nacks;        /*!< transfers ended by a NACK */
+    uint64_t bus_time_us;  /*!< simulated wire time */
+} i2c_bus_sim_stats_t;
+
+/**
+ * @brief Attach a virtual device to a simulated bus, can be called before or after the bus is created
+ *
+ * @param port I2C port number
+ * @param dev_conf Pointer to device configuration
+ * @return i2c_bus_sim_dev_t* device handle, NULL if failed
+ */
+i2c_bus_sim_dev_t *i2c_bus_sim_dev_create(i2c_port_t port, const i2c_bus_sim_dev_config_t *dev_conf);
+
+/**
+ * @brief Detach a virtual device and release it
+ *
+ * @param p_dev Pointer to the device handle, set to NULL after deleted
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ */
+esp_err_t i2c_bus_sim_dev_delete(i2c_bus_sim_dev_t **p_dev);
+
+/**
+ * @brief Get the register map of a virtual device.
+ *        Outside of device callbacks, access it between i2c_bus_sim_lock and i2c_bus_sim_unlock.
+ *
+ * @param dev the device
+ * @return uint8_t* 256 registers
+ */
+uint8_t *i2c_bus_sim_dev_regs(i2c_bus_sim_dev_t *dev);
+
+/**
+ * @brief Make a virtual device hold SDA low, every transfer on its bus times out until the bus is recovered
+ *
+ * @param dev the device
+ * @param pulses SCL pulses the device needs to release SDA, 0 to release it now
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ */
+esp_err_t i2c_bus_sim_dev_set_stuck(i2c_bus_sim_dev_t *dev, uint8_t pulses);
+
+/**
+ * @brief Bus recovery sequence on a simulated bus, used by i2c_bus instead of GPIO bit-banging
+ *
+ * @param port I2C port number
+ * @param pulses SCL pulses generated
+ * @return true SDA is released
+ * @return false a device still holds SDA low
+ */
+bool i2c_bus_sim_line_recover(i2c_port_t port, uint8_t pulses);
+
+/**
+ * @brief Busy wait, advances the simulated time without sleeping
+ *
+ * @param us time to wait
+ */
+void i2c_bus_sim_delay_us(uint32_t us);
+
+/**
+ * @brief Lock the simulated buses against transfers, e.g. to update registers from a test
+ */
+void i2c_bus_sim_lock(void);
+
+/**
+ * @brief Unlock the simulated buses
+ */
+void i2c_bus_sim_unlock(void);
+
+/**
+ * @brief Override the wire time of one byte (9 clocks) on a simulated bus
+ *
+ * @param port I2C port number
+ * @param byte_time_ns time of one byte, 0 to derive it from the configured SCL frequency
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ */
+esp_err_t i2c_bus_sim_set_byte_time(i2c_port_t port, uint32_t byte_time_ns);
+
+/**
+ * @brief Get counters of a simulated bus
+ *
+ * @param port I2C port number
+ * @param stats Pointer to save the counters
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ */
+esp_err_t i2c_bus_sim_get_stats(i2c_port_t port, i2c_bus_sim_stats_t *stats);
+
+/**
+ * @brief Reset counters of a simulated bus
+ *
+ * @param port I2C port number
+ * @return esp_err_t
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Parameter error
+ */
+esp_err_t i2c_bus_sim_reset_stats(i2c_port_t port);
+
+/**
+ * @brief Simulated time, host monotonic time plus the wire time of all simulated transfers.
+ *        Can be called from device callbacks. i2c_bus uses it instead of esp_timer on the linux target, so bus statistics report simulated wire time.
+ *
+ * @return int64_t time in microseconds
+ */
+int64_t i2c_bus_sim_get_time_us(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,132 @@
+// Copyright 2020-2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Same register workload on the backend selected in menuconfig, built once per backend (see CMakeLists.txt):
+ * - byte: single register reads
+ * - burst: 32 byte reads
+ * - write: single register writes
+ * - txn: one transaction of four register reads
+ * - switch: reads alternating between a 100 kHz and a 400 kHz device handle, one clock switch per read
+ * Each line gives the wall time per call and the i2c_bus_get_stats counters of the run.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "esp_timer.h"
+#include "i2c_bus.h"
+
+#define BENCH_PORT       I2C_NUM_0
+#define BENCH_SDA_IO     22
+#define BENCH_SCL_IO     21
+#define BENCH_CLK_SPEED  400000
+#define BENCH_DEV_ADDR   0x39 /* APDS9960 */
+#define BENCH_READ_REG   0x92 /* ID, read only */
+#define BENCH_BURST_REG  0x80 /* ENABLE and the following configuration registers */
+#define BENCH_WRITE_REG  0x89 /* PILT, proximity low threshold, no effect while proximity interrupts are off */
+#define BENCH_CALLS      1000
+
+typedef esp_err_t (*bench_fn_t)(i2c_bus_device_handle_t dev, i2c_bus_device_handle_t slow, int i);
+
+static esp_err_t bench_byte(i2c_bus_device_handle_t dev, i2c_bus_device_handle_t slow, int i)
+{
+    uint8_t data = 0;
+    return i2c_bus_read_byte(dev, BENCH_READ_REG, &data);
+}
+
+static esp_err_t bench_burst(i2c_bus_device_handle_t dev, i2c_bus_device_handle_t slow, int i)
+{
+    uint8_t data[32];
+    return i2c_bus_read_bytes(dev, BENCH_BURST_REG, sizeof(data), data);
+}
+
+static esp_err_t bench_write(i2c_bus_device_handle_t dev, i2c_bus_device_handle_t slow, int i)
+{
+    return i2c_bus_write_byte(dev, BENCH_WRITE_REG, (uint8_t) i);
+}
+
+static esp_err_t bench_txn(i2c_bus_device_handle_t dev, i2c_bus_device_handle_t slow, int i)
+{
+    i2c_bus_txn_t txn;
+    uint8_t data[4];
+    esp_err_t ret = i2c_bus_txn_begin(&txn, dev);
+
+    for (int n = 0; n < 4 && ret == ESP_OK; n++) {
+        ret = i2c_bus_txn_add_read(&txn, BENCH_BURST_REG + n, 1, &data[n]);
+    }
+
+    return ret == ESP_OK ? i2c_bus_txn_commit(&txn) : ret;
+}
+
+static esp_err_t bench_switch(i2c_bus_device_handle_t dev, i2c_bus_device_handle_t slow, int i)
+{
+    uint8_t data = 0;
+    return i2c_bus_read_byte((i & 1) ? slow : dev, BENCH_READ_REG, &data);
+}
+
+static void bench_run(i2c_bus_handle_t bus, const char *name, bench_fn_t fn, i2c_bus_device_handle_t dev, i2c_bus_device_handle_t slow)
+{
+    i2c_bus_stats_t stats = {0};
+    int failed = 0;
+    int max_bin = 0;
+    i2c_bus_reset_stats(bus);
+    int64_t start = esp_timer_get_time();
+
+    for (int i = 0; i < BENCH_CALLS; i++) {
+        failed += (fn(dev, slow, i) != ESP_OK);
+    }
+
+    int64_t elapsed = esp_timer_get_time() - start;
+    i2c_bus_get_stats(bus, &stats);
+
+    for (int b = 0; b < I2C_BUS_STATS_HIST_BINS; b++) {
+        max_bin = stats.latency_hist[b] != 0 ? b : max_bin;
+    }
+
+    printf("%-7s %8.1f %6" PRIu32 " %6d %8.1f %8.1f %9d\n", name, (double) elapsed / BENCH_CALLS, stats.transactions, failed,
+           stats.transactions ? (double) stats.xfer_us / stats.transactions : 0.0,
+           (double) stats.lock_wait_us / BENCH_CALLS, 1 << max_bin);
+}
+
+void app_main(void)
+{
+    i2c_config_t conf = {
+        .mode = I2C_MODE_MASTER,
+        .sda_io_num = BENCH_SDA_IO,
+        .scl_io_num = BENCH_SCL_IO,
+        .sda_pullup_en = true,
+        .scl_pullup_en = true,
+        .master.clk_speed = BENCH_CLK_SPEED,
+    };
+    i2c_bus_handle_t bus = i2c_bus_create(BENCH_PORT, &conf);
+    i2c_bus_device_handle_t dev = i2c_bus_device_create(bus, BENCH_DEV_ADDR, 0);
+    i2c_bus_device_handle_t slow = i2c_bus_device_create(bus, BENCH_DEV_ADDR, 100000);
+
+#ifdef CONFIG_I2C_BUS_BACKEND_I2C_MASTER
+    printf("backend i2c_master, queue depth %d\n", CONFIG_I2C_BUS_I2C_MASTER_QUEUE_DEPTH);
+#else
+    printf("backend legacy\n");
+#endif
+    printf("%d calls per run, device 0x%02x at %d Hz\n", BENCH_CALLS, BENCH_DEV_ADDR, BENCH_CLK_SPEED);
+    printf("%-7s %8s %6s %6s %8s %8s %9s\n", "run", "us/call", "xfers", "failed", "xfer us", "wait us", "max us <");
+    bench_run(bus, "byte", bench_byte, dev, slow);
+    bench_run(bus, "burst", bench_burst, dev, slow);
+    bench_run(bus, "write", bench_write, dev, slow);
+    bench_run(bus, "txn", bench_txn, dev, slow);
+    bench_run(bus, "switch", bench_switch, dev, slow);
+
+    i2c_bus_device_delete(&slow);
+    i2c_bus_device_delete(&dev);
+    i2c_bus_delete(&bus);
+}
@@ -0,0 +1,298 @@
+// Copyright 2020-2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "i2c_bus.h"
+#include "apds9960.h"
+#include "apds9960_sim.h"
+
+#define TEST_PORT       I2C_NUM_0
+#define TEST_PLAIN_ADDR 0x50
+#define TEST_FAST_ADDR  0x52
+
+#define TEST_CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d %s\n", __func__, __LINE__, #cond); \
+            s_failures++; \
+        } \
+    } while (0)
+
+static int s_failures = 0;
+
+/* a plain register map answers scans and keeps what is written */
+static void test_plain_device(i2c_bus_handle_t bus)
+{
+    uint8_t addrs[4] = {0};
+    uint8_t data[4] = {0x11, 0x22, 0x33, 0x44};
+    uint8_t back[4] = {0};
+    uint8_t found = 0;
+    TEST_CHECK(i2c_bus_scan_with_config(bus, NULL, addrs, sizeof(addrs), &found) == ESP_OK);
+    TEST_CHECK(found == 2);
+    TEST_CHECK(i2c_bus_scan_is_present(bus, TEST_PLAIN_ADDR));
+
+    i2c_bus_device_handle_t dev = i2c_bus_device_create(bus, TEST_PLAIN_ADDR, 0);
+    TEST_CHECK(dev != NULL);
+    TEST_CHECK(i2c_bus_write_bytes(dev, 0x10, sizeof(data), data) == ESP_OK);
+    TEST_CHECK(i2c_bus_read_bytes(dev, 0x10, sizeof(back), back) == ESP_OK);
+    TEST_CHECK(memcmp(data, back, sizeof(data)) == 0);
+
+    /* nobody answers at 0x51, the driver reports a missing ACK as ESP_FAIL */
+    i2c_bus_device_handle_t absent = i2c_bus_device_create(bus, TEST_PLAIN_ADDR + 1, 0);
+    TEST_CHECK(i2c_bus_read_bytes(absent, 0x00, 1, back) == ESP_FAIL);
+    i2c_bus_device_delete(&absent);
+    i2c_bus_device_delete(&dev);
+}
+
+static void test_stream_on_chunk(const uint8_t *chunk, size_t len, void *user_ctx)
+{
+    memcpy((uint8_t *) user_ctx, chunk, len);
+}
+
+/* stream chunks come from the device, never from the register cache */
+static void test_stream(i2c_bus_handle_t bus, i2c_bus_sim_dev_t *plain)
+{
+    i2c_bus_device_handle_t dev = i2c_bus_device_create(bus, TEST_PLAIN_ADDR, 0);
+    uint8_t data[4] = {0};
+    uint8_t buf[2 * sizeof(data)];
+    uint8_t out[sizeof(data)] = {0};
+    TEST_CHECK(i2c_bus_reg_cache_enable(dev, NULL, 0) == ESP_OK);
+    TEST_CHECK(i2c_bus_read_bytes(dev, 0x30, sizeof(data), data) == ESP_OK);
+    i2c_bus_sim_lock();
+    memset(i2c_bus_sim_dev_regs(plain) + 0x30, 0x5A, sizeof(data));
+    i2c_bus_sim_unlock();
+    i2c_bus_stream_config_t stream_conf = {
+        .mem_address = 0x30,
+        .chunk_len = sizeof(data),
+        .buf = buf,
+        .on_chunk = test_stream_on_chunk,
+        .user_ctx = out,
+    };
+    TEST_CHECK(i2c_bus_read_stream(dev, &stream_conf, sizeof(data)) == ESP_OK);
+    TEST_CHECK(out[0] == 0x5A && out[3] == 0x5A);
+    i2c_bus_device_delete(&dev);
+}
+
+/* a coalesced status is served within its window, until a transfer the cache can not follow */
+static void test_coalesce(i2c_bus_handle_t bus, i2c_bus_sim_dev_t *plain)
+{
+    i2c_bus_device_handle_t dev = i2c_bus_device_create(bus, TEST_PLAIN_ADDR, 0);
+    const uint8_t status_reg = 0x40;
+    uint8_t status = 0;
+    TEST_CHECK(i2c_bus_reg_cache_enable(dev, &status_reg, 1) == ESP_OK);
+    TEST_CHECK(i2c_bus_reg_cache_set_coalesce(dev, &status_reg, 1, 1000000) == ESP_OK);
+    TEST_CHECK(i2c_bus_read_byte(dev, status_reg, &status) == ESP_OK);
+    i2c_bus_sim_lock();
+    i2c_bus_sim_dev_regs(plain)[status_reg] = 0x01;
+    i2c_bus_sim_unlock();
+    TEST_CHECK(i2c_bus_read_byte(dev, status_reg, &status) == ESP_OK);
+    TEST_CHECK(status == 0x00);
+
+    /* a write without register address, e.g. an interrupt clear, ends the window */
+    TEST_CHECK(i2c_bus_write_bytes(dev, NULL_I2C_MEM_ADDR, 1, &status_reg) == ESP_OK);
+    TEST_CHECK(i2c_bus_read_byte(dev, status_reg, &status) == ESP_OK);
+    TEST_CHECK(status == 0x01);
+
+    /* and so does a raw command link */
+    i2c_bus_sim_lock();
+    i2c_bus_sim_dev_regs(plain)[status_reg] = 0x02;
+    i2c_bus_sim_unlock();
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (TEST_PLAIN_ADDR << 1) | I2C_MASTER_WRITE, true);
+    i2c_master_stop(cmd);
+    TEST_CHECK(i2c_bus_cmd_begin(dev, cmd) == ESP_OK);
+    i2c_cmd_link_delete(cmd);
+    TEST_CHECK(i2c_bus_read_byte(dev, status_reg, &status) == ESP_OK);
+    TEST_CHECK(status == 0x02);
+    i2c_bus_device_delete(&dev);
+}
+
+/* a failed read is sent again, a failed write never is */
+static void test_retry(i2c_bus_handle_t bus)
+{
+    i2c_bus_device_config_t dev_conf = {
+        .dev_addr = TEST_PLAIN_ADDR + 1,
+        .retries = 2,
+    };
+    i2c_bus_device_handle_t absent = i2c_bus_device_create_with_config(bus, &dev_conf);
+    i2c_bus_stats_t stats = {0};
+    uint8_t data = 0;
+    TEST_CHECK(i2c_bus_read_byte(absent, 0x00, &data) == ESP_FAIL);
+    TEST_CHECK(i2c_bus_device_get_stats(absent, &stats) == ESP_OK);
+    TEST_CHECK(stats.retries == 2);
+    TEST_CHECK(i2c_bus_write_byte(absent, 0x00, data) == ESP_FAIL);
+    TEST_CHECK(i2c_bus_device_get_stats(absent, &stats) == ESP_OK);
+    TEST_CHECK(stats.retries == 2);
+    i2c_bus_device_delete(&absent);
+}
+
+/* the probe stops below the device limit or at the caller limit, the wire time of a burst scales with the clock */
+static void test_probe_clk_speed(i2c_bus_handle_t bus)
+{
+    uint8_t regs[256] = {0};
+    regs[0x0F] = 0xA5;
+    i2c_bus_sim_dev_config_t fast_conf = {
+        .dev_addr = TEST_FAST_ADDR,
+        .reg_init = regs,
+        .max_clk_speed = 600000,
+    };
+    i2c_bus_sim_dev_t *fast = i2c_bus_sim_dev_create(TEST_PORT, &fast_conf);
+    i2c_bus_device_handle_t dev = i2c_bus_device_create(bus, TEST_FAST_ADDR, 100000);
+    i2c_bus_device_handle_t dev_default = i2c_bus_device_create(bus, TEST_FAST_ADDR, 0);
+    uint32_t clk_speed = 0;
+    uint8_t value = 0;
+    TEST_CHECK(i2c_bus_device_probe_clk_speed(dev, 0x0F, 0xA5, 1000000, &clk_speed) == ESP_OK);
+    TEST_CHECK(clk_speed == 600000);
+    TEST_CHECK(i2c_bus_read_byte(dev, 0x0F, &value) == ESP_OK);
+    TEST_CHECK(i2c_bus_get_current_clk_speed(bus) == 600000);
+    /* a limit between two steps is tried last */
+    TEST_CHECK(i2c_bus_device_probe_clk_speed(dev, 0x0F, 0xA5, 500000, &clk_speed) == ESP_OK);
+    TEST_CHECK(clk_speed == 500000);
+    /* a limit below 100 kHz is probed as is */
+    TEST_CHECK(i2c_bus_device_probe_clk_speed(dev, 0x0F, 0xA5, 50000, &clk_speed) == ESP_OK);
+    TEST_CHECK(clk_speed == 50000);
+    /* a device on the bus default clock is left on it */
+    TEST_CHECK(i2c_bus_device_probe_clk_speed(dev_default, 0x0F, 0xA5, 600000, &clk_speed) == ESP_OK);
+    TEST_CHECK(clk_speed == 600000);
+    TEST_CHECK(i2c_bus_read_byte(dev_default, 0x0F, &value) == ESP_OK);
+    TEST_CHECK(i2c_bus_get_current_clk_speed(bus) == 400000);
+    i2c_bus_device_delete(&dev_default);
+    i2c_bus_device_delete(&dev);
+
+    /* 32 byte FIFO burst at Fast-mode and Fast-mode Plus, wire time only */
+    uint8_t buf[32];
+    uint32_t burst_us[2] = {0};
+    const uint32_t clk[2] = {400000, 1000000};
+
+    for (int i = 0; i < 2; i++) {
+        i2c_bus_sim_stats_t sim_stats = {0};
+        dev = i2c_bus_device_create(bus, TEST_PLAIN_ADDR, clk[i]);
+        i2c_bus_sim_reset_stats(TEST_PORT);
+        TEST_CHECK(i2c_bus_read_bytes(dev, 0x00, sizeof(buf), buf) == ESP_OK);
+        i2c_bus_sim_get_stats(TEST_PORT, &sim_stats);
+        burst_us[i] = (uint32_t) sim_stats.bus_time_us;
+        i2c_bus_device_delete(&dev);
+    }
+
+    printf("32 byte burst: %u us at 400 kHz, %u us at 1 MHz\n", (unsigned int) burst_us[0], (unsigned int) burst_us[1]);
+    TEST_CHECK(burst_us[1] * 2 < burst_us[0]);
+    i2c_bus_sim_dev_delete(&fast);
+}
+
+/* a replayed transfer runs at its recorded clock */
+static void test_trace_replay(i2c_bus_handle_t bus)
+{
+    i2c_bus_trace_entry_t entry = {
+        .mem_address = 0x00,
+        .rx_len = 32,
+        .dev_addr = TEST_PLAIN_ADDR,
+        .flags = I2C_BUS_TRACE_FLAG_READ,
+        .port = TEST_PORT,
+    };
+    uint32_t wire_us[2] = {0};
+    const uint32_t clk[2] = {100000, 1000000};
+
+    for (int i = 0; i < 2; i++) {
+        i2c_bus_trace_replay_stats_t stats = {0};
+        i2c_bus_sim_stats_t sim_stats = {0};
+        entry.clk_speed = clk[i];
+        i2c_bus_sim_reset_stats(TEST_PORT);
+        TEST_CHECK(i2c_bus_trace_replay(bus, &entry, 1, &stats) == ESP_OK);
+        TEST_CHECK(stats.replayed == 1 && stats.failed == 0);
+        i2c_bus_sim_get_stats(TEST_PORT, &sim_stats);
+        wire_us[i] = (uint32_t) sim_stats.bus_time_us;
+    }
+
+    printf("replayed 32 byte read: %u us at 100 kHz, %u us at 1 MHz\n", (unsigned int) wire_us[0], (unsigned int) wire_us[1]);
+    TEST_CHECK(wire_us[1] * 5 < wire_us[0]);
+}
+
+/* interrupt clears are special function writes, only the address reaches the sensor */
+static void test_apds9960_clear_interrupt(i2c_bus_handle_t bus, apds9960_handle_t sensor)
+{
+    i2c_bus_device_handle_t dev = i2c_bus_device_create(bus, APDS9960_I2C_ADDRESS, 0);
+    uint8_t status = 0;
+    /* STATUS is read only on the sensor, the model lets the test raise PINT and AINT */
+    TEST_CHECK(i2c_bus_write_byte(dev, APDS9960_STATUS, 0x30) == ESP_OK);
+    TEST_CHECK(apds9960_get_proximity_interrupt(sensor));
+    TEST_CHECK(apds9960_clear_interrupt(sensor) == ESP_OK);
+    TEST_CHECK(i2c_bus_read_byte(dev, APDS9960_STATUS, &status) == ESP_OK);
+    TEST_CHECK((status & 0x30) == 0);
+    TEST_CHECK(!apds9960_get_proximity_interrupt(sensor));
+    i2c_bus_device_delete(&dev);
+}
+
+/* a recorded upward swipe is recognised once it is replayed into the gesture FIFO */
+static void test_apds9960_gesture(apds9960_sim_handle_t sim, apds9960_handle_t sensor)
+{
+    /* UDLR datasets, the hand crosses U first then D, and leaves */
+    static const uint8_t up[][4] = {
+        {2, 2, 2, 2}, {2, 2, 2, 2}, {40, 6, 16, 16}, {90, 14, 40, 40},
+        {120, 40, 80, 80}, {90, 90, 100, 100}, {40, 120, 80, 80}, {14, 90, 40, 40},
+        {6, 40, 16, 16}, {2, 2, 2, 2}, {2, 2, 2, 2}, {2, 2, 2, 2},
+    };
+    TEST_CHECK(apds9960_gesture_init(sensor) == ESP_OK);
+    TEST_CHECK(apds9960_sim_play_gesture(sim, up, sizeof(up) / sizeof(up[0]), 0) == ESP_OK);
+    TEST_CHECK(apds9960_read_gesture(sensor) == APDS9960_UP);
+}
+
+/* the bus counters see the simulated wire time */
+static void test_stats(i2c_bus_handle_t bus)
+{
+    i2c_bus_stats_t stats = {0};
+    i2c_bus_sim_stats_t sim_stats = {0};
+    TEST_CHECK(i2c_bus_get_stats(bus, &stats) == ESP_OK);
+    TEST_CHECK(i2c_bus_sim_get_stats(TEST_PORT, &sim_stats) == ESP_OK);
+    TEST_CHECK(stats.transactions > 0);
+    TEST_CHECK(stats.nacks >= 1);
+    TEST_CHECK(sim_stats.bus_time_us > 0);
+}
+
+void app_main(void)
+{
+    i2c_bus_sim_dev_config_t plain_conf = {
+        .dev_addr = TEST_PLAIN_ADDR,
+    };
+    i2c_bus_sim_dev_t *plain = i2c_bus_sim_dev_create(TEST_PORT, &plain_conf);
+    apds9960_sim_handle_t sim = apds9960_sim_create(TEST_PORT, APDS9960_I2C_ADDRESS);
+    i2c_config_t conf = {
+        .mode = I2C_MODE_MASTER,
+        .sda_io_num = 1,
+        .scl_io_num = 2,
+        .sda_pullup_en = true,
+        .scl_pullup_en = true,
+        .master.clk_speed = 400000,
+    };
+    i2c_bus_handle_t bus = i2c_bus_create(TEST_PORT, &conf);
+    apds9960_handle_t sensor = apds9960_create(bus, APDS9960_I2C_ADDRESS);
+
+    test_plain_device(bus);
+    test_retry(bus);
+    test_stream(bus, plain);
+    test_coalesce(bus, plain);
+    test_probe_clk_speed(bus);
+    test_trace_replay(bus);
+    test_apds9960_clear_interrupt(bus, sensor);
+    test_apds9960_gesture(sim, sensor);
+    test_stats(bus);
+
+    apds9960_delete(&sensor);
+    i2c_bus_delete(&bus);
+    apds9960_sim_delete(&sim);
+    i2c_bus_sim_dev_delete(&plain);
+    printf("%s\n", s_failures == 0 ? "i2c_bus host sim test passed" : "i2c_bus host sim test FAILED");
+    exit(s_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -0,0 +1,102 @@
+// Copyright 2020-2021 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Replays a trace dump on the simulated bus and compares the recorded and replayed times.
+ * The dump is the array filled by i2c_bus_trace_dump written as is, e.g. from a debugger or over a serial link.
+ * Every traced address gets a plain register map device without clock limit.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "i2c_bus.h"
+
+#define REPLAY_PORT         I2C_NUM_0
+#define REPLAY_MAX_ENTRIES  4096
+#define REPLAY_FILE_ENV     "I2C_BUS_TRACE_FILE"
+
+static i2c_bus_trace_entry_t s_entries[REPLAY_MAX_ENTRIES];
+static i2c_bus_sim_dev_t *s_devices[0x80];
+
+static size_t replay_load(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+
+    if (f == NULL) {
+        printf("can not open %s\n", path);
+        return 0;
+    }
+
+    size_t num = fread(s_entries, sizeof(i2c_bus_trace_entry_t), REPLAY_MAX_ENTRIES, f);
+    fclose(f);
+    return num;
+}
+
+void app_main(void)
+{
+    const char *path = getenv(REPLAY_FILE_ENV);
+
+    if (path == NULL) {
+        printf("usage: " REPLAY_FILE_ENV "=<trace dump> i2c_bus_trace_replay.elf\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t num = replay_load(path);
+
+    if (num == 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < num; i++) {
+        uint8_t addr = s_entries[i].dev_addr;
+
+        if (addr < 0x80 && s_devices[addr] == NULL) {
+            i2c_bus_sim_dev_config_t dev_conf = {
+                .dev_addr = addr,
+            };
+            s_devices[addr] = i2c_bus_sim_dev_create(REPLAY_PORT, &dev_conf);
+        }
+    }
+
+    i2c_config_t conf = {
+        .mode = I2C_MODE_MASTER,
+        .sda_io_num = 1,
+        .scl_io_num = 2,
+        .sda_pullup_en = true,
+        .scl_pullup_en = true,
+        .master.clk_speed = 100000,
+    };
+    i2c_bus_handle_t bus = i2c_bus_create(REPLAY_PORT, &conf);
+    i2c_bus_trace_replay_stats_t stats = {0};
+    i2c_bus_sim_stats_t sim_stats = {0};
+    esp_err_t ret = i2c_bus_trace_replay(bus, s_entries, num, &stats);
+    i2c_bus_sim_get_stats(REPLAY_PORT, &sim_stats);
+
+    printf("entries %u replayed %u skipped %u failed %u\n", (unsigned int) num, (unsigned int) stats.replayed,
+           (unsigned int) stats.skipped, (unsigned int) stats.failed);
+    printf("recorded %llu us (max %u), replayed %llu us (max %u), wire %llu us\n",
+           (unsigned long long) stats.recorded_us, (unsigned int) stats.recorded_max_us,
+           (unsigned long long) stats.replay_us, (unsigned int) stats.replay_max_us,
+           (unsigned long long) sim_stats.bus_time_us);
+
+    i2c_bus_delete(&bus);
+
+    for (size_t i = 0; i < 0x80; i++) {
+        if (s_devices[i] != NULL) {
+            i2c_bus_sim_dev_delete(&s_devices[i]);
+        }
+    }
+
+    exit(ret == ESP_OK ? EXIT_SUCCESS : EXIT_FAILURE);
+}